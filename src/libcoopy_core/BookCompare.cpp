@@ -56,6 +56,14 @@ int BookCompare::create(coopy::store::TextBook& local,
   return 0;
 }
 
+// true if both books hold the named sheet stored as the same text, so
+// it need only be read once
+static bool sameText(TextBook& a, TextBook& b, const string& name) {
+  if (&a.tail()==&b.tail()) return true;
+  string hash = a.getSheetHash(name);
+  return hash!="" && hash==b.getSheetHash(name);
+}
+
 int BookCompare::compare(TextBook& pivot, TextBook& local, TextBook& remote, 
 			 Patcher& output, const CompareFlags& flags) {
   // Merge currently based purely on names, no content comparison.
@@ -133,9 +141,13 @@ int BookCompare::compare(TextBook& pivot, TextBook& local, TextBook& remote,
       local_sheet = pivot_is_local?pivot_sheet:local.readSheetByIndex(0);
       remote_sheet = pivot_is_remote?pivot_sheet:(local_is_remote?local_sheet:remote.readSheetByIndex(0));
     } else {
+      // digests are only available before sheets are read
+      bool same_pl = sameText(pivot,local,name);
+      bool same_pr = sameText(pivot,remote,name);
+      bool same_lr = sameText(local,remote,name);
       pivot_sheet = pivot.readSheet(name.c_str());
-      local_sheet =  pivot_is_local?pivot_sheet:local.readSheet(name.c_str());
-      remote_sheet = pivot_is_remote?pivot_sheet:(local_is_remote?local_sheet:remote.readSheet(name.c_str()));
+      local_sheet =  same_pl?pivot_sheet:local.readSheet(name.c_str());
+      remote_sheet = same_pr?pivot_sheet:(same_lr?local_sheet:remote.readSheet(name.c_str()));
     }
 
     PolySheet mapping;
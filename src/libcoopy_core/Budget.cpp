@@ -0,0 +1,65 @@
+#include <coopy/Budget.h>
+#include <coopy/Dbg.h>
+
+#include <stdio.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+using namespace coopy::cmp;
+
+// how often to look at memory use, in seconds
+#define BUDGET_MEMORY_INTERVAL 0.01
+
+double Budget::now() {
+#ifdef _WIN32
+  return GetTickCount()/1000.0;
+#else
+  struct timeval tv;
+  gettimeofday(&tv,0/*NULL*/);
+  return tv.tv_sec+tv.tv_usec/1000000.0;
+#endif
+}
+
+double Budget::residentMegabytes() {
+#ifdef _WIN32
+  return 0;
+#else
+  // only available on systems with a Linux-style /proc
+  FILE *fin = fopen("/proc/self/statm","r");
+  if (!fin) return 0;
+  long size = 0, resident = 0;
+  int ct = fscanf(fin,"%ld %ld",&size,&resident);
+  fclose(fin);
+  if (ct!=2) return 0;
+  return ((double)resident)*sysconf(_SC_PAGESIZE)/(1024.0*1024.0);
+#endif
+}
+
+void Budget::start(int time_ms, int memory_mb) {
+  time_limit = (time_ms>0)?time_ms:0;
+  memory_limit = (memory_mb>0)?memory_mb:0;
+  deadline = now()+time_limit/1000.0;
+  checked_memory_at = 0;
+  expired = false;
+}
+
+bool Budget::check() {
+  double t = now();
+  if (time_limit>0 && t>=deadline) {
+    dbg_printf("Budget: out of time\n");
+    expired = true;
+  } else if (memory_limit>0 && t-checked_memory_at>=BUDGET_MEMORY_INTERVAL) {
+    checked_memory_at = t;
+    double mb = residentMegabytes();
+    if (mb>memory_limit) {
+      dbg_printf("Budget: out of memory (%g MB in use)\n", mb);
+      expired = true;
+    }
+  }
+  return expired;
+}
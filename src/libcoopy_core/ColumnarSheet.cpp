@@ -0,0 +1,345 @@
+#include <coopy/ColumnarSheet.h>
+#include <coopy/EfficientMap.h>
+
+#include <string.h>
+
+using namespace std;
+using namespace coopy::store;
+
+#define COLUMNAR_DICT_MIN 1024
+
+class coopy::store::ColumnarDictIndex {
+public:
+  efficient_map<string,unsigned int> index;
+};
+
+ColumnarColumn::~ColumnarColumn() {
+  if (dict_index!=NULL) {
+    delete dict_index;
+    dict_index = NULL;
+  }
+}
+
+unsigned int ColumnarColumn::store(const char *s, int len) {
+  if (dict) {
+    if (dict_index==NULL) {
+      dict_index = new ColumnarDictIndex;
+      COOPY_ASSERT(dict_index);
+    }
+    string key(s,len);
+    efficient_map<string,unsigned int>::const_iterator it =
+      dict_index->index.find(key);
+    if (it!=dict_index->index.end()) {
+      return it->second;
+    }
+    unsigned int code = (unsigned int)dict_values.size();
+    dict_values.push_back(key);
+    dict_index->index[key] = code;
+    return code;
+  }
+  unsigned int at = (unsigned int)bytes.length();
+  bytes.append(s,len);
+  return at;
+}
+
+void ColumnarColumn::append(const char *s, int len, bool null) {
+  offsets.push_back(store(s,len));
+  lengths.push_back(dict?0:(unsigned int)len);
+  nulls.push_back(null);
+  if (dict) {
+    // a column with mostly distinct values gains nothing from a dictionary
+    if (dict_values.size()>COLUMNAR_DICT_MIN &&
+	dict_values.size()*2>offsets.size()) {
+      setDictionary(false);
+    }
+  }
+}
+
+void ColumnarColumn::assign(int p, const char *s, int len, bool null) {
+  nulls[p] = null;
+  if (dict) {
+    offsets[p] = store(s,len);
+    return;
+  }
+  if ((unsigned int)len<=lengths[p]) {
+    if (len>0) memmove(&bytes[offsets[p]],s,len);
+    garbage += lengths[p]-len;
+  } else {
+    garbage += lengths[p];
+    offsets[p] = store(s,len);
+  }
+  lengths[p] = len;
+}
+
+void ColumnarColumn::setDictionary(bool flag) {
+  if (flag==dict) return;
+  int n = size();
+  vector<unsigned int> prev_offsets;
+  vector<unsigned int> prev_lengths;
+  prev_offsets.swap(offsets);
+  prev_lengths.swap(lengths);
+  string prev_bytes;
+  prev_bytes.swap(bytes);
+  vector<string> prev_values;
+  prev_values.swap(dict_values);
+  if (dict_index!=NULL) {
+    delete dict_index;
+    dict_index = NULL;
+  }
+  bool was_dict = dict;
+  dict = flag;
+  garbage = 0;
+  for (int i=0; i<n; i++) {
+    if (was_dict) {
+      const string& v = prev_values[prev_offsets[i]];
+      offsets.push_back(store(v.c_str(),(int)v.length()));
+      lengths.push_back(dict?0:(unsigned int)v.length());
+    } else {
+      offsets.push_back(store(prev_bytes.c_str()+prev_offsets[i],
+			      prev_lengths[i]));
+      lengths.push_back(dict?0:prev_lengths[i]);
+    }
+  }
+}
+
+void ColumnarColumn::compact(const vector<int>& order) {
+  ColumnarColumn next;
+  next.dict = dict;
+  for (int i=0; i<(int)order.size(); i++) {
+    int len = 0;
+    const char *str = data(order[i],len);
+    next.offsets.push_back(next.store(str,len));
+    next.lengths.push_back(dict?0:(unsigned int)len);
+    next.nulls.push_back(nulls[order[i]]);
+  }
+  bytes.swap(next.bytes);
+  offsets.swap(next.offsets);
+  lengths.swap(next.lengths);
+  nulls.swap(next.nulls);
+  dict_values.swap(next.dict_values);
+  ColumnarDictIndex *tmp = dict_index;
+  dict_index = next.dict_index;
+  next.dict_index = tmp;
+  garbage = 0;
+}
+
+
+void ColumnarSheet::clear() {
+  for (int i=0; i<(int)cols.size(); i++) {
+    delete cols[i];
+  }
+  cols.clear();
+  rows.clear();
+  physical = 0;
+  tw = 0;
+}
+
+void ColumnarSheet::addColumnAtEnd() {
+  ColumnarColumn *col = new ColumnarColumn;
+  COOPY_ASSERT(col);
+  col->dict = dictionary;
+  for (int i=0; i<physical; i++) {
+    col->append("",0,false);
+  }
+  cols.push_back(col);
+}
+
+void ColumnarSheet::addField(const char *s, int len, bool escaped) {
+  if (tw>=(int)cols.size()) {
+    addColumnAtEnd();
+  }
+  cols[tw]->append(s,len,escaped);
+  tw++;
+}
+
+void ColumnarSheet::addRecord() {
+  // pad ragged records with empty (not NULL) cells, as CsvSheet does
+  for (int i=tw; i<(int)cols.size(); i++) {
+    cols[i]->append("",0,false);
+  }
+  rows.push_back(physical);
+  physical++;
+  tw = 0;
+}
+
+int ColumnarSheet::readRows(int y0, int count, RowBlock& block) const {
+  int w = width();
+  int h = height();
+  if (y0+count>h) count = h-y0;
+  if (count<0) count = 0;
+  block.reset(y0,w,count);
+  for (int x=0; x<w; x++) {
+    const ColumnarColumn& c = *cols[x];
+    for (int y=y0; y<y0+count; y++) {
+      int p = rows[y];
+      SheetCellView& v = block.cell(x,y);
+      v.data = c.data(p,v.len);
+      v.escaped = c.isNull(p);
+    }
+  }
+  return count;
+}
+
+bool ColumnarSheet::cellString(int x, int y, const std::string& str,
+			       bool escaped) {
+  if (x<0||x>=width()) return false;
+  if (y<0||y>=height()) return false;
+  ColumnarColumn& c = *cols[x];
+  c.assign(rows[y],str.c_str(),(int)str.length(),escaped);
+  if (c.garbage>(long long)c.bytes.length()/2 && c.garbage>65536) {
+    maybeCompact();
+  }
+  return true;
+}
+
+void ColumnarSheet::maybeCompact() {
+  for (int i=0; i<(int)cols.size(); i++) {
+    cols[i]->compact(rows);
+  }
+  physical = (int)rows.size();
+  for (int i=0; i<physical; i++) {
+    rows[i] = i;
+  }
+}
+
+bool ColumnarSheet::deleteColumn(const ColumnRef& column) {
+  int offset = column.getIndex();
+  if (offset<0||offset>=width()) return false;
+  delete cols[offset];
+  cols.erase(cols.begin()+offset);
+  return true;
+}
+
+ColumnRef ColumnarSheet::insertColumn(const ColumnRef& base) {
+  int offset = base.getIndex();
+  if (offset>=width()) return ColumnRef();
+  addColumnAtEnd();
+  if (offset<0) {
+    return ColumnRef(width()-1);
+  }
+  ColumnarColumn *col = cols.back();
+  cols.pop_back();
+  cols.insert(cols.begin()+offset,col);
+  return ColumnRef(offset);
+}
+
+ColumnRef ColumnarSheet::moveColumn(const ColumnRef& src,
+				    const ColumnRef& base) {
+  int offset = base.getIndex();
+  if (offset>=width()) return ColumnRef();
+  int offset_src = src.getIndex();
+  if (offset_src<0||offset_src>=width()) return ColumnRef();
+  ColumnarColumn *col = cols[offset_src];
+  cols.erase(cols.begin()+offset_src);
+  if (offset<0) {
+    cols.push_back(col);
+    return ColumnRef(width()-1);
+  }
+  if (offset>offset_src) offset--;
+  cols.insert(cols.begin()+offset,col);
+  return ColumnRef(offset);
+}
+
+bool ColumnarSheet::deleteRow(const RowRef& src) {
+  int offset = src.getIndex();
+  if (offset<0||offset>=height()) return false;
+  rows.erase(rows.begin()+offset);
+  if (physical>COLUMNAR_DICT_MIN && (int)rows.size()*2<physical) {
+    maybeCompact();
+  }
+  return true;
+}
+
+bool ColumnarSheet::deleteData(int offset) {
+  if (offset<0||offset>height()) return false;
+  rows.resize(offset);
+  maybeCompact();
+  return true;
+}
+
+bool ColumnarSheet::deleteRowSet(const std::vector<int>& ys) {
+  if (ys.size()==0) return true;
+  if (ys[0]<0||ys.back()>=height()) return false;
+  for (int i=1; i<(int)ys.size(); i++) {
+    if (ys[i]<=ys[i-1]) return false;
+  }
+  int at = ys[0];
+  int k = 0;
+  for (int y=ys[0]; y<height(); y++) {
+    if (k<(int)ys.size() && ys[k]==y) {
+      k++;
+      continue;
+    }
+    rows[at] = rows[y];
+    at++;
+  }
+  rows.resize(at);
+  if (physical>COLUMNAR_DICT_MIN && at*2<physical) {
+    maybeCompact();
+  }
+  return true;
+}
+
+bool ColumnarSheet::reorderRows(const std::vector<int>& order) {
+  // a row listed twice would share its cells with its copy
+  std::vector<char> seen(height(),0);
+  std::vector<int> next(order.size());
+  for (int i=0; i<(int)order.size(); i++) {
+    if (order[i]<0||order[i]>=height()) return false;
+    if (seen[order[i]]) return false;
+    seen[order[i]] = 1;
+    next[i] = rows[order[i]];
+  }
+  rows.swap(next);
+  if (physical>COLUMNAR_DICT_MIN && height()*2<physical) {
+    maybeCompact();
+  }
+  return true;
+}
+
+RowRef ColumnarSheet::insertRow(const RowRef& base) {
+  int offset = base.getIndex();
+  if (offset>=height()) return RowRef();
+  for (int i=0; i<(int)cols.size(); i++) {
+    cols[i]->append("",0,false);
+  }
+  if (offset<0) {
+    offset = height();
+    rows.push_back(physical);
+  } else {
+    rows.insert(rows.begin()+offset,physical);
+  }
+  physical++;
+  return RowRef(offset);
+}
+
+RowRef ColumnarSheet::moveRow(const RowRef& src, const RowRef& base) {
+  int offset1 = src.getIndex();
+  if (offset1<0||offset1>=height()) return RowRef();
+  int offset2 = base.getIndex();
+  if (offset2>=height()) return RowRef();
+  int p = rows[offset1];
+  rows.erase(rows.begin()+offset1);
+  if (offset2==-1) {
+    rows.push_back(p);
+    return RowRef(height()-1);
+  }
+  if (offset2>offset1) offset2--;
+  rows.insert(rows.begin()+offset2,p);
+  return RowRef(offset2);
+}
+
+bool ColumnarSheet::resize(int w, int h) {
+  clear();
+  for (int i=0; i<w; i++) {
+    addColumnAtEnd();
+  }
+  for (int j=0; j<h; j++) {
+    for (int i=0; i<w; i++) {
+      cols[i]->append("",0,true);
+    }
+    rows.push_back(physical);
+    physical++;
+  }
+  return true;
+}
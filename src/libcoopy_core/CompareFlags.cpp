@@ -42,5 +42,17 @@ void CompareFlags::copy(const CompareFlags& alt) {
   foreign_pool_set = alt.foreign_pool_set;
   offload_to_sql_when_possible = alt.offload_to_sql_when_possible;
   context_lines = alt.context_lines;
+  viterbi_beam = alt.viterbi_beam;
+  hash_features = alt.hash_features;
+  lsh_bands = alt.lsh_bands;
+  lsh_rows = alt.lsh_rows;
+  key_join = alt.key_join;
+  threads = alt.threads;
+  read_threads = alt.read_threads;
+  time_budget = alt.time_budget;
+  memory_budget = alt.memory_budget;
+  feature_cache = alt.feature_cache;
+  typed_compare = alt.typed_compare;
+  budget = alt.budget;
   default_compare = alt.default_compare;
 }
@@ -31,6 +31,49 @@ void CsvSheet::addField(const char *s, bool escaped) {
   tw++;
 }
 
+int CsvSheet::readRows(int y0, int count, RowBlock& block) const {
+  int w = s.w;
+  if (y0+count>s.h) count = s.h-y0;
+  if (count<0) count = 0;
+  block.reset(y0,w,count);
+  for (int y=y0; y<y0+count; y++) {
+    const std::vector<pairCellType>& row = s.arr[y];
+    int len = (int)row.size();
+    if (len>w) len = w;
+    SheetCellView *out = &block.cell(0,y);
+    for (int x=0; x<len; x++) {
+      const pairCellType& p = row[x];
+      out[x] = SheetCellView(p.first,p.second);
+    }
+    for (int x=len; x<w; x++) {
+      out[x] = SheetCellView("",0,false);
+    }
+  }
+  return count;
+}
+
+void CsvSheet::addRecord(std::vector<pairCellType>& cells) {
+  if (!rec.empty()) {
+    rec.insert(rec.end(),cells.begin(),cells.end());
+    tw += (int)cells.size();
+    cells.clear();
+    addRecord();
+    return;
+  }
+  s.arr.push_back(std::vector<pairCellType>());
+  s.arr.back().swap(cells);
+  tw = (int)s.arr.back().size();
+  if (s.w!=tw && s.w!=0) {
+    valid = false;
+  }
+  if (tw>s.w) {
+    s.w = tw;
+  }
+  tw = 0;
+  th++;
+  s.h = th;
+}
+
 void CsvSheet::addRecord() {
   s.arr.push_back(rec);
   rec.clear();
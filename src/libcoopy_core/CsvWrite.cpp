@@ -2,6 +2,7 @@
 #include <stdlib.h>
 
 #include <coopy/CsvWrite.h>
+#include <coopy/CsvWriter.h>
 #include <coopy/CsvSheet.h>
 #include <coopy/NameSniffer.h>
 #include <coopy/unistdio.h>
@@ -108,15 +109,18 @@ static int write(const DataSheet& src, const Property& config,
     }
   }
 
-  std::string result = src.encode(style);
+  // stream the table out rather than rendering it into a string first
   if (fp) {
-    fwrite(result.c_str(),1,result.length(),fp);
+    CsvWriter writer(fp,style);
+    writer.addSheet(src);
+    writer.flush();
     if (fp!=stdout) {
       fclose(fp);
       fp = NULL;
     }
   } else {
-    *output += result;
+    CsvWriter writer(output,style);
+    writer.addSheet(src);
   }
   return 0;
 }
@@ -0,0 +1,190 @@
+#include <coopy/CsvWriter.h>
+#include <coopy/SheetSchema.h>
+
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace coopy::store;
+using namespace std;
+
+// how much to collect before writing to a file
+#define CSV_WRITE_BUFFER 65536
+
+CsvWriter::CsvWriter(FILE *fp, const SheetStyle& style) {
+  this->fp = fp;
+  buffer.reserve(CSV_WRITE_BUFFER+4096);
+  out = &buffer;
+  init(style);
+}
+
+CsvWriter::CsvWriter(std::string *output, const SheetStyle& style) {
+  fp = 0/*NULL*/;
+  out = output;
+  init(style);
+}
+
+void CsvWriter::init(const SheetStyle& style) {
+  this->style = style;
+  delim = style.getDelimiter();
+  eol = style.getEol();
+  nil = style.getNullToken();
+  have_null = style.haveNullToken();
+  colliding = style.quoteCollidingText();
+  trim = style.shouldTrimEnd();
+  ok = true;
+  cells = 0;
+  row_start = out->length();
+  for (int i=0; i<256; i++) {
+    special[i] = false;
+  }
+  const char *chs = "\"'\r\n\t ";
+  for (int i=0; chs[i]!='\0'; i++) {
+    special[(unsigned char)chs[i]] = true;
+  }
+  special[(unsigned char)delimChar()] = true;
+}
+
+int CsvWriter::findSpecial(const char *str, int len) const {
+  int at = 0;
+#if defined(__SSE2__)
+  if (len>=16) {
+    // compare 16 characters at a time against each special character
+    const char chs[7] = { '"', '\'', '\r', '\n', '\t', ' ', delimChar() };
+    __m128i want[7];
+    for (int i=0; i<7; i++) {
+      want[i] = _mm_set1_epi8(chs[i]);
+    }
+    while (at+16<=len) {
+      __m128i block = _mm_loadu_si128((const __m128i *)(str+at));
+      __m128i hits = _mm_cmpeq_epi8(block,want[0]);
+      for (int i=1; i<7; i++) {
+	hits = _mm_or_si128(hits,_mm_cmpeq_epi8(block,want[i]));
+      }
+      if (_mm_movemask_epi8(hits)!=0) break;
+      at += 16;
+    }
+  }
+#endif
+  for (; at<len; at++) {
+    if (special[(unsigned char)str[at]]) return at;
+  }
+  return len;
+}
+
+void CsvWriter::addCell(const SheetCellView& c) {
+  if (cells==0) {
+    // only ever write out between rows
+    if (fp!=0/*NULL*/&&buffer.length()>=CSV_WRITE_BUFFER) {
+      flush();
+    }
+    row_start = out->length();
+  } else {
+    out->append(delim);
+  }
+  cells++;
+
+  const char *str = c.data;
+  int len = c.len;
+  if (len==0 && c.escaped && have_null) {
+    out->append(nil);
+    return;
+  }
+  bool prefix = false;
+  if (!c.escaped && colliding) {
+    // text that would read back as the null token gets an extra '_'
+    int score = 0;
+    while (score<len && str[score]=='_') {
+      score++;
+    }
+    if (len-score==(int)nil.length() &&
+	memcmp(str+score,nil.c_str(),len-score)==0) {
+      prefix = true;
+    }
+  }
+  if (findSpecial(str,len)==len) {
+    if (prefix) *out += '_';
+    out->append(str,len);
+    return;
+  }
+  addQuoted(str,len,prefix);
+}
+
+void CsvWriter::addQuoted(const char *str, int len, bool prefix) {
+  *out += '"';
+  if (prefix) *out += '_';
+  line_buf.clear();
+  for (int i=0; i<len; i++) {
+    char ch = str[i];
+    if (ch=='"') {
+      *out += '"';
+    }
+    if (ch!='\r'&&ch!='\n') {
+      if (line_buf.length()>0) {
+	out->append(line_buf);
+	line_buf.clear();
+      }
+      *out += ch;
+    } else {
+      // line breaks at the end of a cell are dropped if trimming
+      if (trim) {
+	line_buf += ch;
+      } else {
+	*out += ch;
+      }
+    }
+  }
+  *out += '"';
+}
+
+void CsvWriter::addRow(bool last) {
+  if (cells==0) {
+    row_start = out->length();
+  }
+  if (style.shouldEolAtEof()||!last) {
+    out->append(eol);
+  }
+  cells = 0;
+}
+
+void CsvWriter::addSheet(const DataSheet& sheet) {
+  int w = sheet.width();
+  int h = sheet.height();
+  int header = -1;
+  if (style.shouldMarkHeader()) {
+    SheetSchema *schema = sheet.getSchema();
+    if (schema!=0/*NULL*/) {
+      header = schema->headerHeight();
+    }
+  }
+  RowBlock block;
+  for (int y=0; y<h; y++) {
+    if (!block.contains(y)) {
+      sheet.readRows(y,RowBlock::DEFAULT_HEIGHT,block);
+    }
+    for (int x=0; x<w; x++) {
+      addCell(block.cell(x,y));
+    }
+    int len = (int)(out->length()-row_start);
+    if (w==0) len = 0;
+    addRow(y==h-1);
+    if (header>=0&&header==y) {
+      if (len<3) len = 3;
+      if (len>79) len = 79;
+      out->append(len,'-');
+      out->append(eol);
+    }
+  }
+}
+
+bool CsvWriter::flush() {
+  if (fp!=0/*NULL*/&&buffer.length()>0) {
+    if (fwrite(buffer.c_str(),1,buffer.length(),fp)!=buffer.length()) {
+      ok = false;
+    }
+    buffer.clear();
+  }
+  return ok;
+}
@@ -1,7 +1,8 @@
 
 #include <coopy/DataSheet.h>
-#include <coopy/Sha1Generator.h>
+#include <coopy/Hasher.h>
 #include <coopy/SheetSchema.h>
+#include <coopy/CsvWriter.h>
 
 using namespace coopy::store;
 
@@ -31,106 +32,40 @@ void DataSheet::setMeta(SheetSchema *hint) {
 }
 
 std::string DataSheet::encode(const SheetStyle& style) const {
-  std::string delim = style.getDelimiter();
-  std::string eol = style.getEol();
-  std::string result = "";
-  int last = height()-1;
-  for (int y=0;y<height();y++) {
-    std::string line = "";
-    for (int x=0;x<width();x++) {
-      if (x>0) {
-	line += delim;
-      }
-      line += encodeCell(cellSummary(x,y),style);
-    }
-    int len = line.length();
-    if (style.shouldEolAtEof()||y!=last) {
-      line += eol;
-    }
-    if (style.shouldMarkHeader()) {
-      SheetSchema *schema = getSchema();
-      if (schema!=NULL) {
-	if (schema->headerHeight()>=0) {
-	  if (schema->headerHeight()==y) {
-	    if (len<3) len = 3;
-	    if (len>79) len = 79;
-	    for (int i=0; i<len; i++) {
-	      line += '-';
-	    }
-	    line += eol;
-	  }
-	}
-      }
-    }
-    result += line;
-  }
+  std::string result;
+  CsvWriter writer(&result,style);
+  writer.addSheet(*this);
   return result;
 }
 
 std::string DataSheet::encodeCell(const SheetCell& c, 
 				  const SheetStyle& style) {
-  std::string str = c.text;
-  std::string delim = style.getDelimiter();
-  bool need_quote = false;
-  for (size_t i=0; i<str.length(); i++) {
-    char ch = str[i];
-    if (ch=='"'||ch=='\''||ch==delim[0]||ch=='\r'||ch=='\n'||ch=='\t'||ch==' ') {
-      need_quote = true;
-      break;
-    }
-  }
-  std::string nil = style.getNullToken();
-  /*
-  if (str==nil) {
-    need_quote = !c.escaped;
-  }
-  */
-  //printf("encoding [%s] [%d]\n", str.c_str(), c.escaped);
-  if (str=="" && c.escaped) {
-    if (style.haveNullToken()) {
-      return style.getNullToken();
-    }
-  }
-  std::string result = "";
-  if (!c.escaped) {
-    if (style.quoteCollidingText()) {
-      int score = 0;
-      for (score=0; score<(int)str.length(); score++) {
-	if (str[score]!='_') {
-	  break;
-	}
-      }
-      if (str.substr(score,str.length())==nil) {
-	str = std::string("_") + str;
-      }
-    }
-  }
-  if (need_quote) { result += '"'; }
-  std::string line_buf = "";
-  for (size_t i=0; i<str.length(); i++) {
-    char ch = str[i];
-    if (ch=='"') {
-      result += '"';
-    }
-    if (ch!='\r'&&ch!='\n') {
-      if (line_buf.length()>0) {
-	result += line_buf;
-	line_buf = "";
-      }
-      result += ch;
-    } else {
-      if (style.shouldTrimEnd()) {
-	line_buf+=ch;
-      } else {
-	result+=ch;
-      }
-    }
-  }
-  if (need_quote) { result += '"'; }
+  return encodeCell(SheetCellView(c),style);
+}
+
+std::string DataSheet::encodeCell(const SheetCellView& c, 
+				  const SheetStyle& style) {
+  std::string result;
+  CsvWriter writer(&result,style);
+  writer.addCell(c);
   return result;
 }
 
 
+int DataSheet::readRows(int y0, int count, RowBlock& block) const {
+  int w = width();
+  int h = height();
+  if (y0+count>h) count = h-y0;
+  if (count<0) count = 0;
+  block.reset(y0,w,count);
+  for (int y=y0; y<y0+count; y++) {
+    for (int x=0; x<w; x++) {
+      block.cell(x,y) = cellView(x,y,block.scratch(x,y));
+    }
+  }
+  return count;
+}
+
 bool DataSheet::copyData(const DataSheet& src) {
   if (!canWrite()) {
     fprintf(stderr,"Copy failed, cannot write to target\n");
@@ -187,6 +122,51 @@ Poly<SheetRow> DataSheet::insertRow() {
   return Poly<SheetRow>(row,true);
 }
 
+bool DataSheet::reorderRows(const std::vector<int>& order) {
+  int h = height();
+  int n = (int)order.size();
+  // rank[y] is the position row y has once unlisted rows are deleted
+  std::vector<int> rank(h,-1);
+  for (int i=0; i<n; i++) {
+    int y = order[i];
+    if (y<0||y>=h) return false;
+    if (rank[y]!=-1) return false;
+    rank[y] = 0;
+  }
+  std::vector<int> gone;
+  int kept = 0;
+  for (int y=0; y<h; y++) {
+    if (rank[y]==-1) {
+      gone.push_back(y);
+    } else {
+      rank[y] = kept;
+      kept++;
+    }
+  }
+  if (!deleteRowSet(gone)) return false;
+  // Rows not yet placed keep their relative order below the placed
+  // ones, so the row wanted at i sits at i plus the number of unplaced
+  // rows ranked before it.  A Fenwick tree over ranks keeps that count.
+  std::vector<int> tree(n+1);
+  for (int k=1; k<=n; k++) {
+    tree[k] = k&(-k);
+  }
+  for (int i=0; i<n; i++) {
+    int r = rank[order[i]];
+    int before = 0;
+    for (int k=r; k>0; k-=k&(-k)) {
+      before += tree[k];
+    }
+    for (int k=r+1; k<=n; k+=k&(-k)) {
+      tree[k]--;
+    }
+    int p = i+before;
+    if (p==i) continue;
+    if (moveRow(RowRef(p),RowRef(i)).getIndex()!=i) return false;
+  }
+  return true;
+}
+
 Poly<SheetRow> DataSheet::insertRowOrdered(const RowRef& base) {
   RowRef at = insertRow(base);
   OrderedSheetRow *row = new OrderedSheetRow(this,at.getIndex());
@@ -194,35 +174,38 @@ Poly<SheetRow> DataSheet::insertRowOrdered(const RowRef& base) {
   return Poly<SheetRow>(row,true);
 }
 
-std::string DataSheet::getHash(bool cache) const {
+std::string DataSheet::getHash(bool cache, int kind) const {
   DataSheet *mod = (DataSheet *)this;
-  if (!cache) mod->hash_cache = "";
+  if (!cache || kind!=hash_cache_kind) mod->hash_cache = "";
   if (hash_cache!="") {
-    dbg_printf("(sha1 %ld %s %s)\n", (long int)this, hash_cache.c_str(), desc().c_str());
+    dbg_printf("(hash %ld %s %s)\n", (long int)this, hash_cache.c_str(), desc().c_str());
     return hash_cache;
   }
-  mod->hash_cache = mod->getRawHash();
+  mod->hash_cache_kind = kind;
+  mod->hash_cache = mod->getRawHash(kind);
   if (hash_cache!="") {
-    dbg_printf("(raw sha1 %ld %s %s)\n", (long int)this, hash_cache.c_str(), desc().c_str());
+    dbg_printf("(raw hash %ld %s %s)\n", (long int)this, hash_cache.c_str(), desc().c_str());
     return hash_cache;
   }
-  dbg_printf("Computing sha1\n");
-  Sha1Generator sha1;
+  dbg_printf("Computing hash\n");
+  Hasher hasher(kind);
+  std::string txt;
+  std::string scratch;
   for (int y=0;y<height();y++) {
-    std::string txt;
+    txt.clear();
     for (int x=0;x<width();x++) {
-      SheetCell cell = cellSummary(x,y);
+      SheetCellView cell = cellView(x,y,scratch);
       if (cell.escaped) {
-	txt += "N";
+	txt += 'N';
       } else {
-	txt += "X";
-	txt += cell.text;
+	txt += 'X';
+	cell.appendTo(txt);
       }
     }
-    sha1.add(txt);
+    hasher.add(txt);
   }
-  std::string key = sha1.finish();
-  dbg_printf("sha1 %ld %s %s\n", (long int)this, key.c_str(), desc().c_str());
+  std::string key = hasher.finish();
+  dbg_printf("hash %ld %s %s\n", (long int)this, key.c_str(), desc().c_str());
   if (cache) {
     mod->hash_cache = key;
   }
@@ -0,0 +1,77 @@
+#include <coopy/FeatureCache.h>
+
+#include <ctype.h>
+
+using namespace coopy::cmp;
+using namespace coopy::store;
+using namespace std;
+
+void FeatureCache::tokenize(const SheetCellView& v, int slot,
+			    vector<int>& out) {
+  // as in FPolyMap::add
+  if (slot==0) {
+    part.assign(v.data,v.len);
+    out.push_back(dict.idOf(part));
+    return;
+  }
+  wrap.assign(1,'^');
+  wrap.append(v.data,v.len);
+  wrap += '$';
+  int len = wrap.length();
+  wrap_low = wrap;
+  for (size_t c=0; c<wrap_low.length(); c++) {
+    wrap_low[c] = tolower(wrap_low[c]);
+  }
+  bool need_case = (wrap_low!=wrap);
+  int k = 10-slot*2;
+  for (int i=0; i<len-k; i++){
+    part.assign(wrap,i,k+1);
+    out.push_back(dict.idOf(part));
+    if (need_case) {
+      part_low.assign(wrap_low,i,k+1);
+      if (part_low!=part) {
+	out.push_back(dict.idOf(part_low));
+      }
+    }
+  }
+}
+
+void FeatureCache::getSlot(const SheetCellView& v, int x, int y, int slot,
+			   vector<int>& out) {
+  size_t index = (size_t)x*SLOTS+slot;
+  if (index>=starts.size()) {
+    starts.resize(index+1);
+  }
+  vector<int>& start = starts[index];
+  if (y<(int)start.size() && start[y]>=0) {
+    int at = start[y];
+    int n = ids[at];
+    out.insert(out.end(),ids.begin()+at+1,ids.begin()+at+1+n);
+    return;
+  }
+  size_t prev = out.size();
+  tokenize(v,slot,out);
+  size_t n = out.size()-prev;
+  size_t cost = (n+1)*sizeof(int);
+  if (y>=(int)start.size()) {
+    cost += (y+1-start.size())*sizeof(int);
+  }
+  if (used+cost>limit) return;
+  used += cost;
+  if (y>=(int)start.size()) {
+    start.resize(y+1,-1);
+  }
+  start[y] = (int)ids.size();
+  ids.push_back((int)n);
+  ids.insert(ids.end(),out.begin()+prev,out.end());
+}
+
+void FeatureCache::get(const SheetCellView& v, int x, int y, int ctrl,
+		       vector<int>& out) {
+  out.clear();
+  getSlot(v,x,y,0,out);
+  if (ctrl==0) return;
+  for (int slot=ctrl+1; slot>=1; slot--) {
+    getSlot(v,x,y,slot,out);
+  }
+}
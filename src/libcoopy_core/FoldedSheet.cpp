@@ -35,3 +35,25 @@ SheetCell FoldedSheet::cellSummary(int x, int y) const {
   return SheetCell(result,false);
 }
 
+int FoldedSheet::readRows(int y0, int count, RowBlock& block) const {
+  int w = width();
+  int h = height();
+  if (y0+count>h) count = h-y0;
+  if (count<0) count = 0;
+  block.reset(y0,w,count);
+  for (int y=y0; y<y0+count; y++) {
+    for (int x=0; x<w; x++) {
+      const FoldedCell& c = cell(x,y);
+      if (c.sheet) {
+	block.cell(x,y) = cellView(x,y,block.scratch(x,y));
+	continue;
+      }
+      block.cell(x,y) = SheetCellView(c.datum);
+      if (c.datum.meta.isValid()) {
+	block.setMeta(x,y,c.datum.meta);
+      }
+    }
+  }
+  return count;
+}
+
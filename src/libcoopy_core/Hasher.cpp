@@ -0,0 +1,89 @@
+#include <coopy/Hasher.h>
+
+#include <stdio.h>
+#include <string.h>
+
+using namespace coopy::store;
+using namespace std;
+
+#define FAST_P1 0x9E3779B185EBCA87ULL
+#define FAST_P2 0xC2B2AE3D27D4EB4FULL
+
+static unsigned long long fast_rotl(unsigned long long x, int r) {
+  return (x<<r)|(x>>(64-r));
+}
+
+static unsigned long long fast_final(unsigned long long x) {
+  x = (x^(x>>33))*0xFF51AFD7ED558CCDULL;
+  x = (x^(x>>33))*0xC4CEB9FE1A85EC53ULL;
+  return x^(x>>33);
+}
+
+static unsigned long long fast_word(const unsigned char *at) {
+  // little-endian read, so digests agree across platforms
+  unsigned long long w = 0;
+  for (int i=7; i>=0; i--) {
+    w = (w<<8)|at[i];
+  }
+  return w;
+}
+
+void FastHasher::reset() {
+  h1 = 0x243F6A8885A308D3ULL;
+  h2 = 0x13198A2E03707344ULL;
+  total = 0;
+  npending = 0;
+}
+
+void FastHasher::mix(unsigned long long word) {
+  h1 = fast_rotl(h1^(word*FAST_P1),31)*FAST_P2;
+  h2 = fast_rotl(h2+(word*FAST_P2),27)*FAST_P1+h1;
+}
+
+void FastHasher::add(const char *txt, int len) {
+  if (len<=0) return;
+  const unsigned char *at = (const unsigned char *)txt;
+  total += len;
+  if (npending>0) {
+    while (npending<8 && len>0) {
+      pending[npending++] = *at;
+      at++;
+      len--;
+    }
+    if (npending<8) return;
+    mix(fast_word(pending));
+    npending = 0;
+  }
+  while (len>=8) {
+    mix(fast_word(at));
+    at += 8;
+    len -= 8;
+  }
+  while (len>0) {
+    pending[npending++] = *at;
+    at++;
+    len--;
+  }
+}
+
+void FastHasher::finish(unsigned long long& lo, unsigned long long& hi) {
+  if (npending>0) {
+    memset(pending+npending,0,8-npending);
+    mix(fast_word(pending));
+  }
+  unsigned long long a = h1^total;
+  unsigned long long b = h2^fast_rotl(total,32);
+  a += b;
+  b += a;
+  lo = fast_final(a);
+  hi = fast_final(b^lo);
+  reset();
+}
+
+string FastHasher::finish() {
+  unsigned long long lo, hi;
+  finish(lo,hi);
+  char buf[33];
+  snprintf(buf,sizeof(buf),"%016llx%016llx",hi,lo);
+  return buf;
+}
@@ -50,21 +50,19 @@ void IndexSniffer::sniff() {
   // no useful schema? on to guesswork.
   vector<string> sofar;
   sofar.resize(h);
+  string scratch;
   for (int i=0; i<w; i++) {
     efficient_map<string,int> ct;
     int collide = 0;
     for (int j=0; j<h; j++) {
-      bool escaped = false;
-      string v = sheet.cellString(i,j,escaped);
-      v += escaped?"*":" ";
-      sofar[j] += v;
+      SheetCellView v = sheet.cellView(i,j,scratch);
+      v.appendTo(sofar[j]);
+      sofar[j] += v.escaped?'*':' ';
       //dbg_printf("checking %d %s\n", j, sofar[j].c_str());
-      if (ct.find(sofar[j])==ct.end()) {
-	ct[sofar[j]] = 1;
-      } else {
+      if (!ct.insert(make_pair(sofar[j],1)).second) {
 	collide++;
 	if (collide==1) {
-	  dbg_printf("first collision is for %s\n", v.c_str());
+	  dbg_printf("first collision is for %s\n", v.text().c_str());
 	}
       }
     }
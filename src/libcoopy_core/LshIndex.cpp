@@ -0,0 +1,119 @@
+#include <coopy/LshIndex.h>
+
+#include <algorithm>
+
+using namespace std;
+using namespace coopy::cmp;
+using namespace coopy::store;
+
+// Buckets holding more rows than this say little about any one of
+// them, so a query only takes this many rows from them.
+#define LSH_BUCKET_MAX 50
+
+static unsigned long long lsh_mix(unsigned long long x) {
+  x = (x^(x>>30))*0xBF58476D1CE4E5B9ULL;
+  x = (x^(x>>27))*0x94D049BB133111EBULL;
+  return x^(x>>31);
+}
+
+void LshIndex::setSize(int bands, int rows) {
+  this->bands = bands;
+  this->rows = (rows>0)?rows:1;
+  clear();
+}
+
+void LshIndex::clear() {
+  buckets.clear();
+  sigs.clear();
+  sizes.clear();
+  seen.clear();
+}
+
+void LshIndex::sign(vector<unsigned long long>& features) {
+  sort(features.begin(),features.end());
+  features.erase(unique(features.begin(),features.end()),features.end());
+  int k = bands*rows;
+  sig.assign(k,~0ULL);
+  for (int i=0; i<(int)features.size(); i++) {
+    unsigned long long f = features[i];
+    for (int j=0; j<k; j++) {
+      unsigned long long h = lsh_mix(f+0x9E3779B97F4A7C15ULL*(j+1));
+      if (h<sig[j]) sig[j] = h;
+    }
+  }
+}
+
+unsigned long long LshIndex::bandKey(const unsigned long long *s,
+				     int band) const {
+  unsigned long long key = lsh_mix((unsigned long long)(band+1));
+  for (int i=0; i<rows; i++) {
+    key = lsh_mix(key^s[band*rows+i]);
+  }
+  return key;
+}
+
+void LshIndex::add(int y, vector<unsigned long long>& features) {
+  if (!isActive()) return;
+  if (features.size()==0) return;
+  sign(features);
+  int k = bands*rows;
+  if ((int)sizes.size()<=y) {
+    sizes.resize(y+1,0);
+    sigs.resize((size_t)(y+1)*k,0);
+  }
+  sizes[y] = (int)features.size();
+  copy(sig.begin(),sig.end(),sigs.begin()+(size_t)y*k);
+  for (int b=0; b<bands; b++) {
+    buckets[bandKey(&sig[0],b)].push_back(y);
+  }
+}
+
+void LshIndex::query(int y, vector<unsigned long long>& features,
+		     SparseFloatSheet& match) {
+  if (!isActive()) return;
+  if (features.size()==0) return;
+  sign(features);
+  int k = bands*rows;
+  if (seen.size()<sizes.size()) {
+    seen.resize(sizes.size(),0);
+  }
+  candidates.clear();
+  for (int b=0; b<bands; b++) {
+    efficient_map<unsigned long long, vector<int> >::const_iterator it =
+      buckets.find(bandKey(&sig[0],b));
+    if (it==buckets.end()) continue;
+    const vector<int>& bucket = it->second;
+    int lo = 0;
+    int hi = (int)bucket.size();
+    if (hi>LSH_BUCKET_MAX) {
+      // rows are added in order, so take those nearest to y in order,
+      // which is where a match is most likely to be
+      lo = (int)(lower_bound(bucket.begin(),bucket.end(),y)-bucket.begin());
+      lo -= LSH_BUCKET_MAX/2;
+      if (lo>hi-LSH_BUCKET_MAX) lo = hi-LSH_BUCKET_MAX;
+      if (lo<0) lo = 0;
+      hi = lo+LSH_BUCKET_MAX;
+    }
+    for (int i=lo; i<hi; i++) {
+      int x = bucket[i];
+      if (!seen[x]) {
+	seen[x] = 1;
+	candidates.push_back(x);
+      }
+    }
+  }
+  int nq = (int)features.size();
+  for (int i=0; i<(int)candidates.size(); i++) {
+    int x = candidates[i];
+    seen[x] = 0;
+    const unsigned long long *s = &sigs[(size_t)x*k];
+    int agree = 0;
+    for (int j=0; j<k; j++) {
+      if (s[j]==sig[j]) agree++;
+    }
+    if (agree==0) continue;
+    // estimated overlap, from estimated Jaccard similarity
+    float jac = ((float)agree)/k;
+    match.cell(x,y) += jac*(sizes[x]+nq)/(1+jac);
+  }
+}
@@ -66,6 +66,10 @@ void MeasureMan::compareCore() {
   }
 
   for (int i=0; i<20; i++) {
+    if (flags.budget.exhausted()) {
+      dbg_printf("Out of budget, keeping matches so far\n");
+      break;
+    }
     dbg_printf("\n====================================================\n");
     dbg_printf("== MeasureMan::compare pass %d\n", i);
     compare1(ctrl);
@@ -131,6 +135,9 @@ void MeasureMan::compare1(int ctrl) {
   //dbg_printf("Checking [remote] statistics\n");
   bstat = bnorm_pass.flatten();
 
+  // measurements cut short by the budget are not worth acting on
+  if (flags.budget.exhausted()) return;
+
   if (bstat.valid && astat.valid) {
     // make bnorm look like anorm, statistically
     if (bstat.stddev>0.001) {
@@ -153,6 +160,9 @@ void MeasureMan::compare1(int ctrl) {
 
   bool repeatNeeded = false;
   map<int,int> stateNode, stateNodePrev;
+  // one lattice, reused across repeats so its buffers are kept
+  Viterbi v;
+  v.setBeam(flags.viterbi_beam);
   int stateNodeCount = 0;
   int stateNodePower = 1;
 
@@ -162,7 +172,6 @@ void MeasureMan::compare1(int ctrl) {
 
     repeatNeeded = false;
 
-    Viterbi v;
     /*
       There are match.width() = W nodes
 
@@ -185,22 +194,26 @@ void MeasureMan::compare1(int ctrl) {
     }
     v.setSize(column_stride*history_stride,match_height);
     for (int i=0; i<match_height; i++) {
-      const set<int>& idx0 = flip?match.getCellsInCol(i-1):match.getCellsInRow(i-1);
-      const set<int>& idx1 = flip?match.getCellsInCol(i):match.getCellsInRow(i);
-      const set<int> *pidx0 = &idx0;
+      if (flags.budget.exhausted()) {
+	// abandon this pass, main_pass is untouched so far
+	return;
+      }
+      const vector<int>& idx0 = flip?match.getCellsInCol(i-1):match.getCellsInRow(i-1);
+      const vector<int>& idx1 = flip?match.getCellsInCol(i):match.getCellsInRow(i);
+      const vector<int> *pidx0 = &idx0;
       v.beginTransitions();
       for (int k=0; k<history_stride; k++) {
 	int ksrc = k*column_stride;
-	for (set<int>::const_iterator it1=idx1.begin(); it1!=idx1.end(); 
+	for (vector<int>::const_iterator it1=idx1.begin(); it1!=idx1.end(); 
 	     it1++) {
 	  int i1 = (*it1);
 	  int offset = history_offset[i1];
 	  if (offset&k) continue; // cannot transition here - was there already
 	  int kdest = (k+offset)*column_stride;
 	  
-	  float c = costify(flip?match.cell(i,i1):match.cell(i1,i));
+	  float c = costify(flip?match.cell_const(i,i1):match.cell_const(i1,i));
 	  double mod = 0.1*log(1+fabs((double)(i-i1)))/log(2);
-	  for (set<int>::const_iterator it0=pidx0->begin(); it0!=pidx0->end(); 
+	  for (vector<int>::const_iterator it0=pidx0->begin(); it0!=pidx0->end(); 
 	       it0++) {
 	    int i0 = (*it0);
 	    if (i0!=i1) {
@@ -214,7 +227,7 @@ void MeasureMan::compare1(int ctrl) {
 	  }
 	  v.addTransition(ksrc+0,kdest+i1+1,c);
 	}
-	for (set<int>::const_iterator it0=pidx0->begin(); it0!=pidx0->end(); 
+	for (vector<int>::const_iterator it0=pidx0->begin(); it0!=pidx0->end(); 
 	     it0++) {
 	  int i0 = (*it0);
 	  int offset0 = 0;
@@ -251,10 +264,10 @@ void MeasureMan::compare1(int ctrl) {
 	int bestIndex = v(y)%column_stride-1;
 	double bestValue = 0;
 	if (bestIndex>=0) {
-	  bestValue = flip?match.cell(y,bestIndex):match.cell(bestIndex,y);
+	  bestValue = flip?match.cell_const(y,bestIndex):match.cell_const(bestIndex,y);
 	}
-	double ref = bnorm_pass.match.cell(0,flip?bestIndex:y);
-	double ref2 = anorm_pass.match.cell(0,flip?y:bestIndex);
+	double ref = bnorm_pass.match.cell_const(0,flip?bestIndex:y);
+	double ref2 = anorm_pass.match.cell_const(0,flip?y:bestIndex);
 	if (ref2<ref) ref = ref2;
 	bool ok = false;
 	if (bestValue>ref/4 && bestIndex>=0 && ref>0.01) {
@@ -13,6 +13,7 @@
  */
 
 #include <coopy/MergeOutputCsvDiff.h>
+#include <coopy/CsvWriter.h>
 #include <coopy/SheetStyle.h>
 #include <coopy/DataSheet.h>
 
@@ -34,6 +35,8 @@ using namespace coopy::cmp;
 #define OP_NONE ""
 
 MergeOutputCsvDiff::MergeOutputCsvDiff() {
+  compactReady = false;
+  compactMode = false;
 }
 
 bool MergeOutputCsvDiff::mergeStart() {
@@ -52,6 +55,8 @@ bool MergeOutputCsvDiff::mergeStart() {
 }
 
 bool MergeOutputCsvDiff::mergeClear() {
+  compactReady = false;
+  compactMode = false;
   ops.clear();
   nops.clear();
   activeColumn.clear();
@@ -74,7 +79,9 @@ bool MergeOutputCsvDiff::mergeDone() {
 bool MergeOutputCsvDiff::mergeAllDone() {
   SheetStyle style;
   //SheetCell c = result.cellSummary(0,0);
-  fprintf(out,"%s",result.encode(style).c_str());
+  CsvWriter writer(out,style);
+  writer.addSheet(result);
+  writer.flush();
   return true;
 }
 
@@ -226,6 +233,11 @@ bool MergeOutputCsvDiff::updateRow(const RowChange& change, const char *tag,
 }
 
 bool MergeOutputCsvDiff::changeRow(const RowChange& change) {
+  leaveCompact();
+  return changeNamedRow(change);
+}
+
+bool MergeOutputCsvDiff::changeNamedRow(const RowChange& change) {
   vector<string> lops;
   activeColumn.clear();
   prevSelect = showForSelect;
@@ -242,7 +254,7 @@ bool MergeOutputCsvDiff::changeRow(const RowChange& change) {
     if (change.val.find(name)!=change.val.end()) {
       valueActive = true;
     }
-    bool shouldMatch = condActive && change.indexes.find(name)->second;
+    bool shouldMatch = condActive && change.isIndex(name);
     bool shouldAssign = valueActive;
     if (shouldAssign) {
       // conservative choice, should be optional
@@ -332,7 +344,244 @@ bool MergeOutputCsvDiff::changeRow(const RowChange& change) {
 }
 
 
+static const char *compactOps[4] = {
+  OP_NONE,         // !match  !assign
+  OP_ASSIGN,       // !match   assign
+  OP_MATCH,        //  match  !assign
+  OP_MATCH_ASSIGN, //  match   assign
+};
+
+bool MergeOutputCsvDiff::changeCompactRow(const CompactRowChange& change) {
+  if (!change.columns.isValid()) {
+    return Patcher::changeCompactRow(change);
+  }
+  if (!(compactReady && 
+	compactColumns.getContent()==change.columns.getContent() &&
+	compactOrder==change.columns->order)) {
+    leaveCompact();
+    RowChange expanded;
+    change.toRowChange(expanded);
+    changeNamedRow(expanded);
+    return enterCompact(change);
+  }
+
+  // Same steps as changeNamedRow, by position rather than by name.
+  compactMode = true;
+  int w = (int)compactOrder.size();
+  compactPrevSelect.swap(compactSelect);
+  compactPrevDescribe.swap(compactDescribe);
+  compactSelect.resize(w);
+  compactDescribe.resize(w);
+  bool same = ((int)ops.size()==w);
+  for (int i=0; i<w; i++) {
+    int id = compactOrder[i];
+    bool condActive = change.hasCond(id);
+    bool valueActive = change.hasVal(id);
+    bool shouldMatch = condActive && change.isIndex(id);
+    bool shouldAssign = valueActive;
+    if (shouldAssign) {
+      // conservative choice, should be optional
+      if (condActive) {
+	shouldMatch = true;
+      }
+    }
+    if (change.mode==ROW_CHANGE_INSERT) {
+      // we do not care about matching
+      shouldMatch = compactPrevSelect[i]!=0;
+      shouldAssign = true;
+    }
+    if (change.mode==ROW_CHANGE_DELETE) {
+      // we do not care about assigning
+      shouldAssign = compactPrevDescribe[i]!=0;
+      shouldMatch = true;
+    }
+    int opidx = (shouldMatch?2:0) + (shouldAssign?1:0);
+    compactActive[i] = (opidx!=0);
+    compactSelect[i] = shouldMatch;
+    compactDescribe[i] = shouldAssign;
+    if (same && ops[i]!=compactOps[opidx]) {
+      same = false;
+    }
+  }
+
+  if (!same) {
+    ops.clear();
+    for (int i=0; i<w; i++) {
+      ops.push_back(compactOps[(compactSelect[i]?2:0) + 
+			       (compactDescribe[i]?1:0)]);
+    }
+    operateRow(change,"act");
+  }
+  switch (change.mode) {
+  case ROW_CHANGE_INSERT:
+    updateRow(change,"insert",false,true,false);
+    break;
+  case ROW_CHANGE_DELETE:
+    updateRow(change,"delete",true,false,false);
+    break;
+  case ROW_CHANGE_MOVE:
+    {
+      bool terse = updateRow(change,"practice",true,true,true);
+      if (terse) {
+	updateRow(change,"move",true,true,false);
+      } else {
+	updateRow(change,"select",true,false,false);
+	updateRow(change,"move",false,true,false);
+      }
+    }
+    break;
+  case ROW_CHANGE_CONTEXT:
+    updateRow(change,change.hasAnyCond()?"after":"start",true,false,false);
+    break;
+  case ROW_CHANGE_UPDATE:
+    {
+      bool terse = updateRow(change,"practice",true,true,true);
+      if (terse) {
+	updateRow(change,"update",true,true,false);
+      } else {
+	updateRow(change,"select",true,false,false);
+	updateRow(change,"update",false,true,false);
+      }
+    }
+    break;
+  default:
+    fprintf(stderr,"  Unknown row operation\n\n");
+    exit(1);
+    break;
+  }
+  return true;
+}
+
+bool MergeOutputCsvDiff::operateRow(const CompactRowChange& change, 
+				    const char *tag) {
+  int w = (int)compactOrder.size();
+  vector<string> lnops;
+  for (int i=0; i<w; i++) {
+    if (compactActive[i]) {
+      lnops.push_back(change.nameOf(compactOrder[i]));
+    }
+  }
+  if (lnops!=nops) {
+    if (!showedColumns) {
+      clearThroat();
+      result.addField("column",false);
+      result.addField("name",false);
+      for (int i=0; i<(int)columns.size(); i++) {
+	result.addField(columns[i].c_str(),false);
+      }
+      result.addRecord();
+      showedColumns = true;
+    }
+    if (columns!=lnops) {
+      clearThroat();
+      result.addField("link",false);
+      result.addField("name",false);
+      for (int i=0; i<(int)lnops.size(); i++) {
+	result.addField(lnops[i].c_str(),false);
+      }
+      result.addRecord();
+      columns = lnops;
+    }
+    nops = lnops;
+  }
+
+  if (compactPrevSelect!=compactSelect || 
+      compactPrevDescribe!=compactDescribe) {
+    clearThroat();
+    result.addField((string(tag)=="act")?"link":"row",false);
+    result.addField(tag,false);
+    for (int i=0; i<w; i++) {
+      if (compactActive[i]) {
+	result.addField(ops[i].c_str(),false);
+      }
+    }
+    result.addRecord();
+  }
+  return true;
+}
+
+bool MergeOutputCsvDiff::updateRow(const CompactRowChange& change, 
+				   const char *tag,
+				   bool select, bool update, bool practice) {
+  bool ok = true;
+
+  if (!practice) {
+    clearThroat();
+    result.addField("row",false);
+    result.addField(tag,false);
+  }
+  for (int i=0; i<(int)compactOrder.size(); i++) {
+    if (!compactActive[i]) continue;
+    int id = compactOrder[i];
+    bool shown = false;
+    if (change.hasCond(id) && compactSelect[i] && select) {
+      if (!practice) {
+	result.addField(change.cond[id]);
+      }
+      shown = true;
+    }
+    if (change.hasVal(id) && compactDescribe[i] && update) {
+      if (!practice) {
+	result.addField(change.val[id]);
+      }
+      if (shown) ok = false; // collision
+      shown = true;
+    }
+    if (!shown) {
+      if (!practice) {
+	result.addField("",false);
+      }
+    }
+  }
+  if (!practice) {
+    result.addRecord();
+  }
+  return ok;
+}
+
+bool MergeOutputCsvDiff::enterCompact(const CompactRowChange& change) {
+  // positions stand in for names only if no name repeats
+  const vector<int>& order = change.columns->order;
+  vector<char> seen(change.columns->names.size(),0);
+  for (int i=0; i<(int)order.size(); i++) {
+    if (seen[order[i]]) return true;
+    seen[order[i]] = 1;
+  }
+  compactColumns = change.columns;
+  compactOrder = order;
+  int w = (int)order.size();
+  compactSelect.resize(w);
+  compactDescribe.resize(w);
+  compactActive.resize(w);
+  for (int i=0; i<w; i++) {
+    const string& name = change.nameOf(order[i]);
+    compactSelect[i] = showForSelect[name];
+    compactDescribe[i] = showForDescribe[name];
+    compactActive[i] = activeColumn[name];
+  }
+  compactReady = true;
+  compactMode = false;
+  return true;
+}
+
+bool MergeOutputCsvDiff::leaveCompact() {
+  if (compactMode) {
+    // the maps hold the same names as the vectors, from the
+    // row that entered compact form
+    for (int i=0; i<(int)compactOrder.size(); i++) {
+      const string& name = compactColumns->names[compactOrder[i]];
+      showForSelect[name] = (compactSelect[i]!=0);
+      showForDescribe[name] = (compactDescribe[i]!=0);
+      activeColumn[name] = (compactActive[i]!=0);
+    }
+  }
+  compactReady = false;
+  compactMode = false;
+  return true;
+}
+
 bool MergeOutputCsvDiff::changeName(const NameChange& change) {
+  leaveCompact();
   const vector<string>& names = change.names;
   bool final = change.final;
   bool constant = change.constant;
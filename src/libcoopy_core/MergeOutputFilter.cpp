@@ -5,6 +5,15 @@ using namespace std;
 using namespace coopy::cmp;
 using namespace coopy::store;
 
+static void addInvented(Pool *pool, const string& sheet_name, 
+			const string& column, const SheetCell& val) {
+  PoolColumnLink link = pool->lookup(sheet_name,column);
+  if (link.isInventor()) {
+    PoolRecord& rec = link.getColumn().put(val,SheetCell());
+    rec.linked = false;
+  }
+}
+
 bool MergeOutputFilter::mergeAllDone() {
   Pool *pool = getFlags().pool;
   if (pool) {
@@ -14,8 +23,7 @@ bool MergeOutputFilter::mergeAllDone() {
     map<string,int> seen;
     for (std::list<RowUnit>::iterator it=rows.begin(); it!=rows.end(); it++) {
       RowUnit& unit = *it;
-      RowChange& change = unit.change;
-      if (change.mode == ROW_CHANGE_INSERT) {
+      if (unit.mode() == ROW_CHANGE_INSERT) {
 	const std::string& name = unit.sheet_name;
 
 	if (seen.find(name)==seen.end()) {
@@ -34,12 +42,17 @@ bool MergeOutputFilter::mergeAllDone() {
 	  }
 	}
 
-	for (RowChange::txt2cell::const_iterator it = change.val.begin();
-	     it!=change.val.end(); it++) {
-	  PoolColumnLink link = pool->lookup(name,it->first);
-	  if (link.isInventor()) {
-	    PoolRecord& rec = link.getColumn().put(it->second,SheetCell());
-	    rec.linked = false;
+	if (unit.compact) {
+	  const CompactRowChange& change = unit.compact_change;
+	  for (int id=0; id<change.size(); id++) {
+	    if (!change.hasVal(id)) continue;
+	    addInvented(pool,name,change.nameOf(id),change.val[id]);
+	  }
+	} else {
+	  const RowChange& change = unit.change;
+	  for (RowChange::txt2cell::const_iterator it = change.val.begin();
+	       it!=change.val.end(); it++) {
+	    addInvented(pool,name,it->first,it->second);
 	  }
 	}
       }
@@ -79,6 +92,9 @@ bool MergeOutputFilter::emitRow(const RowUnit& row) {
   if (name!=last_sheet_name) {
     emitPreamble(sheet_units[name]);
   }
+  if (row.compact) {
+    return emitCompactRow(row.compact_change);
+  }
   string resolve = getFlags().resolve;
   if (resolve!="") {
     if (row.change.conflicted) {
@@ -107,6 +123,26 @@ bool MergeOutputFilter::emitRow(const RowUnit& row) {
   return chain->changeRow(row.change);
 }
 
+bool MergeOutputFilter::emitCompactRow(const CompactRowChange& change) {
+  string resolve = getFlags().resolve;
+  if (resolve!="" && change.conflicted) {
+    if (resolve=="ours") {
+      return true;
+    }
+    CompactRowChange change2 = change;
+    for (int id=0; id<change2.size(); id++) {
+      if (resolve=="theirs" && change2.hasConflict(id)) {
+	change2.setVal(id,change2.conflictingVal[id]);
+      } else if (resolve=="neither" && change2.hasConflictParent(id)) {
+	change2.setVal(id,change2.conflictingParentVal[id]);
+      }
+    }
+    change2.clearConflicts();
+    return chain->changeCompactRow(change2);
+  }
+  return chain->changeCompactRow(change);
+}
+
 bool MergeOutputFilter::emitPreamble(const SheetUnit& preamble) {
   string name = preamble.sheet_name;
   //printf("emit [%s]?\n", name.c_str());
@@ -199,18 +235,19 @@ bool MergeOutputFilter::emitPreambleIfNeeded(const SheetUnit& preamble) {
 }
 
 
-bool MergeOutputFilter::changeRow(const RowChange& change) { 
+bool MergeOutputFilter::acceptRow(int mode,
+				  const vector<string>& allNames) { 
   if (!isActiveTable()) return false;
-  SheetUnit unit = getSheetUnit();
+  SheetUnit& unit = getSheetUnit();
   if (!(unit.have_name0||unit.have_name1)) {
     NameChange nc;
     nc.mode = NAME_CHANGE_DECLARE;
     nc.constant = true;
     nc.final = true;
-    nc.names = change.allNames;
+    nc.names = allNames;
     changeName(nc);
   }
-  switch (change.mode) {
+  switch (mode) {
   case ROW_CHANGE_INSERT:
     if (!getFlags().canInsert()) { return false; }
     break;
@@ -222,8 +259,22 @@ bool MergeOutputFilter::changeRow(const RowChange& change) {
     if (!getFlags().canUpdate()) { return false; }
     break;
   }
+  return true;
+}
+
+bool MergeOutputFilter::changeRow(const RowChange& change) { 
+  if (!acceptRow(change.mode,change.allNames)) return false;
   rows.push_back(RowUnit(sheet_name,change));
   getSheetUnit().row_count++;
   return true;
 }
 
+bool MergeOutputFilter::changeCompactRow(const CompactRowChange& change) { 
+  if (!change.columns.isValid()) {
+    return Patcher::changeCompactRow(change);
+  }
+  if (!acceptRow(change.mode,change.columns->allNames)) return false;
+  rows.push_back(RowUnit(sheet_name,change));
+  getSheetUnit().row_count++;
+  return true;
+}
@@ -31,27 +31,61 @@ static string encoder(const SheetCell& x) {
   return encoder(x.text);
 }
 
-static string cond(const vector<string>& names,
-		   const map<string,SheetCell>& conds,
-		   const map<string,SheetCell>& vals,
-		   bool act) {
+namespace {
+  // cells of a row change, column by column, in either form
+  class FullCells {
+  public:
+    const RowChange& change;
+
+    FullCells(const RowChange& change) : change(change) {}
+
+    int width() const { return (int)change.names.size(); }
+    const string& name(int i) const { return change.names[i]; }
+    const SheetCell *cond(int i) const { return find(change.cond,i); }
+    const SheetCell *val(int i) const { return find(change.val,i); }
+
+  private:
+    const SheetCell *find(const RowChange::txt2cell& cells, int i) const {
+      RowChange::txt2cell::const_iterator it = cells.find(name(i));
+      if (it==cells.end()) return 0/*NULL*/;
+      return &(it->second);
+    }
+  };
+
+  class CompactCells {
+  public:
+    const CompactRowChange& change;
+
+    CompactCells(const CompactRowChange& change) : change(change) {}
+
+    int width() const { return change.width(); }
+    const string& name(int i) const { return change.nameOf(change.idAt(i)); }
+    const SheetCell *cond(int i) const {
+      int id = change.idAt(i);
+      return change.hasCond(id)?&change.cond[id]:0/*NULL*/;
+    }
+    const SheetCell *val(int i) const {
+      int id = change.idAt(i);
+      return change.hasVal(id)?&change.val[id]:0/*NULL*/;
+    }
+  };
+}
+
+template <class Cells>
+static string cond(const Cells& cells, bool act) {
   string c = "";
   string pv = "";
   string v = "";
   bool nontrivial_past = false;
-  for (vector<string>::const_iterator it = names.begin();
-       it!=names.end();
-       it++) {
-    string name = *it;
+  for (int i=0; i<cells.width(); i++) {
+    const string& name = cells.name(i);
+    const SheetCell *cval = cells.val(i);
+    const SheetCell *ccond = cells.cond(i);
     if (act) {
-      //if (conds.find(name)!=conds.end()) {
-	//fprintf(stderr,"Missing condition for %s\n", name.c_str());
-	//exit(1);
-      if (vals.find(name)!=vals.end()) {
+      if (cval) {
 	SheetCell pval;
-	SheetCell val = vals.find(name)->second;
-	if (conds.find(name)!=conds.end()) {
-	  pval = conds.find(name)->second;
+	if (ccond) {
+	  pval = *ccond;
 	  if (pval.text!="") {
 	    nontrivial_past = true;
 	  }
@@ -59,20 +93,16 @@ static string cond(const vector<string>& names,
 	if (pv!="") pv += ",";
 	pv += encoder(pval);
 	if (v!="") v += ",";
-	v += encoder(val);
+	v += encoder(*cval);
 	if (c!="") c += ",";
 	c += encoder(name);
       }
-	//}
     } else {
-      if (conds.find(name)!=conds.end()) {
-	if (vals.find(name)==vals.end()) {
-	  SheetCell val = conds.find(name)->second;
-	  if (c!="") c += ",";
-	  c += encoder(name);
-	  if (v!="") v += ",";
-	  v += encoder(val);
-	}
+      if (ccond && !cval) {
+	if (c!="") c += ",";
+	c += encoder(name);
+	if (v!="") v += ",";
+	v += encoder(*ccond);
       }
     }
   }
@@ -85,33 +115,52 @@ static string cond(const vector<string>& names,
   return c + " = " + v;
 }
 
-static string cond(const vector<string>& names,
-		   const map<string,SheetCell>& vals,
+template <class Cells>
+static string cond(const Cells& cells, bool use_vals,
 		   string val_label, string cond_label) {
-  SheetStyle style;
   string c = "";
   string v = "";
-  size_t ct = 0;
-  for (vector<string>::const_iterator it = names.begin();
-       it!=names.end();
-       it++) {
-    string name = *it;
-    if (vals.find(name)!=vals.end()) {
+  int ct = 0;
+  for (int i=0; i<cells.width(); i++) {
+    const SheetCell *val = use_vals?cells.val(i):cells.cond(i);
+    if (val) {
       ct++;
-      SheetCell val = vals.find(name)->second;
       if (c!="") c += " ";
-      c += encoder(name);
+      c += encoder(cells.name(i));
       if (v!="") v += " ";
-      v += encoder(val);
+      v += encoder(*val);
     }
   }
-  if (ct==names.size()) {
+  if (ct==cells.width()) {
     c = "*";
     return string("  ") + val_label + " " + v;
   }
   return string("  ") + cond_label + " " + c + "\n  " + val_label + " " + v;
 }
 
+template <class Cells>
+static void writeRow(FILE *out, int mode, const Cells& cells) {
+  switch (mode) {
+  case ROW_CHANGE_INSERT:
+    fprintf(out,"insert row:\n%s\n\n",
+	   cond(cells,true,"add","where").c_str());
+    break;
+  case ROW_CHANGE_DELETE:
+    fprintf(out,"delete row:\n%s\n\n",
+	   cond(cells,false,"remove","where").c_str());
+    break;
+  case ROW_CHANGE_UPDATE:
+    fprintf(out,"update row:\n  where %s\n  set   %s\n\n",
+	   cond(cells,false).c_str(),
+	   cond(cells,true).c_str());
+    break;
+  default:
+    fprintf(out,"  Unknown row operation\n\n");
+    exit(1);
+    break;
+  }
+}
+
 static string cond(const vector<string>& names) {
   string c = "";
   for (vector<string>::const_iterator it = names.begin();
@@ -143,57 +192,53 @@ bool MergeOutputHumanDiff::changeColumn(const OrderChange& change) {
   //printf("Got order change %s -> %s\n",
   //vector2string(change.namesBefore).c_str(),
   //vector2string(change.namesAfter).c_str());
+  // the subject is a column identity, not a position
+  int idx = -1;
+  const vector<string> *names = &change.namesBefore;
+  const char *action = "";
   switch (change.mode) {
   case ORDER_CHANGE_DELETE:
-    fprintf(out,"delete column: %s\n  before %s\n  after  %s\n\n", 
-	   change.namesBefore[change.subject].c_str(),
-	   vector2string(change.namesBefore).c_str(),
-	   vector2string(change.namesAfter).c_str());
+    idx = change.identityToIndex(change.subject);
+    action = "delete";
     break;
   case ORDER_CHANGE_INSERT:
-    fprintf(out,"insert column: %s\n  before %s\n  after  %s\n\n", 
-	   change.namesAfter[change.subject].c_str(),
-	   vector2string(change.namesBefore).c_str(),
-	   vector2string(change.namesAfter).c_str());
+    idx = change.identityToIndexAfter(change.subject);
+    names = &change.namesAfter;
+    action = "insert";
     break;
   case ORDER_CHANGE_MOVE:
-    fprintf(out,"move column: %s\n  before %s\n  after  %s\n\n", 
-	   change.namesBefore[change.subject].c_str(),
-	   vector2string(change.namesBefore).c_str(),
-	   vector2string(change.namesAfter).c_str());
+    idx = change.identityToIndex(change.subject);
+    action = "move";
     break;
   default:
     fprintf(out,"  Unknown column operation\n\n");
     exit(1);
     break;
   }
+  if (idx<0 || idx>=(int)names->size()) {
+    fprintf(stderr, "Could not find column to %s\n", action);
+    exit(1);
+  }
+  fprintf(out,"%s column: %s\n  before %s\n  after  %s\n\n", 
+	  action,
+	  (*names)[idx].c_str(),
+	  vector2string(change.namesBefore).c_str(),
+	  vector2string(change.namesAfter).c_str());
   return true;
 }
 
 bool MergeOutputHumanDiff::changeRow(const RowChange& change) {
   checkMessage();
-  //printf("Got row change %s ==> %s\n",
-  // map2string(change.cond).c_str(),
-  // map2string(change.val).c_str());
-  switch (change.mode) {
-  case ROW_CHANGE_INSERT:
-    fprintf(out,"insert row:\n%s\n\n",
-	   cond(change.names,change.val,"add","where").c_str());
-    break;
-  case ROW_CHANGE_DELETE:
-    fprintf(out,"delete row:\n%s\n\n",
-	   cond(change.names,change.cond,"remove","where").c_str());
-    break;
-  case ROW_CHANGE_UPDATE:
-    fprintf(out,"update row:\n  where %s\n  set   %s\n\n",
-	   cond(change.names,change.cond,change.val,false).c_str(),
-	   cond(change.names,change.cond,change.val,true).c_str());
-    break;
-  default:
-    fprintf(out,"  Unknown row operation\n\n");
-    exit(1);
-    break;
+  writeRow(out,change.mode,FullCells(change));
+  return true;
+}
+
+bool MergeOutputHumanDiff::changeCompactRow(const CompactRowChange& change) {
+  if (!change.columns.isValid()) {
+    return Patcher::changeCompactRow(change);
   }
+  checkMessage();
+  writeRow(out,change.mode,CompactCells(change));
   return true;
 }
 
@@ -1,4 +1,5 @@
 #include <coopy/MergeOutputPatch.h>
+#include <coopy/CsvWriter.h>
 
 using namespace std;
 using namespace coopy::store;
@@ -22,6 +23,8 @@ bool MergeOutputPatch::addRow(const char *tag,
 
 bool MergeOutputPatch::mergeAllDone() {
   SheetStyle style;
-  fprintf(out,"%s",get().encode(style).c_str());
+  CsvWriter writer(out,style);
+  writer.addSheet(get());
+  writer.flush();
   return true;
 }
@@ -5,7 +5,7 @@ using namespace std;
 using namespace coopy::cmp;
 using namespace coopy::store;
 
-bool MergeOutputRowOps::changeRow(const RowChange& change) {
+bool MergeOutputRowOps::startOps(const vector<string>& allNames) {
   const CompareFlags& flags = getFlags();
   if (!ops.isValid()) {
     SimpleSheetSchema ss;
@@ -18,7 +18,7 @@ bool MergeOutputRowOps::changeRow(const RowChange& change) {
     if (flags.ids.size()>0) {
       ids = flags.ids;
     } else {
-      ids = change.allNames;
+      ids = allNames;
     }
     for (int i=0; i<(int)ids.size(); i++) {
       ss.addColumn((ids[i] + "0").c_str());
@@ -38,10 +38,19 @@ bool MergeOutputRowOps::changeRow(const RowChange& change) {
 
     ops.deleteData();
   }
+  return true;
+}
 
+Poly<SheetRow> MergeOutputRowOps::startRow(int mode) {
   Poly<SheetRow> row = ops.insertRow();
   row->setCell(0,SheetCell(sheet_name.c_str(),false));
-  row->setCell(1,SheetCell(change.modeString().c_str(),false));
+  row->setCell(1,SheetCell(RowChange::modeString(mode).c_str(),false));
+  return row;
+}
+
+bool MergeOutputRowOps::changeRow(const RowChange& change) {
+  startOps(change.allNames);
+  Poly<SheetRow> row = startRow(change.mode);
   int at = 2;
   for (int i=0; i<(int)ids.size(); i++) {
     string id = ids[i];
@@ -61,3 +70,36 @@ bool MergeOutputRowOps::changeRow(const RowChange& change) {
 
   return true;
 }
+
+bool MergeOutputRowOps::changeCompactRow(const CompactRowChange& change) {
+  if (!change.columns.isValid()) {
+    return Patcher::changeCompactRow(change);
+  }
+  startOps(change.columns->allNames);
+  if (idColumns.getContent()!=change.columns.getContent()) {
+    idColumns = change.columns;
+    idNumbers.clear();
+    for (int i=0; i<(int)ids.size(); i++) {
+      idNumbers.push_back(idColumns->find(ids[i]));
+    }
+  }
+  Poly<SheetRow> row = startRow(change.mode);
+  int at = 2;
+  for (int i=0; i<(int)ids.size(); i++) {
+    int id = idNumbers[i];
+    if (id>=0 && change.hasCond(id)) {
+      row->setCell(at,change.cond[id]);
+    }
+    at++;
+  }
+  for (int i=0; i<(int)ids.size(); i++) {
+    int id = idNumbers[i];
+    if (id>=0 && change.hasVal(id)) {
+      row->setCell(at,change.val[id]);
+    }
+    at++;
+  }
+  row->flush();
+
+  return true;
+}
@@ -9,6 +9,7 @@
 
 using namespace std;
 using namespace coopy::cmp;
+using namespace coopy::store;
 
 static void getSqlQuote(const CompareFlags *flags, char *key, char *val) {
   char k = '\"';
@@ -77,70 +78,121 @@ bool MergeOutputSqlDiff::changeColumn(const OrderChange& change) {
 }
 
 
+static void addVal(SqlText& text, const string& column, 
+		   const SheetCell& cell, char del1, char del2) {
+  if (text.vals!="") {
+    text.vals += ", ";
+    text.val_columns += ", ";
+    text.val_values += ", ";
+  }
+  // Should dig up good default quoting rules
+  string c = quoteSql(column,del1,false);
+  text.vals += c;
+  text.val_columns += c;
+  text.vals += "=";
+  if (cell.escaped) {
+    text.vals += "NULL";
+    text.val_values += "NULL";
+  } else {
+    string q = quoteSql(cell.text,del2,true);
+    text.vals += q;
+    text.val_values += q;
+  }
+}
+
+static void addCond(SqlText& text, const string& column, 
+		    const SheetCell& cell, char del1, char del2) {
+  if (text.conds!="") {
+    text.conds += " AND ";
+  }
+  string c = quoteSql(column,del1,false);
+  text.conds += c;
+  text.conds += "=";
+  if (cell.escaped) {
+    text.conds += "NULL";
+  } else {
+    string q = quoteSql(cell.text,del2,true);
+    text.conds += q;
+  }
+}
+
 SqlText MergeOutputSqlDiff::getText(const RowChange& change, const char *sheet_name, const CompareFlags *flags) {
   SqlText text;
-  string& name = text.name;
-  string& vals = text.vals;
-  string& conds = text.conds;
-  string& val_columns = text.val_columns;
-  string& val_values = text.val_values;
   char del1 = '\"';
   char del2 = '\'';
   getSqlQuote(flags,&del1,&del2);
 
-  name = quoteSql(sheet_name,del1,false);
+  text.name = quoteSql(sheet_name,del1,false);
   for (RowChange::txt2cell::const_iterator it=change.val.begin(); 
        it!=change.val.end(); 
        it++) {
-    if (it!=change.val.begin()) {
-      vals += ", ";
-      val_columns += ", ";
-      val_values += ", ";
-    }
-    // Should dig up good default quoting rules
-    string c = quoteSql(it->first,del1,false);
-    vals += c;
-    val_columns += c;
-    vals += "=";
-    if (it->second.escaped) {
-      vals += "NULL";
-      val_values += "NULL";
-    } else {
-      string q = quoteSql(it->second.text,del2,true);
-      vals += q;
-      val_values += q;
-    }
+    addVal(text,it->first,it->second,del1,del2);
   }
-
   for (RowChange::txt2cell::const_iterator it=change.cond.begin(); 
        it!=change.cond.end(); 
        it++) {
-    if (it!=change.cond.begin()) {
-      conds += " AND ";
+    addCond(text,it->first,it->second,del1,del2);
+  }
+  return text;
+}
+
+SqlText MergeOutputSqlDiff::getText(const CompactRowChange& change) {
+  SqlText text;
+  char del1 = '\"';
+  char del2 = '\'';
+  getSqlQuote(&getFlags(),&del1,&del2);
+
+  // columns go out in name order, as they would from a RowChange
+  const RowChangeNames& names = *change.columns;
+  if (sortedColumns.getContent()!=change.columns.getContent() ||
+      sorted.size()!=names.names.size()) {
+    sortedColumns = change.columns;
+    multimap<string,int> order;
+    for (int id=0; id<(int)names.names.size(); id++) {
+      order.insert(make_pair(names.names[id],id));
     }
-    string c = quoteSql(it->first,del1,false);
-    conds += c;
-    conds += "=";
-    if (it->second.escaped) {
-      conds += "NULL";
-    } else {
-      string q = quoteSql(it->second.text,del2,true);
-      conds += q;
+    sorted.clear();
+    for (multimap<string,int>::const_iterator it=order.begin();
+	 it!=order.end(); it++) {
+      sorted.push_back(it->second);
+    }
+  }
+
+  text.name = quoteSql(sheet_name,del1,false);
+  for (int i=0; i<(int)sorted.size(); i++) {
+    int id = sorted[i];
+    if (change.hasVal(id)) {
+      addVal(text,names.names[id],change.val[id],del1,del2);
+    }
+  }
+  for (int i=0; i<(int)sorted.size(); i++) {
+    int id = sorted[i];
+    if (change.hasCond(id)) {
+      addCond(text,names.names[id],change.cond[id],del1,del2);
     }
   }
   return text;
 }
 
 bool MergeOutputSqlDiff::changeRow(const RowChange& change) {
-  SqlText text = getText(change,sheet_name.c_str(),
-			 &getFlags());
-  string& name = text.name;
-  string& vals = text.vals;
-  string& conds = text.conds;
-  string& val_columns = text.val_columns;
-  string& val_values = text.val_values;
+  return emitRow(change.mode,getText(change,sheet_name.c_str(),&getFlags()));
+}
 
-  switch (change.mode) {
+bool MergeOutputSqlDiff::changeCompactRow(const CompactRowChange& change) {
+  if (!change.columns.isValid()) {
+    return Patcher::changeCompactRow(change);
+  }
+  return emitRow(change.mode,getText(change));
+}
+
+bool MergeOutputSqlDiff::emitRow(int mode, const SqlText& text) {
+  const string& name = text.name;
+  const string& vals = text.vals;
+  const string& conds = text.conds;
+  const string& val_columns = text.val_columns;
+  const string& val_values = text.val_values;
+
+  switch (mode) {
   case ROW_CHANGE_INSERT:
     fprintf(out,"INSERT INTO %s (%s) VALUES (%s);\n", 
 	    name.c_str(),
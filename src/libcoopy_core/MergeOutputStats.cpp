@@ -113,10 +113,18 @@ bool MergeOutputStats::changeColumn(const OrderChange& change) {
 }
 
 bool MergeOutputStats::changeRow(const RowChange& change) {
-  if (change.mode == ROW_CHANGE_CONTEXT) return true;
+  return countRow(change.mode);
+}
+
+bool MergeOutputStats::changeCompactRow(const CompactRowChange& change) {
+  return countRow(change.mode);
+}
+
+bool MergeOutputStats::countRow(int mode) {
+  if (mode == ROW_CHANGE_CONTEXT) return true;
   active = true;
   ct_row++;
-  switch (change.mode) {
+  switch (mode) {
   case ROW_CHANGE_INSERT:
     ct_row_insert++;
     break;
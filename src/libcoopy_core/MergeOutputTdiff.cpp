@@ -190,48 +190,36 @@ bool MergeOutputTdiff::changeColumn(const OrderChange& change) {
   }
   fprintf(out,"\n");
 
-  activeColumn.clear();
-  for (int i=0; i<(int)change.namesAfter.size(); i++) {
-    activeColumn[change.namesAfter[i]] = true;
-  }
+  show.clear();
   //nops = change.namesAfter;
   return true;
 }
 
-bool MergeOutputTdiff::operateRow(const RowChange& change, const char *tag) {
-  /*
-  vector<string> lnops;
-  for (int i=0; i<(int)change.names.size(); i++) {
-    if (activeColumn[change.names[i]]) {
-      lnops.push_back(change.names[i]);
-    }
-  }
-  */
-  if (true) { //lnops!=nops) {
+bool MergeOutputTdiff::operateRow(const CompactRowChange& change,
+				  const char *tag) {
+  if (true) {
     if (true) {
       fprintf(out, "@ |");
-      for (int i=0; i<(int)change.names.size(); i++) {
-	if (activeColumn[change.names[i]]) {
-	  bool select = check(showForSelect,change.names[i]);
-	  bool cond = check(showForCond,change.names[i]);
-	  bool view = check(showForDescribe,change.names[i]);
+      for (int i=0; i<change.width(); i++) {
+	int id = change.idAt(i);
+	if (check(id,SHOW_ACTIVE)) {
+	  bool select = check(id,SHOW_SELECT);
 	  fprintf(out,"%s%s|",
-		  stringy(change.names[i]).c_str(),
+		  stringy(change.nameOf(id)).c_str(),
 		  select?"=":"");
-	  //(view&&!(cond||select))?"":"");  // = was ->
 	}
       }
       fprintf(out,"\n");
       showedColumns = true;
     }
-    //nops = lnops;
   }
 
   return true;
 }
 
 // practice mode is unnecessary for this output style
-bool MergeOutputTdiff::updateRow(const RowChange& change, const char *tag,
+bool MergeOutputTdiff::updateRow(const CompactRowChange& change,
+				 const char *tag,
 				 bool select, bool update, bool practice,
 				 bool factored) {
   bool ok = true;
@@ -254,21 +242,18 @@ bool MergeOutputTdiff::updateRow(const RowChange& change, const char *tag,
     }
     fprintf(out, "%s%c |",change.conflicted?"!":"",ch);
   }
-  for (int i=0; i<(int)change.names.size(); i++) {
-    string name = change.names[i];
-    if (activeColumn[name]) {
-      bool conflict = change.conflictingVal.find(name)!=
-	change.conflictingVal.end();
+  for (int i=0; i<change.width(); i++) {
+    int id = change.idAt(i);
+    if (check(id,SHOW_ACTIVE)) {
+      bool conflict = change.hasConflict(id);
       bool shown = false;
-      bool transition = false; //showForDesign[name]&&showForSelect[name];
-      //if (change.cond.find(name)!=change.cond.end() && 
-      //  showForSelect[name] && select) {
-      bool select = check(showForSelect,name);
-      bool cond = check(showForCond,name);
-      bool view = check(showForDescribe,name);
+      bool transition = false;
+      bool select = check(id,SHOW_SELECT);
+      bool cond = check(id,SHOW_COND);
+      bool view = check(id,SHOW_DESCRIBE);
       if (!factored) {
 	fprintf(out,"%s%s%s%s",
-		stringy(name).c_str(),
+		stringy(change.nameOf(id)).c_str(),
 		select?"=":"",
 		(view&&!(cond||select))?((ch=='+')?":->":":*->"):"",
 		(cond&&!(view||select))?":":"");
@@ -279,23 +264,18 @@ bool MergeOutputTdiff::updateRow(const RowChange& change, const char *tag,
       }
       if (conflict) {
 	fprintf(out,"!");
-	if (change.conflictingParentVal.find(name)!=change.conflictingParentVal.end()) {
-	  fprintf(out,"%s!",celly(change.conflictingParentVal.find(name)->second).c_str());
+	if (change.hasConflictParent(id)) {
+	  fprintf(out,"%s!",celly(change.conflictingParentVal[id]).c_str());
 	}
       }
 
-      if (showForCond[name] && select) {
-	fprintf(out,"%s",celly(change.cond.find(name)->second).c_str());
+      if (cond && select) {
+	fprintf(out,"%s",celly(change.cond[id]).c_str());
 	transition = true;
 	shown = true;
       }
-      if (showForDescribe[name] && update) {
-	SheetCell v;
-	if (conflict) {
-	  v = change.conflictingVal.find(name)->second;
-	} else {
-	  v = change.val.find(name)->second;
-	}
+      if (view && update) {
+	const SheetCell& v = conflict?change.conflictingVal[id]:change.val[id];
 	fprintf(out,"%s%s",
 		transition?"->":"",
 		celly(v).c_str());
@@ -312,79 +292,86 @@ bool MergeOutputTdiff::updateRow(const RowChange& change, const char *tag,
   return ok;
 }
 
-bool MergeOutputTdiff::changeRow(const RowChange& change,
+bool MergeOutputTdiff::sameOps(const vector<int>& lops,
+			       const CompactRowChange& change) const {
+  if (lops.size()!=ops.size()) return false;
+  if (opsColumns.getContent()==change.columns.getContent()) {
+    return lops==ops;
+  }
+  if (!opsColumns.isValid()) return false;
+  // different name tables, compare by name
+  for (int i=0; i<(int)lops.size(); i++) {
+    if ((lops[i]<0)!=(ops[i]<0)) return false;
+    int id0 = (ops[i]<0)?(-1-ops[i]):ops[i];
+    int id1 = (lops[i]<0)?(-1-lops[i]):lops[i];
+    if (opsColumns->names[id0]!=change.nameOf(id1)) return false;
+  }
+  return true;
+}
+
+string MergeOutputTdiff::opsText(const vector<int>& lops,
+				 const CompactRowChange& change) const {
+  vector<string> txt;
+  for (int i=0; i<(int)lops.size(); i++) {
+    int id = (lops[i]<0)?(-1-lops[i]):lops[i];
+    txt.push_back(string((lops[i]<0)?OP_NONE:OP_MATCH) + change.nameOf(id));
+  }
+  return vector2string(txt);
+}
+
+bool MergeOutputTdiff::changeRow(const CompactRowChange& change,
 				 bool factored,
 				 bool caching) {
   showSheet();
-  vector<string> lops;
-  activeColumn.clear();
-  prevSelect = showForSelect;
-  prevDescribe = showForDescribe;
-  prevCond = showForCond;
-  showForSelect.clear();
-  showForDescribe.clear();
-  showForCond.clear();
-  for (int i=0; i<(int)change.names.size(); i++) {
-    string name = change.names[i];
-    bool condActive = false;
-    bool valueActive = false;
-    if (change.cond.find(name)!=change.cond.end()) {
-      condActive = true;
-    }
-    if (change.val.find(name)!=change.val.end()) {
-      valueActive = true;
-    }
+  vector<int> lops;
+  show.assign(change.size(),0);
+  for (int i=0; i<change.width(); i++) {
+    int id = change.idAt(i);
+    bool condActive = change.hasCond(id);
+    bool valueActive = change.hasVal(id);
     bool shouldCond = condActive;
-    bool shouldMatch = condActive && change.indexes.find(name)->second;
+    bool shouldMatch = condActive && change.isIndex(id);
     bool shouldAssign = valueActive;
     if (shouldAssign) {
       // conservative choice, should be optional
-      if (change.cond.find(name)!=change.cond.end()) {
+      if (condActive) {
 	shouldMatch = true;
       }
     }
 
     if (change.mode==ROW_CHANGE_INSERT) {
       // we do not care about matching
-      shouldMatch = false; //revSelect[name];
+      shouldMatch = false;
     }
     if (change.mode==ROW_CHANGE_DELETE) {
       // we do not care about assigning
-      shouldAssign = false; //prevDescribe[name];
+      shouldAssign = false;
     }
 
     // ignoring shouldShow for now.
-    int opidx = (shouldMatch?2:0) + (shouldAssign?1:0);
-    string opi[4] = {
-      OP_NONE,         // !match  !assign
-      OP_ASSIGN,       // !match   assign
-      OP_MATCH,        //  match  !assign
-      OP_MATCH_ASSIGN, //  match   assign
-    };
-    string op = opi[opidx];
-    
-    if (opidx!=0) {
-      activeColumn[name] = true;
-    }
+    // all of OP_MATCH, OP_ASSIGN, OP_MATCH_ASSIGN look the same, so
+    // just note whether the column is shown at all.
+    bool active = shouldMatch||shouldAssign;
+    if (id>=(int)show.size()) show.resize(id+1,0);
+    show[id] = (active?SHOW_ACTIVE:0) |
+      (shouldMatch?SHOW_SELECT:0) |
+      (shouldAssign?SHOW_DESCRIBE:0) |
+      (shouldCond?SHOW_COND:0);
 
     // no way yet to communicate CONTEXT request
-    lops.push_back(op + name);
-    showForSelect[name] = shouldMatch;
-    showForDescribe[name] = shouldAssign;
-    showForCond[name] = shouldCond;
+    lops.push_back(active?id:(-1-id));
   }
   if (caching) {
     // state 0 = no factoring of header
     // state 1 = factoring of header
     float costFactored = 1;
     float costUnfactored = 1.9;
-    dbg_printf("local ops %s\n", vector2string(lops).c_str());
+    dbg_printf("local ops %s\n", opsText(lops,change).c_str());
     float costSwitch = 0.25;
-    if (lops!=ops) {
-      //if (ops.size()>0) {
+    if (!sameOps(lops,change)) {
       costFactored += 1.1;
-      //}
       ops = lops;
+      opsColumns = change.columns;
       costSwitch = 0;
     }
     //printf("factored %g unfactored %g\n", costFactored, costUnfactored);
@@ -398,14 +385,16 @@ bool MergeOutputTdiff::changeRow(const RowChange& change,
     return true;
   }
 
-  dbg_printf("round 2 - local ops %s (%d)\n", vector2string(lops).c_str(), factored);
+  dbg_printf("round 2 - local ops %s (%d)\n", opsText(lops,change).c_str(), factored);
   if (factored) {
-    if (lops!=ops) {
+    if (!sameOps(lops,change)) {
       ops = lops;
+      opsColumns = change.columns;
       operateRow(change,"act");
     }
   } else {
     ops = lops;
+    opsColumns = change.columns;
   }
   lastWasFactored = factored;
   switch (change.mode) {
@@ -440,12 +429,7 @@ bool MergeOutputTdiff::changeName(const NameChange& change) {
   bool constant = change.constant;
   bool loud = change.loud;
   if (!final) {
-    activeColumn.clear();
-    for (int i=0; i<(int)names.size(); i++) {
-      activeColumn[names[i]] = true;
-      showForSelect[names[i]] = true;
-      showForDescribe[names[i]] = true;
-    }
+    show.clear();
     if (loud||!constant) {
       showSheet();
       //fprintf(out, "/* %s %s ","column","name");
@@ -474,14 +458,9 @@ bool MergeOutputTdiff::setSheet(const char *name) {
 
 void MergeOutputTdiff::flushRows() {
   ops.clear();
-  //opsLoose.clear();
+  opsColumns.clear();
   lastWasFactored = false;
-  //nops.clear();
-  activeColumn.clear();
-  showForSelect.clear();
-  showForDescribe.clear();
-  prevSelect.clear();
-  prevDescribe.clear();
+  show.clear();
   columns.clear();
   constantColumns = true;
   showedColumns = false;
@@ -494,7 +473,7 @@ void MergeOutputTdiff::flushRows() {
     formLattice.showPath();
   }
   for (int i=0; i<(int)rowCache.size(); i++) {
-    RowChange& change = rowCache[i];
+    CompactRowChange& change = rowCache[i];
     changeRow(change,(formLattice(i)==1),false);
   }
   formLattice.reset();
@@ -3,6 +3,7 @@
 #include <coopy/Mover.h>
 #include <coopy/NameSniffer.h>
 #include <coopy/IndexSniffer.h>
+#include <coopy/TaskGroup.h>
 
 #include <stdlib.h>
 #include <ctype.h>
@@ -16,6 +17,10 @@
 using namespace std;
 using namespace coopy::store;
 using namespace coopy::cmp;
+using namespace coopy::os;
+
+// Rows evaluated by one task in a threaded diff, see Merger::mergeRows.
+#define MERGE_ROW_CHUNK 256
 
 static string normalize_string(string low, const CompareFlags& flags) {
   if (flags.ignore_case) {
@@ -46,16 +51,38 @@ static bool compare_string(const SheetCell& a, const SheetCell& b,
   return normalize_string(a.text,flags)==normalize_string(b.text,flags);
 }
 
-bool Merger::mergeRow(coopy::store::DataSheet& pivot, 
-		      coopy::store::DataSheet& local, 
-		      coopy::store::DataSheet& remote,
-		      MatchUnit& row_unit, 
-		      Patcher& output,
-		      const CompareFlags& flags, 
-		      std::vector<coopy::cmp::RowChange>& rc) {
+static bool compare_cell(const SheetCell& a, const SheetCell& b,
+			 const vector<TypedValue>& ta,
+			 const vector<TypedValue>& tb,
+			 size_t i,
+			 const CompareFlags& flags) {
+  if (compare_string(a,b,flags)) return true;
+  if (i>=ta.size()||i>=tb.size()) return false;
+  return ta[i].equals(tb[i]);
+}
+
+static void typed_cell(const TypedColumns& typed, bool stored,
+		       const RowBlock& block, int x, int y,
+		       vector<TypedValue>& result) {
+  result.push_back(TypedValue());
+  if (stored) {
+    typed.get(x,y,result.back());
+  } else {
+    result.back().parse(block.cell(x,y),typed.kind(x));
+  }
+}
+
+void Merger::evaluateRow(const coopy::store::DataSheet& pivot, 
+			 const coopy::store::DataSheet& local, 
+			 const coopy::store::DataSheet& remote,
+			 const MatchUnit& row_unit,
+			 const CompareFlags& flags,
+			 bool diff,
+			 coopy::store::RowBlock& pivot_block,
+			 coopy::store::RowBlock& local_block,
+			 coopy::store::RowBlock& remote_block,
+			 MergeRowResult& result) const {
   bool fixedColumns = flags.fixed_columns;
-  bool diff = output.wantDiff();
-  bool link = output.wantLinks();
   int pRow = row_unit.pivotUnit;
   int lRow = row_unit.localUnit;
   int rRow = row_unit.remoteUnit;
@@ -68,19 +95,24 @@ bool Merger::mergeRow(coopy::store::DataSheet& pivot,
   vector<SheetCell> saveLocal;
   vector<int> expandDel;
   vector<int> existsLocally;
-  map<string,SheetCell> cond, value, value0, conflicted_value,
-    conflicted_parent_value;
-  vector<string> address;
-  vector<string> action;
-  int lastCol = -1;
-  int addCol = 0;
-  address.push_back("0");
-  action.push_back("select");
+  vector<TypedValue> typedLocal, typedRemote, typedPivot;
+  bool typed = flags.typed_compare;
+  // conditions and values go straight into the change, by column
+  // number; see column_names.  The change gets its columns in commitRow.
+  CompactRowChange& rowChange = result.change;
+  rowChange.hasNames = true;
+  const vector<int>& column_ids = column_names->order;
+  const string empty_name = "";
+  // Fetch each source row once, rather than cell by cell.  Rows are
+  // read fresh on every call since the output may edit local in place.
+  if (lRow>=0) local.readRows(lRow,1,local_block);
+  if (rRow>=0) remote.readRows(rRow,1,remote_block);
+  if (pRow>=0) pivot.readRows(pRow,1,pivot_block);
   int at = 0;
-  for (list<MatchUnit>::iterator it=col_merge.accum.begin();
+  for (vector<MatchUnit>::const_iterator it=col_merge.accum.begin();
        it!=col_merge.accum.end(); 
        it++) {
-    MatchUnit& unit = *it;
+    const MatchUnit& unit = *it;
     int pCol = unit.pivotUnit;
     int lCol = unit.localUnit;
     int rCol = unit.remoteUnit;
@@ -92,33 +124,42 @@ bool Merger::mergeRow(coopy::store::DataSheet& pivot,
       if (lRow>=0 && lCol>=0) {
 	//printf("access local %d %d (size %d %d)\n", lCol, lRow, 
 	//local.width(), local.height());
-	expandLocal.push_back(local.cellSummary(lCol,lRow));
+	expandLocal.push_back(local_block.summary(lCol,lRow));
+	if (typed) typed_cell(*typed_local,false,local_block,lCol,lRow,
+			      typedLocal);
       } else {
 	expandLocal.push_back(blankCell);
+	if (typed) typedLocal.push_back(TypedValue());
       }
       if (rRow>=0 && rCol>=0) {
 	//printf("access remote %d %d\n", rCol, rRow);
-	expandRemote.push_back(remote.cellSummary(rCol,rRow));
+	expandRemote.push_back(remote_block.summary(rCol,rRow));
+	if (typed) typed_cell(*typed_remote,remote_stored,remote_block,rCol,rRow,
+			      typedRemote);
       } else {
 	expandRemote.push_back(blankCell);
+	if (typed) typedRemote.push_back(TypedValue());
       }
       if (pRow>=0 && pCol>=0) {
 	//printf("access pivot %d %d\n", pCol, pRow);
-	expandPivot.push_back(pivot.cellSummary(pCol,pRow));
+	expandPivot.push_back(pivot_block.summary(pCol,pRow));
+	if (typed) typed_cell(*typed_pivot,pivot_stored,pivot_block,pCol,pRow,
+			      typedPivot);
       } else {
 	expandPivot.push_back(blankCell);
+	if (typed) typedPivot.push_back(TypedValue());
       }
     }
     if (lRow>=0 && lCol>=0 && !deleted) {
-      string n;
-      if (names.size()>at) n = names[at];
+      const string& n = (names.size()>at)?names[at]:empty_name;
       if (diff || include_column.find(n)!=include_column.end()) {
 	if (exclude_column.find(n)==exclude_column.end()) {
 	  //printf("I think that %s has name %s\n",
 	  //local.cellSummary(lCol,lRow).toString().c_str(),
 	  //names[at].c_str());
 	  //cond[names[at]] = pivot.cellSummary(pCol,pRow);
-	  cond[n] = local.cellSummary(lCol,lRow);
+	  rowChange.setCond(columnId(column_ids,at),
+			    local_block.summary(lCol,lRow));
 	  /*
 	    printf("LOCAL %s IS\n%s\n", 
 	    local.desc().c_str(),
@@ -132,31 +173,8 @@ bool Merger::mergeRow(coopy::store::DataSheet& pivot,
     if (!deleted) {
       at++;
     }
-    if (diff) {
-      if (lCol!=-1) {
-	lastCol = lCol;
-	addCol = 0;
-      } else {
-	addCol++;
-      }
-      char buf[256];
-      if (addCol>0) {
-	snprintf(buf,sizeof(buf),"%d+%d", lastCol+1, addCol);
-      } else {
-	snprintf(buf,sizeof(buf),"%d", lastCol+1);
-      }
-      address.push_back(buf);
-      if (deleted) {
-	action.push_back("delete");
-      } else if (lCol==-1) {
-	action.push_back("add");
-      } else {
-	action.push_back("");
-      }
-    }
   }
   //printf("Onwards\n");
-  bool conflict = false;
   bool change = false;
   expandMerge = expandLocal;
   at = 0;
@@ -179,7 +197,7 @@ bool Merger::mergeRow(coopy::store::DataSheet& pivot,
       }
     }
     if (!ignored) {
-      if (!compare_string(_l,_r,flags)) {
+      if (!compare_cell(_l,_r,typedLocal,typedRemote,i,flags)) {
 	if (_l==blankCell) {
 	  if (!_r.escaped) {
 	    _l = _r;
@@ -189,8 +207,9 @@ bool Merger::mergeRow(coopy::store::DataSheet& pivot,
 	  if (_r!=blankCell) {
 	    // two assertions, do they conflict?
 	    // if pivot is the same as either, then no.
-	    if (compare_string(_p,_l,flags)||compare_string(_p,_r,flags)) {
-	      if (compare_string(_p,_l,flags)) { 
+	    if (compare_cell(_p,_l,typedPivot,typedLocal,i,flags)||
+		compare_cell(_p,_r,typedPivot,typedRemote,i,flags)) {
+	      if (compare_cell(_p,_l,typedPivot,typedLocal,i,flags)) { 
 		_l = _r; 
 		change = true;
 		novel = true;
@@ -198,21 +217,18 @@ bool Merger::mergeRow(coopy::store::DataSheet& pivot,
 	    } else {
 	      string resolve = flags.resolve;
 	      if (resolve=="") {
-		fprintf(stderr,"# conflict: {{%s}} vs {{%s}} from {{%s}}\n",
-			_l.toString().c_str(),
-			_r.toString().c_str(),
-			_p.toString().c_str());
-		conflict = true;
+		result.messages += "# conflict: {{" + _l.toString() +
+		  "}} vs {{" + _r.toString() +
+		  "}} from {{" + _p.toString() + "}}\n";
+		result.conflicts++;
 		conflicted1 = true;
 		change = true;
 		novel = true;
-		output.setConflicted();
 	      } else {
-		fprintf(stderr,"# auto-resolving conflict: ours:{{%s}} vs theirs:{{%s}} from neither:{{%s}} -- picking %s\n",
-			_l.toString().c_str(),
-			_r.toString().c_str(),
-			_p.toString().c_str(),
-			resolve.c_str());
+		result.messages += "# auto-resolving conflict: ours:{{" +
+		  _l.toString() + "}} vs theirs:{{" + _r.toString() +
+		  "}} from neither:{{" + _p.toString() + "}} -- picking " +
+		  resolve + "\n";
 		if (resolve=="ours") {
 		  // do nothing
 		} else if (resolve=="theirs") {
@@ -235,14 +251,13 @@ bool Merger::mergeRow(coopy::store::DataSheet& pivot,
     if (diff) {
       if (!deleted) {
 	if (novel) {
-	  string n;
-	  if (names.size()>at) n = names[at];
+	  const string& n = (at>=0&&at<(int)names.size())?names[at]:empty_name;
 	  if (exclude_column.find(n)==exclude_column.end()) {
-	    value[n] = _l;
+	    int id = columnId(column_ids,at);
+	    rowChange.setVal(id,_l);
 	    if (conflicted1) {
 	      //printf("SETTING conflicted value\n");
-	      conflicted_value[n] = _r;
-	      conflicted_parent_value[n] = _p;
+	      rowChange.setConflict(id,_r,_p);
 	    }
 	  }
 	}
@@ -278,6 +293,28 @@ bool Merger::mergeRow(coopy::store::DataSheet& pivot,
     output.declareLink(decl);
   }
   */
+}
+
+void Merger::commitRow(const coopy::store::DataSheet& pivot, 
+		       const MatchUnit& row_unit, 
+		       Patcher& output,
+		       const CompareFlags& flags, 
+		       MergeRowResult& result,
+		       std::vector<coopy::cmp::CompactRowChange>& rc) {
+  bool diff = output.wantDiff();
+  int pRow = row_unit.pivotUnit;
+  int lRow = row_unit.localUnit;
+  int rRow = row_unit.remoteUnit;
+  bool delRow = row_unit.deleted;
+  if (result.messages!="") {
+    fputs(result.messages.c_str(),stderr);
+  }
+  for (int i=0; i<result.conflicts; i++) {
+    output.setConflicted();
+  }
+  bool conflict = (result.conflicts>0);
+  CompactRowChange& rowChange = result.change;
+  rowChange.columns = column_names;
 
   if (!diff) {
     if (conflict) {
@@ -304,15 +341,6 @@ bool Merger::mergeRow(coopy::store::DataSheet& pivot,
       //return false;
     }
     */
-    if (address!=lastAddress) {
-      //output.addRow("[for]",address,blank);
-      lastAddress = address;
-    }
-    if (address!=lastAddress || action!=lastAction) {
-      //output.addRow("[do]",action,blank);
-      lastAction = action;
-    }
-
     bool activity = true;
 
     /*
@@ -343,14 +371,8 @@ bool Merger::mergeRow(coopy::store::DataSheet& pivot,
 	       (int)expandMerge.size(), local.width(), current_row, local.height());
     */
 
-    RowChange rowChange;
-    RowChange rowChangeMove;
+    CompactRowChange rowChangeMove;
     bool haveMove = false;
-    rowChange.cond = cond;
-    rowChange.val = value;
-    rowChange.conflictingVal = conflicted_value;
-    rowChange.conflictingParentVal = conflicted_parent_value;
-    rowChange.names = names;
     rowChange.conflicted = conflict;
     rowChange.pRow = pRow;
     rowChange.lRow = lRow;
@@ -370,7 +392,7 @@ bool Merger::mergeRow(coopy::store::DataSheet& pivot,
 	    //if (fixed_row.find(lRow)!=fixed_row.end()) {
 	    if (last_local_row>=0) {
 	      if (last_local_row_marked!=last_local_row) {
-		RowChange alt = lastRowChange;
+		CompactRowChange alt = lastRowChange;
 		alt.mode = ROW_CHANGE_CONTEXT;
 		if (flags.use_order) {
 		  if (pivot.height()>0) {
@@ -382,7 +404,7 @@ bool Merger::mergeRow(coopy::store::DataSheet& pivot,
 	    if (prev_had_row||lRow!=0) {
 	      dbg_printf("MOVE! lRow %d last_local_row %d last_local_row_marked %d\n",
 			 lRow, last_local_row, last_local_row_marked);
-	      RowChange alt = rowChange;
+	      CompactRowChange alt = rowChange;
 	      alt.mode = ROW_CHANGE_MOVE;
 	      if (flags.use_order) {
 		haveMove = true;
@@ -396,18 +418,6 @@ bool Merger::mergeRow(coopy::store::DataSheet& pivot,
       }
     }
     if (activity||delRow) {
-      char buf[256];
-      if (lRow==-1) {
-	addition++;
-	snprintf(buf,sizeof(buf),"%d+%d",last_row+1,addition);
-      } else {
-	snprintf(buf,sizeof(buf),"%d",lRow+1);
-	addition = 0;
-      }
-      SheetCell cbuf(buf,false);
-      expandMerge.insert(expandMerge.begin(),cbuf);
-      expandLocal.insert(expandLocal.begin(),cbuf);
-      expandRemote.insert(expandRemote.begin(),cbuf);
       //if (change) {
       //output.addRow("[-]",expandLocal,blank);
       //}
@@ -424,7 +434,7 @@ bool Merger::mergeRow(coopy::store::DataSheet& pivot,
 	  //last_local_row_marked, last_local_row, lRow);
 	  if (last_local_row>=0) {
 	    if (last_local_row_marked!=last_local_row) {
-	      RowChange alt = lastRowChange;
+	      CompactRowChange alt = lastRowChange;
 	      alt.mode = ROW_CHANGE_CONTEXT;
 	      if (flags.use_order) {
 		if (pivot.height()>0) {
@@ -434,7 +444,8 @@ bool Merger::mergeRow(coopy::store::DataSheet& pivot,
 	    }
 	  } else {
 	    if (!(prev_had_row||had_foreign_row||allGone)) {
-	      RowChange alt;
+	      CompactRowChange alt;
+	      alt.columns = column_names;
 	      alt.mode = ROW_CHANGE_CONTEXT;
 	      if (flags.use_order) {
 		if (pivot.height()>0) {
@@ -466,7 +477,7 @@ bool Merger::mergeRow(coopy::store::DataSheet& pivot,
 	  }
 	} else {
 	  if (flags.canUpdate()) {
-	    if (value.size()!=0) {
+	    if (rowChange.hasAnyVal()) {
 	      //output.addRow("[+]",expandMerge,blank);
 	      rowChange.mode = haveMove?ROW_CHANGE_MOVE:ROW_CHANGE_UPDATE;
 	      haveMove = false;
@@ -493,10 +504,151 @@ bool Merger::mergeRow(coopy::store::DataSheet& pivot,
       bottom_local_row = last_local_row;
     }
   }
+}
+
+
+
+bool Merger::mergeRow(coopy::store::DataSheet& pivot, 
+		      coopy::store::DataSheet& local, 
+		      coopy::store::DataSheet& remote,
+		      MatchUnit& row_unit, 
+		      Patcher& output,
+		      const CompareFlags& flags, 
+		      std::vector<coopy::cmp::CompactRowChange>& rc) {
+  MergeRowResult result;
+  evaluateRow(pivot,local,remote,row_unit,flags,output.wantDiff(),
+	      pivot_block,local_block,remote_block,result);
+  commitRow(pivot,row_unit,output,flags,result,rc);
   return true;
 }
 
 
+void Merger::prepareColumns() {
+  int width = 0;
+  for (vector<MatchUnit>::const_iterator it=col_merge.accum.begin();
+       it!=col_merge.accum.end(); 
+       it++) {
+    if (!it->deleted) width++;
+  }
+  blank_column = -1;
+  if (width>(int)column_names->order.size()) {
+    blank_column = column_names->add("");
+  }
+}
+
+int Merger::mergeThreads(const CompareFlags& flags,
+			 const DataSheet& pivot,
+			 const DataSheet& local,
+			 const DataSheet& remote) const {
+  if (flags.threads<=1) return 1;
+  if (!TaskGroup::isThreaded()) return 1;
+  if (!pivot.canReadConcurrently()) return 1;
+  if (!local.canReadConcurrently()) return 1;
+  if (!remote.canReadConcurrently()) return 1;
+  return flags.threads;
+}
+
+/**
+ *
+ * Evaluate a run of rows of a diff.  Each task reads rows into its own
+ * blocks, and writes only its own results.
+ *
+ */
+class MergeRowTask : public Task {
+public:
+  const Merger& merger;
+  const DataSheet& pivot;
+  const DataSheet& local;
+  const DataSheet& remote;
+  const CompareFlags& flags;
+  const vector<MatchUnit>& units;
+  vector<MergeRowResult>& results;
+  bool allGone;
+  int base;
+  int from;
+  int to;
+  RowBlock pivot_block;
+  RowBlock local_block;
+  RowBlock remote_block;
+
+  MergeRowTask(const Merger& merger,
+	       const DataSheet& pivot,
+	       const DataSheet& local,
+	       const DataSheet& remote,
+	       const CompareFlags& flags,
+	       const vector<MatchUnit>& units,
+	       vector<MergeRowResult>& results,
+	       bool allGone) : merger(merger), pivot(pivot), local(local),
+    remote(remote), flags(flags), units(units), results(results),
+    allGone(allGone) {
+    base = from = to = 0;
+  }
+
+  virtual void run() {
+    for (int i=from; i<to; i++) {
+      const MatchUnit& unit = units[i];
+      if (unit.remoteUnit==-1 && allGone) continue;
+      merger.evaluateRow(pivot,local,remote,unit,flags,true,
+			 pivot_block,local_block,remote_block,
+			 results[i-base]);
+    }
+  }
+};
+
+void Merger::mergeRows(coopy::store::DataSheet& pivot, 
+		       coopy::store::DataSheet& local, 
+		       coopy::store::DataSheet& remote,
+		       Patcher& output,
+		       const CompareFlags& flags,
+		       int threads,
+		       std::vector<coopy::cmp::CompactRowChange>& rc) {
+  vector<MatchUnit>& units = row_merge.accum;
+  int n = (int)units.size();
+  if (allGone) {
+    for (int i=0; i<n; i++) {
+      units[i].localUnit = -1;
+      units[i].pivotUnit = -1;
+    }
+  }
+  // Rows are evaluated a batch at a time, several chunks per thread,
+  // then committed in order.
+  vector<MergeRowResult> results;
+  vector<MergeRowTask *> tasks;
+  for (int t=0; t<threads*4; t++) {
+    tasks.push_back(new MergeRowTask(*this,pivot,local,remote,flags,
+				     units,results,allGone));
+  }
+  int batch = (int)tasks.size()*MERGE_ROW_CHUNK;
+  for (int start=0; start<n; start+=batch) {
+    int stop = start+batch;
+    if (stop>n) stop = n;
+    // results are reset here rather than by the tasks, since a
+    // committed change holds a reference to column_names, whose
+    // count is not safe to change from several threads
+    results.assign(stop-start,MergeRowResult());
+    TaskGroup group(threads);
+    for (int t=0; t<(int)tasks.size(); t++) {
+      MergeRowTask& task = *tasks[t];
+      task.base = start;
+      task.from = start+t*MERGE_ROW_CHUNK;
+      if (task.from>=stop) break;
+      task.to = task.from+MERGE_ROW_CHUNK;
+      if (task.to>stop) task.to = stop;
+      group.add(task);
+    }
+    group.run();
+    for (int i=start; i<stop; i++) {
+      MatchUnit& unit = units[i];
+      if (unit.remoteUnit!=-1 || !allGone) {
+	commitRow(pivot,unit,output,flags,results[i-start],rc);
+      }
+    }
+  }
+  for (int t=0; t<(int)tasks.size(); t++) {
+    delete tasks[t];
+  }
+}
+
 bool Merger::merge(MergerState& state) {
   last_local_row = -1;
   bottom_local_row = -1;
@@ -504,6 +656,8 @@ bool Merger::merge(MergerState& state) {
   had_row = false;
   had_foreign_row = false;
   allGone = false;
+  column_names = Poly<RowChangeNames>(new RowChangeNames,true);
+  column_names->setNames(names);
 
   coopy::store::DataSheet& pivot = state.pivot;
   coopy::store::DataSheet& local = state.local;
@@ -531,6 +685,17 @@ bool Merger::merge(MergerState& state) {
     exclude_column[flags.exclude_columns[i]] = 1;
   }
 
+  if (flags.typed_compare) {
+    // local may be edited as the merge goes, so its cells are read
+    // afresh with each row; the cache only supplies its column types
+    typed_local = state.typed_local;
+    typed_pivot = state.typed_pivot;
+    typed_remote = state.typed_remote;
+    COOPY_ASSERT(typed_local&&typed_pivot&&typed_remote);
+    pivot_stored = (&pivot!=&local);
+    remote_stored = (&remote!=&local);
+  }
+
   dbg_printf("Merging column order...\n");
   CompareFlags cflags = flags;
   cflags.head_trimmed = false;
@@ -565,9 +730,6 @@ bool Merger::merge(MergerState& state) {
   if (diff) {
     current_row = 0;
     last_row = -1;
-    addition = 0;
-    lastAddress.clear();
-    lastAction.clear();
 
     local_names.sniff();
     remote_names.sniff();
@@ -618,7 +780,7 @@ bool Merger::merge(MergerState& state) {
 	       vector2string(local_col_names).c_str());
 
     // Pass 1: signal any column deletions
-    for (list<MatchUnit>::iterator it=col_merge.accum.begin();
+    for (vector<MatchUnit>::iterator it=col_merge.accum.begin();
 	 it!=col_merge.accum.end(); 
 	 it++) {
       MatchUnit& unit = *it;
@@ -663,7 +825,7 @@ bool Merger::merge(MergerState& state) {
 
     // Pass 2: check order
     vector<int> shuffled_cols;
-    for (list<MatchUnit>::iterator it=col_merge.accum.begin();
+    for (vector<MatchUnit>::iterator it=col_merge.accum.begin();
 	 it!=col_merge.accum.end(); 
 	 it++) {
       MatchUnit& unit = *it;
@@ -760,7 +922,7 @@ bool Merger::merge(MergerState& state) {
 
     // Pass 3: signal any column insertions
     int at = 0;
-    for (list<MatchUnit>::iterator it=col_merge.accum.begin();
+    for (vector<MatchUnit>::iterator it=col_merge.accum.begin();
 	 it!=col_merge.accum.end(); 
 	 it++) {
       MatchUnit& unit = *it;
@@ -813,13 +975,14 @@ bool Merger::merge(MergerState& state) {
 
     // PASS 4 - column renames
     if (flags.assume_header) {
-      for (list<MatchUnit>::iterator it=col_merge.accum.begin();
+      for (vector<MatchUnit>::iterator it=col_merge.accum.begin();
 	   it!=col_merge.accum.end(); 
 	   it++) {
 	MatchUnit& unit = *it;
-	int lCol = unit.pivotUnit;
+	int lCol = unit.localUnit;
 	int rCol = unit.remoteUnit;
 	bool deleted = unit.deleted;
+	if (lCol>=local.width() || rCol>=remote.width()) continue;
 	if (lCol!=-1 && rCol!=-1 && !deleted) {
 	  string lName = local_names.suggestColumnName(lCol);
 	  string rName = remote_names.suggestColumnName(rCol);
@@ -851,6 +1014,7 @@ bool Merger::merge(MergerState& state) {
     }
     
     names = local_col_names;
+    column_names->setNames(names);
     filtered_names.clear();
 
     if (fixedColumns) {
@@ -874,7 +1038,7 @@ bool Merger::merge(MergerState& state) {
 	remote_names.sniff();
       
 	// perspective: MERGE, COLUMN
-	for (list<MatchUnit>::iterator it=col_merge.accum.begin();
+	for (vector<MatchUnit>::iterator it=col_merge.accum.begin();
 	     it!=col_merge.accum.end(); 
 	     it++) {
 	  MatchUnit& unit = *it;
@@ -900,10 +1064,16 @@ bool Merger::merge(MergerState& state) {
       }
     }
 
-    vector<RowChange> rc;
+    vector<CompactRowChange> rc;
     // Now process rows
+    int threads = link?1:mergeThreads(flags,pivot,local,remote);
     if (!state.allIdentical) {
-      for (list<MatchUnit>::iterator it=row_merge.accum.begin();
+      prepareColumns();
+    }
+    if (!state.allIdentical && threads>1) {
+      mergeRows(pivot,local,remote,output,flags,threads,rc);
+    } else if (!state.allIdentical) {
+      for (vector<MatchUnit>::iterator it=row_merge.accum.begin();
 	   it!=row_merge.accum.end(); 
 	   it++) {
 	MatchUnit& unit = *it;
@@ -974,14 +1144,13 @@ bool Merger::merge(MergerState& state) {
     if (rc.size()>0) {
       output.addPoolsFromFlags(state.local);
     }
+    /*
+      scope for being smarter here about what gets scoped in.
+    */
+    column_names->setIndexes(indexes);
+    column_names->allNames = local_col_names;
     for (int i=0; i<(int)rc.size(); i++) {
-      /*
-	scope for being smarter here about what gets scoped in.
-       */
-      RowChange& change = rc[i];
-      change.indexes = indexes;
-      change.allNames = local_col_names;
-      output.changeRow(change);
+      output.changeCompactRow(rc[i]);
     }
 
     //printf(">>> %s %d\n", __FILE__, __LINE__);
@@ -1000,7 +1169,7 @@ bool Merger::merge(MergerState& state) {
       
     // perspective: MERGE, COLUMN
     bool column_change = false;
-    for (list<MatchUnit>::iterator it=col_merge.accum.begin();
+    for (vector<MatchUnit>::iterator it=col_merge.accum.begin();
 	 it!=col_merge.accum.end(); 
 	 it++) {
       MatchUnit& unit = *it;
@@ -1015,7 +1184,7 @@ bool Merger::merge(MergerState& state) {
 
 
     if (column_change) {
-      for (list<MatchUnit>::iterator it=col_merge.accum.begin();
+      for (vector<MatchUnit>::iterator it=col_merge.accum.begin();
 	   it!=col_merge.accum.end(); 
 	   it++) {
 	MatchUnit& unit = *it;
@@ -1042,7 +1211,7 @@ bool Merger::merge(MergerState& state) {
   }
 
   vector<string> header;
-  for (list<MatchUnit>::iterator it=col_merge.accum.begin();
+  for (vector<MatchUnit>::iterator it=col_merge.accum.begin();
        it!=col_merge.accum.end(); 
        it++) {
     MatchUnit& unit = *it;
@@ -1063,8 +1232,9 @@ bool Merger::merge(MergerState& state) {
     }
   }
   output.addHeader("[conflict]",header,"");
+  prepareColumns();
 
-  for (list<MatchUnit>::iterator it=row_merge.accum.begin();
+  for (vector<MatchUnit>::iterator it=row_merge.accum.begin();
        it!=row_merge.accum.end(); 
        it++) {
     MatchUnit& unit = *it;
@@ -1087,11 +1257,11 @@ bool Merger::merge(MergerState& state) {
 
     bool deleted = unit.deleted;
     if (!deleted) {
-      vector<RowChange> rc;
+      vector<CompactRowChange> rc;
       bool ok = mergeRow(pivot,local,remote,unit,output,flags,rc);
       if (!ok) return false;
       for (int i=0; i<(int)rc.size(); i++) {
-	output.changeRow(rc[i]);
+	output.changeCompactRow(rc[i]);
       }
     }
   }
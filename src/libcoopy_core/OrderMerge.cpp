@@ -1,10 +1,7 @@
 #include <coopy/OrderMerge.h>
 #include <coopy/Dbg.h>
-#include <coopy/Viterbi.h>
-#include <coopy/EfficientMap.h>
 
-#include <list>
-#include <map>
+#include <vector>
 
 using namespace std;
 using namespace coopy::cmp;
@@ -17,81 +14,53 @@ using namespace coopy::cmp;
 
  */
 
-void OrderMerge::process(int ilocal, int iremote,
-			 int& base_local, int& base_remote,
-			 int stop_local, int stop_remote) {
-  //dbg_printf("process %d %d / %d %d / %d %d\n", ilocal, iremote, 
-  //base_local, base_remote, stop_local, stop_remote);
-  while (true) {
-    //dbg_printf("--- process %d %d / %d %d / %d %d\n", ilocal, iremote, 
-    //	       base_local, base_remote, stop_local, stop_remote);
-    if (ilocal>=stop_local &&
-	iremote>=stop_remote) {
-      break;
-    }
-    int _l = ilocal;
-    if (ilocal<stop_local) {
-      if (_l<xlocal.height()) {
-	if (xlocal.cell(0,_l)==0) {
-	  int _lp = order_local.b2a(_l);
-	  if (_lp!=-1) {
-	    int _lpr = order_remote.a2b(_lp);
-	    if (_lpr!=-1) {
-	      process(base_local,base_remote,base_local,base_remote,ilocal,_lpr);
-	      //dbg_printf("Local unit %d exists in pivot at %d and in remote at %d\n", _l, _lp, _lpr);
-	      accum.push_back(MatchUnit(_lp,_l,_lpr,false,MATCH_UNIT_PRESERVE));
-	      if (_lpr>=0) {
-		xremote.cell(0,_lpr) = 1;
-	      }
-	      if (_l>=0) {
-		xlocal.cell(0,_l) = 1;
-	      }
-	    } else {
-	      dbg_printf("Local unit %d exists in pivot at %d, but not in remote - [DELETE]\n", _l, _lp);
-	      accum.push_back(MatchUnit(_lp,_l,-1,true,MATCH_UNIT_DELETE));
-	      if (_l>=0) {
-		xlocal.cell(0,_l) = 1;
-	      }
-	    }
-	  } else {
-	    dbg_printf("Local unit %d not in pivot - [ADD]\n", _l);
-	    accum.push_back(MatchUnit(-1,_l,-1,false,MATCH_UNIT_PRESERVE));
-	    if (_l>=0) {
-	      xlocal.cell(0,_l) = 1;
-	    }
-	  }
+void OrderMerge::addRemote(int _r) {
+  if (_r<0||_r>=(int)xremote.size()) return;
+  if (xremote[_r]) return;
+  int _rp = order_remote.b2a(_r);
+  if (_rp!=-1) {
+    // either we will get this from the local side (assuming no
+    // collisions), or it was deleted locally; skip.
+    return;
+  }
+  dbg_printf("Remote unit %d not in pivot - [ADD]\n", _r);
+  accum.push_back(MatchUnit(-1,-1,_r,false,MATCH_UNIT_INSERT));
+  xremote[_r] = 1;
+}
+
+void OrderMerge::process(int stop_local, int stop_remote) {
+  // remote units before this one have been offered already
+  int base_remote = 0;
+  for (int _l=0; _l<stop_local && _l<(int)xlocal.size(); _l++) {
+    if (xlocal[_l]) continue;
+    int _lp = order_local.b2a(_l);
+    if (_lp!=-1) {
+      int _lpr = order_remote.a2b(_lp);
+      if (_lpr!=-1) {
+	// place any new remote units that come before this one
+	for (; base_remote<_lpr; base_remote++) {
+	  addRemote(base_remote);
 	}
-      }
-    } else {
-      int _r = iremote;
-      if (_r<xremote.height()) {
-	if (xremote.cell(0,_r)==0) {
-	  int _rp = order_remote.b2a(_r);
-	  if (_rp!=-1) {
-	    int _rpl = order_local.a2b(_rp);
-	    if (_rpl!=-1) {
-	      // we will get this (assuming no collisions), skip...
-	    } else {
-	      // deleted locally
-	    }
-	  } else {
-	    dbg_printf("Remote unit %d not in pivot - [ADD]\n", _r);
-	    accum.push_back(MatchUnit(-1,-1,_r,false,MATCH_UNIT_INSERT));
-	    if (_r>=0) {
-	      xremote.cell(0,_r) = 1;
-	    }
-	  }
+	//dbg_printf("Local unit %d exists in pivot at %d and in remote at %d\n", _l, _lp, _lpr);
+	accum.push_back(MatchUnit(_lp,_l,_lpr,false,MATCH_UNIT_PRESERVE));
+	if (_lpr>=0 && _lpr<(int)xremote.size()) {
+	  xremote[_lpr] = 1;
 	}
+	xlocal[_l] = 1;
+      } else {
+	dbg_printf("Local unit %d exists in pivot at %d, but not in remote - [DELETE]\n", _l, _lp);
+	accum.push_back(MatchUnit(_lp,_l,-1,true,MATCH_UNIT_DELETE));
+	xlocal[_l] = 1;
       }
-    }
-    if (ilocal<stop_local) {
-      ilocal++;
-      base_local++;
     } else {
-      iremote++;
-      base_remote++;
+      dbg_printf("Local unit %d not in pivot - [ADD]\n", _l);
+      accum.push_back(MatchUnit(-1,_l,-1,false,MATCH_UNIT_PRESERVE));
+      xlocal[_l] = 1;
     }
   }
+  for (int _r=0; _r<stop_remote; _r++) {
+    addRemote(_r);
+  }
 }
 
 
@@ -365,18 +334,39 @@ static void evaluate(const OrderResult& order_local,
 }
 
 
-static int safe_next(const efficient_map<int,int>& m, int val, int def) {
-  efficient_map<int,int>::const_iterator it = m.find(val);
-  if (it==m.end()) return def;
-  return it->second;
-}
-
-static int next_avail(const set<int>& s, int val) {
-  set<int>::const_iterator it = s.find(val);
-  if (it==s.end()) return -2;
-  it++;
-  if (it==s.end()) return -2;
-  return *it;
+/*
+  Flag the entries of seq that lie outside one longest strictly
+  increasing subsequence.  Patience sorting, O(n log n).
+ */
+static void markUnordered(const vector<int>& seq, 
+			  vector<unsigned char>& out) {
+  int n = (int)seq.size();
+  out.assign(n,1);
+  vector<int> tails;  // positions in seq ending the best run of each length
+  vector<int> parent(n,-1);
+  for (int i=0; i<n; i++) {
+    int lo = 0;
+    int hi = (int)tails.size();
+    while (lo<hi) {
+      int mid = (lo+hi)/2;
+      if (seq[tails[mid]]<seq[i]) {
+	lo = mid+1;
+      } else {
+	hi = mid;
+      }
+    }
+    if (lo>0) parent[i] = tails[lo-1];
+    if (lo==(int)tails.size()) {
+      tails.push_back(i);
+    } else {
+      tails[lo] = i;
+    }
+  }
+  int at = tails.empty()?-1:tails.back();
+  while (at!=-1) {
+    out[at] = 0;
+    at = parent[at];
+  }
 }
 
 void OrderMerge::merge(const OrderResult& nlocal,
@@ -394,278 +384,98 @@ void OrderMerge::merge(const OrderResult& nlocal,
     order_local.trimTail(-1,-2);
     order_remote.trimTail(-1,-2);
   }
-  xlocal.resize(1,order_local.blen(),0);
-  xremote.resize(1,order_remote.blen(),0);
+  accum.clear();
+  xlocal.assign(order_local.blen(),0);
+  xremote.assign(order_remote.blen(),0);
   start_local = 0;
   start_remote = 0;
-  int base_local = 0;
-  int base_remote = 0;
-  process(0,0,base_local,base_remote,order_local.blen(),order_remote.blen());
-
-  bool good = false;
-  bool more = true;
-  list<MatchUnit> canon;
-  list<MatchUnit> canon_rem1;
-  list<MatchUnit> canon_rem2;
-  list<MatchUnit> *canon_src = &accum;
-
-  bool ordered = flags.use_order;
+  process(order_local.blen(),order_remote.blen());
 
   if (flags.use_order||columnar) {
 
-    while (more) {
-
-      int ct = 0;
-      efficient_map<int,int> l2k, r2k, p2k;
-      efficient_map<int,int> it2k;
-      efficient_map<int,MatchUnit *> mu;
-      set<int> availableP;
-      set<int> availableL;
-      set<int> availableR;
-    
-      int lowestL = -2;
-      int lowestR = -2;
-      int gct = 0;
-      for (list<MatchUnit>::iterator it=canon_src->begin();
-	   it!=canon_src->end(); 
-	   it++) {
-	MatchUnit& unit = *it;
-	int pCol = unit.pivotUnit;
-	int lCol = unit.localUnit;
-	int rCol = unit.remoteUnit;
-	bool deleted = unit.deleted;
-	/*dbg_printf("match %d: %d: P/L/R %d %d %d %s\n", 
-	  gct, deleted?-1:ct, pCol, lCol, rCol,
-	  deleted?"(deleted)":"");*/
-	gct++;
-	if (deleted) { continue; }
-	it2k[gct-1] = ct;
-	if ((lCol<lowestL&&lCol>=0)||lowestL==-2) {
-	  lowestL = lCol;
-	}
-	if (lCol!=-1) {
-	  availableL.insert(lCol);
-	}
-	if ((rCol<lowestR&&rCol>=0)||lowestR==-2) {
-	  lowestR = rCol;
-	}
-	if (rCol!=-1) {
-	  availableR.insert(rCol);
-	}
-	if (pCol!=-1) {
-	  availableP.insert(pCol);
-	}
-	if (pCol>=0) {
-	  p2k[pCol] = ct;
-	}
-	if (lCol>=0) {
-	  l2k[lCol] = ct;
-	}
-	if (rCol>=0) {
-	  r2k[rCol] = ct;
-	}
-	mu[ct] = &unit;
-	ct++;
-      }
-      int units = ct;
-    
-      Viterbi v;
-    
-      int dud = units;
-      v.setSize(units+1,units+2);
-      set<int> idx;
-    
-      v.beginTransitions();
-      if (lowestL>=0) {
-	v.addTransition(l2k[lowestL],l2k[lowestL],0);  
-	idx.insert(l2k[lowestL]);
-      }
-      if (lowestR>=0) {
-	v.addTransition(r2k[lowestR],r2k[lowestR],0);  
-	idx.insert(r2k[lowestR]);
-      }
-      v.addTransition(dud,dud,1);  
-      v.endTransitions();
-    
-      for (int draw=0; draw<units-1; draw++) {
-	//dbg_printf("DRAW %d (%d)\n", draw, units);
-	v.beginTransitions();
-
-	set<int> idx2;
-	for (set<int>::const_iterator it1=idx.begin(); it1!=idx.end(); it1++) {
-	  int k = (*it1);
-	  //dbg_printf("  draw %d k %d\n", draw, k);
-	  if (k==dud) continue;
-
-	  MatchUnit& unit = *mu[k];
-	  int pCol = unit.pivotUnit;
-	  int lCol = unit.localUnit;
-	  int rCol = unit.remoteUnit;
-	  bool deleted = unit.deleted;
-
-	  //dbg_printf("    match P/L/R %d %d %d %s\n", pCol, lCol, rCol,
-	  //deleted?"(deleted)":"");
-
-	  if (lCol==-1 && rCol==-1) {
-	    int next = safe_next(p2k,next_avail(availableP,pCol),dud);
-	    v.addTransition(k,next,0);
-	    //dbg_printf("    transition %d %d\n", k, next);
-	    idx2.insert(next);
-	    continue;
-	  }
-	  if (rCol==-1) {
-	    int next = safe_next(l2k,next_avail(availableL,lCol),dud);
-	    v.addTransition(k,next,0);
-	    //dbg_printf("    transition %d %d\n", k, next);
-	    idx2.insert(next);
-	    continue;
-	  }
-	  if (lCol==-1) {
-	    int next = safe_next(r2k,next_avail(availableR,rCol),dud);
-	    v.addTransition(k,next,0);
-	    //dbg_printf("    transition %d %d\n", k, next);
-	    idx2.insert(next);
-	    continue;
-	  }
-	  int lnext = safe_next(l2k,next_avail(availableL,lCol),dud);
-	  int rnext = safe_next(r2k,next_avail(availableR,rCol),dud);
-	  /*
-	    if (lnext==dud||rnext==dud) {
-	    v.addTransition(k,lnext,0);
-	    dbg_printf("    transition %d %d\n", k, lnext);
-	    idx2.insert(lnext);
-	    v.addTransition(k,rnext,0);
-	    dbg_printf("    transition %d %d\n", k, rnext);
-	    idx2.insert(rnext);
-	    continue;
-	    }
-	  */
-	  int pnext = safe_next(p2k,next_avail(availableP,pCol),dud);
-	  if (lnext!=pnext) {
-	    v.addTransition(k,lnext,0);
-	    //dbg_printf("    transition %d %d\n", k, lnext);
-	    idx2.insert(lnext);
-	  }
-	  if (rnext!=pnext) {
-	    v.addTransition(k,rnext,0);
-	    //dbg_printf("    transition %d %d\n", k, rnext);
-	    idx2.insert(rnext);
-	  }
-	  if (rnext==pnext&&lnext==pnext) {
-	    v.addTransition(k,pnext,0);
-	    //dbg_printf("    transition %d %d\n", k, pnext);
-	    idx2.insert(pnext);
-	  }
-	}
-	idx = idx2;
-	v.addTransition(dud,dud,1);  
-	v.endTransitions();
-      }
-
-      v.beginTransitions();
-      for (int draw=0; draw<=units; draw++) {
-	v.addTransition(draw,draw,(draw==units));
-      }
-      v.endTransitions();
-      int qo = 1;
-
-      /*
-	if (_csv_verbose) {
-	dbg_printf("Viterbi calculation:\n");
-	int q = v.length()-qo;
-	for (int i=0; i<q; i++) {
-	int k = v.getPath(i);
-	dbg_printf("*** %d\n", k);
-	}
-	}
-      */
-
-      int q = v.length()-qo;
-      efficient_map<int,int> dups;
-      efficient_map<int,int> accepted;
-      dups[dud] = 1;
-      good = true;
-      //if (v.getPath(q)!=dud) {
-      for (int i=0; i<q; i++) {
-	int k = v.getPath(i);
-	int k2 = k;
-	if (i<q-1) {
-	  k2 = v.getPath(i+1);
-	}
-	if (dups.find(k)==dups.end() && dups.find(k2)==dups.end()) {
-	  canon.push_back(*mu[k]);
-	  //dbg_printf("     ADDED -> %d (%d %d %d)\n", canon.size(),
-	  //	   mu[k]->pivotUnit, mu[k]->localUnit, mu[k]->remoteUnit);
-	  dups[k] = 1;
-	  accepted[k] = 1;
-	} else {
-	  //dbg_printf("     hit dodgy match\n");
-	  good = false;
-	  break;
-	}
-      }
+    // Start from the remote order, then take from the local side
+    // every unit it has that remote lacks, and every unit it moved
+    // relative to the pivot.  Those go just after the unit before
+    // them in local order.  A unit moved on both sides follows local.
+    int n = (int)accum.size();
+    int lenL = 0, lenR = 0;
+    for (int i=0; i<n; i++) {
+      const MatchUnit& unit = accum[i];
+      if (unit.localUnit>=lenL) lenL = unit.localUnit+1;
+      if (unit.remoteUnit>=lenR) lenR = unit.remoteUnit+1;
+    }
+    vector<int> byL(lenL,-1), byR(lenR,-1);
+    for (int i=0; i<n; i++) {
+      const MatchUnit& unit = accum[i];
+      if (unit.deleted) continue;
+      if (unit.localUnit>=0) byL[unit.localUnit] = i;
+      if (unit.remoteUnit>=0) byR[unit.remoteUnit] = i;
+    }
 
-      more = !good;
-      list<MatchUnit> *canon_old_src = canon_src;
-      if (canon_src != &canon_rem1) {
-	canon_src = &canon_rem1;
-      } else {
-	canon_src = &canon_rem2;
-      }
-      canon_src->clear();
-      int gct2 = 0;
-      int omit = 0;
-      for (list<MatchUnit>::iterator it=canon_old_src->begin();
-	   it!=canon_old_src->end(); 
-	   it++) {
-	if (it2k.find(gct2)!=it2k.end()) {
-	  if (accepted.find(it2k[gct2])!=accepted.end()) {
-	    omit++;
-	  } else {
-	    canon_src->push_back(*it);
-	  }
-	}
-	gct2++;
-      }
-      dbg_printf("Got to length %d of %d...\n",
-		 canon.size(), accum.size());
-      if (omit==0) {
-	//      dbg_printf("No progress made\n");
-	more = false;
-      }
-      dbg_printf("STATUS %d %d / %s, %s\n", canon.size(), accum.size(), good?"good":"no good", more?"more":"no more");
+    // a unit is moved locally if it is off the longest run of
+    // local units that keep their pivot order
+    vector<unsigned char> moved(n,0);
+    vector<int> seq, seqUnit;
+    for (int l=0; l<lenL; l++) {
+      int u = byL[l];
+      if (u<0 || accum[u].pivotUnit<0) continue;
+      seq.push_back(accum[u].pivotUnit);
+      seqUnit.push_back(u);
+    }
+    vector<unsigned char> off;
+    markUnordered(seq,off);
+    for (int i=0; i<(int)seq.size(); i++) {
+      moved[seqUnit[i]] = off[i];
     }
 
-    if (canon_src!=&accum) {
-      for (list<MatchUnit>::iterator it=canon_src->begin();
-	   it!=canon_src->end(); 
-	   it++) {
-	if (!it->deleted) {
-	  canon.push_back(*it);
-	  //dbg_printf("     ADDED UNORDERED -> %d (%d %d %d)\n", canon.size(),
-	  //it->pivotUnit, it->localUnit, it->remoteUnit);
+    // units in merged order, as a linked list
+    vector<int> next(n,-1), prev(n,-1);
+    vector<unsigned char> listed(n,0);
+    int head = -1, tail = -1;
+    for (int r=0; r<lenR; r++) {
+      int u = byR[r];
+      if (u<0) continue;
+      prev[u] = tail;
+      if (tail>=0) next[tail] = u; else head = u;
+      tail = u;
+      listed[u] = 1;
+    }
+    int last = -1;
+    for (int l=0; l<lenL; l++) {
+      int u = byL[l];
+      if (u<0) continue;
+      if (!listed[u] || moved[u]) {
+	if (listed[u]) {
+	  if (prev[u]>=0) next[prev[u]] = next[u]; else head = next[u];
+	  if (next[u]>=0) prev[next[u]] = prev[u]; else tail = prev[u];
 	}
+	int after = (last>=0)?next[last]:head;
+	prev[u] = last;
+	next[u] = after;
+	if (last>=0) next[last] = u; else head = u;
+	if (after>=0) prev[after] = u; else tail = u;
+	listed[u] = 1;
       }
+      last = u;
     }
 
-    for (list<MatchUnit>::iterator it=accum.begin();
-	 it!=accum.end(); 
-	 it++) {
-      if (it->deleted) {
-	canon.push_back(*it);
-	//dbg_printf("     ADDED DELETED -> %d (%d %d %d)\n", canon.size(),
-	//it->pivotUnit, it->localUnit, it->remoteUnit);
+    vector<MatchUnit> canon;
+    canon.reserve(n);
+    for (int u=head; u>=0; u=next[u]) {
+      canon.push_back(accum[u]);
+    }
+    for (int i=0; i<n; i++) {
+      if (accum[i].deleted) {
+	canon.push_back(accum[i]);
       }
     }
-    accum = canon;
+    accum.swap(canon);
   }
 
   int ct = 0;
   overlap = 0;
-  for (list<MatchUnit>::iterator it=accum.begin();
-       it!=accum.end(); 
-       it++) {
-    MatchUnit& unit = *it;
+  for (int i=0; i<(int)accum.size(); i++) {
+    MatchUnit& unit = accum[i];
     int pCol = unit.pivotUnit;
     int lCol = unit.localUnit;
     int rCol = unit.remoteUnit;
@@ -250,6 +250,110 @@ void RowChange::show() {
   diff.changeRow(*this);
 }
 
+void RowChangeNames::setNames(const vector<string>& names) {
+  order.clear();
+  for (int i=0; i<(int)names.size(); i++) {
+    order.push_back(add(names[i]));
+  }
+}
+
+int RowChangeNames::add(const string& name) {
+  map<string,int>::const_iterator it = ids.find(name);
+  if (it!=ids.end()) return it->second;
+  int id = (int)names.size();
+  ids[name] = id;
+  names.push_back(name);
+  RowChange::txt2bool::const_iterator idx = indexes.find(name);
+  index_mask.push_back((idx!=indexes.end()&&idx->second)?1:0);
+  return id;
+}
+
+void RowChangeNames::setIndexes(const RowChange::txt2bool& indexes) {
+  this->indexes = indexes;
+  index_mask.assign(names.size(),0);
+  for (int i=0; i<(int)names.size(); i++) {
+    RowChange::txt2bool::const_iterator idx = indexes.find(names[i]);
+    if (idx!=indexes.end()&&idx->second) index_mask[i] = 1;
+  }
+}
+
+bool CompactRowChange::covers(int id) const {
+  for (int i=0; i<width(); i++) {
+    if (idAt(i)==id) return true;
+  }
+  return false;
+}
+
+void CompactRowChange::toRowChange(RowChange& change) const {
+  change.mode = mode;
+  change.sequential = sequential;
+  change.conflicted = conflicted;
+  change.pRow = pRow;
+  change.lRow = lRow;
+  change.rRow = rRow;
+  change.cond.clear();
+  change.val.clear();
+  change.conflictingVal.clear();
+  change.conflictingParentVal.clear();
+  change.names.clear();
+  change.allNames.clear();
+  change.indexes.clear();
+  if (!columns.isValid()) return;
+  for (int i=0; i<width(); i++) {
+    change.names.push_back(nameOf(idAt(i)));
+  }
+  for (int id=0; id<(int)active.size(); id++) {
+    if (!active[id]) continue;
+    const string& name = nameOf(id);
+    if (hasCond(id)) change.cond[name] = cond[id];
+    if (hasVal(id)) change.val[name] = val[id];
+    if (hasConflict(id)) change.conflictingVal[name] = conflictingVal[id];
+    if (hasConflictParent(id)) {
+      change.conflictingParentVal[name] = conflictingParentVal[id];
+    }
+  }
+  change.allNames = columns->allNames;
+  change.indexes = columns->indexes;
+}
+
+void CompactRowChange::fromRowChange(const RowChange& change) {
+  mode = change.mode;
+  sequential = change.sequential;
+  conflicted = change.conflicted;
+  pRow = change.pRow;
+  lRow = change.lRow;
+  rRow = change.rRow;
+  active.clear();
+  cond.clear();
+  val.clear();
+  conflictingVal.clear();
+  conflictingParentVal.clear();
+  RowChangeNames *names = new RowChangeNames;
+  columns = Poly<RowChangeNames>(names,true);
+  names->setNames(change.names);
+  names->allNames = change.allNames;
+  names->setIndexes(change.indexes);
+  hasNames = true;
+  for (RowChange::txt2cell::const_iterator it = change.cond.begin();
+       it!=change.cond.end(); it++) {
+    setCond(names->add(it->first),it->second);
+  }
+  for (RowChange::txt2cell::const_iterator it = change.val.begin();
+       it!=change.val.end(); it++) {
+    setVal(names->add(it->first),it->second);
+  }
+  for (RowChange::txt2cell::const_iterator it = change.conflictingVal.begin();
+       it!=change.conflictingVal.end(); it++) {
+    set(names->add(it->first),CELL_CONFLICT,conflictingVal,it->second);
+  }
+  for (RowChange::txt2cell::const_iterator it = 
+	 change.conflictingParentVal.begin();
+       it!=change.conflictingParentVal.end(); it++) {
+    set(names->add(it->first),CELL_CONFLICT_PARENT,conflictingParentVal,
+	it->second);
+  }
+}
+
 
 
 
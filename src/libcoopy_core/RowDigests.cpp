@@ -0,0 +1,254 @@
+#include <coopy/RowDigests.h>
+#include <coopy/DataSheet.h>
+#include <coopy/Hasher.h>
+
+using namespace coopy::store;
+using namespace std;
+
+int RowDigests::span(int level) {
+  long long s = FANOUT;
+  for (int i=0; i<level; i++) {
+    s *= FANOUT;
+    if (s>0x40000000LL) return 0x40000000;
+  }
+  return (int)s;
+}
+
+void RowDigests::clear() {
+  width = -1;
+  rows.clear();
+  row_ok.clear();
+  nodes.clear();
+  node_ok.clear();
+}
+
+void RowDigests::dirty(int y) {
+  row_ok[y] = 0;
+  for (int k=0; k<(int)node_ok.size(); k++) {
+    int i = y/span(k);
+    if (i<(int)node_ok[k].size()) {
+      node_ok[k][i] = 0;
+    }
+  }
+}
+
+void RowDigests::dirtyFrom(int y) {
+  for (int k=0; k<(int)node_ok.size(); k++) {
+    vector<char>& ok = node_ok[k];
+    for (int i=y/span(k); i<(int)ok.size(); i++) {
+      ok[i] = 0;
+    }
+  }
+}
+
+void RowDigests::rowsInserted(int y, int n) {
+  if (y<0 || y>(int)rows.size() || n<=0) return;
+  rows.insert(rows.begin()+y,n,0);
+  row_ok.insert(row_ok.begin()+y,n,0);
+  // everything after y has moved
+  dirtyFrom(y);
+}
+
+void RowDigests::rowsRemoved(int y, int n) {
+  if (y<0 || y>=(int)rows.size() || n<=0) return;
+  if (y+n>(int)rows.size()) n = (int)rows.size()-y;
+  rows.erase(rows.begin()+y,rows.begin()+y+n);
+  row_ok.erase(row_ok.begin()+y,row_ok.begin()+y+n);
+  dirtyFrom(y);
+}
+
+void RowDigests::rowsRemoved(const vector<int>& ys) {
+  if (ys.size()==0) return;
+  if (ys[0]<0 || ys.back()>=(int)rows.size()) return;
+  int at = ys[0];
+  int k = 0;
+  for (int y=ys[0]; y<(int)rows.size(); y++) {
+    if (k<(int)ys.size() && ys[k]==y) {
+      k++;
+      continue;
+    }
+    rows[at] = rows[y];
+    row_ok[at] = row_ok[y];
+    at++;
+  }
+  rows.resize(at);
+  row_ok.resize(at);
+  dirtyFrom(ys[0]);
+}
+
+void RowDigests::fitLevels() {
+  int h = (int)rows.size();
+  int levels = 1;
+  while ((h+span(levels-1)-1)/span(levels-1)>FANOUT) {
+    levels++;
+  }
+  nodes.resize(levels);
+  node_ok.resize(levels);
+  for (int k=0; k<levels; k++) {
+    int n = (h+span(k)-1)/span(k);
+    int prev = (int)nodes[k].size();
+    if (n==prev) continue;
+    // a block at the old edge may have changed size
+    if (prev>0 && prev-1<n) {
+      node_ok[k][prev-1] = 0;
+    }
+    nodes[k].resize(n,0);
+    node_ok[k].resize(n,0);
+  }
+}
+
+void RowDigests::update(const DataSheet& sheet) {
+  int w = sheet.width();
+  if (w!=width) {
+    clear();
+    width = w;
+  }
+  int h = sheet.height();
+  if ((int)rows.size()!=h) {
+    int old = (int)rows.size();
+    rows.resize(h,0);
+    row_ok.resize(h,0);
+    dirtyFrom((old<h)?old:h);
+  }
+  fitLevels();
+  RowBlock block;
+  int top = (int)nodes.size()-1;
+  for (int i=0; i<(int)nodes[top].size(); i++) {
+    updateNode(sheet,block,top,i);
+  }
+}
+
+bool RowDigests::isCurrent(const DataSheet& sheet) const {
+  int h = sheet.height();
+  if (sheet.width()!=width) return false;
+  if ((int)rows.size()!=h) return false;
+  if (nodes.size()==0) return false;
+  for (int k=0; k<(int)nodes.size(); k++) {
+    if ((int)nodes[k].size()!=(h+span(k)-1)/span(k)) return false;
+  }
+  int top = (int)nodes.size()-1;
+  // as in fitLevels, the top level is the first with few enough blocks
+  if (top>0 && (int)nodes[top-1].size()<=FANOUT) return false;
+  if ((int)nodes[top].size()>FANOUT) return false;
+  for (int i=0; i<(int)node_ok[top].size(); i++) {
+    if (!node_ok[top][i]) return false;
+  }
+  return true;
+}
+
+void RowDigests::updateNode(const DataSheet& sheet, RowBlock& block,
+			    int level, int index) {
+  if (node_ok[level][index]) return;
+  FastHasher hasher;
+  int first = index*FANOUT;
+  if (level==0) {
+    int last = first+FANOUT;
+    if (last>(int)rows.size()) last = (int)rows.size();
+    for (int y=first; y<last; y++) {
+      if (!row_ok[y]) {
+	if (!block.contains(y)) {
+	  int run = y;
+	  while (run<last && !row_ok[run]) run++;
+	  sheet.readRows(y,run-y,block);
+	}
+	for (int x=0; x<width; x++) {
+	  const SheetCellView& v = block.cell(x,y);
+	  int mark = v.len*2+(v.escaped?1:0);
+	  hasher.add((const char *)&mark,sizeof(mark));
+	  hasher.add(v.data,v.len);
+	}
+	rows[y] = hasher.finish64();
+	row_ok[y] = 1;
+      }
+    }
+    hasher.add((const char *)&rows[first],(last-first)*sizeof(rows[0]));
+  } else {
+    int last = first+FANOUT;
+    if (last>(int)nodes[level-1].size()) last = (int)nodes[level-1].size();
+    for (int i=first; i<last; i++) {
+      updateNode(sheet,block,level-1,i);
+    }
+    hasher.add((const char *)&nodes[level-1][first],
+	       (last-first)*sizeof(rows[0]));
+  }
+  int count = (int)rows.size();
+  hasher.add((const char *)&count,sizeof(count));
+  nodes[level][index] = hasher.finish64();
+  node_ok[level][index] = 1;
+}
+
+void RowDigests::addRange(vector<pair<int,int> >& ranges,
+			  int first, int last) {
+  if (first>=last) return;
+  if (ranges.size()>0 && ranges.back().second==first) {
+    ranges.back().second = last;
+    return;
+  }
+  ranges.push_back(make_pair(first,last));
+}
+
+void RowDigests::compareNode(const RowDigests& alt, int level, int index,
+			     int lo, int hi, int off,
+			     vector<pair<int,int> >& ranges) const {
+  int s = span(level);
+  long long start = (long long)index*s;
+  long long end = start+s;
+  if (end<=lo || start>=hi) return;
+  if (start>=lo && end<=hi) {
+    if (nodes[level][index]==alt.nodes[level][index]) return;
+  }
+  if (level==0) {
+    int y0 = (start>lo)?(int)start:lo;
+    int y1 = (end<hi)?(int)end:hi;
+    for (int y=y0; y<y1; y++) {
+      if (rows[y]!=alt.rows[y]) {
+	addRange(ranges,y-off,y-off+1);
+      }
+    }
+    return;
+  }
+  int first = index*FANOUT;
+  int last = first+FANOUT;
+  if (last>(int)nodes[level-1].size()) last = (int)nodes[level-1].size();
+  for (int i=first; i<last; i++) {
+    compareNode(alt,level-1,i,lo,hi,off,ranges);
+  }
+}
+
+void RowDigests::differingRanges(const DataSheet& a, const DataSheet& b,
+				 vector<pair<int,int> >& ranges) {
+  ranges.clear();
+  RowDigests ta, tb;
+  int oa = 0, ob = 0;
+  const RowDigests *da = a.getRowDigests(oa);
+  if (!da) {
+    ta.update(a);
+    da = &ta;
+    oa = 0;
+  }
+  const RowDigests *db = b.getRowDigests(ob);
+  if (!db) {
+    tb.update(b);
+    db = &tb;
+    ob = 0;
+  }
+  int ha = a.height();
+  int hb = b.height();
+  int h = (ha<hb)?ha:hb;
+  if (oa==ob) {
+    // blocks line up, so whole blocks can be compared at once
+    int levels = (int)da->nodes.size();
+    if ((int)db->nodes.size()<levels) levels = (int)db->nodes.size();
+    int top = levels-1;
+    for (int i=0; i<(int)da->nodes[top].size(); i++) {
+      da->compareNode(*db,top,i,oa,oa+h,oa,ranges);
+    }
+  } else {
+    for (int y=0; y<h; y++) {
+      if (da->rows[y+oa]!=db->rows[y+ob]) {
+	addRange(ranges,y,y+1);
+      }
+    }
+  }
+  addRange(ranges,h,(ha>hb)?ha:hb);
+}
@@ -0,0 +1,391 @@
+#include <coopy/RowMatchIndex.h>
+#include <coopy/Hasher.h>
+
+#include <algorithm>
+
+using namespace std;
+using namespace coopy::cmp;
+using namespace coopy::store;
+
+static void add_cell(FastHasher& hasher, const char *txt, int len,
+		     bool escaped) {
+  char pre[5];
+  pre[0] = escaped?1:0;
+  for (int i=0; i<4; i++) {
+    pre[i+1] = (char)((len>>(8*i))&0xff);
+  }
+  hasher.add(pre,5);
+  hasher.add(txt,len);
+}
+
+void RowMatchIndex::clear() {
+  sheet_id = 0/*NULL*/;
+  sheet_width = -1;
+  cols.clear();
+  keys.clear();
+  left.clear();
+  right.clear();
+  parent.clear();
+  count.clear();
+  priority.clear();
+  root = -1;
+  seed = 1;
+  slots.clear();
+  used = 0;
+  removed = 0;
+}
+
+bool RowMatchIndex::valid(const DataSheet& sheet,
+			  const vector<int>& cols) const {
+  if (sheet_id!=&sheet.dataTail()) return false;
+  if (sheet_width!=sheet.width()) return false;
+  if (size()!=sheet.height()) return false;
+  return this->cols==cols;
+}
+
+unsigned long long RowMatchIndex::keyOfRow(const DataSheet& sheet, int y) {
+  FastHasher hasher;
+  for (int i=0; i<(int)cols.size(); i++) {
+    SheetCellView v = sheet.cellView(cols[i],y,scratch);
+    add_cell(hasher,v.data,v.len,v.escaped);
+  }
+  return hasher.finish64();
+}
+
+unsigned long long RowMatchIndex::keyOfCells(const vector<SheetCell>& cond) {
+  FastHasher hasher;
+  for (int i=0; i<(int)cols.size(); i++) {
+    const SheetCell& c = cond[cols[i]];
+    add_cell(hasher,c.text.c_str(),(int)c.text.length(),c.escaped);
+  }
+  return hasher.finish64();
+}
+
+int RowMatchIndex::makeSerial(unsigned long long key) {
+  // xorshift, so the tree has the same shape from run to run
+  seed ^= seed<<13;
+  seed ^= seed>>17;
+  seed ^= seed<<5;
+  keys.push_back(key);
+  left.push_back(-1);
+  right.push_back(-1);
+  parent.push_back(-1);
+  count.push_back(1);
+  priority.push_back(seed);
+  return (int)keys.size()-1;
+}
+
+void RowMatchIndex::pull(int x) {
+  int n = 1;
+  if (left[x]>=0) {
+    n += count[left[x]];
+    parent[left[x]] = x;
+  }
+  if (right[x]>=0) {
+    n += count[right[x]];
+    parent[right[x]] = x;
+  }
+  count[x] = n;
+}
+
+int RowMatchIndex::join(int a, int b) {
+  if (a<0) return b;
+  if (b<0) return a;
+  if (priority[a]>priority[b]) {
+    right[a] = join(right[a],b);
+    pull(a);
+    return a;
+  }
+  left[b] = join(a,left[b]);
+  pull(b);
+  return b;
+}
+
+void RowMatchIndex::split(int t, int n, int& a, int& b) {
+  if (t<0) {
+    a = b = -1;
+    return;
+  }
+  int at = (left[t]<0)?0:count[left[t]];
+  int lo, hi;
+  if (n<=at) {
+    split(left[t],n,lo,hi);
+    left[t] = hi;
+    pull(t);
+    a = lo;
+    b = t;
+  } else {
+    split(right[t],n-at-1,lo,hi);
+    right[t] = lo;
+    pull(t);
+    a = t;
+    b = hi;
+  }
+}
+
+void RowMatchIndex::treeInsert(int s, int y) {
+  int a, b;
+  left[s] = right[s] = -1;
+  count[s] = 1;
+  split(root,y,a,b);
+  root = join(join(a,s),b);
+  parent[root] = -1;
+}
+
+int RowMatchIndex::treeRemove(int y) {
+  int a, b, m, c;
+  split(root,y,a,b);
+  split(b,1,m,c);
+  root = join(a,c);
+  if (root>=0) parent[root] = -1;
+  parent[m] = -1;
+  return m;
+}
+
+int RowMatchIndex::serialAt(int y) const {
+  int x = root;
+  while (x>=0) {
+    int at = (left[x]<0)?0:count[left[x]];
+    if (y==at) break;
+    if (y<at) {
+      x = left[x];
+    } else {
+      y -= at+1;
+      x = right[x];
+    }
+  }
+  return x;
+}
+
+int RowMatchIndex::rowOf(int s) const {
+  int y = (left[s]<0)?0:count[left[s]];
+  int x = s;
+  while (parent[x]>=0) {
+    int p = parent[x];
+    if (right[p]==x) {
+      y += ((left[p]<0)?0:count[left[p]])+1;
+    }
+    x = p;
+  }
+  return y;
+}
+
+void RowMatchIndex::order(vector<int>& serials) const {
+  serials.clear();
+  vector<int> stack;
+  int x = root;
+  while (x>=0||stack.size()>0) {
+    while (x>=0) {
+      stack.push_back(x);
+      x = left[x];
+    }
+    x = stack.back();
+    stack.pop_back();
+    serials.push_back(x);
+    x = right[x];
+  }
+}
+
+void RowMatchIndex::plant(const vector<int>& serials) {
+  // serials are in row order; link them up as a treap in one pass,
+  // keeping a stack of the right spine
+  vector<int> stack;
+  for (int i=0; i<(int)serials.size(); i++) {
+    int s = serials[i];
+    int last = -1;
+    while (stack.size()>0&&priority[stack.back()]<priority[s]) {
+      last = stack.back();
+      stack.pop_back();
+    }
+    left[s] = last;
+    right[s] = -1;
+    if (stack.size()>0) right[stack.back()] = s;
+    stack.push_back(s);
+  }
+  root = (stack.size()>0)?stack[0]:-1;
+  if (root<0) return;
+  // counts go bottom up, so visit parents first and pull in reverse
+  vector<int> todo;
+  todo.push_back(root);
+  for (int i=0; i<(int)todo.size(); i++) {
+    int x = todo[i];
+    if (left[x]>=0) todo.push_back(left[x]);
+    if (right[x]>=0) todo.push_back(right[x]);
+  }
+  for (int i=(int)todo.size()-1; i>=0; i--) {
+    pull(todo[i]);
+  }
+  parent[root] = -1;
+}
+
+void RowMatchIndex::compact() {
+  // drop the serials of removed rows, renumbering the rest in order
+  vector<int> serials;
+  order(serials);
+  vector<unsigned long long> keys2(serials.size());
+  vector<unsigned int> priority2(serials.size());
+  for (int i=0; i<(int)serials.size(); i++) {
+    keys2[i] = keys[serials[i]];
+    priority2[i] = priority[serials[i]];
+    serials[i] = i;
+  }
+  keys.swap(keys2);
+  priority.swap(priority2);
+  left.assign(keys.size(),-1);
+  right.assign(keys.size(),-1);
+  parent.assign(keys.size(),-1);
+  count.assign(keys.size(),1);
+  plant(serials);
+  rehash();
+}
+
+void RowMatchIndex::build(const DataSheet& sheet, const vector<int>& cols) {
+  clear();
+  sheet_id = &sheet.dataTail();
+  sheet_width = sheet.width();
+  this->cols = cols;
+  int h = sheet.height();
+  vector<int> serials(h);
+  for (int y=0; y<h; y++) {
+    serials[y] = makeSerial(keyOfRow(sheet,y));
+  }
+  plant(serials);
+  rehash();
+}
+
+void RowMatchIndex::rehash() {
+  size_t len = 16;
+  while (len<(size_t)size()*2) len *= 2;
+  slots.assign(len,-1);
+  used = 0;
+  removed = 0;
+  vector<int> serials;
+  order(serials);
+  for (int i=0; i<(int)serials.size(); i++) {
+    place(serials[i]);
+  }
+}
+
+void RowMatchIndex::place(int s) {
+  if ((size_t)(used+removed+1)*4>slots.size()*3) {
+    // rehash places every serial in the tree, s included
+    rehash();
+    return;
+  }
+  size_t mask = slots.size()-1;
+  size_t at = (size_t)(keys[s]&mask);
+  while (slots[at]>=0) {
+    at = (at+1)&mask;
+  }
+  if (slots[at]==-2) removed--;
+  slots[at] = s;
+  used++;
+}
+
+void RowMatchIndex::unplace(int s) {
+  size_t mask = slots.size()-1;
+  size_t at = (size_t)(keys[s]&mask);
+  while (slots[at]!=s) {
+    at = (at+1)&mask;
+  }
+  slots[at] = -2;
+  used--;
+  removed++;
+}
+
+void RowMatchIndex::candidates(const DataSheet& sheet,
+			       const vector<int>& cols,
+			       const vector<SheetCell>& cond,
+			       vector<int>& rows) {
+  rows.clear();
+  if (!valid(sheet,cols)) {
+    build(sheet,cols);
+  }
+  unsigned long long key = keyOfCells(cond);
+  size_t mask = slots.size()-1;
+  size_t at = (size_t)(key&mask);
+  while (slots[at]!=-1) {
+    int s = slots[at];
+    if (s>=0&&keys[s]==key) rows.push_back(rowOf(s));
+    at = (at+1)&mask;
+  }
+  sort(rows.begin(),rows.end());
+}
+
+void RowMatchIndex::rowInserted(const DataSheet& sheet, int y) {
+  if (sheet_id==0/*NULL*/) return;
+  if (y<0||y>size()) {
+    clear();
+    return;
+  }
+  int s = makeSerial(keyOfRow(sheet,y));
+  treeInsert(s,y);
+  place(s);
+}
+
+void RowMatchIndex::rowRemoved(int y) {
+  if (sheet_id==0/*NULL*/) return;
+  if (y<0||y>=size()) {
+    clear();
+    return;
+  }
+  unplace(treeRemove(y));
+  if ((int)keys.size()>2*size()+16) compact();
+}
+
+void RowMatchIndex::rowsRemoved(const vector<int>& rows) {
+  if (sheet_id==0/*NULL*/) return;
+  if (rows.size()==0) return;
+  if (rows.back()>=size()) {
+    clear();
+    return;
+  }
+  if ((int)rows.size()*4<size()) {
+    for (int i=(int)rows.size()-1; i>=0; i--) {
+      unplace(treeRemove(rows[i]));
+    }
+    if ((int)keys.size()>2*size()+16) compact();
+    return;
+  }
+  // many rows; cheaper to rebuild the tree without them
+  vector<int> serials;
+  order(serials);
+  int at = 0;
+  int out = 0;
+  for (int y=0; y<(int)serials.size(); y++) {
+    if (at<(int)rows.size()&&rows[at]==y) {
+      at++;
+      continue;
+    }
+    serials[out] = serials[y];
+    out++;
+  }
+  serials.resize(out);
+  plant(serials);
+  compact();
+}
+
+void RowMatchIndex::rowMoved(int from, int to) {
+  if (sheet_id==0/*NULL*/) return;
+  if (from<0||from>=size()||to<0||to>=size()) {
+    clear();
+    return;
+  }
+  if (from==to) return;
+  // the serial, and so its place in the hash table, goes with the row
+  treeInsert(treeRemove(from),to);
+}
+
+void RowMatchIndex::rowChanged(const DataSheet& sheet, int y) {
+  if (sheet_id==0/*NULL*/) return;
+  if (y<0||y>=size()) {
+    clear();
+    return;
+  }
+  int s = serialAt(y);
+  unsigned long long key = keyOfRow(sheet,y);
+  if (key==keys[s]) return;
+  unplace(s);
+  keys[s] = key;
+  place(s);
+}
@@ -21,6 +21,8 @@
 #include <coopy/Sha1Generator.h>
 #include <string.h>
 
+using namespace coopy::store;
+
 #define SHA1HashSize 20
 #define shaSuccess 0
 #define shaInputTooLong 1
@@ -435,50 +437,44 @@ static void DigestToBase16(unsigned char *digest, char *zBuf){
   zBuf[j] = 0;
 }
 
-/*
-** The state of a incremental SHA1 checksum computation.  Only one
-** such computation can be underway at a time, of course.
-*/
-static SHA1Context incrCtx;
-static int incrInit = 0;
+Sha1Generator::Sha1Generator() {
+  SHA1Context *ctx = new SHA1Context;
+  SHA1Reset(ctx);
+  implementation = ctx;
+}
 
-static int hashLen = 0;
+Sha1Generator::Sha1Generator(const Sha1Generator& alt) {
+  implementation = new SHA1Context(*((SHA1Context*)alt.implementation));
+}
 
-/*
-** Add more text to the incremental SHA1 checksum.
-*/
-void sha1sum_step_text(const char *zText, int nBytes){
-  if( !incrInit ){
-    SHA1Reset(&incrCtx);
-    incrInit = 1;
-  }
-  if( nBytes<=0 ){
-    if( nBytes==0 ) return;
-    nBytes = strlen(zText);
-  }
-  hashLen += nBytes;
-  SHA1Input(&incrCtx, (unsigned char*)zText, nBytes);
+const Sha1Generator& Sha1Generator::operator=(const Sha1Generator& alt) {
+  *((SHA1Context*)implementation) = *((SHA1Context*)alt.implementation);
+  return *this;
+}
+
+Sha1Generator::~Sha1Generator() {
+  delete (SHA1Context*)implementation;
+  implementation = 0/*NULL*/;
+}
+
+void Sha1Generator::reset() {
+  SHA1Reset((SHA1Context*)implementation);
+}
+
+void Sha1Generator::add(const char *txt, int len) {
+  if (len<=0) return;
+  SHA1Input((SHA1Context*)implementation, (const uint8_t*)txt, len);
 }
 
 /*
-** Finish the incremental SHA1 checksum.  Store the result in blob pOut
-** if pOut!=0.  Also return a pointer to the result.  
-**
-** This resets the incremental checksum preparing for the next round
-** of computation.  The return pointer points to a static buffer that
-** is overwritten by subsequent calls to this function.
+** Finish the checksum, and reset for the next round of computation.
 */
-char *sha1sum_finish(){
-  unsigned char zResult[20];
-  static char zOut[41];
-  sha1sum_step_text(0,0);
-  SHA1Result(&incrCtx, zResult);
-  incrInit = 0;
+std::string Sha1Generator::finish() {
+  unsigned char zResult[SHA1HashSize];
+  char zOut[41];
+  SHA1Context *ctx = (SHA1Context*)implementation;
+  SHA1Result(ctx, zResult);
+  SHA1Reset(ctx);
   DigestToBase16(zResult, zOut);
-  if (hashLen!=0) { 
-    //printf("Length %d\n", hashLen);
-  }
-  hashLen = 0;
   return zOut;
 }
-
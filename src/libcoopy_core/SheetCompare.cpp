@@ -12,12 +12,18 @@
 #include <coopy/Merger.h>
 #include <coopy/SchemaSniffer.h>
 #include <coopy/Compare.h>
+#include <coopy/IndexSniffer.h>
+#include <coopy/EfficientMap.h>
+#include <coopy/TaskGroup.h>
+#include <coopy/Hasher.h>
+#include <coopy/RowDigests.h>
 
 #include <string>
 #include <map>
 
 using namespace coopy::store;
 using namespace coopy::cmp;
+using namespace coopy::os;
 
 using namespace std;
 
@@ -55,9 +61,11 @@ public:
       bool fail = false;
 
       if (local_hash=="") {
+	string scratch_a, scratch_b;
 	for (int r=0; r<pass.a.height() && !fail; r++) {
 	  for (int c=0; c<pass.a.width(); c++) {
-	    if (pass.a.cellSummary(c,r)!=pass.b.cellSummary(c,r)) {
+	    if (pass.a.cellView(c,r,scratch_a)!=
+		pass.b.cellView(c,r,scratch_b)) {
 	      dbg_printf("FastMatch::match mismatch at (%d,%d): [%s] vs [%s]\n",
 			 c,r,
 			 pass.a.cellSummary(c,r).toString().c_str(),
@@ -126,16 +134,246 @@ public:
     // Non identical eh?  Well, maybe we've been told to trust
     // some identifying columns.
 
-    if (local_names!=NULL && remote_names!=NULL) {
+    if (!rowLike) return;
+    if (local_names==NULL || remote_names==NULL) return;
+
+    if (flags.trust_ids) {
       if (local_names->hasSubset()&&remote_names->hasSubset()) {
 	// Great!  No need to do anything elaborate.  We've probably
 	// already wasted too much time sucking data into memory,
 	// oh well...
-	
-	// process subset here...
+	joinKeys(local_names->getSubset(),remote_names->getSubset());
+      }
+      return;
+    }
+
+    // Or maybe the schema or the data itself suggests a unique key.
+    if (flags.key_join) {
+      vector<int> akeys, bkeys;
+      if (!suggestKeys(pass.a,flags,*local_names,akeys)) return;
+      if (!suggestKeys(pass.b,flags,*remote_names,bkeys)) return;
+      if (akeys.size()!=bkeys.size()) {
+	dbg_printf("FastMatch::match keys differ in width\n");
+	return;
+      }
+      const vector<string>& an = local_names->suggestNames();
+      const vector<string>& bn = remote_names->suggestNames();
+      for (int i=0; i<(int)akeys.size(); i++) {
+	bool named = akeys[i]<(int)an.size() && bkeys[i]<(int)bn.size();
+	if (named ? (an[akeys[i]]!=bn[bkeys[i]]) : (akeys[i]!=bkeys[i])) {
+	  dbg_printf("FastMatch::match keys differ in columns\n");
+	  return;
+	}
+      }
+      joinKeys(akeys,bkeys);
+    }
+  }
+
+  /**
+   *
+   * Pair up rows whose content (in mapped columns) is identical and
+   * unique on both sides, patience-diff style, so that fuzzy matching
+   * only has the gaps between them left to work on.
+   *
+   */
+  void anchor(const OrderResult& cols) {
+    vector<int> acols, bcols;
+    if (cols.isBlank()) {
+      // no column mapping yet, only compare like with like
+      if (pass.a.width()!=pass.b.width()) return;
+      for (int i=0; i<pass.a.width(); i++) {
+	acols.push_back(i);
+	bcols.push_back(i);
+      }
+    } else {
+      for (int i=0; i<pass.a.width(); i++) {
+	int j = cols.a2b(i);
+	if (j<0 || j>=pass.b.width()) continue;
+	acols.push_back(i);
+	bcols.push_back(j);
+      }
+    }
+    if (acols.size()==0) return;
+
+    bool aligned = pass.a.width()==pass.b.width() && 
+      (int)acols.size()==pass.a.width();
+    for (int i=0; i<(int)acols.size() && aligned; i++) {
+      aligned = (acols[i]==bcols[i]);
+    }
+    if (aligned) {
+      anchorAligned();
+    }
+
+    efficient_map<unsigned long long,int> aindex, bindex;
+    hashRows(pass.a,pass.asel,acols,aindex);
+    if (aindex.size()==0) return;
+    hashRows(pass.b,pass.bsel,bcols,bindex);
+
+    RowBlock ablock, bblock;
+    FastHasher hasher;
+    int ct = 0;
+    for (int y=0; y<pass.b.height(); y++) {
+      if (pass.bsel.cell(0,y)!=-1) continue;
+      if (!bblock.contains(y)) {
+	pass.b.readRows(y,RowBlock::DEFAULT_HEIGHT,bblock);
+      }
+      unsigned long long h = hashRow(hasher,bblock,bcols,y);
+      if (bindex[h]!=y) continue;
+      efficient_map<unsigned long long,int>::const_iterator it =
+	aindex.find(h);
+      if (it==aindex.end()) continue;
+      int x = it->second;
+      if (x<0) continue;
+      // guard against hash collisions
+      pass.a.readRows(x,1,ablock);
+      bool same = true;
+      for (int i=0; i<(int)acols.size() && same; i++) {
+	same = (ablock.cell(acols[i],x)==bblock.cell(bcols[i],y));
+      }
+      if (!same) continue;
+      pass.asel.cell(0,x) = y;
+      pass.bsel.cell(0,y) = x;
+      ct++;
+    }
+    dbg_printf("FastMatch::anchor anchored %d of %d rows\n",
+	       ct, pass.b.height());
+  }
+
+  /**
+   *
+   * Pair up rows that are identical and at the same position in
+   * tables with the same columns.  Only done for tables that track
+   * their row digests, where finding such rows costs little more
+   * than the number of rows that changed.
+   *
+   */
+  void anchorAligned() {
+    int offset = 0;
+    if (!pass.a.getRowDigests(offset)) return;
+    if (!pass.b.getRowDigests(offset)) return;
+    vector<pair<int,int> > ranges;
+    RowDigests::differingRanges(pass.a,pass.b,ranges);
+    int h = pass.a.height();
+    if (pass.b.height()<h) h = pass.b.height();
+    int ct = 0;
+    int y = 0;
+    for (int i=0; i<=(int)ranges.size(); i++) {
+      int stop = (i<(int)ranges.size())?ranges[i].first:h;
+      if (stop>h) stop = h;
+      for (; y<stop; y++) {
+	if (pass.asel.cell(0,y)!=-1) continue;
+	if (pass.bsel.cell(0,y)!=-1) continue;
+	pass.asel.cell(0,y) = y;
+	pass.bsel.cell(0,y) = y;
+	ct++;
+      }
+      if (i<(int)ranges.size()) y = ranges[i].second;
+    }
+    dbg_printf("FastMatch::anchorAligned anchored %d of %d rows in place\n",
+	       ct, pass.b.height());
+  }
+
+private:
+  static unsigned long long hashRow(FastHasher& hasher,
+				    const RowBlock& block,
+				    const vector<int>& cols, int y) {
+    // each cell's length and escape state go in too, so that cell
+    // boundaries matter
+    for (int i=0; i<(int)cols.size(); i++) {
+      const SheetCellView& v = block.cell(cols[i],y);
+      int mark = v.len*2+(v.escaped?1:0);
+      hasher.add((const char *)&mark,sizeof(mark));
+      hasher.add(v.data,v.len);
+    }
+    return hasher.finish64();
+  }
+
+  static void hashRows(DataSheet& sheet, const IntSheet& sel,
+		       const vector<int>& cols,
+		       efficient_map<unsigned long long,int>& index) {
+    RowBlock block;
+    FastHasher hasher;
+    for (int y=0; y<sheet.height(); y++) {
+      if (sel.cell(0,y)!=-1) continue;
+      if (!block.contains(y)) {
+	sheet.readRows(y,RowBlock::DEFAULT_HEIGHT,block);
+      }
+      pair<efficient_map<unsigned long long,int>::iterator,bool> r = 
+	index.insert(make_pair(hashRow(hasher,block,cols,y),y));
+      if (!r.second) {
+	// repeated row, leave it to fuzzy matching
+	r.first->second = -1;
+      }
+    }
+  }
+
+  static bool suggestKeys(DataSheet& sheet, const CompareFlags& flags,
+			  NameSniffer& names, vector<int>& keys) {
+    IndexSniffer sniffer(sheet,flags,names);
+    vector<int> indexes = sniffer.suggestIndexes();
+    keys.clear();
+    for (int i=0; i<(int)indexes.size(); i++) {
+      if (indexes[i]) keys.push_back(i);
+    }
+    // a key covering every column is no key at all
+    return keys.size()>0 && (int)keys.size()<sheet.width();
+  }
+
+  static void encodeRowKey(const RowBlock& block, const vector<int>& keys,
+			   int y, string& key) {
+    key.clear();
+    char buf[32];
+    for (int i=0; i<(int)keys.size(); i++) {
+      const SheetCellView& v = block.cell(keys[i],y);
+      // length-prefixed, so cell boundaries cannot be confused
+      snprintf(buf,sizeof(buf),"%d%c",v.len,v.escaped?'*':':');
+      key += buf;
+      v.appendTo(key);
+    }
+  }
+
+  static void indexKeys(DataSheet& sheet, const IntSheet& sel,
+			const vector<int>& keys,
+			efficient_map<string,int>& index) {
+    RowBlock block;
+    string key;
+    for (int y=0; y<sheet.height(); y++) {
+      if (sel.cell(0,y)!=-1) continue;
+      if (!block.contains(y)) {
+	sheet.readRows(y,RowBlock::DEFAULT_HEIGHT,block);
+      }
+      encodeRowKey(block,keys,y,key);
+      pair<efficient_map<string,int>::iterator,bool> r = 
+	index.insert(make_pair(key,y));
+      if (!r.second) {
+	// repeated key, leave it to fuzzy matching
+	r.first->second = -1;
       }
     }
   }
+
+  // Pair up rows whose keys are identical and unique on both sides.
+  // Everything else is left unassigned, for MeasureMan to work on.
+  void joinKeys(const vector<int>& akeys, const vector<int>& bkeys) {
+    efficient_map<string,int> aindex, bindex;
+    indexKeys(pass.a,pass.asel,akeys,aindex);
+    indexKeys(pass.b,pass.bsel,bkeys,bindex);
+    int ct = 0;
+    for (efficient_map<string,int>::const_iterator it = bindex.begin();
+	 it!=bindex.end(); it++) {
+      int y = it->second;
+      if (y<0) continue;
+      efficient_map<string,int>::const_iterator ait = aindex.find(it->first);
+      if (ait==aindex.end()) continue;
+      int x = ait->second;
+      if (x<0) continue;
+      pass.asel.cell(0,x) = y;
+      pass.bsel.cell(0,y) = x;
+      ct++;
+    }
+    dbg_printf("FastMatch::joinKeys matched %d of %d rows on %d key column(s)\n",
+	       ct, pass.b.height(), (int)bkeys.size());
+  }
 };
 
 
@@ -151,6 +389,218 @@ static string encodeKey(DataSheet& sheet, int x, int y, int len) {
 }
 
 
+class HashTask : public Task {
+public:
+  DataSheet& sheet;
+
+  HashTask(DataSheet& sheet) : sheet(sheet) {
+  }
+
+  virtual void run() {
+    sheet.getHash(true,Hasher::HASH_FAST);
+    // bring row digests up to date too, while nothing else is running,
+    // so row mapping threads only ever read them
+    sheet.updateRowDigests();
+  }
+};
+
+// true if both sheets share a hash cache
+static bool sameTable(const DataSheet& a, const DataSheet& b) {
+  return &a.tail_const()==&b.tail_const();
+}
+
+// true if both sheets are views of the same stored table, and so
+// share its row digests
+static bool sameData(const DataSheet& a, const DataSheet& b) {
+  return &a.dataTail()==&b.dataTail();
+}
+
+// true if both sheets show the same rows of the same stored table,
+// say two copies of a view that hides the same header rows
+static bool sameView(const DataSheet& a, const DataSheet& b) {
+  if (sameTable(a,b)) return true;
+  return sameData(a,b) && a.height()==b.height() && a.width()==b.width();
+}
+
+// true if hashing both sheets would update the same row digests
+static bool sharedDigests(const DataSheet& a, const DataSheet& b) {
+  return !sameTable(a,b) && sameData(a,b);
+}
+
+static int hashThreads(const CompareFlags& flags,
+		       DataSheet& pivot,
+		       DataSheet& local,
+		       DataSheet& remote) {
+  if (flags.threads<=1) return 1;
+  if (!TaskGroup::isThreaded()) return 1;
+  if (!pivot.canReadConcurrently()) return 1;
+  if (!local.canReadConcurrently()) return 1;
+  if (!remote.canReadConcurrently()) return 1;
+  // say, a table both with and without its header row
+  if (sharedDigests(pivot,local)) return 1;
+  if (sharedDigests(pivot,remote)) return 1;
+  if (sharedDigests(local,remote)) return 1;
+  return flags.threads;
+}
+
+static int mappingThreads(const CompareFlags& flags,
+			  SheetView& vpivot,
+			  SheetView& vlocal,
+			  SheetView& vremote) {
+  if (flags.threads<=1) return 1;
+  if (!TaskGroup::isThreaded()) return 1;
+  if (!vpivot.sheet.canReadConcurrently()) return 1;
+  if (!vlocal.sheet.canReadConcurrently()) return 1;
+  if (!vremote.sheet.canReadConcurrently()) return 1;
+  return 2;
+}
+
+/**
+ *
+ * Map rows of the pivot to rows of one side (local or remote).  The
+ * two sides are independent, and only read the sheets, so they can
+ * run on separate threads.
+ *
+ */
+class RowMapTask : public Task {
+public:
+  SheetView& vpivot;
+  SheetView& vside;
+  const OrderResult& col_order;
+  OrderResult& row_order;
+  const CompareFlags& eflags;
+  bool approx;
+  const char *name;
+  const TypedColumns *tpivot;
+  const TypedColumns *tside;
+
+  RowMapTask(SheetView& vpivot, SheetView& vside,
+	     const OrderResult& col_order, OrderResult& row_order,
+	     const CompareFlags& eflags, bool approx,
+	     const char *name) : vpivot(vpivot), vside(vside),
+    col_order(col_order), row_order(row_order), eflags(eflags),
+    approx(approx), name(name) {
+    tpivot = tside = 0/*NULL*/;
+  }
+
+  void setTypedColumns(const TypedColumns *tpivot, const TypedColumns *tside) {
+    this->tpivot = tpivot;
+    this->tside = tside;
+  }
+
+  virtual void run() {
+    dbg_printf("SheetCompare::compare pivot <-> %s rows\n", name);
+
+    MeasurePass row_pass_local(vpivot,vside);
+    MeasurePass row_pass_norm1(vpivot,vpivot);
+    MeasurePass row_pass_norm2(vside,vside);
+
+    IntSheet p = col_order.allA2b();
+    IntSheet l = col_order.allB2a();
+    for (int i=0; i<p.height(); i++) {
+      if (p.cell(0,i)>=0) {
+	p.cell(0,i) = i;
+      }
+    }
+    for (int i=0; i<l.height(); i++) {
+      if (l.cell(0,i)>=0) {
+	l.cell(0,i) = i;
+      }
+    }
+
+    OrderResult o1, o2;
+    o1.setup(p,p);
+    o2.setup(l,l);
+
+    if (p.height()>0 || l.height()>0) {
+      COOPY_ASSERT(p.height()==vpivot.sheet.width());
+      COOPY_ASSERT(l.height()==vside.sheet.width());
+    }
+
+    CombinedRowMan row_local(eflags,col_order,vside.sheet.height());
+    CombinedRowMan row_norm1(eflags,o1,vpivot.sheet.height());
+    CombinedRowMan row_norm2(eflags,o2,vside.sheet.height());
+
+    // each table's cells are tokenized once, for all three measures
+    FeatureDictionary dict;
+    FeatureCache pivot_features(dict), side_features(dict);
+    if (eflags.feature_cache>0) {
+      pivot_features.setLimit(eflags.feature_cache);
+      side_features.setLimit(eflags.feature_cache);
+    }
+    row_local.setFeatureCache(&pivot_features,&side_features);
+    row_norm1.setFeatureCache(&pivot_features,&pivot_features);
+    row_norm2.setFeatureCache(&side_features,&side_features);
+    row_local.setTypedColumns(tpivot,tside);
+    row_norm1.setTypedColumns(tpivot,tpivot);
+    row_norm2.setTypedColumns(tside,tside);
+    
+    MeasureMan row_man(row_local,row_pass_local,
+		       row_norm1,row_pass_norm1,
+		       row_norm2,row_pass_norm2,
+		       1,
+		       eflags,
+		       approx);
+    
+    row_man.setup();
+    FastMatch row_fast_match(row_pass_local);
+    row_fast_match.match(true,eflags);
+    row_fast_match.anchor(col_order);
+    row_man.compare();
+
+    row_order = row_pass_local.getOrder();
+  }
+};
+
+/**
+ *
+ * Map columns of the pivot to columns of one side (local or remote).
+ *
+ */
+class ColMapTask : public Task {
+public:
+  SheetView& vpivot;
+  SheetView& vside;
+  const OrderResult& row_order;
+  OrderResult& col_order;
+  const CompareFlags& eflags;
+  const char *name;
+
+  ColMapTask(SheetView& vpivot, SheetView& vside,
+	     const OrderResult& row_order, OrderResult& col_order,
+	     const CompareFlags& eflags,
+	     const char *name) : vpivot(vpivot), vside(vside),
+    row_order(row_order), col_order(col_order), eflags(eflags),
+    name(name) {
+  }
+
+  virtual void run() {
+    dbg_printf("SheetCompare::compare pivot <-> %s columns\n", name);
+
+    IdentityOrderResult id;
+    MeasurePass col_pass_local(vpivot,vside);
+    MeasurePass col_pass_norm1(vpivot,vpivot);
+    MeasurePass col_pass_norm2(vside,vside);
+
+    ColMan col_local(row_order);
+    ColMan col_norm1(id);
+    ColMan col_norm2(id);
+
+    MeasureMan col_man(col_local,col_pass_local,
+		       col_norm1,col_pass_norm1,
+		       col_norm2,col_pass_norm2,
+		       0,
+		       eflags);
+
+    col_man.setup();
+    FastMatch col_fast_match(col_pass_local);
+    col_fast_match.match(false,eflags);
+    col_man.compare();
+
+    col_order = col_pass_local.getOrder();
+  }
+};
+
 void SheetCompare::doRowMapping(OrderResult& p2l_row_order,
 				OrderResult& p2r_row_order,
 				const OrderResult& p2l_col_order,
@@ -160,115 +610,26 @@ void SheetCompare::doRowMapping(OrderResult& p2l_row_order,
 				SheetView& vpivot,
 				SheetView& vlocal,
 				SheetView& vremote,
+				const TypedColumns *tpivot,
+				const TypedColumns *tlocal,
+				const TypedColumns *tremote,
 				bool approx) {
   /////////////////////////////////////////////////////////////////////////
   // PIVOT to LOCAL row mapping
 
-  dbg_printf("SheetCompare::compare pivot <-> local rows\n");
-
   bool valueBasedPivot = (flags.mapping==NULL);
 
   if (valueBasedPivot) {
-    IdentityOrderResult id;
-    MeasurePass p2l_row_pass_local(vpivot,vlocal);
-    MeasurePass p2l_row_pass_norm1(vpivot,vpivot);
-    MeasurePass p2l_row_pass_norm2(vlocal,vlocal);
-
-    IntSheet p2l_p = p2l_col_order.allA2b();
-    IntSheet p2l_l = p2l_col_order.allB2a();
-    for (int i=0; i<p2l_p.height(); i++) {
-      if (p2l_p.cell(0,i)>=0) {
-	p2l_p.cell(0,i) = i;
-      }
-    }
-    for (int i=0; i<p2l_l.height(); i++) {
-      if (p2l_l.cell(0,i)>=0) {
-	p2l_l.cell(0,i) = i;
-      }
-    }
-
-    OrderResult p2l_1, p2l_2;
-    p2l_1.setup(p2l_p,p2l_p);
-    p2l_2.setup(p2l_l,p2l_l);
-
-    if (p2l_p.height()>0 || p2l_l.height()>0) {
-      COOPY_ASSERT(p2l_p.height()==vpivot.sheet.width());
-      COOPY_ASSERT(p2l_l.height()==vlocal.sheet.width());
-    }
-
-    CombinedRowMan p2l_row_local(eflags,p2l_col_order,vlocal.sheet.height());
-    CombinedRowMan p2l_row_norm1(eflags,p2l_1,vpivot.sheet.height());
-    CombinedRowMan p2l_row_norm2(eflags,p2l_2,vlocal.sheet.height());
-    
-    MeasureMan p2l_row_man(p2l_row_local,p2l_row_pass_local,
-			   p2l_row_norm1,p2l_row_pass_norm1,
-			   p2l_row_norm2,p2l_row_pass_norm2,
-			   1,
-			   eflags,
-			   approx);
-    
-    p2l_row_man.setup();
-    FastMatch p2l_row_fast_match(p2l_row_pass_local);
-    //p2l_row_fast_match.local_names = &pivot_names;
-    //p2l_row_fast_match.remote_names = &local_names;
-    //p2l_row_fast_match.local_hash = pivot_hash;
-    //p2l_row_fast_match.remote_hash = local_hash;
-    p2l_row_fast_match.match(true,eflags);
-    p2l_row_man.compare();
-    
-    /////////////////////////////////////////////////////////////////////////
-    // PIVOT to REMOTE row mapping
-    
-    dbg_printf("SheetCompare::compare pivot <-> remote rows\n");
-    
-    MeasurePass p2r_row_pass_local(vpivot,vremote);
-    MeasurePass p2r_row_pass_norm1(vpivot,vpivot);
-    MeasurePass p2r_row_pass_norm2(vremote,vremote);
-
-    IntSheet p2r_p = p2r_col_order.allA2b();
-    IntSheet p2r_r = p2r_col_order.allB2a();
-    for (int i=0; i<p2r_p.height(); i++) {
-      if (p2r_p.cell(0,i)>=0) {
-	p2r_p.cell(0,i) = i;
-      }
-    }
-    for (int i=0; i<p2r_r.height(); i++) {
-      if (p2r_r.cell(0,i)>=0) {
-	p2r_r.cell(0,i) = i;
-      }
-    }
-
-    OrderResult p2r_1, p2r_2;
-    p2r_1.setup(p2r_p,p2r_p);
-    p2r_2.setup(p2r_r,p2r_r);
-
-    if (p2r_p.height()>0 || p2r_r.height()>0) {
-      COOPY_ASSERT(p2r_p.height()==vpivot.sheet.width());
-      COOPY_ASSERT(p2r_r.height()==vremote.sheet.width());
-    }
-    
-    CombinedRowMan p2r_row_local(eflags,p2r_col_order,vremote.sheet.height());
-    CombinedRowMan p2r_row_norm1(eflags,p2r_1,vpivot.sheet.height());
-    CombinedRowMan p2r_row_norm2(eflags,p2r_2,vremote.sheet.height());
-    
-    MeasureMan p2r_row_man(p2r_row_local,p2r_row_pass_local,
-			   p2r_row_norm1,p2r_row_pass_norm1,
-			   p2r_row_norm2,p2r_row_pass_norm2,
-			   1,
-			   eflags,
-			   approx);
-    
-    p2r_row_man.setup();
-    FastMatch p2r_row_fast_match(p2r_row_pass_local);
-    //p2r_row_fast_match.local_names = &pivot_names;
-    //p2r_row_fast_match.remote_names = &remote_names;
-    //p2r_row_fast_match.local_hash = pivot_hash;
-    //p2r_row_fast_match.remote_hash = remote_hash;
-    p2r_row_fast_match.match(true,eflags);
-    p2r_row_man.compare();
-    
-    p2l_row_order = p2l_row_pass_local.getOrder();
-    p2r_row_order = p2r_row_pass_local.getOrder();
+    RowMapTask p2l(vpivot,vlocal,p2l_col_order,p2l_row_order,
+		   eflags,approx,"local");
+    RowMapTask p2r(vpivot,vremote,p2r_col_order,p2r_row_order,
+		   eflags,approx,"remote");
+    p2l.setTypedColumns(tpivot,tlocal);
+    p2r.setTypedColumns(tpivot,tremote);
+    TaskGroup group(mappingThreads(eflags,vpivot,vlocal,vremote));
+    group.add(p2l);
+    group.add(p2r);
+    group.run();
   } else {
 
     // set up links using mapping
@@ -344,61 +705,12 @@ void SheetCompare::doColMapping(const OrderResult& p2l_row_order,
 				SheetView& vpivot,
 				SheetView& vlocal,
 				SheetView& vremote) {
-  IdentityOrderResult id;
-
-  /////////////////////////////////////////////////////////////////////////
-  // PIVOT to LOCAL column mapping
-
-  dbg_printf("SheetCompare::compare pivot <-> local columns\n");
-
-  MeasurePass p2l_col_pass_local(vpivot,vlocal);
-  MeasurePass p2l_col_pass_norm1(vpivot,vpivot);
-  MeasurePass p2l_col_pass_norm2(vlocal,vlocal);
-
-  ColMan p2l_col_local(p2l_row_order);
-  ColMan p2l_col_norm1(id);
-  ColMan p2l_col_norm2(id);
-
-  MeasureMan p2l_col_man(p2l_col_local,p2l_col_pass_local,
-			 p2l_col_norm1,p2l_col_pass_norm1,
-			 p2l_col_norm2,p2l_col_pass_norm2,
-			 0,
-			 eflags);
-
-  p2l_col_man.setup();
-  FastMatch p2l_col_fast_match(p2l_col_pass_local);
-  p2l_col_fast_match.match(false,eflags);
-  p2l_col_man.compare();
-
-
-  /////////////////////////////////////////////////////////////////////////
-  // PIVOT to REMOTE column mapping
-
-  dbg_printf("SheetCompare::compare pivot <-> remote columns\n");
-
-  MeasurePass p2r_col_pass_local(vpivot,vremote);
-  MeasurePass p2r_col_pass_norm1(vpivot,vpivot);
-  MeasurePass p2r_col_pass_norm2(vremote,vremote);
-
-  ColMan p2r_col_local(p2r_row_order);
-  ColMan p2r_col_norm1(id);
-  ColMan p2r_col_norm2(id);
-
-  MeasureMan p2r_col_man(p2r_col_local,p2r_col_pass_local,
-			 p2r_col_norm1,p2r_col_pass_norm1,
-			 p2r_col_norm2,p2r_col_pass_norm2,
-			 0,
-			 eflags);
-
-  p2r_col_man.setup();
-  FastMatch p2r_col_fast_match(p2r_col_pass_local);
-  //p2r_col_fast_match.local_hash = pivot_hash;
-  //p2r_col_fast_match.remote_hash = remote_hash;
-  p2r_col_fast_match.match(false,eflags);
-  p2r_col_man.compare();
-
-  p2l_col_order = p2l_col_pass_local.getOrder();
-  p2r_col_order = p2r_col_pass_local.getOrder();
+  ColMapTask p2l(vpivot,vlocal,p2l_row_order,p2l_col_order,eflags,"local");
+  ColMapTask p2r(vpivot,vremote,p2r_row_order,p2r_col_order,eflags,"remote");
+  TaskGroup group(mappingThreads(eflags,vpivot,vlocal,vremote));
+  group.add(p2l);
+  group.add(p2r);
+  group.run();
 }
 
 int SheetCompare::compare(DataSheet& _pivot, DataSheet& _local, 
@@ -477,6 +789,10 @@ int SheetCompare::compare(DataSheet& _pivot, DataSheet& _local,
   NameSniffer remote_names(remote,flags,false);
 
   CompareFlags eflags = flags;
+  if (!eflags.budget.isLimited()) {
+    // budget runs from here, unless the caller started one already
+    eflags.budget.start(eflags.time_budget,eflags.memory_budget);
+  }
 
   if (!local.isSequential()) {
     eflags.use_order = false;
@@ -485,7 +801,8 @@ int SheetCompare::compare(DataSheet& _pivot, DataSheet& _local,
     eflags.use_order = false;
   }
 
-  if (eflags.trust_ids || eflags.bias_ids || eflags.trust_column_names) {
+  if (eflags.trust_ids || eflags.bias_ids || eflags.trust_column_names ||
+      eflags.key_join) {
     local_names.sniff();
     remote_names.sniff();
     pivot_names.sniff();
@@ -524,9 +841,31 @@ int SheetCompare::compare(DataSheet& _pivot, DataSheet& _local,
     }
   }
 
-  std::string local_hash = local.getHash(true);
-  std::string remote_hash = remote.getHash(true);
-  std::string pivot_hash = pivot.getHash(true);
+  if (sameView(local,pivot) && sameView(remote,pivot) &&
+      !output.wantLinks()) {
+    // nothing has changed, and there is nothing to say about that
+    dbg_printf("SheetCompare::compare on one table, done\n");
+    return 0;
+  }
+
+  {
+    // hash each table once, concurrently if allowed
+    HashTask pivot_task(pivot), local_task(local), remote_task(remote);
+    TaskGroup group(hashThreads(eflags,pivot,local,remote));
+    group.add(pivot_task);
+    if (!sameTable(local,pivot)) {
+      group.add(local_task);
+    }
+    if (!sameTable(remote,pivot) && !sameTable(remote,local)) {
+      group.add(remote_task);
+    }
+    group.run();
+  }
+
+  // digests are only compared with each other, so the fast kind will do
+  std::string local_hash = local.getHash(true,Hasher::HASH_FAST);
+  std::string remote_hash = remote.getHash(true,Hasher::HASH_FAST);
+  std::string pivot_hash = pivot.getHash(true,Hasher::HASH_FAST);
 
   SheetView vpivot(pivot,pivot_names,pivot_hash);
   SheetView vlocal(local,local_names,local_hash);
@@ -537,6 +876,27 @@ int SheetCompare::compare(DataSheet& _pivot, DataSheet& _local,
   OrderResult p2l_col_order;
   OrderResult p2r_col_order;
 
+  // with typed comparison, each table is read by type just once, for
+  // both rounds of row mapping and for the merge
+  TypedColumns typed_pivot, typed_local, typed_remote;
+  const TypedColumns *tpivot = 0/*NULL*/;
+  const TypedColumns *tlocal = 0/*NULL*/;
+  const TypedColumns *tremote = 0/*NULL*/;
+  if (eflags.typed_compare) {
+    typed_pivot.build(pivot);
+    tpivot = tlocal = tremote = &typed_pivot;
+    if (&local!=&pivot) {
+      typed_local.build(local);
+      tlocal = &typed_local;
+    }
+    if (&remote==&local) {
+      tremote = tlocal;
+    } else if (&remote!=&pivot) {
+      typed_remote.build(remote);
+      tremote = &typed_remote;
+    }
+  }
+
   bool ordered = false;
   if (flags.default_compare) {
     int result = flags.default_compare->compare(pivot,local,remote,p2l_row_order,p2r_row_order,p2l_col_order,p2r_col_order,flags);
@@ -552,7 +912,8 @@ int SheetCompare::compare(DataSheet& _pivot, DataSheet& _local,
     doRowMapping(p2l_row_order,p2r_row_order,
 		 p2l_col_order,p2r_col_order,
 		 flags,eflags,
-		 vpivot,vlocal,vremote,!id_based);
+		 vpivot,vlocal,vremote,
+		 tpivot,tlocal,tremote,!id_based);
     
     /////////////////////////////////////////////////////////////////////////
     // COLUMN MAPPING from PIVOT to LOCAL and REMOTE
@@ -570,7 +931,8 @@ int SheetCompare::compare(DataSheet& _pivot, DataSheet& _local,
       doRowMapping(p2l_row_order,p2r_row_order,
 		   p2l_col_order,p2r_col_order,
 		   flags,eflags,
-		   vpivot,vlocal,vremote,false);
+		   vpivot,vlocal,vremote,
+		   tpivot,tlocal,tremote,false);
     }
   }
 
@@ -589,6 +951,9 @@ int SheetCompare::compare(DataSheet& _pivot, DataSheet& _local,
 		    eflags,
 		    local_names,
 		    remote_names);
+  state.typed_pivot = tpivot;
+  state.typed_local = tlocal;
+  state.typed_remote = tremote;
   state.allIdentical = (pivot_hash == local_hash) && 
     (pivot_hash == remote_hash) &&
     (pivot_hash != "");
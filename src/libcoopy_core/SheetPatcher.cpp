@@ -23,7 +23,7 @@ static bool null_like(const SheetCell& a) {
   return a.escaped||a.text==""||a.text=="NULL";
 }
 
-static bool is_match(const SheetCell& a, const SheetCell& b) {
+static bool is_match(const SheetCellView& a, const SheetCell& b) {
   return a==b;
   //if (a==b) return true;
   //if (!null_like(a)) return false;
@@ -79,20 +79,57 @@ int SheetPatcher::matchRow(const std::vector<int>& active_cond,
     }
   }
 
+  string scratch;
+  if (!show) {
+    // only rows with the same key can match exactly; see RowMatchIndex
+    match_cols.clear();
+    for (int c=0; c<width; c++) {
+      if (active_cond[c]) match_cols.push_back(c);
+    }
+    row_index.candidates(sheet,match_cols,cond,match_rows);
+    int found = -1;
+    for (int i=0; i<(int)match_rows.size(); i++) {
+      int r = match_rows[i];
+      if (activeRow.cellView(0,r,scratch).textEquals("---",3)) continue;
+      int c;
+      for (c=0; c<width; c++) {
+	if (active_cond[c]) {
+	  if (!is_match(sheet.cellView(c,r,scratch),cond[c])) break;
+	}
+      }
+      if (c==width) {
+	if (pending_base<0) {
+	  dbg_printf("Found row %d\n", r);
+	  return r;
+	}
+	if (r>=pending_base||(pending_marks[r]&2)) {
+	  // a queued row matches, and it is not in place yet
+	  flushEdits();
+	  return matchRow(active_cond,active_name,cond,width,show);
+	}
+	if (found<0) found = r;
+      }
+    }
+    if (found>=0) {
+      dbg_printf("Found row %d\n", found);
+      return found;
+    }
+    dbg_printf("No match for update\n");
+    matchRow(active_cond,active_name,cond,width,true);
+    return -1;
+  }
+
   int r = -1;
   int bct = 0;
   int rbest = -1;
   for (r=0; r<sheet.height(); r++) {
     int ct = 0;
-    if (activeRow.cellString(0,r)!="---") {
+    if (!activeRow.cellView(0,r,scratch).textEquals("---",3)) {
       bool match = true;
       for (int c=0; c<width; c++) {
 	if (active_cond[c]) {
-	  if (!is_match(sheet.cellSummary(c,r),cond[c])) {
+	  if (!is_match(sheet.cellView(c,r,scratch),cond[c])) {
 	    match = false;
-	    if (!show) {
-	      break;
-	    }
 	  } else {
 	    ct++;
 	    if (ct>bct) {
@@ -108,28 +145,22 @@ int SheetPatcher::matchRow(const std::vector<int>& active_cond,
       }
     }
   }
-  if (!show) {
-    dbg_printf("No match for update\n");
-    matchRow(active_cond,active_name,cond,width,true);
+  fprintf(stderr,"# No match for update");
+  if (sheet.getSchema()) {
+    fprintf(stderr," in %s",sheet.getSchema()->getSheetName().c_str()); 
   }
-  if (show) {
-    fprintf(stderr,"# No match for update");
-    if (sheet.getSchema()) {
-      fprintf(stderr," in %s",sheet.getSchema()->getSheetName().c_str()); 
-    }
-    if (rbest>=0) {
-      fprintf(stderr," - closest was:\n"); 
-      for (int c=0; c<width; c++) {
-	if (active_cond[c]) {
-	  fprintf(stderr,"#   '%s' <-> '%s' %s\n",
-		  sheet.cellSummary(c,rbest).text.c_str(),
-		  cond[c].text.c_str(),
-		  (sheet.cellSummary(c,rbest)!=cond[c])?"FAIL":"OK");
-	}
+  if (rbest>=0) {
+    fprintf(stderr," - closest was:\n"); 
+    for (int c=0; c<width; c++) {
+      if (active_cond[c]) {
+	fprintf(stderr,"#   '%s' <-> '%s' %s\n",
+		sheet.cellSummary(c,rbest).text.c_str(),
+		cond[c].text.c_str(),
+		(sheet.cellSummary(c,rbest)!=cond[c])?"FAIL":"OK");
       }
-    } else {
-      fprintf(stderr,"\n");
     }
+  } else {
+    fprintf(stderr,"\n");
   }
   return -1;
 }
@@ -235,6 +266,7 @@ bool SheetPatcher::moveColumn(int idx, int idx2) {
   PolySheet sheet = getSheet();
   ColumnRef from(idx);
   ColumnRef to(idx2);
+  row_index.clear();
   bool ok = sheet.moveColumn(from,to).isValid();
   activeCol.moveColumn(from,to);
   ColumnRef at = statusCol.moveColumn(from,to);
@@ -293,6 +325,8 @@ bool SheetPatcher::changeColumn(const OrderChange& change) {
   if (chain) chain->changeColumn(change);
 
   dbg_printf("\n======================\nChange column...\n");
+  flushEdits();
+  row_index.clear();
 
   PolySheet sheet = getSheet();
   if (!sheet.isValid()) {
@@ -437,7 +471,7 @@ static string colorEncode(const SheetCell& c) {
   return "NULL";
 }
 
-bool SheetPatcher::markChanges(const RowChange& change, int r,int width,
+bool SheetPatcher::markChanges(bool conflicted, int r,int width,
 			       std::vector<int>& active_val,
 			       std::vector<SheetCell>& val,
 			       std::vector<SheetCell>& cval,
@@ -491,7 +525,7 @@ bool SheetPatcher::markChanges(const RowChange& change, int r,int width,
 	}
       }
       string init = separator;
-      if (change.conflicted) {
+      if (conflicted) {
 	if (conflict_separator=="") {
 	  conflict_separator = string("!");
 	  bool more = true;
@@ -513,7 +547,7 @@ bool SheetPatcher::markChanges(const RowChange& change, int r,int width,
       if (init.length()>activeRow.cellString(0,r).length()) {
 	activeRow.cellString(0,r,init);
       }
-      if (change.conflicted) {
+      if (conflicted) {
 	if (descriptive) {
 	  Poly<Appearance> appear = sheet.getCellAppearance(0,r);
 	  if (appear.isValid()) {
@@ -581,7 +615,7 @@ bool SheetPatcher::markChanges(const RowChange& change, int r,int width,
 	  }
 	}
       } else {
-	if (change.conflicted) {
+	if (conflicted) {
 	  sheet.cellSummary(conflictColumn,r,SheetCell("CONFLICT",false));
 	  //printf("AT %d %d\n", conflictColumn,r);
 
@@ -663,7 +697,24 @@ bool SheetPatcher::handleConflicts() {
 }
 
 bool SheetPatcher::changeRow(const RowChange& change) {
+  return applyRow(&change,0/*NULL*/);
+}
+
+bool SheetPatcher::changeCompactRow(const CompactRowChange& change) {
+  if (!change.columns.isValid()) {
+    return Patcher::changeCompactRow(change);
+  }
+  return applyRow(0/*NULL*/,&change);
+}
+
+bool SheetPatcher::applyRow(const RowChange *full,
+			    const CompactRowChange *compact) {
   sheetUpdateNeeded = true;
+  int mode = full?full->mode:compact->mode;
+  bool sequential = full?full->sequential:compact->sequential;
+  bool conflicted = full?full->conflicted:compact->conflicted;
+  const vector<string>& allNames = 
+    full?full->allNames:compact->columns->allNames;
 
   PolySheet sheet = getSheet();
   if (!sheet.isValid()) {
@@ -672,11 +723,11 @@ bool SheetPatcher::changeRow(const RowChange& change) {
   }
 
   if (!declaredNames) {
-    if (chain) chain->declareNames(change.allNames,false);
-    declareNames(change.allNames,false);
+    if (chain) chain->declareNames(allNames,false);
+    declareNames(allNames,false);
   }
 
-  if (change.conflicted) {
+  if (conflicted) {
     if (!handleConflicts()) {
       fprintf(stderr,"Cannot handle conflicts.\n");
       return false;
@@ -684,17 +735,22 @@ bool SheetPatcher::changeRow(const RowChange& change) {
   }
 
   if (activeRow.height()!=sheet.height() || activeRow.width()!=1) {
+    flushEdits();
     activeRow.resize(1,sheet.height());
   }
 
   dbg_printf("\n======================\nRow cursor in: %d\n", rowCursor);
   if (coopy_is_verbose()) {
     RowChange c;
-    c = change;
+    if (full) {
+      c = *full;
+    } else {
+      compact->toRowChange(c);
+    }
     c.show();
   }
 
-  if (!change.sequential) rowCursor = -1;
+  if (!sequential) rowCursor = -1;
   //map<string,int> dir;
   vector<int> active_cond;
   vector<string> active_name;
@@ -704,7 +760,6 @@ bool SheetPatcher::changeRow(const RowChange& change) {
   vector<SheetCell> val;
   vector<SheetCell> cval;
   vector<SheetCell> pval;
-  vector<string> allNames = change.allNames;
   int width = sheet.width(); //(int)change.allNames.size();
   /*
   if (width==0) {
@@ -726,56 +781,97 @@ bool SheetPatcher::changeRow(const RowChange& change) {
     cval.push_back(SheetCell());
     pval.push_back(SheetCell());
   }
-  for (RowChange::txt2cell::const_iterator it = change.cond.begin();
-       it!=change.cond.end(); it++) {
-    if (name2col.find(it->first)!=name2col.end()) {
-      int idx = name2col[it->first]; //dir[it->first];
-      //printf("  [cond] %d %s -> %s\n", idx, it->first.c_str(), it->second.toString().c_str());
-      active_cond[idx] = 1;
-      active_conds++;
-      cond[idx] = it->second;
-      active_name[idx] = it->first;
+  if (full) {
+    for (RowChange::txt2cell::const_iterator it = full->cond.begin();
+	 it!=full->cond.end(); it++) {
+      if (name2col.find(it->first)!=name2col.end()) {
+	int idx = name2col[it->first]; //dir[it->first];
+	//printf("  [cond] %d %s -> %s\n", idx, it->first.c_str(), it->second.toString().c_str());
+	active_cond[idx] = 1;
+	active_conds++;
+	cond[idx] = it->second;
+	active_name[idx] = it->first;
+      }
     }
-  }
-  for (RowChange::txt2cell::const_iterator it = change.val.begin();
-       it!=change.val.end(); it++) {
-    if (name2col.find(it->first)!=name2col.end()) {
-      int idx = name2col[it->first]; //dir[it->first];
-      //printf("  [val] %d %s -> %s\n", idx, it->first.c_str(), it->second.toString().c_str());
-      active_val[idx] = 1;
-      val[idx] = it->second;
-      cval[idx] = it->second;
-      pval[idx] = it->second;
-    } else {
-      if (std::find(change.names.begin(),change.names.end(),it->first)!=
-	  change.names.end()) {
-	fprintf(stderr,"Unknown column %s\n", it->first.c_str());
+    for (RowChange::txt2cell::const_iterator it = full->val.begin();
+	 it!=full->val.end(); it++) {
+      if (name2col.find(it->first)!=name2col.end()) {
+	int idx = name2col[it->first]; //dir[it->first];
+	//printf("  [val] %d %s -> %s\n", idx, it->first.c_str(), it->second.toString().c_str());
+	active_val[idx] = 1;
+	val[idx] = it->second;
+	cval[idx] = it->second;
+	pval[idx] = it->second;
+      } else {
+	if (std::find(full->names.begin(),full->names.end(),it->first)!=
+	    full->names.end()) {
+	  fprintf(stderr,"Unknown column %s\n", it->first.c_str());
+	}
       }
     }
-  }
-  for (RowChange::txt2cell::const_iterator it = change.conflictingVal.begin();
-       it!=change.conflictingVal.end(); it++) {
-    if (name2col.find(it->first)!=name2col.end()) {
-      int idx = name2col[it->first];
-      cval[idx] = it->second;
+    for (RowChange::txt2cell::const_iterator it = full->conflictingVal.begin();
+	 it!=full->conflictingVal.end(); it++) {
+      if (name2col.find(it->first)!=name2col.end()) {
+	int idx = name2col[it->first];
+	cval[idx] = it->second;
+      }
     }
-  }
-  for (RowChange::txt2cell::const_iterator it = change.conflictingParentVal.begin();
-       it!=change.conflictingParentVal.end(); it++) {
-    if (name2col.find(it->first)!=name2col.end()) {
-      int idx = name2col[it->first];
-      pval[idx] = it->second;
+    for (RowChange::txt2cell::const_iterator it = full->conflictingParentVal.begin();
+	 it!=full->conflictingParentVal.end(); it++) {
+      if (name2col.find(it->first)!=name2col.end()) {
+	int idx = name2col[it->first];
+	pval[idx] = it->second;
+      }
+    }
+  } else {
+    for (int id=0; id<compact->size(); id++) {
+      if (!compact->active[id]) continue;
+      const string& name = compact->nameOf(id);
+      map<string,int>::const_iterator it = name2col.find(name);
+      if (it==name2col.end()) {
+	if (compact->hasVal(id) && compact->covers(id)) {
+	  fprintf(stderr,"Unknown column %s\n", name.c_str());
+	}
+	continue;
+      }
+      int idx = it->second;
+      if (compact->hasCond(id)) {
+	active_cond[idx] = 1;
+	active_conds++;
+	cond[idx] = compact->cond[id];
+	active_name[idx] = name;
+      }
+      if (compact->hasVal(id)) {
+	active_val[idx] = 1;
+	val[idx] = compact->val[id];
+	cval[idx] = compact->val[id];
+	pval[idx] = compact->val[id];
+      }
+      if (compact->hasConflict(id)) {
+	cval[idx] = compact->conflictingVal[id];
+      }
+      if (compact->hasConflictParent(id)) {
+	pval[idx] = compact->conflictingParentVal[id];
+      }
     }
   }
 
-
   bool result = false;
   bool defer = false;
+  bool follows = cursor_follows;
+  cursor_follows = false;
   
-  switch (change.mode) {
+  switch (mode) {
   case ROW_CHANGE_INSERT:
     {
       RowRef tail(rowCursor);
+      int anchor = -1;
+      if (sheet.isSequential()&&!descriptive) {
+	// the row waits at the end of the table; see flushEdits
+	bool flushed = false;
+	anchor = queueAnchor(follows,flushed);
+	tail = RowRef(-1);
+      }
       Poly<SheetRow> inserter;
       if (sheet.isSequential()) {
 	inserter = sheet.insertRowOrdered(tail);
@@ -860,7 +956,12 @@ bool SheetPatcher::changeRow(const RowChange& change) {
       if (sheet.isSequential()) {
 	int r = inserter->getRowAfterFlush().getIndex();
 	activeRow.insertRowOrdered(tail);
+	row_index.rowInserted(sheet,r);
 	activeRow.cellString(0,r,"+++");
+	if (anchor>=0) {
+	  queueRow(anchor,r);
+	  break;
+	}
 	if (descriptive) {
 	  Poly<Appearance> appear = sheet.getRowAppearance(r);
 	  if (appear.isValid()) {
@@ -891,8 +992,10 @@ bool SheetPatcher::changeRow(const RowChange& change) {
       RowRef row(r);
       rowCursor = r;
       if (!descriptive) {
-	sheet.deleteRow(row);
-	activeRow.deleteRow(row);
+	// marked for now, and removed along with the others by
+	// flushEdits; matchRow passes over marked rows
+	activeRow.cellString(0,r,"---");
+	pending_deletes++;
       } else {
 	Poly<Appearance> appear = sheet.getRowAppearance(r);
 	if (appear.isValid()) {
@@ -946,6 +1049,24 @@ bool SheetPatcher::changeRow(const RowChange& change) {
 	result = false;
 	break;
       }
+      if (sheet.isSequential()&&!descriptive) {
+	// the row stays where it is until flushEdits
+	bool flushed = false;
+	int anchor = queueAnchor(follows,flushed);
+	if (flushed) {
+	  r = matchRow(active_cond,active_name,cond,width);
+	  if (r<0) {
+	    result = false;
+	    break;
+	  }
+	}
+	pending_marks[r] |= 2;
+	markChanges(conflicted,r,width,active_val,val,cval,pval);
+	row_index.rowChanged(sheet,r);
+	queueRow(anchor,r);
+	result = true;
+	break;
+      }
       RowRef from(r);
       RowRef to(rowCursor);
       dbg_printf("Moving %d to %d in sheet of length %d\n", from.getIndex(), to.getIndex(), sheet.height());
@@ -955,6 +1076,7 @@ bool SheetPatcher::changeRow(const RowChange& change) {
 		sheet.desc().c_str());
       } else {
 	activeRow.moveRow(from,to);
+	row_index.rowMoved(r,result.getIndex());
       }
       r = result.getIndex();
       dbg_printf("Move result was %d\n", r);
@@ -962,7 +1084,8 @@ bool SheetPatcher::changeRow(const RowChange& change) {
 	dbg_printf("%d %s / ", y, sheet.cellString(0,y).c_str());
       }
       dbg_printf("\n");
-      markChanges(change,r,width,active_val,val,cval,pval);
+      markChanges(conflicted,r,width,active_val,val,cval,pval);
+      row_index.rowChanged(sheet,r);
       r++;
       if (r>=sheet.height()) {
 	r = -1;
@@ -981,7 +1104,8 @@ bool SheetPatcher::changeRow(const RowChange& change) {
 	break;
       }
       dbg_printf("Match for assignment\n");
-      markChanges(change,r,width,active_val,val,cval,pval);
+      markChanges(conflicted,r,width,active_val,val,cval,pval);
+      row_index.rowChanged(sheet,r);
       r++;
       if (r>=sheet.height()) {
 	r = -1;
@@ -998,13 +1122,23 @@ bool SheetPatcher::changeRow(const RowChange& change) {
   }
 
   if (defer) {
-    deferred_rows.push_back(RowUnit(sheetName,change));
+    if (full) {
+      deferred_rows.push_back(RowUnit(sheetName,*full));
+    } else {
+      deferred_rows.push_back(RowUnit(sheetName,*compact));
+    }
     dbg_printf("DEFERRED a row\n");
   }
 
   if (result) {
     changeCount++;
-    if (chain) chain->changeRow(change);
+    if (chain) {
+      if (full) {
+	chain->changeRow(*full);
+      } else {
+	chain->changeCompactRow(*compact);
+      }
+    }
   }
 
   return result;
@@ -1064,6 +1198,7 @@ bool SheetPatcher::declareNames(const std::vector<std::string>& names,
 
 bool SheetPatcher::setSheet(const char *name) {
   checkedHeader = false;
+  row_index.clear();
   updateSheet();
   sheetUpdateNeeded = true;
 
@@ -1119,10 +1254,12 @@ bool SheetPatcher::setSheet(const char *name) {
 
 
 bool SheetPatcher::mergeStart() {
+  flushEdits();
   sheetChange = true;
   sheetName = "";
   killNeutral = false;
   activeRow.resize(1,0);
+  row_index.clear();
   setNames();
   if (chain) chain->mergeStart();
   return true;
@@ -1155,7 +1292,11 @@ bool SheetPatcher::mergeDone() {
 	if (unit.sheet_name!=sheetName) {
 	  setSheet(unit.sheet_name.c_str());
 	}
-	changeRow(unit.change);
+	if (unit.compact) {
+	  changeCompactRow(unit.compact_change);
+	} else {
+	  changeRow(unit.change);
+	}
       }
     }
   } while (len>0 && len!=prev_len);
@@ -1239,8 +1380,125 @@ void SheetPatcher::updatePool() {
 }
 
 
+int SheetPatcher::queueAnchor(bool follows, bool& flushed) {
+  flushed = false;
+  if (pending_base>=0) {
+    // a cursor of -1 appends, after anything already queued there
+    if (rowCursor<0) return pending_base;
+    int anchor = (rowCursor<pending_base)?rowCursor:pending_base;
+    // the cursor is just before rows already queued here, unless it
+    // was left by them; the queue can only grow at the back
+    if (!(pending_marks[anchor]&1)||follows) return anchor;
+    flushEdits();
+    flushed = true;
+  }
+  PolySheet sheet = getSheet();
+  pending_base = sheet.height();
+  pending_marks.assign(pending_base+1,0);
+  if (rowCursor<0||rowCursor>=pending_base) return pending_base;
+  return rowCursor;
+}
+
+void SheetPatcher::queueRow(int anchor, int r) {
+  pending_edits.push_back(make_pair(anchor,r));
+  pending_marks[anchor] |= 1;
+  rowCursor = (anchor<pending_base)?anchor:-1;
+  cursor_follows = true;
+}
+
+static bool anchor_less(const pair<int,int>& a, const pair<int,int>& b) {
+  return a.first<b.first;
+}
+
+void SheetPatcher::flushEdits() {
+  if (pending_deletes==0&&pending_base<0) return;
+  pending_deletes = 0;
+  PolySheet sheet = getSheet();
+  if (pending_base>=0) {
+    int base = pending_base;
+    bool follows = cursor_follows;
+    pending_base = -1;
+    cursor_follows = false;
+    if (!sheet.isValid()) {
+      pending_edits.clear();
+      pending_marks.clear();
+      return;
+    }
+    // each anchor gets its queued rows, in the order queued, then
+    // itself unless moved or deleted
+    stable_sort(pending_edits.begin(),pending_edits.end(),anchor_less);
+    vector<int> order;
+    string scratch;
+    int at = (rowCursor<base)?rowCursor:base;
+    int cursor = -1;
+    int k = 0;
+    for (int y=0; y<=base; y++) {
+      if (y==at&&!follows) cursor = (int)order.size();
+      while (k<(int)pending_edits.size()&&pending_edits[k].first==y) {
+	order.push_back(pending_edits[k].second);
+	k++;
+      }
+      if (y==at&&follows) cursor = (int)order.size();
+      if (y==base) break;
+      if (pending_marks[y]&2) continue;
+      if (activeRow.cellView(0,y,scratch).textEquals("---",3)) continue;
+      order.push_back(y);
+    }
+    pending_edits.clear();
+    pending_marks.clear();
+    dbg_printf("Placing queued rows, keeping %d of %d\n", (int)order.size(),
+	       sheet.height());
+    if (!sheet.reorderRows(order)) {
+      fprintf(stderr,"Row reorder failed in sheet of type %s\n",
+	      sheet.desc().c_str());
+      activeRow.resize(1,sheet.height());
+      row_index.clear();
+      rowCursor = -1;
+      return;
+    }
+    activeRow.reorderRows(order);
+    row_index.clear();
+    if (rowCursor>=0) {
+      rowCursor = (cursor<sheet.height())?cursor:-1;
+    }
+    return;
+  }
+  if (!sheet.isValid()) return;
+  vector<int> rows;
+  string scratch;
+  int h = activeRow.height();
+  if (h>sheet.height()) h = sheet.height();
+  for (int y=0; y<h; y++) {
+    if (activeRow.cellView(0,y,scratch).textEquals("---",3)) {
+      rows.push_back(y);
+    }
+  }
+  if (rows.size()==0) return;
+  dbg_printf("Deleting %d marked rows\n", (int)rows.size());
+  if (!sheet.deleteRowSet(rows)) {
+    fprintf(stderr,"Row delete failed in sheet of type %s\n",
+	    sheet.desc().c_str());
+    activeRow.resize(1,sheet.height());
+    row_index.clear();
+    rowCursor = -1;
+    return;
+  }
+  activeRow.deleteRowSet(rows);
+  row_index.rowsRemoved(rows);
+  if (rowCursor>=0) {
+    int before = (int)(lower_bound(rows.begin(),rows.end(),rowCursor)-
+		       rows.begin());
+    rowCursor -= before;
+    if (rowCursor>=sheet.height()) {
+      rowCursor = -1;
+    }
+  }
+}
+
 bool SheetPatcher::updateSheet() {
+  flushEdits();
   if (!sheetUpdateNeeded) return false;
+  row_index.clear();
 
   if (descriptive) {
     PolySheet sheet = getSheet();
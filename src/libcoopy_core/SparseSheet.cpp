@@ -14,13 +14,18 @@ Stat SparseFloatSheet::normalize(int first, int last, float sc, bool modify) {
   float tot = 0;
   float tot2 = 0;
   int ct = 0;
-  for (efficient_map<long long,float>::iterator it=data.begin(); it!=data.end(); it++) {
-    long long col = it->first % ww;
-    if (col>=first&&col<=last) {
-      float r = it->second;
-      tot += r;
-      tot2 += r*r;
-      ct++;
+  settle();
+  for (int y=0; y<(int)index.size(); y++) {
+    const vector<int>& idx = index[y];
+    const vector<float>& val = values[y];
+    for (int i=0; i<(int)idx.size(); i++) {
+      int col = idx[i];
+      if (col>=first&&col<=last) {
+	float r = val[i];
+	tot += r;
+	tot2 += r*r;
+	ct++;
+      }
     }
   }
   if (ct==0) return s;
@@ -36,12 +41,16 @@ Stat SparseFloatSheet::normalize(int first, int last, float sc, bool modify) {
   //printf("mean %g, dev %g\n", mean, dev);
   if (dev<sc) dev = sc;
   if (modify) {
-    for (efficient_map<long long,float>::iterator it=data.begin(); it!=data.end(); it++) {
-      long long col = it->first % ww;
-      if (col>=first&&col<=last) {
-	float r = it->second;
-	r = (r-mean)/dev;
-	it->second = r;
+    for (int y=0; y<(int)index.size(); y++) {
+      const vector<int>& idx = index[y];
+      vector<float>& val = values[y];
+      for (int i=0; i<(int)idx.size(); i++) {
+	int col = idx[i];
+	if (col>=first&&col<=last) {
+	  float r = val[i];
+	  r = (r-mean)/dev;
+	  val[i] = r;
+	}
       }
     }
   }
@@ -56,20 +65,24 @@ void SparseFloatSheet::findBest(IntSheet& bestIndex, FloatSheet& bestValue, Floa
   bestIndex.resize(1,h,-1);
   bestValue.resize(1,h,0);
   bestInc.resize(1,h,0);
-  for (efficient_map<long long,float>::iterator it=data.begin(); it!=data.end(); it++) {
-    long long x = it->first % w;
-    long long y = it->first / w;
-    if (x>=w || y>=h) {
-      fprintf(stderr,"SparseSheet - out of range: %ld %ld : (%dx%d)\n", 
-	      (long)x, (long)y, w, h);
-      exit(1);
-    }
-    float val = it->second;
-    float& best = bestValue.cell(0,y);
-    if (val>best) {
-      bestIndex.cell(0,y) = x;
-      bestInc.cell(0,y) = val - best;
-      best = val;
+  settle();
+  for (int y=0; y<(int)index.size(); y++) {
+    const vector<int>& idx = index[y];
+    const vector<float>& vals = values[y];
+    for (int i=0; i<(int)idx.size(); i++) {
+      int x = idx[i];
+      if (x>=w || y>=h) {
+	fprintf(stderr,"SparseSheet - out of range: %ld %ld : (%dx%d)\n", 
+		(long)x, (long)y, w, h);
+	exit(1);
+      }
+      float val = vals[i];
+      float& best = bestValue.cell(0,y);
+      if (val>best) {
+	bestIndex.cell(0,y) = x;
+	bestInc.cell(0,y) = val - best;
+	best = val;
+      }
     }
   }
 }
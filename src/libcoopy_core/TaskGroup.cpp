@@ -0,0 +1,84 @@
+#include <coopy/TaskGroup.h>
+#include <coopy/Dbg.h>
+
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+using namespace coopy::os;
+using namespace std;
+
+#ifdef HAVE_PTHREAD
+
+namespace {
+  struct TaskQueue {
+    vector<Task*> *tasks;
+    int next;
+    pthread_mutex_t lock;
+  };
+}
+
+static void *task_worker(void *data) {
+  TaskQueue *q = (TaskQueue *)data;
+  while (true) {
+    pthread_mutex_lock(&q->lock);
+    int at = q->next;
+    if (at<(int)q->tasks->size()) q->next++;
+    pthread_mutex_unlock(&q->lock);
+    if (at>=(int)q->tasks->size()) break;
+    (*q->tasks)[at]->run();
+  }
+  return 0/*NULL*/;
+}
+
+bool TaskGroup::isThreaded() {
+  return true;
+}
+
+void TaskGroup::run() {
+  int n = (int)tasks.size();
+  int workers = threads;
+  if (workers>n) workers = n;
+  if (workers<=1) {
+    for (int i=0; i<n; i++) {
+      tasks[i]->run();
+    }
+    tasks.clear();
+    return;
+  }
+  TaskQueue q;
+  q.tasks = &tasks;
+  q.next = 0;
+  pthread_mutex_init(&q.lock,0/*NULL*/);
+  vector<pthread_t> ids;
+  for (int i=1; i<workers; i++) {
+    pthread_t id;
+    if (pthread_create(&id,0/*NULL*/,task_worker,&q)!=0) {
+      dbg_printf("TaskGroup::run could not start thread %d\n", i);
+      break;
+    }
+    ids.push_back(id);
+  }
+  // the calling thread does its share too
+  task_worker(&q);
+  for (int i=0; i<(int)ids.size(); i++) {
+    pthread_join(ids[i],0/*NULL*/);
+  }
+  pthread_mutex_destroy(&q.lock);
+  tasks.clear();
+}
+
+#else
+
+bool TaskGroup::isThreaded() {
+  return false;
+}
+
+void TaskGroup::run() {
+  for (int i=0; i<(int)tasks.size(); i++) {
+    tasks[i]->run();
+  }
+  tasks.clear();
+}
+
+#endif
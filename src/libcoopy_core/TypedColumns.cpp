@@ -0,0 +1,424 @@
+#include <coopy/TypedColumns.h>
+#include <coopy/SheetSchema.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <ctype.h>
+
+using namespace std;
+using namespace coopy::store;
+using namespace coopy::cmp;
+
+// 2^63, the first double past the range of a 64-bit integer
+#define TYPED_INT_LIMIT 9223372036854775808.0
+
+// Check whether a double holds an integer in the 64-bit range, and
+// if so get it.
+static bool real_as_integer(double d, long long& result) {
+  if (d!=floor(d)) return false;
+  if (d<-TYPED_INT_LIMIT || d>=TYPED_INT_LIMIT) return false;
+  result = (long long)d;
+  return true;
+}
+
+static bool is_digit(char ch) {
+  return ch>='0'&&ch<='9';
+}
+
+// Check that text is a plain decimal number, and whether it has no
+// fraction or exponent.
+static bool scan_number(const char *s, int len, bool& integral) {
+  int p = 0;
+  if (p<len && s[p]=='-') p++;
+  int start = p;
+  while (p<len && is_digit(s[p])) p++;
+  int nd = p-start;
+  if (nd>1 && s[start]=='0') return false;
+  integral = true;
+  int fd = 0;
+  if (p<len && s[p]=='.') {
+    p++;
+    int fstart = p;
+    while (p<len && is_digit(s[p])) p++;
+    fd = p-fstart;
+    integral = false;
+  }
+  if (nd+fd==0) return false;
+  if (p<len && (s[p]=='e'||s[p]=='E')) {
+    p++;
+    if (p<len && (s[p]=='-'||s[p]=='+')) p++;
+    int estart = p;
+    while (p<len && is_digit(s[p])) p++;
+    if (p==estart) return false;
+    integral = false;
+  }
+  return p==len;
+}
+
+static bool parse_integer(const char *s, int len, long long& result) {
+  bool integral = false;
+  if (!scan_number(s,len,integral)) return false;
+  if (!integral) return false;
+  bool neg = (s[0]=='-');
+  unsigned long long v = 0;
+  unsigned long long lim = neg?(1ULL<<63):((1ULL<<63)-1);
+  for (int p=neg?1:0; p<len; p++) {
+    unsigned long long d = s[p]-'0';
+    if (v>(lim-d)/10) return false;
+    v = v*10+d;
+  }
+  result = neg?(long long)(0-v):(long long)v;
+  return true;
+}
+
+static bool parse_real(const char *s, int len, double& result) {
+  bool integral = false;
+  if (!scan_number(s,len,integral)) return false;
+  char buf[64];
+  string big;
+  const char *txt = buf;
+  if (len<(int)sizeof(buf)) {
+    memcpy(buf,s,len);
+    buf[len] = '\0';
+  } else {
+    big = string(s,len);
+    txt = big.c_str();
+  }
+  result = strtod(txt,0/*NULL*/);
+  return true;
+}
+
+static int read_digits(const char *s, int len, int& p, int n) {
+  if (p+n>len) return -1;
+  int v = 0;
+  for (int i=0; i<n; i++) {
+    if (!is_digit(s[p+i])) return -1;
+    v = v*10+(s[p+i]-'0');
+  }
+  p += n;
+  return v;
+}
+
+// days since 1970-01-01 in the proleptic Gregorian calendar
+static long long days_from_civil(long long y, int m, int d) {
+  y -= (m<=2);
+  long long era = (y>=0?y:y-399)/400;
+  long long yoe = y-era*400;
+  long long doy = (153*(m+(m>2?-3:9))+2)/5+d-1;
+  long long doe = yoe*365+yoe/4-yoe/100+doy;
+  return era*146097+doe-719468;
+}
+
+static void civil_from_days(long long z, long long& y, int& m, int& d) {
+  z += 719468;
+  long long era = (z>=0?z:z-146096)/146097;
+  long long doe = z-era*146097;
+  long long yoe = (doe-doe/1460+doe/36524-doe/146096)/365;
+  long long doy = doe-(365*yoe+yoe/4-yoe/100);
+  long long mp = (5*doy+2)/153;
+  d = (int)(doy-(153*mp+2)/5+1);
+  m = (int)(mp<10?mp+3:mp-9);
+  y = yoe+era*400+(m<=2);
+}
+
+static int days_in_month(int y, int m) {
+  static const int days[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+  if (m==2 && (y%4==0 && (y%100!=0 || y%400==0))) return 29;
+  return days[m-1];
+}
+
+// YYYY-MM-DD, optionally followed by HH:MM or HH:MM:SS
+static bool parse_datetime(const char *s, int len, long long& result) {
+  int p = 0;
+  int y = read_digits(s,len,p,4);
+  if (y<0 || p>=len || s[p]!='-') return false;
+  p++;
+  int m = read_digits(s,len,p,2);
+  if (m<1 || m>12 || p>=len || s[p]!='-') return false;
+  p++;
+  int d = read_digits(s,len,p,2);
+  if (d<1 || d>days_in_month(y,m)) return false;
+  int hr = 0, mn = 0, sc = 0;
+  if (p<len) {
+    if (s[p]!=' ' && s[p]!='T') return false;
+    p++;
+    hr = read_digits(s,len,p,2);
+    if (hr<0 || hr>23 || p>=len || s[p]!=':') return false;
+    p++;
+    mn = read_digits(s,len,p,2);
+    if (mn<0 || mn>59) return false;
+    if (p<len) {
+      if (s[p]!=':') return false;
+      p++;
+      sc = read_digits(s,len,p,2);
+      if (sc<0 || sc>60) return false;
+    }
+    if (p!=len) return false;
+  }
+  result = days_from_civil(y,m,d)*86400+hr*3600+mn*60+sc;
+  return true;
+}
+
+static bool same_word(const char *s, int len, const char *word) {
+  for (int i=0; i<len; i++) {
+    if (word[i]=='\0' || tolower(s[i])!=word[i]) return false;
+  }
+  return word[len]=='\0';
+}
+
+static bool parse_boolean(const char *s, int len, long long& result) {
+  if (same_word(s,len,"true")) {
+    result = 1;
+    return true;
+  }
+  if (same_word(s,len,"false")) {
+    result = 0;
+    return true;
+  }
+  return false;
+}
+
+bool TypedValue::parse(const SheetCellView& v, int kind) {
+  this->kind = TYPED_TEXT;
+  if (kind==TYPED_TEXT) return false;
+  if (v.escaped) {
+    this->kind = TYPED_NULL;
+    return true;
+  }
+  bool ok = false;
+  switch (kind) {
+  case TYPED_INTEGER:
+    ok = parse_integer(v.data,v.len,i);
+    break;
+  case TYPED_REAL:
+    if (parse_integer(v.data,v.len,i)) {
+      // kept exact, rather than rounded to the nearest double
+      this->kind = TYPED_INTEGER;
+      d = (double)i;
+      return true;
+    }
+    ok = parse_real(v.data,v.len,d);
+    break;
+  case TYPED_DATETIME:
+    ok = parse_datetime(v.data,v.len,i);
+    break;
+  case TYPED_BOOLEAN:
+    ok = parse_boolean(v.data,v.len,i);
+    break;
+  }
+  if (ok) this->kind = kind;
+  return ok;
+}
+
+bool TypedValue::equals(const TypedValue& alt) const {
+  if (kind==TYPED_TEXT || alt.kind==TYPED_TEXT) return false;
+  if (kind==TYPED_NULL || alt.kind==TYPED_NULL) {
+    return kind==alt.kind;
+  }
+  bool num = (kind==TYPED_INTEGER || kind==TYPED_REAL);
+  bool alt_num = (alt.kind==TYPED_INTEGER || alt.kind==TYPED_REAL);
+  if (num && alt_num) {
+    if (kind==TYPED_REAL && alt.kind==TYPED_REAL) {
+      return d==alt.d;
+    }
+    // integers compare exactly, never by way of a double; a real
+    // only equals an integer if it is that integer
+    long long a = i;
+    long long b = alt.i;
+    if (kind==TYPED_REAL && !real_as_integer(d,a)) return false;
+    if (alt.kind==TYPED_REAL && !real_as_integer(alt.d,b)) return false;
+    return a==b;
+  }
+  if (kind!=alt.kind) return false;
+  return i==alt.i;
+}
+
+string TypedValue::canonical() const {
+  char buf[256];
+  switch (kind) {
+  case TYPED_NULL:
+    return "NULL";
+  case TYPED_INTEGER:
+    snprintf(buf,sizeof(buf),"%lld",i);
+    return buf;
+  case TYPED_REAL:
+    {
+      // written as the integer it equals, if any
+      long long n = 0;
+      if (real_as_integer(d,n)) {
+	snprintf(buf,sizeof(buf),"%lld",n);
+      } else {
+	snprintf(buf,sizeof(buf),"%.15g",d);
+      }
+    }
+    return buf;
+  case TYPED_DATETIME:
+    {
+      long long days = i/86400;
+      long long secs = i%86400;
+      if (secs<0) {
+	secs += 86400;
+	days--;
+      }
+      long long y;
+      int m, dd;
+      civil_from_days(days,y,m,dd);
+      if (secs==0) {
+	snprintf(buf,sizeof(buf),"%04lld-%02d-%02d",y,m,dd);
+      } else {
+	snprintf(buf,sizeof(buf),"%04lld-%02d-%02d %02d:%02d:%02d",y,m,dd,
+		 (int)(secs/3600),(int)((secs/60)%60),(int)(secs%60));
+      }
+    }
+    return buf;
+  case TYPED_BOOLEAN:
+    return i?"true":"false";
+  }
+  return "";
+}
+
+static int kind_of_family(int family) {
+  switch (family) {
+  case ColumnType::COLUMN_FAMILY_INTEGER:
+    return TypedValue::TYPED_INTEGER;
+  case ColumnType::COLUMN_FAMILY_REAL:
+  case ColumnType::COLUMN_FAMILY_CURRENCY:
+    return TypedValue::TYPED_REAL;
+  case ColumnType::COLUMN_FAMILY_DATETIME:
+    return TypedValue::TYPED_DATETIME;
+  case ColumnType::COLUMN_FAMILY_BOOLEAN:
+    return TypedValue::TYPED_BOOLEAN;
+  }
+  return -1;
+}
+
+void TypedColumns::build(const DataSheet& sheet) {
+  clear();
+  int w = sheet.width();
+  h = sheet.height();
+  cols.resize(w);
+  if (w==0||h==0) return;
+
+  // types given by the schema, -1 where one should be guessed
+  vector<int> given(w,-1);
+  bool guess = false;
+  SheetSchema *schema = sheet.getSchema();
+  for (int x=0; x<w; x++) {
+    if (schema) {
+      ColumnInfo info = schema->getColumnInfo(x);
+      if (info.hasType()) {
+	given[x] = kind_of_family(info.getColumnType().family);
+      }
+    }
+    if (given[x]<0) guess = true;
+  }
+
+  RowBlock block;
+  TypedValue v;
+  if (guess) {
+    vector<int> present(w,0), ints(w,0), reals(w,0), dates(w,0), bools(w,0);
+    for (int y=0; y<h; y++) {
+      if (!block.contains(y)) sheet.readRows(y,RowBlock::DEFAULT_HEIGHT,block);
+      for (int x=0; x<w; x++) {
+	if (given[x]>=0) continue;
+	const SheetCellView& c = block.cell(x,y);
+	if (c.escaped || c.len==0) continue;
+	present[x]++;
+	if (v.parse(c,TypedValue::TYPED_REAL)) {
+	  reals[x]++;
+	  if (v.parse(c,TypedValue::TYPED_INTEGER)) ints[x]++;
+	} else if (v.parse(c,TypedValue::TYPED_DATETIME)) {
+	  dates[x]++;
+	} else if (v.parse(c,TypedValue::TYPED_BOOLEAN)) {
+	  bools[x]++;
+	}
+      }
+    }
+    for (int x=0; x<w; x++) {
+      if (given[x]>=0) continue;
+      int n = present[x];
+      int k = TypedValue::TYPED_TEXT;
+      if (n==0) {
+	k = TypedValue::TYPED_TEXT;
+      } else if (ints[x]*2>=n && ints[x]==reals[x]) {
+	k = TypedValue::TYPED_INTEGER;
+      } else if (reals[x]*2>=n) {
+	k = TypedValue::TYPED_REAL;
+      } else if (dates[x]*2>=n) {
+	k = TypedValue::TYPED_DATETIME;
+      } else if (bools[x]*2>=n) {
+	k = TypedValue::TYPED_BOOLEAN;
+      }
+      given[x] = k;
+    }
+  }
+
+  bool any = false;
+  for (int x=0; x<w; x++) {
+    Column& col = cols[x];
+    col.kind = given[x];
+    if (col.kind==TypedValue::TYPED_TEXT) continue;
+    any = true;
+    if (col.kind==TypedValue::TYPED_REAL) {
+      col.dval.resize(h,0);
+    } else {
+      col.ival.resize(h,0);
+    }
+    col.nulls.resize(h,false);
+    col.parsed.resize(h,false);
+  }
+  if (!any) return;
+
+  block = RowBlock();
+  for (int y=0; y<h; y++) {
+    if (!block.contains(y)) sheet.readRows(y,RowBlock::DEFAULT_HEIGHT,block);
+    for (int x=0; x<w; x++) {
+      Column& col = cols[x];
+      if (col.kind==TypedValue::TYPED_TEXT) continue;
+      if (!v.parse(block.cell(x,y),col.kind)) continue;
+      col.parsed[y] = true;
+      if (v.kind==TypedValue::TYPED_NULL) {
+	col.nulls[y] = true;
+      } else if (v.kind==TypedValue::TYPED_INTEGER &&
+		 col.kind==TypedValue::TYPED_REAL) {
+	// an integer in a column of reals keeps its exact value
+	if (col.whole.size()==0) {
+	  col.ival.resize(h,0);
+	  col.whole.resize(h,false);
+	}
+	col.ival[y] = v.i;
+	col.whole[y] = true;
+      } else if (col.kind==TypedValue::TYPED_REAL) {
+	col.dval[y] = v.d;
+      } else {
+	col.ival[y] = v.i;
+      }
+    }
+  }
+}
+
+bool TypedColumns::get(int x, int y, TypedValue& v) const {
+  v.kind = TypedValue::TYPED_TEXT;
+  if (x<0||x>=(int)cols.size()||y<0||y>=h) return false;
+  const Column& col = cols[x];
+  if (col.kind==TypedValue::TYPED_TEXT) return false;
+  if (!col.parsed[y]) return false;
+  if (col.nulls[y]) {
+    v.kind = TypedValue::TYPED_NULL;
+    return true;
+  }
+  v.kind = col.kind;
+  if (col.kind==TypedValue::TYPED_REAL && col.whole.size()>0 &&
+      col.whole[y]) {
+    v.kind = TypedValue::TYPED_INTEGER;
+    v.i = col.ival[y];
+    v.d = (double)v.i;
+  } else if (col.kind==TypedValue::TYPED_REAL) {
+    v.d = col.dval[y];
+  } else {
+    v.i = col.ival[y];
+  }
+  return true;
+}
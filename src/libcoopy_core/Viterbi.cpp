@@ -2,30 +2,87 @@
 #include <coopy/Viterbi.h>
 #include <coopy/Dbg.h>
 
-//#include <iostream>
-//using namespace std;
+#include <algorithm>
 
-//#define DBG_LEVEL 100
-//#define DBG(x) if (DBG_LEVEL>=(x))
-
-using namespace coopy::store;
+using namespace std;
 using namespace coopy::cmp;
 
 void Viterbi::setSize(int states, int sequence_length) {
   K = states;
   T = sequence_length;
-  cost.resize(K,T);
-  src.resize(K,T,-1);
-  path.resize(1,T,-1);
+  growStates(K);
   reset();
+  step_start.reserve(T);
+  path.reserve(T);
+}
+
+void Viterbi::reset() {
+  index = 0;
+  mode = 0;
+  path_valid = 0;
+  best_cost = 0;
+  step_start.clear();
+  state.clear();
+  cost.clear();
+  src.clear();
+  path.clear();
+  // Storage is kept, only the state tables need wiping.
+  fill(slot_prev.begin(),slot_prev.end(),-1);
+  fill(slot_curr.begin(),slot_curr.end(),-1);
 }
 
+void Viterbi::growStates(int k) {
+  if ((int)slot_curr.size()<k) {
+    slot_prev.resize(k,-1);
+    slot_curr.resize(k,-1);
+  }
+}
+
+void Viterbi::beginStep() {
+  step_start.push_back((int)state.size());
+}
+
+void Viterbi::endStep() {
+  int start = step_start.back();
+  int end = (int)state.size();
+  for (int i=start; i<end; i++) {
+    slot_curr[state[i]] = -1;
+  }
+  if (beam>0 && end>start) {
+    float lo = cost[start];
+    for (int i=start+1; i<end; i++) {
+      if (cost[i]<lo) lo = cost[i];
+    }
+    int at = start;
+    for (int i=start; i<end; i++) {
+      if (cost[i]<=lo+beam) {
+	state[at] = state[i];
+	cost[at] = cost[i];
+	src[at] = src[i];
+	at++;
+      }
+    }
+    end = at;
+    state.resize(end);
+    cost.resize(end);
+    src.resize(end);
+  }
+  if (index>0) {
+    for (int i=step_start[index-1]; i<start; i++) {
+      slot_prev[state[i]] = -1;
+    }
+  }
+  for (int i=start; i<end; i++) {
+    slot_prev[state[i]] = i;
+  }
+}
 
 void Viterbi::assertMode(int n_mode) {
   switch (n_mode) {
     case 0:
       if (mode==1)
 	{
+	  endStep();
 	  index++;
 	}
       mode = 0;
@@ -33,19 +90,9 @@ void Viterbi::assertMode(int n_mode) {
     case 1:
       if (mode==0)
 	{
-	  //assert(index<T);
-
-	  // Zeroing is now implicit.
-	  // The absence of a cell(x,y) should imply:
-	  //   cost(x,y) = 0
-	  //   src(x,y)  = -1
-	  /*
-	  for (int i=0; i<K; i++)
-	    {
-	      cost(i,index) = 0;
-	      src(i,index) = -1;
-	    }
-	  */
+	  // Zeroing is implicit.
+	  // A state with no entry in a step is unreachable at that step.
+	  beginStep();
 	}
       mode = 1;
       break;
@@ -56,54 +103,37 @@ void Viterbi::assertMode(int n_mode) {
 }
 
 void Viterbi::addTransition(int s0, int s1, float c) {
-  bool resize = false;
   if (s0>=K) {
     K = s0+1;
-    resize = true;
   }
   if (s1>=K) {
     K = s1+1;
-    resize = true;
-  }
-  if (resize) {
-    cost.nonDestructiveResize(K,T);
-    src.nonDestructiveResize(K,T,-1);
-    path.nonDestructiveResize(1,T,-1);
   }
+  growStates(K);
   path_valid = 0;
   assertMode(1);
   if (index>=T) {
     T=index+1;
-    //printf("RESIZE! index %d T %d\n", index, T);
-    cost.nonDestructiveResize(K,T);
-    src.nonDestructiveResize(K,T,-1);
-    path.nonDestructiveResize(1,T,-1);
   }
-  int sourced = 0;
+  int from = -1;
   if (index>0)
     {
-      c += cost(s0,index-1);
-      sourced = (src(s0,index-1)!=-1);
+      from = slot_prev[s0];
+      if (from<0) return;
+      c += cost[from];
     }
-  else
+  int at = slot_curr[s1];
+  if (at<0)
     {
-      sourced = 1;
+      slot_curr[s1] = (int)state.size();
+      state.push_back(s1);
+      cost.push_back(c);
+      src.push_back(from);
     }
-  
-  if (sourced)
+  else if (c<cost[at])
     {
-      if (c<cost(s1,index)||src(s1,index)==-1)
-	{
-	  //cout << "Setting " << s1 << "," << index << " to "
-	  //<< s0 << endl;
-	  cost(s1,index) = c;
-	  src(s1,index) = s0;
-	}
-      else
-	{
-	  //cout << "Rejecting " << s1 << "," << index << " to "
-	  //<< s0 << endl;
-	}
+      cost[at] = c;
+      src[at] = from;
     }
 }
 
@@ -111,33 +141,29 @@ void Viterbi::calculatePath() {
   if (!path_valid)
     {
       endTransitions();
-      float best = 0;
-      int bestj = -1;
       if (index<=0) {
 	// declare victory and exit
 	path_valid = 1;
 	return;
       }
-      for (int j=0; j<K; j++)
+      int best = -1;
+      for (int i=step_start[index-1]; i<(int)state.size(); i++)
 	{
-	  //DBG(50) cout << "j=" << j << " and bestj is " << bestj 
-	  //	       << " and src(j,index-1)=" << src(j,index-2)
-	  //	       << endl;
-	  if ((cost(j,index-1)<best||bestj==-1)&&src(j,index-1)!=-1)
+	  if (best==-1||cost[i]<cost[best]||
+	      (cost[i]==cost[best]&&state[i]<state[best]))
 	    {
-	      best = cost(j,index-1);
-	      bestj = j;
+	      best = i;
 	    }
 	}
-      best_cost = best;
+      COOPY_ASSERT(best!=-1);
+      best_cost = cost[best];
 
+      path.resize(index);
       for (int i=index-1; i>=0; i--)
 	{
-	  path(0,i) = bestj;
-	  //DBG(50) cout << "i=" << i << " and bestj is " << bestj << endl;
-	  COOPY_ASSERT(bestj!=-1);
-	  COOPY_ASSERT(bestj>=0&&bestj<K);
-	  bestj = src(bestj,i);
+	  COOPY_ASSERT(best!=-1);
+	  path[i] = state[best];
+	  best = src[best];
 	}
       path_valid = 1;
     }
@@ -147,13 +173,13 @@ void Viterbi::showPath() {
   calculatePath();
   for (int i=0; i<index; i++)
     {
-      if (path(0,i)==-1)
+      if (path[i]==-1)
 	{
 	  printf("*");
 	}
       else
 	{
-	  printf("%d",path(0,i));
+	  printf("%d",path[i]);
 	}
       if (K>=10)
 	{
@@ -162,5 +188,3 @@ void Viterbi::showPath() {
     }
   printf(" costs %g\n", getCost());
 }
-
-
@@ -0,0 +1,67 @@
+#ifndef COOPY_BUDGET_INC
+#define COOPY_BUDGET_INC
+
+namespace coopy {
+  namespace cmp {
+    class Budget;
+  }
+}
+
+/**
+ *
+ * Limits on how long a comparison may run, and how much memory the
+ * process may grow to while it runs.  Matching code checks
+ * exhausted() between units of work and, once it is true, stops
+ * refining and keeps whatever alignment it has so far.  Anything
+ * left unmatched then shows up as inserted or deleted.
+ *
+ */
+class coopy::cmp::Budget {
+public:
+  Budget() {
+    time_limit = 0;
+    memory_limit = 0;
+    deadline = 0;
+    checked_memory_at = 0;
+    expired = false;
+  }
+
+  /**
+   *
+   * Set limits, in milliseconds of wall-clock time from now and in
+   * megabytes of resident memory.  Zero means no limit.
+   *
+   */
+  void start(int time_ms, int memory_mb);
+
+  bool isLimited() const {
+    return time_limit>0 || memory_limit>0;
+  }
+
+  /**
+   *
+   * Check the limits.  Once exhausted, stays exhausted.  Cheap enough
+   * to call once per row; memory is only sampled now and then.
+   *
+   */
+  bool exhausted() {
+    if (expired) return true;
+    if (!isLimited()) return false;
+    return check();
+  }
+
+private:
+  int time_limit;
+  int memory_limit;
+  double deadline;
+  double checked_memory_at;
+  bool expired;
+
+  bool check();
+
+  static double now();
+
+  static double residentMegabytes();
+};
+
+#endif
@@ -0,0 +1,258 @@
+#ifndef COOPY_COLUMNARSHEET
+#define COOPY_COLUMNARSHEET
+
+#include <coopy/DataSheet.h>
+
+#include <vector>
+#include <string>
+
+namespace coopy {
+  namespace store {
+    class ColumnarColumn;
+    class ColumnarDictIndex;
+    class ColumnarSheet;
+  }
+}
+
+/**
+ *
+ * Storage for a single column of a ColumnarSheet.  Cell text is packed
+ * into one byte buffer, addressed by an offset/length pair per stored
+ * cell.  NULLs are tracked in a bitmap.  Optionally, the column can
+ * be dictionary encoded, in which case the offset of a cell is an
+ * index into a table of distinct values.
+ *
+ */
+class coopy::store::ColumnarColumn {
+public:
+  std::string bytes;
+  std::vector<unsigned int> offsets;
+  std::vector<unsigned int> lengths;
+  std::vector<bool> nulls;
+  long long garbage;
+
+  bool dict;
+  std::vector<std::string> dict_values;
+  ColumnarDictIndex *dict_index;
+
+  ColumnarColumn() {
+    garbage = 0;
+    dict = false;
+    dict_index = 0 /*NULL*/;
+  }
+
+  ~ColumnarColumn();
+
+  int size() const {
+    return (int)offsets.size();
+  }
+
+  const char *data(int p, int& len) const {
+    if (dict) {
+      const std::string& v = dict_values[offsets[p]];
+      len = (int)v.length();
+      return v.c_str();
+    }
+    len = (int)lengths[p];
+    return bytes.c_str()+offsets[p];
+  }
+
+  bool isNull(int p) const {
+    return nulls[p];
+  }
+
+  void append(const char *s, int len, bool null);
+
+  void assign(int p, const char *s, int len, bool null);
+
+  void setDictionary(bool flag);
+
+  void compact(const std::vector<int>& order);
+
+private:
+  unsigned int store(const char *s, int len);
+
+  ColumnarColumn(const ColumnarColumn& alt);
+  const ColumnarColumn& operator=(const ColumnarColumn& alt);
+};
+
+/**
+ *
+ * A table stored column by column, intended for large read-mostly
+ * inputs.  Each column keeps its text in a single byte buffer rather
+ * than one std::string per cell, which cuts allocation and memory
+ * overhead substantially compared with CsvSheet.  Rows are addressed
+ * through an index, so row insertions, deletions and moves do not
+ * touch the cell data.
+ *
+ * Loading follows the same addField()/addRecord() protocol as
+ * CsvSheet, see CsvFile::read.
+ *
+ */
+class coopy::store::ColumnarSheet : public DataSheet {
+private:
+  std::vector<ColumnarColumn *> cols;
+  std::vector<int> rows;
+  int physical;
+  int tw;
+  bool dictionary;
+  SheetStyle style;
+  Poly<SheetSchema> pSchema;
+
+  void addColumnAtEnd();
+
+  void maybeCompact();
+
+  ColumnarSheet(const ColumnarSheet& alt);
+  const ColumnarSheet& operator=(const ColumnarSheet& alt);
+
+public:
+  using DataSheet::insertRow;
+
+  ColumnarSheet() {
+    physical = 0;
+    tw = 0;
+    dictionary = false;
+  }
+
+  virtual ~ColumnarSheet() {
+    clear();
+  }
+
+  /**
+   *
+   * Turn dictionary encoding on or off for columns created from now on.
+   * Dictionary encoded columns fall back to plain storage automatically
+   * if they turn out to have too many distinct values.
+   *
+   */
+  void setDictionary(bool flag) {
+    dictionary = flag;
+  }
+
+  bool isDictionary() const {
+    return dictionary;
+  }
+
+  void clear();
+
+  const SheetStyle& getStyle() {
+    return style;
+  }
+
+  void setStyle(const SheetStyle& style) {
+    this->style = style;
+  }
+
+  virtual SheetSchema *getSchema() const {
+    return pSchema.getContent();
+  }
+
+  void setSchema(Poly<SheetSchema> pSchema) {
+    this->pSchema = pSchema;
+  }
+
+  void addField(const char *s, int len, bool escaped);
+
+  void addField(const SheetCell& c) {
+    addField(c.text.c_str(),(int)c.text.length(),c.escaped);
+  }
+
+  void addRecord();
+
+  virtual int width() const {
+    return (int)cols.size();
+  }
+
+  virtual int height() const {
+    return (int)rows.size();
+  }
+
+  /**
+   *
+   * Direct access to the stored bytes of a cell.  The pointer remains
+   * valid until the sheet is next modified.
+   *
+   */
+  const char *cellData(int x, int y, int& len, bool& escaped) const {
+    const ColumnarColumn& c = *cols[x];
+    int p = rows[y];
+    escaped = c.isNull(p);
+    return c.data(p,len);
+  }
+
+  virtual std::string cellString(int x, int y) const {
+    int len = 0;
+    bool escaped = false;
+    const char *str = cellData(x,y,len,escaped);
+    return std::string(str,len);
+  }
+
+  virtual std::string cellString(int x, int y, bool& escaped) const {
+    int len = 0;
+    const char *str = cellData(x,y,len,escaped);
+    return std::string(str,len);
+  }
+
+  virtual SheetCellView cellView(int x, int y, std::string& scratch) const {
+    SheetCellView v;
+    v.data = cellData(x,y,v.len,v.escaped);
+    return v;
+  }
+
+  virtual int readRows(int y0, int count, RowBlock& block) const;
+
+  virtual bool canReadConcurrently() const {
+    return true;
+  }
+
+  virtual bool cellString(int x, int y, const std::string& str) {
+    return cellString(x,y,str,false);
+  }
+
+  virtual bool cellString(int x, int y, const std::string& str,
+			  bool escaped);
+
+  virtual bool deleteColumn(const ColumnRef& column);
+
+  virtual ColumnRef insertColumn(const ColumnRef& base);
+
+  virtual ColumnRef insertColumn(const ColumnRef& base,
+				 const ColumnInfo& info) {
+    return insertColumn(base);
+  }
+
+  virtual bool modifyColumn(const ColumnRef& base,
+			    const ColumnInfo& info) {
+    return true;
+  }
+
+  virtual ColumnRef moveColumn(const ColumnRef& src, const ColumnRef& base);
+
+  virtual bool deleteRow(const RowRef& src);
+
+  virtual bool deleteData(int offset = 0);
+
+  virtual bool deleteRowSet(const std::vector<int>& ys);
+
+  virtual bool reorderRows(const std::vector<int>& order);
+
+  virtual RowRef insertRow(const RowRef& base);
+
+  virtual RowRef moveRow(const RowRef& src, const RowRef& base);
+
+  virtual bool canResize() { return true; }
+
+  virtual bool resize(int w, int h);
+
+  virtual bool applySchema(const SheetSchema& ss) {
+    resize(ss.getColumnCount(),0);
+    return true;
+  }
+
+  virtual std::string getDescription() const {
+    return "columnar";
+  }
+};
+
+#endif
@@ -8,6 +8,7 @@
 
 #include <coopy/unistdio.h>
 #include <coopy/Pool.h>
+#include <coopy/Budget.h>
 
 namespace coopy {
   namespace cmp {
@@ -98,6 +99,18 @@ public:
   bool foreign_pool_set;
   bool offload_to_sql_when_possible;
   int context_lines;
+  float viterbi_beam;
+  bool hash_features;
+  int lsh_bands;
+  int lsh_rows;
+  bool key_join;
+  int threads;
+  int read_threads;
+  int time_budget;
+  int memory_budget;
+  int feature_cache;
+  bool typed_compare;
+  Budget budget;
   Compare *default_compare;
 
   CompareFlags() {
@@ -126,6 +139,17 @@ public:
     clean_sheets = false;
     offload_to_sql_when_possible = false;
     context_lines = -2; // use default
+    viterbi_beam = 0; // no pruning
+    hash_features = false;
+    lsh_bands = 0; // no lsh index
+    lsh_rows = 2;
+    key_join = false;
+    threads = 1;
+    read_threads = 1;
+    time_budget = 0; // milliseconds, no limit
+    memory_budget = 0; // megabytes, no limit
+    feature_cache = 0; // bytes, use the default
+    typed_compare = false;
     default_compare = 0 /*NULL*/;
   }
 
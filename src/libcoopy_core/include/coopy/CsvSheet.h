@@ -60,6 +60,7 @@ public:
   // Deprecated, should migrate to deleteRow
   bool removeRow(int index) {
     s.arr.erase(s.arr.begin()+index);
+    s.digests.rowsRemoved(index,1);
     if (s.arr.size()<(size_t)s.h) {
       th = s.h = s.arr.size();
       return true;
@@ -100,6 +101,15 @@ public:
 
   void addRecord();
 
+  /**
+   *
+   * Add a record made of the given cells, as if each had been added
+   * with addField and then addRecord called.  The cells are taken
+   * from the vector, which is left empty.
+   *
+   */
+  void addRecord(std::vector<pairCellType>& cells);
+
   void addRow(CsvSheet& alt, int row) {
     for (int i=0; i<alt.width(); i++) {
       const pairCellType& p = alt.pcell(i,row);
@@ -112,6 +122,7 @@ public:
     tw = th = 0;
     s.w = s.h = 0;
     s.arr.clear();
+    s.digests.clear();
     rec.clear();
     valid = true;
   }
@@ -146,6 +157,22 @@ public:
     return ""; 
   }
 
+  virtual SheetCellView cellView(int x, int y, std::string& scratch) const {
+    if (!valid) {
+      if ((int)s.arr[y].size()<=x) {
+	return SheetCellView("",0,false);
+      }
+    }
+    const pairCellType& c = pcell(x,y);
+    return SheetCellView(c.first,c.second);
+  }
+
+  virtual int readRows(int y0, int count, RowBlock& block) const;
+
+  virtual bool canReadConcurrently() const {
+    return true;
+  }
+
   virtual bool cellString(int x, int y, const std::string& str) {
     cell(x,y) = str;
     return true;
@@ -163,6 +190,7 @@ public:
     s.arr = alt.s.arr;
     s.h = alt.s.h;
     s.w = alt.s.w;
+    s.digests.clear();
     return *this;
   }
 
@@ -0,0 +1,101 @@
+#ifndef COOPY_CSVWRITER_INC
+#define COOPY_CSVWRITER_INC
+
+#include <coopy/DataSheet.h>
+#include <coopy/SheetStyle.h>
+
+#include <stdio.h>
+
+#include <string>
+
+namespace coopy {
+  namespace store {
+    class CsvWriter;
+  }
+}
+
+/**
+ *
+ * Encodes tables as CSV a row at a time.  Output goes either to a file,
+ * through a buffer that is written out whenever it fills, or straight
+ * onto the end of a string.  Tables are never rendered into a string
+ * of their own first, so writing a large table to a file does not
+ * need a second copy of it in memory.
+ *
+ * The text produced is the same as DataSheet::encode, which is built
+ * on this class.
+ *
+ */
+class coopy::store::CsvWriter {
+public:
+  CsvWriter(FILE *fp, const SheetStyle& style);
+
+  CsvWriter(std::string *output, const SheetStyle& style);
+
+  ~CsvWriter() {
+    flush();
+  }
+
+  /**
+   *
+   * Add a cell to the current row.
+   *
+   */
+  void addCell(const SheetCellView& c);
+
+  /**
+   *
+   * End the current row.  Set last if no rows will follow, so that
+   * the style can decide whether the file ends with a line break.
+   *
+   */
+  void addRow(bool last = false);
+
+  /**
+   *
+   * Add all the rows of a table.
+   *
+   */
+  void addSheet(const DataSheet& sheet);
+
+  /**
+   *
+   * Write out anything buffered.  Returns false on a write error.
+   *
+   */
+  bool flush();
+
+private:
+  FILE *fp;
+  std::string buffer;
+  std::string *out;
+  SheetStyle style;
+  std::string delim;
+  std::string eol;
+  std::string nil;
+  bool have_null;
+  bool colliding;
+  bool trim;
+  bool ok;
+  int cells;
+  size_t row_start;
+  std::string line_buf;
+  // characters that mean a cell needs quoting
+  bool special[256];
+
+  void init(const SheetStyle& style);
+
+  char delimChar() const {
+    // an empty delimiter still makes nuls special, as it always has
+    return (delim.length()>0)?delim[0]:'\0';
+  }
+
+  int findSpecial(const char *str, int len) const;
+
+  void addQuoted(const char *str, int len, bool prefix);
+
+  CsvWriter(const CsvWriter& alt);
+  const CsvWriter& operator=(const CsvWriter& alt);
+};
+
+#endif
@@ -9,6 +9,7 @@
 #include <coopy/RefCount.h>
 #include <coopy/SheetCell.h>
 #include <coopy/Appearance.h>
+#include <coopy/Hasher.h>
 
 #include <string>
 #include <vector>
@@ -16,6 +17,8 @@
 namespace coopy {
   namespace store {
     class RowCache;
+    class RowBlock;
+    class RowDigests;
     class DataSheet;
     class SheetRow;
     class OrderedSheetRow;
@@ -45,6 +48,78 @@ public:
 };
 
 
+/**
+ *
+ * Reusable buffer for reading a block of whole rows from a table at
+ * once, see DataSheet::readRows.  Cells are views that point either
+ * into the table's own storage or into strings held by the block, so
+ * they are valid until the table is modified or the block is reused.
+ * Rows are addressed with the same row numbers as in the table.
+ *
+ */
+class coopy::store::RowBlock {
+public:
+  int y0;
+  int w;
+  int h;
+  bool hasMeta;
+  std::vector<SheetCellView> cells;
+  std::vector<std::string> store;
+  std::vector<Poly<SheetCellMeta> > meta;
+
+  static const int DEFAULT_HEIGHT = 256;
+
+  RowBlock() {
+    y0 = w = h = 0;
+    hasMeta = false;
+  }
+
+  void reset(int y0, int w, int h) {
+    this->y0 = y0;
+    this->w = w;
+    this->h = h;
+    hasMeta = false;
+    if ((int)cells.size()<w*h) {
+      cells.resize(w*h);
+      store.resize(w*h);
+    }
+  }
+
+  bool contains(int y) const {
+    return y>=y0 && y<y0+h;
+  }
+
+  const SheetCellView& cell(int x, int y) const {
+    return cells[(y-y0)*w+x];
+  }
+
+  SheetCellView& cell(int x, int y) {
+    return cells[(y-y0)*w+x];
+  }
+
+  std::string& scratch(int x, int y) {
+    return store[(y-y0)*w+x];
+  }
+
+  void setMeta(int x, int y, const Poly<SheetCellMeta>& m) {
+    if (!hasMeta) {
+      meta.clear();
+      meta.resize(w*h);
+      hasMeta = true;
+    }
+    meta[(y-y0)*w+x] = m;
+  }
+
+  SheetCell summary(int x, int y) const {
+    const SheetCellView& v = cell(x,y);
+    SheetCell c(v.text(),v.escaped);
+    if (hasMeta) {
+      c.meta = meta[(y-y0)*w+x];
+    }
+    return c;
+  }
+};
+
 /**
  *
  * An abstract table.  
@@ -55,6 +130,7 @@ public:
   DataSheet() {
     pool = 0 /*NULL*/;
     meta_hint = 0 /*NULL*/;
+    hash_cache_kind = Hasher::HASH_SHA1;
   }
 
   virtual ~DataSheet();
@@ -103,6 +179,33 @@ public:
     return c;
   }
 
+  /**
+   *
+   * @return a view of the contents of cell in column x, row y, without
+   * copying it where the sheet can avoid that.  The view points either
+   * into the sheet's own storage or into the supplied scratch string,
+   * and is only valid until the next change to either.  Cell metadata
+   * is not included, use cellSummary for that.
+   *
+   */
+  virtual SheetCellView cellView(int x, int y, std::string& scratch) const {
+    bool escaped = false;
+    scratch = cellString(x,y,escaped);
+    return SheetCellView(scratch,escaped);
+  }
+
+  /**
+   *
+   * Read rows y0 to y0+count-1, all columns, into a reusable buffer.
+   * This is cheaper than reading cell by cell for tables that have
+   * a wrapper or a database between them and their data.
+   *
+   * @return the number of rows actually read, which is less than
+   * count near the end of the table
+   *
+   */
+  virtual int readRows(int y0, int count, RowBlock& block) const;
+
   /**
    *
    * sets the contents of cell in column x, row y to a specified string value
@@ -180,6 +283,9 @@ public:
    * Encode a cell value as text using a specified style.
    *
    */
+  static std::string encodeCell(const SheetCellView& str, 
+				const SheetStyle& style);
+
   static std::string encodeCell(const SheetCell& str, 
 				const SheetStyle& style);
 
@@ -235,6 +341,34 @@ public:
     return true;
   }
 
+  /**
+   *
+   * Delete a set of rows, given as row numbers in increasing order
+   * (numbered as before any are deleted).  Tables stored as arrays
+   * should override this to close up the gaps in a single pass.
+   *
+   */
+  virtual bool deleteRowSet(const std::vector<int>& rows) {
+    for (int i=1; i<(int)rows.size(); i++) {
+      if (rows[i]<=rows[i-1]) return false;
+    }
+    for (int i=(int)rows.size()-1; i>=0; i--) {
+      if (!deleteRow(RowRef(rows[i]))) return false;
+    }
+    return true;
+  }
+
+  /**
+   *
+   * Rearrange rows so that row i holds what was row order[i].  Rows
+   * not listed are removed.  An order that lists a row twice or a
+   * row out of range is refused before any row changes.  The default
+   * works through deleteRowSet and moveRow; tables stored as arrays
+   * should override this to place every row in a single pass.
+   *
+   */
+  virtual bool reorderRows(const std::vector<int>& order);
+
   virtual bool hasDimension() const {
     return true;
   }
@@ -312,9 +446,18 @@ public:
     return output;
   }
 
-  virtual std::string getHash(bool cache=false) const;
+  /**
+   *
+   * Digest of the table's content, of the given kind (see Hasher).
+   * SHA-1 digests agree with those computed by other means, for
+   * example by a database; FAST digests are only good for comparing
+   * tables within the process.
+   *
+   */
+  virtual std::string getHash(bool cache=false, 
+			      int kind = Hasher::HASH_SHA1) const;
 
-  virtual std::string getRawHash() const {
+  virtual std::string getRawHash(int kind = Hasher::HASH_SHA1) const {
     return "";
   }
 
@@ -335,6 +478,42 @@ public:
     return true;
   }
 
+  // const accessors (cellView, readRows, ...) may safely be called
+  // from several threads at once
+  virtual bool canReadConcurrently() const {
+    return false;
+  }
+
+  /**
+   *
+   * Bring up to date the per-row digests the table keeps as it is
+   * modified, if it does that (see getRowDigests).  This writes to
+   * the digests, so it must not run at the same time as anything
+   * else using this table, or another view of the same stored table
+   * (see dataTail).
+   *
+   * @return true if the table keeps row digests
+   *
+   */
+  virtual bool updateRowDigests() {
+    return false;
+  }
+
+  /**
+   *
+   * Per-row digests kept by the table, as of the last call to
+   * updateRowDigests.  Row y of this table is row y+offset of the
+   * digests.  Only reads, so digests may be read from any thread
+   * until the table is next modified.
+   *
+   * @return the digests, or NULL if the table does not keep them or
+   * has changed since they were last brought up to date
+   *
+   */
+  virtual const RowDigests *getRowDigests(int& offset) const {
+    return 0/*NULL*/;
+  }
+
   virtual DataSheet *getNestedSheet(int x, int y) {
     return 0/*NULL*/; 
   }
@@ -395,6 +574,7 @@ public:
 
 private:
   std::string hash_cache;
+  int hash_cache_kind;
   SheetSchema *meta_hint;
   Pool *pool;
 };
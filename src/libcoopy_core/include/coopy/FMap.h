@@ -2,6 +2,8 @@
 #define COOPY_FMAP
 
 #include <string>
+#include <vector>
+#include <algorithm>
 
 #include <coopy/FVal.h>
 #include <coopy/Dbg.h>
@@ -11,6 +13,7 @@
 namespace coopy {
   namespace cmp {
     typedef std::string Feature;
+    template <class FVal> class FHashTable;
     template <class FVal> class FPolyMap;
     typedef FPolyMap<FSingleVal> FMap;
     typedef FPolyMap<FMultiVal> FMultiMap;
@@ -18,6 +21,82 @@ namespace coopy {
 }
 
 
+/**
+ *
+ * Open-addressing table from 64-bit feature hashes to feature values.
+ * A key of zero marks an empty slot.
+ *
+ */
+template <class FVal>
+class coopy::cmp::FHashTable {
+public:
+  std::vector<unsigned long long> keys;
+  std::vector<FVal> vals;
+  int count;
+
+  FHashTable() {
+    count = 0;
+  }
+
+  // Storage is kept if well used, since the table is usually
+  // refilled with about as many features as before.
+  void clear() {
+    if ((size_t)count*8<keys.size()) {
+      keys.clear();
+      vals.clear();
+    } else if (count>0) {
+      std::fill(keys.begin(),keys.end(),0);
+      std::fill(vals.begin(),vals.end(),FVal());
+    }
+    count = 0;
+  }
+
+  FVal *find(unsigned long long key) {
+    if (keys.empty()) return 0/*NULL*/;
+    size_t mask = keys.size()-1;
+    size_t at = (size_t)(key&mask);
+    while (keys[at]!=0) {
+      if (keys[at]==key) return &vals[at];
+      at = (at+1)&mask;
+    }
+    return 0/*NULL*/;
+  }
+
+  // key must not be present already
+  FVal& insert(unsigned long long key) {
+    if ((size_t)(count+1)*2>keys.size()) grow();
+    size_t mask = keys.size()-1;
+    size_t at = (size_t)(key&mask);
+    while (keys[at]!=0) {
+      at = (at+1)&mask;
+    }
+    keys[at] = key;
+    count++;
+    return vals[at];
+  }
+
+private:
+  void grow() {
+    std::vector<unsigned long long> prev_keys;
+    std::vector<FVal> prev_vals;
+    prev_keys.swap(keys);
+    prev_vals.swap(vals);
+    size_t n = prev_keys.empty()?1024:prev_keys.size()*2;
+    keys.resize(n,0);
+    vals.resize(n);
+    size_t mask = n-1;
+    for (size_t i=0; i<prev_keys.size(); i++) {
+      if (prev_keys[i]==0) continue;
+      size_t at = (size_t)(prev_keys[i]&mask);
+      while (keys[at]!=0) {
+	at = (at+1)&mask;
+      }
+      keys[at] = prev_keys[i];
+      vals[at] = prev_vals[i];
+    }
+  }
+};
+
 template <class FVal>
 class coopy::cmp::FPolyMap {
 public:
@@ -28,11 +107,44 @@ public:
   coopy::store::SparseFloatSheet& rowMatch;
   bool query;
   int len;
+  std::string wrap, wrap_low, part, part_low;
+  bool hashed;
+  FHashTable<FVal> hf;
+  std::vector<unsigned long long> *collect;
+  // features numbered by a FeatureDictionary; an entry is only live
+  // if its stamp matches the current generation
+  std::vector<FVal> fid;
+  std::vector<int> stamp;
+  int generation;
 
   FPolyMap(coopy::store::SparseFloatSheet& sheet, int len) : rowMatch(sheet) {
     query = false;
     ct = 0;
     this->len = len;
+    hashed = false;
+    collect = 0/*NULL*/;
+    generation = 0;
+  }
+
+  /**
+   *
+   * Key features by a 64-bit hash of their text rather than by the
+   * text itself.  This avoids building a string per feature, at the
+   * cost of a (very small) chance of two features colliding.
+   *
+   */
+  void setHashed(bool flag) {
+    hashed = flag;
+  }
+
+  /**
+   *
+   * Divert feature hashes into a list, rather than adding or querying
+   * them.  Pass NULL to stop.
+   *
+   */
+  void setCollect(std::vector<unsigned long long> *collect) {
+    this->collect = collect;
   }
 
   coopy::store::FloatSheet& getMatch();
@@ -53,9 +165,11 @@ public:
 
   void resetCache() {
     f.clear();
+    hf.clear();
+    generation++;
   }
 
-  void queryBit(std::string txt) {
+  void queryBit(const std::string& txt) {
     typename Cache::iterator it = f.find(txt);
     if (it!=f.end()) {
       it->second.apply(rowMatch,ycurr);
@@ -64,12 +178,13 @@ public:
     summarize();
   }
 
-  void addBit(std::string txt, bool alt) {
-    if (f.find(Feature(txt))==f.end()) {
+  void addBit(const std::string& txt, bool alt) {
+    typename Cache::iterator it = f.find(txt);
+    if (it==f.end()) {
       if (alt) return;
-      f[Feature(txt)] = FVal();
+      it = f.insert(std::make_pair(Feature(txt),FVal())).first;
     }
-    FVal& val = f[Feature(txt)];
+    FVal& val = it->second;
     val.setIndex(ycurr,alt);
     if (!alt) {
       ct++;
@@ -85,28 +200,97 @@ public:
     }
   }
 
+  void applyKey(unsigned long long key, bool query, bool alt) {
+    if (collect) {
+      collect->push_back(key);
+      return;
+    }
+    FVal *val = hf.find(key);
+    if (query) {
+      if (val) val->apply(rowMatch,ycurr);
+      ct++;
+      summarize();
+      return;
+    }
+    if (!val) {
+      if (alt) return;
+      val = &hf.insert(key);
+    }
+    val->setIndex(ycurr,alt);
+    if (!alt) {
+      ct++;
+      summarize();
+    }
+  }
 
-  void add(std::string txt, bool query, bool alt, int ctrl) {
-    //printf("add %s %d %d\n", txt.c_str(), query, ctrl);
+  void applyId(int id, bool query, bool alt) {
+    bool live = id<(int)stamp.size() && stamp[id]==generation;
+    if (query) {
+      if (live) fid[id].apply(rowMatch,ycurr);
+      ct++;
+      summarize();
+      return;
+    }
+    if (!live) {
+      if (alt) return;
+      if (id>=(int)stamp.size()) {
+	stamp.resize(id+1,-1);
+	fid.resize(id+1);
+      }
+      stamp[id] = generation;
+      fid[id] = FVal();
+    }
+    fid[id].setIndex(ycurr,alt);
+    if (!alt) {
+      ct++;
+      summarize();
+    }
+  }
+
+  // Same features as add(), already numbered by a FeatureCache.
+  // These are kept apart from features added as text.
+  void addIds(const std::vector<int>& ids, bool query, bool alt) {
+    this->query = query;
+    for (size_t i=0; i<ids.size(); i++) {
+      applyId(ids[i],query,alt);
+    }
+  }
+
+
+  void add(const std::string& txt, bool query, bool alt, int ctrl) {
+    add(txt.c_str(),(int)txt.length(),query,alt,ctrl);
+  }
+
+  // Buffers for the text and its fragments are reused from call to
+  // call, since this is run for every cell of a table.
+  void add(const char *txt, int tlen, bool query, bool alt, int ctrl) {
+    //printf("add %s %d %d\n", txt, query, ctrl);
+    if (hashed||collect) {
+      addHashed(txt,tlen,query,alt,ctrl);
+      return;
+    }
     this->query = query;
-    applyBit(txt,query,alt);
+    part.assign(txt,tlen);
+    applyBit(part,query,alt);
     if (ctrl!=0) {
-      txt = std::string("^") + txt + "$";
-      int len = txt.length();
-      std::string txt_low = txt;
-      for (size_t c=0; c<txt_low.length(); c++) {
-	txt_low[c] = tolower(txt_low[c]);
+      wrap.assign(1,'^');
+      wrap.append(txt,tlen);
+      wrap += '$';
+      int len = wrap.length();
+      wrap_low = wrap;
+      for (size_t c=0; c<wrap_low.length(); c++) {
+	wrap_low[c] = tolower(wrap_low[c]);
       }
-      bool need_case = (txt_low!=txt);
+      bool need_case = (wrap_low!=wrap);
       int base = 8-ctrl*2;
       for (int k=base; k<10; k+=2) {
 	for (int i=0; i<len-k; i++){
-	  std::string part = txt.substr(i,k+1);
+	  part.assign(wrap,i,k+1);
 	  applyBit(part,query,alt);
 	  if (need_case) {
-	    std::string low = txt_low.substr(i,k+1);
-	    if (low!=part) {
-	      applyBit(low,query,alt);
+	    part_low.assign(wrap_low,i,k+1);
+	    if (part_low!=part) {
+	      applyBit(part_low,query,alt);
 	    }
 	  }
 	}
@@ -114,6 +298,46 @@ public:
     }
   }
 
+  // Same features as add(), but hashed.  Each n-gram window is hashed
+  // with a rolling polynomial hash, so equal text always gives an
+  // equal hash however it was reached, and the lower-cased copy is
+  // hashed alongside.
+  void addHashed(const char *txt, int tlen, bool query, bool alt, 
+		 int ctrl) {
+    this->query = query;
+    applyKey(featureKey(polyHash(txt,tlen),tlen),query,alt);
+    if (ctrl==0) return;
+    wrap.assign(1,'^');
+    wrap.append(txt,tlen);
+    wrap += '$';
+    int len = wrap.length();
+    wrap_low.resize(len);
+    bool need_case = foldCase(wrap.data(),&wrap_low[0],len);
+    const unsigned char *w = (const unsigned char *)wrap.data();
+    const unsigned char *wl = (const unsigned char *)wrap_low.data();
+    int base = 8-ctrl*2;
+    for (int k=base; k<10; k+=2) {
+      int n = k+1;
+      if (len-k<=0) continue;
+      unsigned long long top = 1;
+      for (int j=1; j<n; j++) top *= HASH_BASE;
+      unsigned long long h = polyHash(wrap.data(),n);
+      unsigned long long hl = need_case?polyHash(wrap_low.data(),n):h;
+      for (int i=0; i<len-k; i++) {
+	if (i>0) {
+	  h = (h-w[i-1]*top)*HASH_BASE+w[i+k];
+	  if (need_case) {
+	    hl = (hl-wl[i-1]*top)*HASH_BASE+wl[i+k];
+	  }
+	}
+	applyKey(featureKey(h,n),query,alt);
+	if (need_case && hl!=h) {
+	  applyKey(featureKey(hl,n),query,alt);
+	}
+      }
+    }
+  }
+
   static int getCtrlMax() { return 4; }
 
   void summarize(bool force = false) {
@@ -122,6 +346,41 @@ public:
     }
   }
 
+private:
+  static const unsigned long long HASH_BASE = 1099511628211ULL;
+
+  static unsigned long long polyHash(const char *txt, int len) {
+    const unsigned char *t = (const unsigned char *)txt;
+    unsigned long long h = 0;
+    for (int i=0; i<len; i++) {
+      h = h*HASH_BASE+t[i];
+    }
+    return h;
+  }
+
+  // mix in the length and spread the bits; zero is reserved
+  static unsigned long long featureKey(unsigned long long h, int len) {
+    unsigned long long x = h^(((unsigned long long)len)*0x9E3779B97F4A7C15ULL);
+    x = (x^(x>>30))*0xBF58476D1CE4E5B9ULL;
+    x = (x^(x>>27))*0x94D049BB133111EBULL;
+    x = x^(x>>31);
+    return (x==0)?1:x;
+  }
+
+  // ASCII lower-casing, written without branches so it vectorizes
+  static bool foldCase(const char *src, char *dest, int len) {
+    const unsigned char *s = (const unsigned char *)src;
+    unsigned char *d = (unsigned char *)dest;
+    unsigned char diff = 0;
+    for (int i=0; i<len; i++) {
+      unsigned char c = s[i];
+      unsigned char up = (unsigned char)((unsigned char)(c-'A')<26);
+      d[i] = c|(up<<5);
+      diff |= up;
+    }
+    return diff!=0;
+  }
+
 };
 
 
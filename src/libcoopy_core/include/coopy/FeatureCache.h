@@ -0,0 +1,132 @@
+#ifndef COOPY_FEATURECACHE
+#define COOPY_FEATURECACHE
+
+#include <coopy/SheetCell.h>
+#include <coopy/EfficientMap.h>
+
+#include <string>
+#include <vector>
+
+namespace coopy {
+  namespace cmp {
+    class FeatureDictionary;
+    class FeatureCache;
+  }
+}
+
+/**
+ *
+ * Numbers features densely from zero, so that per-pass tables of
+ * features can be plain arrays.  Shared by the caches of the tables
+ * being compared, so a feature gets the same number on both sides.
+ *
+ */
+class coopy::cmp::FeatureDictionary {
+public:
+  FeatureDictionary() {
+    used = 0;
+  }
+
+  int idOf(const std::string& feature) {
+    std::pair<efficient_map<std::string,int>::iterator,bool> r =
+      index.insert(std::make_pair(feature,size()));
+    if (r.second) {
+      used += feature.length()+ENTRY_BYTES;
+    }
+    return r.first->second;
+  }
+
+  int size() const {
+    return (int)index.size();
+  }
+
+  /**
+   *
+   * Rough count of the memory held by the features numbered so far.
+   *
+   */
+  size_t bytes() const {
+    return used;
+  }
+
+private:
+  // guess at the cost of a map entry beyond its text
+  static const size_t ENTRY_BYTES = 48;
+
+  efficient_map<std::string,int> index;
+  size_t used;
+};
+
+/**
+ *
+ * Text features of the cells of one table (see FPolyMap::add), as
+ * numbers from a dictionary, kept from one matching pass to the next.
+ * A cell is tokenized once per n-gram size, however many passes,
+ * control levels and normalization measures look at it; each higher
+ * control level only adds the sizes it needs.
+ *
+ * Features come in "slots".  Slot 0 is the whole text; slot s>0 is
+ * all n-grams of length 11-2s.  Control level 0 uses slot 0 only,
+ * and level c>0 uses slot 0 then slots c+1 down to 1, which is the
+ * order FPolyMap::add produces them in.
+ *
+ * Storage per cell stops growing at a fixed limit; features of cells
+ * beyond that are tokenized again on each request.  The same limit
+ * applies to the dictionary, which grows with every new feature, so
+ * once full() callers should stop asking for features and go back to
+ * handling cell text directly.
+ *
+ */
+class coopy::cmp::FeatureCache {
+public:
+  FeatureCache(FeatureDictionary& dict) : dict(dict) {
+    limit = DEFAULT_LIMIT;
+    used = 0;
+  }
+
+  static const int SLOTS = 6;
+
+  // bytes
+  static const size_t DEFAULT_LIMIT = 128*1024*1024;
+
+  void setLimit(size_t limit) {
+    this->limit = limit;
+  }
+
+  /**
+   *
+   * Check whether this cache and its dictionary have reached the limit.
+   *
+   */
+  bool full() const {
+    return used+dict.bytes()>=limit;
+  }
+
+  /**
+   *
+   * Set out to the features of cell (x,y), whose text is v, for
+   * control level ctrl.
+   *
+   */
+  void get(const coopy::store::SheetCellView& v, int x, int y, int ctrl,
+	   std::vector<int>& out);
+
+private:
+  FeatureDictionary& dict;
+  std::string wrap, wrap_low, part, part_low;
+  // per column and slot, where each row's features start in ids
+  // (-1 if not stored)
+  std::vector<std::vector<int> > starts;
+  // for each stored cell and slot, a count followed by that many ids
+  std::vector<int> ids;
+  size_t limit;
+  size_t used;
+
+  void getSlot(const coopy::store::SheetCellView& v, int x, int y, 
+	       int slot, std::vector<int>& out);
+
+  void tokenize(const coopy::store::SheetCellView& v, int slot, 
+		std::vector<int>& out);
+};
+
+#endif
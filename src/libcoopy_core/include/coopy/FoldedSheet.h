@@ -78,6 +78,16 @@ public:
 
   virtual coopy::store::SheetCell cellSummary(int x, int y) const;
 
+  virtual coopy::store::SheetCellView cellView(int x, int y, 
+					       std::string& scratch) const {
+    const FoldedCell& c = cell(x,y);
+    if (!c.sheet) return coopy::store::SheetCellView(c.datum);
+    return coopy::store::DataSheet::cellView(x,y,scratch);
+  }
+
+  virtual int readRows(int y0, int count, 
+		       coopy::store::RowBlock& block) const;
+
   virtual bool cellSummary(int x, int y, const coopy::store::SheetCell& c) {
     FoldedCell& c2 = cell(x,y);
     c2.datum = c;
@@ -0,0 +1,144 @@
+#ifndef COOPY_HASHER_INC
+#define COOPY_HASHER_INC
+
+#include <coopy/Sha1Generator.h>
+
+#include <string>
+
+namespace coopy {
+  namespace store {
+    class FastHasher;
+    class Hasher;
+  }
+}
+
+/**
+ *
+ * Incremental non-cryptographic 128-bit hash, for telling apart data
+ * within a single process.  Much cheaper than SHA-1, but the digest
+ * is not stable across versions and should not be stored.
+ *
+ */
+class coopy::store::FastHasher {
+public:
+  FastHasher() {
+    reset();
+  }
+
+  void reset();
+
+  void add(const std::string& str) {
+    add(str.c_str(),str.length());
+  }
+
+  void add(const char *txt, int len);
+
+  /**
+   *
+   * Finish, giving the two 64-bit halves of the digest, and reset.
+   *
+   */
+  void finish(unsigned long long& lo, unsigned long long& hi);
+
+  /**
+   *
+   * Finish, giving a 64-bit digest, and reset.
+   *
+   */
+  unsigned long long finish64() {
+    unsigned long long lo, hi;
+    finish(lo,hi);
+    return lo;
+  }
+
+  /**
+   *
+   * Return the digest in base 16, and reset.
+   *
+   */
+  std::string finish();
+
+private:
+  unsigned long long h1, h2;
+  unsigned long long total;
+  unsigned char pending[8];
+  int npending;
+
+  void mix(unsigned long long word);
+};
+
+/**
+ *
+ * Incremental hash of a chosen kind: SHA-1, for digests that may be
+ * compared with ones computed elsewhere, or FAST, for digests that
+ * are only compared within the process.  Each instance carries its
+ * own state.
+ *
+ */
+class coopy::store::Hasher {
+public:
+  enum {
+    HASH_SHA1 = 0,
+    HASH_FAST = 1
+  };
+
+  Hasher(int kind = HASH_SHA1) {
+    this->kind = kind;
+  }
+
+  int getKind() const {
+    return kind;
+  }
+
+  /**
+   *
+   * Switch to a different kind of hash.  Anything added so far, to a
+   * hash of either kind, is discarded.
+   *
+   */
+  void setKind(int kind) {
+    this->kind = kind;
+    sha1.reset();
+    fast.reset();
+  }
+
+  void reset() {
+    if (kind==HASH_FAST) {
+      fast.reset();
+    } else {
+      sha1.reset();
+    }
+  }
+
+  void add(const std::string& str) {
+    add(str.c_str(),str.length());
+  }
+
+  void add(const char *txt, int len) {
+    if (kind==HASH_FAST) {
+      fast.add(txt,len);
+    } else {
+      sha1.add(txt,len);
+    }
+  }
+
+  /**
+   *
+   * Return the digest in base 16 (40 digits for SHA-1, 32 for FAST),
+   * and reset for the next round.
+   *
+   */
+  std::string finish() {
+    if (kind==HASH_FAST) {
+      return fast.finish();
+    }
+    return sha1.finish();
+  }
+
+private:
+  int kind;
+  Sha1Generator sha1;
+  FastHasher fast;
+};
+
+#endif
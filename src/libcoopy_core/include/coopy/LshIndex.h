@@ -0,0 +1,83 @@
+#ifndef COOPY_LSHINDEX
+#define COOPY_LSHINDEX
+
+#include <coopy/SparseSheet.h>
+#include <coopy/EfficientMap.h>
+
+#include <vector>
+
+namespace coopy {
+  namespace cmp {
+    class LshIndex;
+  }
+}
+
+/**
+ *
+ * Locality-sensitive index of rows, for fuzzy row matching.  Each row
+ * is signed with a MinHash over the hashes of its features.  The
+ * signature is cut into bands, and rows are bucketed by band.  A query
+ * row is only scored against rows that share at least one bucket,
+ * rather than against every row that shares any feature.  From a
+ * bucket too common to be telling, only the rows nearest the query row
+ * in order are taken.
+ *
+ * The score added to the match matrix for a candidate pair is the
+ * estimated number of features they share, which is on the same scale
+ * as the scores FMultiMap produces for rare features.
+ *
+ */
+class coopy::cmp::LshIndex {
+public:
+  LshIndex() {
+    bands = 0;
+    rows = 2;
+  }
+
+  /**
+   *
+   * Set the number of bands, and the number of signature values per
+   * band.  Zero bands disables the index.
+   *
+   */
+  void setSize(int bands, int rows);
+
+  bool isActive() const {
+    return bands>0;
+  }
+
+  void clear();
+
+  /**
+   *
+   * Index row y by its features.  The feature list is sorted and
+   * deduplicated in place.
+   *
+   */
+  void add(int y, std::vector<unsigned long long>& features);
+
+  /**
+   *
+   * Score query row y against all indexed rows colliding with it in
+   * some band.  Scores go into match.cell(indexed row, y).
+   *
+   */
+  void query(int y, std::vector<unsigned long long>& features,
+	     coopy::store::SparseFloatSheet& match);
+
+private:
+  int bands;
+  int rows;
+  efficient_map<unsigned long long, std::vector<int> > buckets;
+  std::vector<unsigned long long> sigs;
+  std::vector<int> sizes;
+  std::vector<unsigned long long> sig;
+  std::vector<int> seen;
+  std::vector<int> candidates;
+
+  void sign(std::vector<unsigned long long>& features);
+
+  unsigned long long bandKey(const unsigned long long *s, int band) const;
+};
+
+#endif
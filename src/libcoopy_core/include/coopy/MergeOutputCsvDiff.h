@@ -31,12 +31,33 @@ public:
   std::vector<std::string> columns;
   bool showedColumns;
 
+  // Compact rows that cover the same columns as the row before them
+  // keep showForSelect/showForDescribe in vectors, by position in
+  // compactOrder, rather than in the maps.  While compactMode is set
+  // the vectors are the ones to trust.
+  coopy::store::Poly<RowChangeNames> compactColumns;
+  std::vector<int> compactOrder;
+  std::vector<char> compactSelect, compactDescribe, compactActive;
+  std::vector<char> compactPrevSelect, compactPrevDescribe;
+  bool compactReady;
+  bool compactMode;
+
   MergeOutputCsvDiff();
 
   virtual bool wantDiff() { return true; }
 
   virtual bool changeColumn(const OrderChange& change);
   virtual bool changeRow(const RowChange& change);
+  virtual bool changeCompactRow(const CompactRowChange& change);
+
+  bool changeNamedRow(const RowChange& change);
+
+  bool enterCompact(const CompactRowChange& change);
+  bool leaveCompact();
+
+  bool operateRow(const CompactRowChange& change, const char *tag);
+  bool updateRow(const CompactRowChange& change, const char *tag, 
+		 bool select, bool update, bool practice);
 
   bool operateRow(const RowChange& change, const char *tag);
   bool updateRow(const RowChange& change, const char *tag, bool select, 
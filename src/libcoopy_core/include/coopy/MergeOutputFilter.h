@@ -6,6 +6,7 @@
 #include <string>
 #include <list>
 #include <map>
+#include <vector>
 
 namespace coopy {
   namespace cmp {
@@ -40,10 +41,28 @@ class coopy::cmp::RowUnit {
 public:
   std::string sheet_name;
   RowChange change;
+  // rows received in compact form are kept that way, in compact_change
+  bool compact;
+  CompactRowChange compact_change;
 
   RowUnit(const std::string& sheet_name, const RowChange& change) :
     sheet_name(sheet_name),
-    change(change) {
+    change(change),
+    compact(false) {
+  }
+
+  RowUnit(const std::string& sheet_name, const CompactRowChange& change) :
+    sheet_name(sheet_name),
+    compact(true),
+    compact_change(change) {
+  }
+
+  int mode() const {
+    return compact?compact_change.mode:change.mode;
+  }
+
+  bool conflicted() const {
+    return compact?compact_change.conflicted:change.conflicted;
   }
 };
 
@@ -51,7 +70,7 @@ public:
   changeConfig: pass through
   changePool, changeColumn, changeName: cache verbatim per sheet
     order - changename1 changecolumns changename2 changepools
-  changeRow: stack + release
+  changeRow, changeCompactRow: stack + release
  */
 class coopy::cmp::MergeOutputFilter : public MergeOutput {
 private:
@@ -99,6 +118,10 @@ public:
 
   virtual bool changeRow(const RowChange& change);
 
+  virtual bool changeCompactRow(const CompactRowChange& change);
+
+  bool acceptRow(int mode, const std::vector<std::string>& allNames);
+
   virtual bool changePool(const PoolChange& change) { 
     if (!isActiveTable()) return false;
     if (!getFlags().canSchema()) return false;
@@ -135,6 +158,8 @@ public:
 
   bool emitRow(const RowUnit& row);
 
+  bool emitCompactRow(const CompactRowChange& change);
+
   bool isActiveTable() {
     if (desired_sheets.size()==0) return true;
     return desired_sheets.find(sheet_name)!=desired_sheets.end();
@@ -24,6 +24,7 @@ public:
   virtual bool wantDiff() { return true; }
   virtual bool changeColumn(const OrderChange& change);
   virtual bool changeRow(const RowChange& change);
+  virtual bool changeCompactRow(const CompactRowChange& change);
 
   virtual bool mergeStart();
   virtual bool mergeDone();
@@ -17,13 +17,21 @@ private:
   std::string sheet_name;
   std::vector<std::string> ids;
   coopy::store::PolySheet ops;
+  // numbers of ids within idColumns, -1 where absent
+  std::vector<int> idNumbers;
+  coopy::store::Poly<RowChangeNames> idColumns;
+
+  bool startOps(const std::vector<std::string>& allNames);
+  coopy::store::Poly<coopy::store::SheetRow> startRow(int mode);
 public:
   virtual bool wantDiff() { return true; }
   virtual bool changeRow(const RowChange& change);
+  virtual bool changeCompactRow(const CompactRowChange& change);
 
   virtual bool setSheet(const char *name) {
     sheet_name = name;
     ops.clear();
+    idColumns.clear();
     return true;
   }
 
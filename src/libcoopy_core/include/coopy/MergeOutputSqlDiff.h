@@ -5,6 +5,7 @@
 #include <coopy/Dbg.h>
 
 #include <string>
+#include <vector>
 
 namespace coopy {
   namespace cmp {
@@ -25,6 +26,12 @@ public:
 class coopy::cmp::MergeOutputSqlDiff : public MergeOutput {
 private:
   std::string sheet_name;
+  // ids of sortedColumns, in order of their names
+  std::vector<int> sorted;
+  coopy::store::Poly<RowChangeNames> sortedColumns;
+
+  SqlText getText(const CompactRowChange& change);
+  bool emitRow(int mode, const SqlText& text);
 public:
   MergeOutputSqlDiff() {
     sheet_name = coopy_get_default_table_name();
@@ -33,6 +40,7 @@ public:
   virtual bool wantDiff() { return true; }
   virtual bool changeColumn(const OrderChange& change);
   virtual bool changeRow(const RowChange& change);
+  virtual bool changeCompactRow(const CompactRowChange& change);
 
   virtual bool setSheet(const char *name) { 
     sheet_name = name;
@@ -20,6 +20,8 @@ private:
   bool active;
   int ct_col, ct_col_insert, ct_col_delete, ct_col_move, ct_col_rename;
   int ct_row, ct_row_insert, ct_row_delete, ct_row_move, ct_row_update;
+
+  bool countRow(int mode);
 public:
   MergeOutputStats() {
     active = false;
@@ -30,6 +32,7 @@ public:
 
   virtual bool changeColumn(const OrderChange& change);
   virtual bool changeRow(const RowChange& change);
+  virtual bool changeCompactRow(const CompactRowChange& change);
 
   virtual bool setSheet(const char *name) {
     sheet_name = name;
@@ -4,7 +4,7 @@
 #include <coopy/MergeOutput.h>
 #include <coopy/Viterbi.h>
 
-#include <map>
+#include <vector>
 
 namespace coopy {
   namespace cmp {
@@ -14,16 +14,19 @@ namespace coopy {
 
 class coopy::cmp::MergeOutputTdiff : public MergeOutput {
 public:
-  std::vector<std::string> ops;
-  std::vector<std::string> opsLoose;
-  //std::vector<std::string> nops;
-  std::map<std::string,bool> activeColumn;
-  std::map<std::string,bool> showForSelect;
-  std::map<std::string,bool> showForDescribe;
-  std::map<std::string,bool> showForCond;
-  std::map<std::string,bool> prevSelect;
-  std::map<std::string,bool> prevDescribe;
-  std::map<std::string,bool> prevCond;
+  enum {
+    SHOW_ACTIVE = 1,
+    SHOW_SELECT = 2,
+    SHOW_DESCRIBE = 4,
+    SHOW_COND = 8,
+  };
+
+  // form of the last row header: a column number per column, negated
+  // (less one) for columns not shown
+  std::vector<int> ops;
+  coopy::store::Poly<RowChangeNames> opsColumns;
+  // how each column of the current row is shown, by column number
+  std::vector<unsigned char> show;
   bool constantColumns;
   std::vector<std::string> columns;
   bool showedColumns;
@@ -32,31 +35,36 @@ public:
   bool sheetNameBreakShown;
   bool lastWasFactored;
 
-  std::vector<coopy::cmp::RowChange> rowCache;
+  std::vector<coopy::cmp::CompactRowChange> rowCache;
   coopy::cmp::Viterbi formLattice;
 
   MergeOutputTdiff();
 
-  bool check(std::map<std::string,bool>& m, const std::string& name) {
-    if (m.find(name)==m.end()) return false;
-    return m[name];
+  bool check(int id, int flag) const {
+    if (id<0||id>=(int)show.size()) return false;
+    return (show[id]&flag)!=0;
   }
 
   virtual bool wantDiff() { return true; }
 
   virtual bool changeColumn(const OrderChange& change);
   virtual bool changeRow(const RowChange& change) {
-    //rowCache.push_back(change);
+    CompactRowChange compact;
+    compact.fromRowChange(change);
+    changeRow(compact,false,true);
+    return true;
+  }
+
+  virtual bool changeCompactRow(const CompactRowChange& change) {
     changeRow(change,false,true);
     return true;
   }
 
-  bool changeRow(const RowChange& change, bool factored, bool caching);
+  bool changeRow(const CompactRowChange& change, bool factored, bool caching);
 
-  bool operateRow(const RowChange& change, const char *tag);
-  bool updateRow(const RowChange& change, const char *tag, bool select, 
-		 bool update, bool practice, bool factored);
-  //bool describeRow(const RowChange& change, const char *tag, bool factored);
+  bool operateRow(const CompactRowChange& change, const char *tag);
+  bool updateRow(const CompactRowChange& change, const char *tag,
+		 bool select, bool update, bool practice, bool factored);
 
   virtual bool mergeStart();
   virtual bool mergeDone();
@@ -70,6 +78,13 @@ public:
   void flushRows();
 
   virtual bool changePool(const PoolChange& change);
+
+private:
+  bool sameOps(const std::vector<int>& lops,
+	       const CompactRowChange& change) const;
+
+  std::string opsText(const std::vector<int>& lops,
+		      const CompactRowChange& change) const;
 };
 
 #endif
@@ -8,6 +8,7 @@
 #include <coopy/CompareFlags.h>
 #include <coopy/NameSniffer.h>
 #include <coopy/EfficientMap.h>
+#include <coopy/TypedColumns.h>
 
 #include <vector>
 #include <set>
@@ -16,6 +17,7 @@ namespace coopy {
   namespace cmp {
     class Merger;
     class MergerState;
+    class MergeRowResult;
   }
 }
 
@@ -33,6 +35,11 @@ public:
   coopy::store::NameSniffer& local_names;
   coopy::store::NameSniffer& remote_names;
   bool allIdentical;
+  // with typed comparison, the tables read by type (see TypedColumns);
+  // the same cache may serve several tables if they are one
+  const TypedColumns *typed_pivot;
+  const TypedColumns *typed_local;
+  const TypedColumns *typed_remote;
 
   MergerState(coopy::store::DataSheet& pivot,
 	      coopy::store::DataSheet& local,
@@ -52,6 +59,27 @@ public:
     flags(flags),
     local_names(local_names), remote_names(remote_names) {
       allIdentical = false;
+      typed_pivot = typed_local = typed_remote = 0/*NULL*/;
+  }
+};
+
+/**
+ *
+ * The cells of one row compared across pivot, local and remote, before
+ * the row is placed in the output.  See Merger::evaluateRow.
+ *
+ */
+class coopy::cmp::MergeRowResult {
+public:
+  // conditions and values, with no columns attached yet
+  CompactRowChange change;
+  // number of cells in conflict
+  int conflicts;
+  // notes on conflicts, for stderr
+  std::string messages;
+
+  MergeRowResult() {
+    conflicts = 0;
   }
 };
 
@@ -59,6 +87,9 @@ class coopy::cmp::Merger {
 
 public:
   Merger() {
+    pivot_stored = remote_stored = false;
+    typed_local = typed_remote = typed_pivot = 0/*NULL*/;
+    blank_column = -1;
   }
 
   bool merge(MergerState& state);
@@ -68,28 +99,95 @@ public:
 		coopy::store::DataSheet& remote,
 		MatchUnit& row_unit, Patcher& output,
 		const CompareFlags& flags,
-		std::vector<coopy::cmp::RowChange>& rc);
+		std::vector<coopy::cmp::CompactRowChange>& rc);
+
+  /**
+   *
+   * First half of mergeRow: compare the cells of a row.  Depends only
+   * on the row, and only reads the sheets and the merger, so rows may
+   * be evaluated in any order, or on several threads at once given
+   * separate blocks and results.  The result should be fresh.
+   *
+   */
+  void evaluateRow(const coopy::store::DataSheet& pivot, 
+		   const coopy::store::DataSheet& local, 
+		   const coopy::store::DataSheet& remote,
+		   const MatchUnit& row_unit,
+		   const CompareFlags& flags,
+		   bool diff,
+		   coopy::store::RowBlock& pivot_block,
+		   coopy::store::RowBlock& local_block,
+		   coopy::store::RowBlock& remote_block,
+		   MergeRowResult& result) const;
+
+  /**
+   *
+   * Second half of mergeRow: place an evaluated row in the output,
+   * with any context and moves it needs.  Rows must be committed in
+   * order.
+   *
+   */
+  void commitRow(const coopy::store::DataSheet& pivot, 
+		 const MatchUnit& row_unit,
+		 Patcher& output,
+		 const CompareFlags& flags,
+		 MergeRowResult& result,
+		 std::vector<coopy::cmp::CompactRowChange>& rc);
 
 private:
+  // number of the at-th column of names, see RowChangeNames
+  int columnId(const std::vector<int>& ids, int at) const {
+    if (at<(int)ids.size()) return ids[at];
+    return blank_column;
+  }
+
+  // add the unnamed column, if rows have more columns than names,
+  // so that evaluating rows never changes column_names
+  void prepareColumns();
+
+  // threads to evaluate rows of a diff on, see evaluateRow
+  int mergeThreads(const CompareFlags& flags,
+		   const coopy::store::DataSheet& pivot,
+		   const coopy::store::DataSheet& local,
+		   const coopy::store::DataSheet& remote) const;
+
+  // mergeRow for every row of a diff, evaluating rows on threads
+  void mergeRows(coopy::store::DataSheet& pivot, 
+		 coopy::store::DataSheet& local, 
+		 coopy::store::DataSheet& remote,
+		 Patcher& output,
+		 const CompareFlags& flags,
+		 int threads,
+		 std::vector<coopy::cmp::CompactRowChange>& rc);
+
   OrderMerge row_merge;
   OrderMerge col_merge;
   int conflicts;
-  std::vector<std::string> lastAddress;
-  std::vector<std::string> lastAction;
   std::vector<std::string> names;
+  coopy::store::Poly<RowChangeNames> column_names;
+  int blank_column;
   std::set<std::string> filtered_names;
   int last_local_row;
   int last_local_row_marked;
   int bottom_local_row;
-  RowChange lastRowChange;
+  CompactRowChange lastRowChange;
   bool had_row;
   bool had_foreign_row;
   efficient_map<std::string,int> include_column;
   efficient_map<std::string,int> exclude_column;
 
+  coopy::store::RowBlock local_block;
+  coopy::store::RowBlock remote_block;
+  coopy::store::RowBlock pivot_block;
+
+  const TypedColumns *typed_local;
+  const TypedColumns *typed_remote;
+  const TypedColumns *typed_pivot;
+  bool pivot_stored;
+  bool remote_stored;
+
   int current_row;
   int last_row;
-  int addition;
   bool allGone;
   //SheetSchema defaultSheetSchema;
   //SheetSchema *pivotSheetSchema;
@@ -3,11 +3,10 @@
 
 #include <coopy/OrderResult.h>
 #include <coopy/CsvSheet.h>
-#include <coopy/OrderResult.h>
 #include <coopy/MatchUnit.h>
 #include <coopy/CompareFlags.h>
 
-#include <list>
+#include <vector>
 
 namespace coopy {
   namespace cmp {
@@ -15,19 +14,41 @@ namespace coopy {
   }
 }
 
+/**
+ *
+ * Merge the order of units (rows or columns) of a local and remote
+ * table, each aligned against a common pivot.  The result is a
+ * sequence of MatchUnits in accum.
+ *
+ * The first pass, process(), is a single walk over local then remote
+ * units, O(L+R).  When order matters, accum is then rebuilt in
+ * remote order, with units that are new locally, or that local moved
+ * relative to the pivot, placed after the unit before them in local
+ * order.  Units local moved are those off a longest increasing run of
+ * pivot numbers in local order, found by patience sorting, so the
+ * whole merge is O(n log n) however the rows are shuffled.
+ *
+ */
 class coopy::cmp::OrderMerge {
 public:
   OrderResult order_local, order_remote;
-  std::list<MatchUnit> accum;
+  std::vector<MatchUnit> accum;
   int overlap;
-  coopy::store::IntSheet xlocal, xremote;
+  std::vector<unsigned char> xlocal, xremote;
   int start_local;
   int start_remote;
   CompareFlags flags;
 
-  void process(int ilocal, int iremote,
-	       int& base_local, int& base_remote,
-	       int stop_local, int stop_remote);
+  /**
+   *
+   * Visit local units in order, then any remote units not yet placed.
+   * Remote-only units are placed just before the first local unit
+   * they precede in the remote order.
+   *
+   */
+  void process(int stop_local, int stop_remote);
+
+  void addRemote(int _r);
 
   void merge(const OrderResult& nlocal,
 	     const OrderResult& nremote,
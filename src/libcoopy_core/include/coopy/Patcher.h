@@ -18,6 +18,8 @@ namespace coopy {
     class OrderChange;
     class RowChangeContext;
     class RowChange;
+    class RowChangeNames;
+    class CompactRowChange;
     class NameChange;
     class TableField;
     class PoolChange;
@@ -218,7 +220,24 @@ public:
     return pRow>=-1;
   }
 
+  /**
+   *
+   * Check whether a condition is indexical.  When no columns at all
+   * are marked, every condition is treated as indexical.
+   *
+   */
+  bool isIndex(const std::string& name) const {
+    if (indexes.size()==0) return true;
+    txt2bool::const_iterator it = indexes.find(name);
+    if (it==indexes.end()) return false;
+    return it->second;
+  }
+
   std::string modeString() const {
+    return modeString(mode);
+  }
+
+  static std::string modeString(int mode) {
     switch (mode) {
     case ROW_CHANGE_NONE:
       return "none";
@@ -240,6 +259,221 @@ public:
 };
 
 
+/**
+ *
+ * Column names shared by a run of CompactRowChanges, so that each
+ * change can refer to columns by number rather than carry its own
+ * name-keyed maps.  Each distinct name gets a number, in order of
+ * first appearance.  "order" gives the numbers of the columns the
+ * changes cover (RowChange::names), in column order.
+ *
+ */
+class coopy::cmp::RowChangeNames : public coopy::store::RefCount {
+public:
+  std::vector<std::string> names;
+  std::vector<int> order;
+  std::vector<std::string> allNames;
+  RowChange::txt2bool indexes;
+
+  /**
+   *
+   * Set the columns covered by changes, numbering their names.
+   *
+   */
+  void setNames(const std::vector<std::string>& names);
+
+  /**
+   *
+   * Get the number of a name, numbering it if it is new.
+   *
+   */
+  int add(const std::string& name);
+
+  /**
+   *
+   * Get the number of a name, or -1 if it has none.
+   *
+   */
+  int find(const std::string& name) const {
+    std::map<std::string,int>::const_iterator it = ids.find(name);
+    if (it==ids.end()) return -1;
+    return it->second;
+  }
+
+  void setIndexes(const RowChange::txt2bool& indexes);
+
+  /**
+   *
+   * Same as RowChange::isIndex, by number.
+   *
+   */
+  bool isIndex(int id) const {
+    if (indexes.size()==0) return true;
+    if (id<0||id>=(int)index_mask.size()) return false;
+    return index_mask[id]!=0;
+  }
+
+private:
+  std::map<std::string,int> ids;
+  std::vector<unsigned char> index_mask;
+};
+
+
+/**
+ *
+ * A RowChange in compact form.  Cells are held in small vectors
+ * indexed by column number (see RowChangeNames), with a byte of flags
+ * per column saying which of them are set, rather than in maps keyed
+ * by name.  The names are shared by all changes made from the same
+ * table.
+ *
+ * Patchers receive these through Patcher::changeCompactRow(), which
+ * expands them into a RowChange unless overridden.
+ *
+ */
+class coopy::cmp::CompactRowChange {
+public:
+  enum {
+    CELL_COND = 1,
+    CELL_VAL = 2,
+    CELL_CONFLICT = 4,
+    CELL_CONFLICT_PARENT = 8,
+  };
+
+  int mode;
+  bool sequential;
+  bool conflicted;
+  int pRow, lRow, rRow;
+  // false for a change that covers no columns (empty RowChange::names)
+  bool hasNames;
+  coopy::store::Poly<RowChangeNames> columns;
+  std::vector<unsigned char> active;
+  std::vector<coopy::store::SheetCell> cond;
+  std::vector<coopy::store::SheetCell> val;
+  std::vector<coopy::store::SheetCell> conflictingVal;
+  std::vector<coopy::store::SheetCell> conflictingParentVal;
+
+  CompactRowChange() {
+    mode = ROW_CHANGE_NONE;
+    sequential = true;
+    conflicted = false;
+    pRow = lRow = rRow = -2;
+    hasNames = false;
+  }
+
+  /**
+   *
+   * Number of columns covered, in column order.
+   *
+   */
+  int width() const {
+    return hasNames?(int)columns->order.size():0;
+  }
+
+  /**
+   *
+   * Number of the i-th column covered, or -1 if there is no such
+   * column.
+   *
+   */
+  int idAt(int i) const {
+    if (i<0||i>=width()) return -1;
+    return columns->order[i];
+  }
+
+  /**
+   *
+   * Name of a column by number, or an empty string for a number that
+   * was never given out.
+   *
+   */
+  const std::string& nameOf(int id) const {
+    static const std::string none;
+    if (!columns.isValid()) return none;
+    if (id<0||id>=(int)columns->names.size()) return none;
+    return columns->names[id];
+  }
+
+  int size() const {
+    return (int)active.size();
+  }
+
+  bool has(int id, int flag) const {
+    return id>=0 && id<(int)active.size() && (active[id]&flag)!=0;
+  }
+
+  bool hasCond(int id) const { return has(id,CELL_COND); }
+  bool hasVal(int id) const { return has(id,CELL_VAL); }
+  bool hasConflict(int id) const { return has(id,CELL_CONFLICT); }
+  bool hasConflictParent(int id) const { 
+    return has(id,CELL_CONFLICT_PARENT); 
+  }
+
+  bool hasAnyCond() const { return any(CELL_COND); }
+  bool hasAnyVal() const { return any(CELL_VAL); }
+
+  void setCond(int id, const coopy::store::SheetCell& c) {
+    set(id,CELL_COND,cond,c);
+  }
+
+  void setVal(int id, const coopy::store::SheetCell& c) {
+    set(id,CELL_VAL,val,c);
+  }
+
+  void setConflict(int id, const coopy::store::SheetCell& c,
+		   const coopy::store::SheetCell& parent) {
+    set(id,CELL_CONFLICT,conflictingVal,c);
+    set(id,CELL_CONFLICT_PARENT,conflictingParentVal,parent);
+  }
+
+  bool isIndex(int id) const {
+    return columns->isIndex(id);
+  }
+
+  /**
+   *
+   * Drop conflicting values, as RowChange does when a conflict
+   * is resolved.
+   *
+   */
+  void clearConflicts() {
+    for (int i=0; i<(int)active.size(); i++) {
+      active[i] &= ~(CELL_CONFLICT|CELL_CONFLICT_PARENT);
+    }
+    conflictingVal.clear();
+    conflictingParentVal.clear();
+    conflicted = false;
+  }
+
+  /**
+   *
+   * Check whether a column is among those covered.
+   *
+   */
+  bool covers(int id) const;
+
+  void toRowChange(RowChange& change) const;
+
+  void fromRowChange(const RowChange& change);
+
+private:
+  bool any(int flag) const {
+    for (int i=0; i<(int)active.size(); i++) {
+      if (active[i]&flag) return true;
+    }
+    return false;
+  }
+
+  void set(int id, int flag, std::vector<coopy::store::SheetCell>& cells,
+	   const coopy::store::SheetCell& c) {
+    if (id>=(int)active.size()) active.resize(id+1,0);
+    if (id>=(int)cells.size()) cells.resize(active.size());
+    active[id] |= flag;
+    cells[id] = c;
+  }
+};
+
+
 /**
  * Declaration of all column names and column order.
  */
@@ -332,6 +566,18 @@ public:
 
   virtual bool changeRow(const RowChange& change) { return false; }
 
+  /**
+   *
+   * Receive a row change in compact form.  By default it is expanded
+   * into a RowChange and passed to changeRow().
+   *
+   */
+  virtual bool changeCompactRow(const CompactRowChange& change) {
+    RowChange expanded;
+    change.toRowChange(expanded);
+    return changeRow(expanded);
+  }
+
   virtual bool changePool(const PoolChange& change) { return false; }
 
   virtual bool declareLink(const LinkDeclare& decl) { return false; }
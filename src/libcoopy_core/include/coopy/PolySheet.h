@@ -156,6 +156,18 @@ public:
     return sheet->cellSummary(x,y+dh);
   }
 
+  virtual SheetCellView cellView(int x, int y, std::string& scratch) const {
+    COOPY_ASSERT(sheet);
+    return sheet->cellView(x,y+dh,scratch);
+  }
+
+  virtual int readRows(int y0, int count, RowBlock& block) const {
+    COOPY_ASSERT(sheet);
+    int n = sheet->readRows(y0+dh,count,block);
+    block.y0 = y0;
+    return n;
+  }
+
   virtual bool cellSummary(int x, int y, const SheetCell& c) {
     COOPY_ASSERT(sheet);
     return sheet->cellSummary(x,y+dh,c);
@@ -230,6 +242,30 @@ public:
 			     (dh==0)?last:last.delta(dh));
   }
 
+  virtual bool deleteRowSet(const std::vector<int>& rows) {
+    COOPY_ASSERT(sheet);
+    if (dh==0) return sheet->deleteRowSet(rows);
+    std::vector<int> shifted(rows);
+    for (int i=0; i<(int)shifted.size(); i++) {
+      shifted[i] += dh;
+    }
+    return sheet->deleteRowSet(shifted);
+  }
+
+  virtual bool reorderRows(const std::vector<int>& order) {
+    COOPY_ASSERT(sheet);
+    if (dh==0) return sheet->reorderRows(order);
+    // rows above the offset stay where they are
+    std::vector<int> shifted;
+    for (int i=0; i<dh; i++) {
+      shifted.push_back(i);
+    }
+    for (int i=0; i<(int)order.size(); i++) {
+      shifted.push_back(order[i]+dh);
+    }
+    return sheet->reorderRows(shifted);
+  }
+
   // insert a row before base; if base is invalid insert after all rows
   virtual RowRef insertRow(const RowRef& base) {
     COOPY_ASSERT(sheet);
@@ -325,21 +361,21 @@ public:
     return v;
   }
 
-  virtual std::string getHash(bool cache) const {
+  virtual std::string getHash(bool cache, int kind) const {
     if (dh==0) {
       COOPY_ASSERT(sheet);
-      return sheet->getHash(cache);
+      return sheet->getHash(cache,kind);
     }
-    return DataSheet::getHash(cache);
+    return DataSheet::getHash(cache,kind);
   }
 
 
-  virtual std::string getRawHash() const {
+  virtual std::string getRawHash(int kind) const {
     if (dh==0) {
       COOPY_ASSERT(sheet);
-      return sheet->getRawHash();
+      return sheet->getRawHash(kind);
     }
-    return DataSheet::getRawHash();
+    return DataSheet::getRawHash(kind);
   }
 
   virtual DataSheet& tail() {
@@ -368,6 +404,23 @@ public:
     return sheet->isSequential();
   }
 
+  virtual bool canReadConcurrently() const {
+    COOPY_ASSERT(sheet);
+    return sheet->canReadConcurrently();
+  }
+
+  virtual bool updateRowDigests() {
+    COOPY_ASSERT(sheet);
+    return sheet->updateRowDigests();
+  }
+
+  virtual const RowDigests *getRowDigests(int& offset) const {
+    COOPY_ASSERT(sheet);
+    const RowDigests *digests = sheet->getRowDigests(offset);
+    offset += dh;
+    return digests;
+  }
+
   virtual DataSheet *getNestedSheet(int x, int y) {
     COOPY_ASSERT(sheet);
     return sheet->getNestedSheet(x,y);
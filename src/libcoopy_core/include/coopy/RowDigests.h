@@ -0,0 +1,127 @@
+#ifndef COOPY_ROWDIGESTS_INC
+#define COOPY_ROWDIGESTS_INC
+
+#include <vector>
+#include <utility>
+
+namespace coopy {
+  namespace store {
+    class DataSheet;
+    class RowBlock;
+    class RowDigests;
+  }
+}
+
+/**
+ *
+ * Cached digests of the rows of a table, with a tree of digests of
+ * blocks of rows on top.  Tables that keep one up to date (by calling
+ * touch(), rowsInserted(), etc as they change) only need to rehash
+ * the rows that actually changed, and two such tables can be compared
+ * block by block, skipping identical blocks entirely.  Digests are
+ * FastHasher values, so only meaningful within a process.
+ *
+ * Nothing here is synchronized.  update() may be called from one
+ * thread at a time, and the digests may then be read from any number
+ * of threads until the next change.
+ *
+ */
+class coopy::store::RowDigests {
+public:
+  // rows per block, and blocks per block at higher levels
+  static const int FANOUT = 64;
+
+  RowDigests() {
+    width = -1;
+  }
+
+  /**
+   *
+   * Note that row y has (or may have) changed.
+   *
+   */
+  void touch(int y) {
+    if (y<(int)row_ok.size() && row_ok[y]) {
+      dirty(y);
+    }
+  }
+
+  void rowsInserted(int y, int n);
+
+  void rowsRemoved(int y, int n);
+
+  // rows given in increasing order
+  void rowsRemoved(const std::vector<int>& ys);
+
+  /**
+   *
+   * Forget all digests, as after a change to columns.
+   *
+   */
+  void clear();
+
+  /**
+   *
+   * Bring digests up to date with the table, rehashing only rows
+   * marked as changed (or not yet seen).  Does not modify anything if
+   * already up to date.
+   *
+   */
+  void update(const DataSheet& sheet);
+
+  /**
+   *
+   * Check whether the digests are up to date with the table, with no
+   * rows or blocks left to rehash.
+   *
+   */
+  bool isCurrent(const DataSheet& sheet) const;
+
+  int height() const {
+    return (int)rows.size();
+  }
+
+  unsigned long long getRow(int y) const {
+    return rows[y];
+  }
+
+  /**
+   *
+   * Find the ranges of rows where a and b differ, comparing row y of
+   * one table with row y of the other.  Each range is a pair
+   * (first row, last row + 1).  Tables whose own digests are up to
+   * date (see DataSheet::updateRowDigests) are compared block by
+   * block, skipping blocks of identical rows.  Other tables are
+   * hashed in full.
+   *
+   */
+  static void differingRanges(const DataSheet& a, const DataSheet& b,
+			      std::vector<std::pair<int,int> >& ranges);
+
+private:
+  int width;
+  std::vector<unsigned long long> rows;
+  std::vector<char> row_ok;
+  std::vector<std::vector<unsigned long long> > nodes;
+  std::vector<std::vector<char> > node_ok;
+
+  void dirty(int y);
+
+  void dirtyFrom(int y);
+
+  void fitLevels();
+
+  void updateNode(const DataSheet& sheet, RowBlock& block,
+		  int level, int index);
+
+  static int span(int level);
+
+  void compareNode(const RowDigests& alt, int level, int index,
+		   int lo, int hi, int off,
+		   std::vector<std::pair<int,int> >& ranges) const;
+
+  static void addRange(std::vector<std::pair<int,int> >& ranges,
+		       int first, int last);
+};
+
+#endif
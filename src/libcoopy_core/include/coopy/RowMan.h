@@ -5,6 +5,9 @@
 #include <coopy/CompareFlags.h>
 #include <coopy/FMap.h>
 #include <coopy/OrderResult.h>
+#include <coopy/LshIndex.h>
+#include <coopy/FeatureCache.h>
+#include <coopy/TypedColumns.h>
 
 namespace coopy {
   namespace cmp {
@@ -29,18 +32,86 @@ public:
   std::vector<int> ref_subset, query_subset;
   coopy::store::SparseFloatSheet match;
   const OrderResult& comp;
+  LshIndex lsh;
+  std::vector<unsigned long long> features;
+  FeatureCache *acache, *bcache;
+  const TypedColumns *atyped, *btyped;
+  std::vector<int> ids;
+  TypedValue tv;
+  std::string canon;
+  coopy::store::SheetCellView canon_view;
+  // for matching without a column mapping, whether features come from
+  // the caches (decided on first use, as the map is never reset then)
+  bool use_cache;
+  bool cache_decided;
 
  RowManOf(const CompareFlags& flags,
 	  const OrderResult& comp,
 	  int len) : flags(flags), m(match,len), comp(comp) {
     vigor = 0;
     bound = -1;
+    m.setHashed(flags.hash_features);
+    acache = bcache = 0/*NULL*/;
+    atyped = btyped = 0/*NULL*/;
+    use_cache = true;
+    cache_decided = false;
   }
 
   void setVigor(int vigor) {
     this->vigor = vigor;
   }
 
+  /**
+   *
+   * Only score rows that collide in a MinHash band, see LshIndex.
+   *
+   */
+  void setLsh(int bands, int rows) {
+    lsh.setSize(bands,rows);
+  }
+
+  /**
+   *
+   * Keep features of the rows of the two tables being compared in
+   * caches, which may be shared with other measures of the same
+   * tables.  Only used for text features; hashed features are about
+   * as cheap to recompute as to look up.
+   *
+   */
+  void setFeatureCache(FeatureCache *acache, FeatureCache *bcache) {
+    this->acache = acache;
+    this->bcache = bcache;
+  }
+
+  // Features in the map must all come from the caches or all from
+  // text, so this is only checked when the map is empty.
+  bool cachesFull() const {
+    return (acache&&acache->full()) || (bcache&&bcache->full());
+  }
+
+  /**
+   *
+   * Match typed cells of the two tables (see TypedColumns) by value,
+   * so that "1.0" and "1" look alike.
+   *
+   */
+  void setTypedColumns(const TypedColumns *atyped,
+		       const TypedColumns *btyped) {
+    this->atyped = atyped;
+    this->btyped = btyped;
+  }
+
+  const coopy::store::SheetCellView& view(const TypedColumns *typed,
+					  const coopy::store::SheetCellView& v,
+					  int x, int y) {
+    if (!typed) return v;
+    if (!typed->get(x,y,tv)) return v;
+    if (tv.kind==TypedValue::TYPED_NULL) return v;
+    canon = tv.canonical();
+    canon_view = coopy::store::SheetCellView(canon,false);
+    return canon_view;
+  }
+
   virtual void setup(MeasurePass& pass) {
     pass.setSize(pass.a.height(),pass.b.height());
     if (flags.trust_ids||flags.bias_ids) {
@@ -49,8 +120,22 @@ public:
     }
   }
 
+  // features from pairs of neighbouring cells of row y
+  void addPairs(const coopy::store::RowBlock& block, int w, int y,
+		std::string& txt, bool query, bool alt, int ctrl) {
+    for (int x=0; x<w-1; x++) {
+      txt.clear();
+      block.cell(x,y).appendTo(txt);
+      block.cell(x+1,y).appendTo(txt);
+      m.setCurr(x,y);
+      m.add(txt,query,alt,ctrl);
+    }
+  }
+
   void apply(coopy::store::DataSheet& a, 
 	     coopy::store::IntSheet& asel, 
+	     FeatureCache *cache,
+	     const TypedColumns *typed,
 	     int target,
 	     bool query, 
 	     bool alt, int ctrl) {
@@ -59,10 +144,30 @@ public:
     m.resetCount();
     int top = (bound<0)?h:bound;
     int at = 0;
+    std::string txt;
+    coopy::store::RowBlock block;
+    // with an lsh index, features are gathered per row and the
+    // index does the matching; "alt" counts have no role there, as
+    // the index itself limits how much a common feature counts
+    bool use_lsh = lsh.isActive();
+    if (use_lsh && alt) return;
+    if (use_lsh || vigor==1 || m.hashed) cache = 0/*NULL*/;
+    // a pass over a single column reads just that column's cells
+    bool single = (target!=-1) && !flags.trust_ids && !flags.bias_ids;
+    std::string scratch;
+    coopy::store::SheetCellView one;
     for (int y=0; y<h; y++) {
+      if (flags.budget.exhausted()) break;
       if (asel.cell(0,y)==-1) {
 	if (at<top) {
 	  at++;
+	  if (!single && !block.contains(y)) {
+	    a.readRows(y,coopy::store::RowBlock::DEFAULT_HEIGHT,block);
+	  }
+	  if (use_lsh) {
+	    features.clear();
+	    m.setCollect(&features);
+	  }
 	  if (!(flags.trust_ids)) {
 	    if (!flags.bias_ids) {
 	      int first = target;
@@ -72,42 +177,68 @@ public:
 		last = w-1;
 	      }
 	      for (int x=first; x<=last; x++) {
-		std::string txt = a.cellString(x,y);
+		if (single) one = a.cellView(x,y,scratch);
+		const coopy::store::SheetCellView& v =
+		  view(typed,single?one:block.cell(x,y),x,y);
 		m.setCurr(x,y);
-		m.add(txt,query,alt,ctrl);
+		if (cache) {
+		  cache->get(v,x,y,ctrl,ids);
+		  m.addIds(ids,query,alt);
+		} else {
+		  m.add(v.data,v.len,query,alt,ctrl);
+		}
 		//printf("ADD %d %d %s %d\n", x, y, txt.c_str(), query);
 	      }
 	    } else {
 	      const std::vector<int>& subset = query?query_subset:ref_subset;
 	      for (int x=0; x<(int)subset.size(); x++) {
-		std::string txt = a.cellString(subset[x],y);
+		const coopy::store::SheetCellView& v =
+		  view(typed,block.cell(subset[x],y),subset[x],y);
 		m.setCurr(subset[x],y);
-		m.add(txt,query,alt,ctrl);
+		if (cache) {
+		  cache->get(v,subset[x],y,ctrl,ids);
+		  m.addIds(ids,query,alt);
+		} else {
+		  m.add(v.data,v.len,query,alt,ctrl);
+		}
 	      }
 	    }
 	  } else {
 	    const std::vector<int>& subset = query?query_subset:ref_subset;
-	    std::string txt = "";
+	    txt.clear();
 	    for (int x=0; x<(int)subset.size(); x++) {
-	      txt += a.cellString(subset[x],y) + "__";
+	      block.cell(subset[x],y).appendTo(txt);
+	      txt += "__";
 	    }
 	    m.setCurr(0,y);
 	    m.add(txt,query,alt,0);
 	  }
+	  if (use_lsh) {
+	    if (vigor==1) {
+	      if (!block.contains(y)) {
+		a.readRows(y,coopy::store::RowBlock::DEFAULT_HEIGHT,block);
+	      }
+	      addPairs(block,w,y,txt,query,alt,ctrl);
+	    }
+	    m.setCollect(0/*NULL*/);
+	    if (query) {
+	      lsh.query(y,features,match);
+	    } else {
+	      lsh.add(y,features);
+	    }
+	  }
 	} else {
 	  match.cell(0,y) = -2;
 	}
       }
     }
-    if (vigor==1) {
+    if (vigor==1 && !use_lsh) {
       for (int y=0; y<h; y++) {
 	if (asel.cell(0,y)>=-1) {
-	  for (int x=0; x<w-1; x++) {
-	    std::string txt = a.cellString(x,y);
-	    txt += a.cellString(x+1,y);
-	    m.setCurr(x,y);
-	    m.add(txt,query,alt,ctrl);
+	  if (!block.contains(y)) {
+	    a.readRows(y,coopy::store::RowBlock::DEFAULT_HEIGHT,block);
 	  }
+	  addPairs(block,w,y,txt,query,alt,ctrl);
 	}
       }
     }
@@ -120,9 +251,14 @@ public:
 	     coopy::store::IntSheet& bsel,
 	     int ctrl) {
     match.resize(a.height(),b.height(),0);
+    lsh.clear();
     if (flags.trust_ids||flags.bias_ids||comp.isBlank()) {
-      apply(a,asel,-1,false,false,ctrl);
-      apply(b,bsel,-1,true,false,ctrl);
+      if (!cache_decided) {
+	use_cache = !cachesFull();
+	cache_decided = true;
+      }
+      apply(a,asel,use_cache?acache:0/*NULL*/,atyped,-1,false,false,ctrl);
+      apply(b,bsel,use_cache?bcache:0/*NULL*/,btyped,-1,true,false,ctrl);
       return;
     }
     // Have a column mapping
@@ -132,9 +268,14 @@ public:
       int j = comp.a2b(i);
       if (j!=-1) {
 	m.resetCache();
-	apply(a,asel,i,false,false,ctrl);
-	apply(b,bsel,j,false,true,ctrl);
-	apply(b,bsel,j,true,false,ctrl);
+	lsh.clear();
+	// past the limit, features are kept for this column only
+	bool cached = !cachesFull();
+	FeatureCache *ac = cached?acache:0/*NULL*/;
+	FeatureCache *bc = cached?bcache:0/*NULL*/;
+	apply(a,asel,ac,atyped,i,false,false,ctrl);
+	apply(b,bsel,bc,btyped,j,false,true,ctrl);
+	apply(b,bsel,bc,btyped,j,true,false,ctrl);
       }
     }
   }
@@ -166,6 +307,19 @@ public:
 		int len) : man1(flags,comp,len), man2(flags,comp,len) {
     theta = man1.getCtrlMax()/2;
     flip = false;
+    man2.setLsh(flags.lsh_bands,flags.lsh_rows);
+  }
+
+  // man1 and man2 hash cells the same way, so can share caches
+  void setFeatureCache(FeatureCache *acache, FeatureCache *bcache) {
+    man1.setFeatureCache(acache,bcache);
+    man2.setFeatureCache(acache,bcache);
+  }
+
+  void setTypedColumns(const TypedColumns *atyped,
+		       const TypedColumns *btyped) {
+    man1.setTypedColumns(atyped,btyped);
+    man2.setTypedColumns(atyped,btyped);
   }
 
   virtual void setup(MeasurePass& pass) {
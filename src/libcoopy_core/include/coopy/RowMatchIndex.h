@@ -0,0 +1,149 @@
+#ifndef COOPY_ROWMATCHINDEX
+#define COOPY_ROWMATCHINDEX
+
+#include <coopy/DataSheet.h>
+#include <coopy/SheetCell.h>
+
+#include <vector>
+
+namespace coopy {
+  namespace cmp {
+    class RowMatchIndex;
+  }
+}
+
+/**
+ *
+ * Index of the rows of a table by the values of a set of columns, for
+ * finding the rows a patch refers to without comparing every row.
+ * Each row gets a 64-bit key hashed from its cells in those columns,
+ * and rows are placed in a hash table by key.  Rows with the same key
+ * may still differ (keys can collide), so callers should check the
+ * cells of the candidates they get back.
+ *
+ * The index is built on first use, and rebuilt if the column set,
+ * table, or table size changes.  Changes made through the patcher are
+ * reported with rowInserted() and friends.  The hash table holds a
+ * serial number for each row that stays with the row as it shifts,
+ * and a tree over the serials (a treap ordered by row position) gives
+ * the current row number of a serial.  So inserts, moves and removals
+ * cost O(log n) each, and the hash table never needs rebuilding
+ * because of them.
+ *
+ */
+class coopy::cmp::RowMatchIndex {
+public:
+  RowMatchIndex() {
+    clear();
+  }
+
+  /**
+   *
+   * Forget everything, as after a change to the columns of the table.
+   *
+   */
+  void clear();
+
+  /**
+   *
+   * Find the rows of sheet whose cells in columns cols may equal
+   * cond[col] for each of those columns.  Rows come back in order.
+   *
+   */
+  void candidates(const coopy::store::DataSheet& sheet,
+		  const std::vector<int>& cols,
+		  const std::vector<coopy::store::SheetCell>& cond,
+		  std::vector<int>& rows);
+
+  /**
+   *
+   * Row y of sheet is new.
+   *
+   */
+  void rowInserted(const coopy::store::DataSheet& sheet, int y);
+
+  void rowRemoved(int y);
+
+  /**
+   *
+   * Rows were removed all at once; rows are in order, and numbered as
+   * before the removal.
+   *
+   */
+  void rowsRemoved(const std::vector<int>& rows);
+
+  /**
+   *
+   * The row at from is now at to.
+   *
+   */
+  void rowMoved(int from, int to);
+
+  /**
+   *
+   * Cells of row y of sheet may have changed.
+   *
+   */
+  void rowChanged(const coopy::store::DataSheet& sheet, int y);
+
+private:
+  const coopy::store::DataSheet *sheet_id;
+  int sheet_width;
+  std::vector<int> cols;
+  // for each serial: its key, and its place in the tree (-1 for none)
+  std::vector<unsigned long long> keys;
+  std::vector<int> left, right, parent, count;
+  std::vector<unsigned int> priority;
+  int root;
+  unsigned int seed;
+  // open addressing table of serials, by key; -1 for an empty slot,
+  // -2 for a slot whose serial was removed
+  std::vector<int> slots;
+  int used;
+  int removed;
+  std::string scratch;
+
+  bool valid(const coopy::store::DataSheet& sheet,
+	     const std::vector<int>& cols) const;
+
+  unsigned long long keyOfRow(const coopy::store::DataSheet& sheet, int y);
+
+  unsigned long long keyOfCells(const std::vector<coopy::store::SheetCell>& cond);
+
+  void build(const coopy::store::DataSheet& sheet,
+	     const std::vector<int>& cols);
+
+  int size() const {
+    return (root<0)?0:count[root];
+  }
+
+  int makeSerial(unsigned long long key);
+
+  void pull(int x);
+
+  int join(int a, int b);
+
+  void split(int t, int n, int& a, int& b);
+
+  void treeInsert(int s, int y);
+
+  int treeRemove(int y);
+
+  int serialAt(int y) const;
+
+  int rowOf(int s) const;
+
+  void order(std::vector<int>& serials) const;
+
+  void plant(const std::vector<int>& serials);
+
+  void compact();
+
+  void rehash();
+
+  void place(int s);
+
+  void unplace(int s);
+};
+
+#endif
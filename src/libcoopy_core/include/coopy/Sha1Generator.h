@@ -3,29 +3,45 @@
 
 #include <string>
 
-extern void sha1sum_step_text(const char *zText, int nBytes);
-extern char *sha1sum_finish();
-
 namespace coopy {
   namespace store {
     class Sha1Generator;
   }
 }
 
+/**
+ *
+ * Incremental SHA-1 checksum.  Each instance carries its own state, so
+ * any number of checksums can be computed at once, on any thread.
+ *
+ */
 class coopy::store::Sha1Generator {
 public:
+  Sha1Generator();
+
+  Sha1Generator(const Sha1Generator& alt);
+
+  const Sha1Generator& operator=(const Sha1Generator& alt);
+
+  ~Sha1Generator();
+
+  void reset();
+
   void add(const std::string& str) {
     add(str.c_str(),str.length());
   }
 
-  void add(const char *txt, int len) {
-    sha1sum_step_text(txt,len);
-  }
+  void add(const char *txt, int len);
 
-  std::string finish() {
-    return sha1sum_finish();
-  }
+  /**
+   *
+   * Return the checksum in base 16, and reset for the next round.
+   *
+   */
+  std::string finish();
+
+private:
+  void *implementation;
 };
 
 #endif
-
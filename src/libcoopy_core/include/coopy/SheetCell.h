@@ -2,11 +2,13 @@
 #define COOPY_SHEETCELL_INC
 
 #include <string>
+#include <string.h>
 #include <coopy/RefCount.h>
 
 namespace coopy {
   namespace store {
     class SheetCell;
+    class SheetCellView;
     class SheetCellMeta;
     class SheetCellSimpleMeta;
   }
@@ -94,6 +96,78 @@ public:
   static SheetCell makeInt(int x);
 };
 
+/**
+ *
+ * A non-owning look at the content of a cell: a pointer and length
+ * into storage held elsewhere, plus the NULL flag.  Use
+ * DataSheet::cellView to get one without copying the cell.  Any
+ * cell metadata (such as urls) is not carried.
+ *
+ */
+class coopy::store::SheetCellView {
+public:
+  const char *data;
+  int len;
+  bool escaped;
+
+  SheetCellView() {
+    data = "";
+    len = 0;
+    escaped = true;
+  }
+
+  SheetCellView(const char *data, int len, bool escaped) :
+    data(data), len(len), escaped(escaped) {
+  }
+
+  SheetCellView(const std::string& text, bool escaped) :
+    data(text.c_str()), len((int)text.length()), escaped(escaped) {
+  }
+
+  SheetCellView(const SheetCell& c) :
+    data(c.text.c_str()), len((int)c.text.length()), escaped(c.escaped) {
+  }
+
+  bool textEquals(const char *str, int slen) const {
+    if (len!=slen) return false;
+    return memcmp(data,str,len)==0;
+  }
+
+  bool textEquals(const std::string& str) const {
+    return textEquals(str.c_str(),(int)str.length());
+  }
+
+  bool operator==(const SheetCellView& alt) const {
+    if (escaped!=alt.escaped) return false;
+    return textEquals(alt.data,alt.len);
+  }
+
+  bool operator!=(const SheetCellView& alt) const {
+    return !((*this)==alt);
+  }
+
+  bool operator==(const SheetCell& alt) const {
+    if (escaped!=alt.escaped) return false;
+    return textEquals(alt.text);
+  }
+
+  bool operator!=(const SheetCell& alt) const {
+    return !((*this)==alt);
+  }
+
+  std::string text() const {
+    return std::string(data,len);
+  }
+
+  void appendTo(std::string& str) const {
+    str.append(data,len);
+  }
+
+  SheetCell toCell() const {
+    return SheetCell(text(),escaped);
+  }
+};
+
 #endif
 
 
@@ -6,6 +6,7 @@
 #include <coopy/CompareFlags.h>
 #include <coopy/SheetView.h>
 #include <coopy/OrderResult.h>
+#include <coopy/TypedColumns.h>
 
 namespace coopy {
   namespace cmp {
@@ -39,6 +40,9 @@ private:
 		    coopy::store::SheetView& vpivot,
 		    coopy::store::SheetView& vlocal,
 		    coopy::store::SheetView& vremote,
+		    const coopy::cmp::TypedColumns *tpivot,
+		    const coopy::cmp::TypedColumns *tlocal,
+		    const coopy::cmp::TypedColumns *tremote,
 		    bool approx);
 
   void doColMapping(const coopy::cmp::OrderResult& p2l_row_order,
@@ -8,6 +8,7 @@
 #include <coopy/CsvSheet.h>
 #include <coopy/NameSniffer.h>
 #include <coopy/MergeOutputFilter.h>
+#include <coopy/RowMatchIndex.h>
 
 #include <vector>
 #include <list>
@@ -53,6 +54,22 @@ private:
   bool sheetUpdateNeeded;
   coopy::store::NameSniffer *sniffer;
   coopy::store::DataSheet *sniffedSheet;
+  RowMatchIndex row_index;
+  std::vector<int> match_cols;
+  std::vector<int> match_rows;
+  // rows deleted but not yet removed from the table; see flushEdits
+  int pending_deletes;
+  // rows inserted or moved but not yet put in place; see flushEdits.
+  // Each is (anchor, row): row goes before the row numbered anchor
+  // when the queue was started, or at the end if anchor is
+  // pending_base.  New rows wait at the end of the table, at
+  // pending_base and up; moved rows wait where they were.
+  std::vector<std::pair<int,int> > pending_edits;
+  int pending_base;
+  // per anchor: 1 if rows are queued there, 2 if the row has moved
+  std::vector<char> pending_marks;
+  // the cursor is just after the last row queued at its anchor
+  bool cursor_follows;
 
   int matchRow(const std::vector<int>& active_cond,
 	       const std::vector<std::string>& active_name,
@@ -73,6 +90,13 @@ private:
   bool renameColumn(int idx, const std::string& name, 
 		    const std::string& oldName);
 
+  // exactly one of full and compact is given
+  bool applyRow(const RowChange *full, const CompactRowChange *compact);
+
+  int queueAnchor(bool follows, bool& flushed);
+
+  void queueRow(int anchor, int r);
+
 public:
   SheetPatcher(bool descriptive = false,
 	       bool forReview = false,
@@ -93,6 +117,9 @@ public:
     conflictColumn = -1;
     declaredNames = false;
     checkedHeader = false;
+    pending_deletes = 0;
+    pending_base = -1;
+    cursor_follows = false;
   }
 
   static SheetPatcher *createForApply() {
@@ -157,6 +184,7 @@ public:
 
   virtual bool changeColumn(const OrderChange& change);
   virtual bool changeRow(const RowChange& change);
+  virtual bool changeCompactRow(const CompactRowChange& change);
   virtual bool declareNames(const std::vector<std::string>& names, bool final);
 
   virtual bool changePool(const PoolChange& change) {
@@ -197,7 +225,7 @@ public:
     return true;
   }
 
-  bool markChanges(const RowChange& change, int r,int width,
+  bool markChanges(bool conflicted, int r,int width,
 		   std::vector<int>& active_val,
 		   std::vector<coopy::store::SheetCell>& val,
 		   std::vector<coopy::store::SheetCell>& cval,
@@ -208,6 +236,10 @@ public:
 
   bool updateSheet();
 
+  // put queued rows in place and remove rows marked as deleted, all
+  // in one pass
+  void flushEdits();
+
   //virtual coopy::store::PolySheet getSheet();
 
 };
@@ -8,10 +8,13 @@
 #include <coopy/Stat.h>
 
 #include <set>
+#include <vector>
+#include <algorithm>
 
 namespace coopy {
   namespace store {
     template <class T> class SparseSheet;
+    template <class T> class CompactSparseSheet;
     class SparseFloatSheet;
     class SparseIntSheet;
     class SparseByteSheet;
@@ -170,6 +173,278 @@ public:
 };
 
 
+/**
+ *
+ * A sparse table stored in compressed-sparse-row form.  Each row keeps
+ * a sorted vector of the columns it has cells in, alongside a vector
+ * of their values.  A per-column index is built on demand when
+ * getCellsInCol() is called, and dropped whenever a cell is added or
+ * removed.
+ *
+ * Cells added in column order are appended.  A cell added out of order
+ * "opens" its row: the row gets a dense map from column to position,
+ * and new cells are appended unsorted, so filling a row in any order
+ * costs no shifting.  The open row is sorted again when another row
+ * needs opening, or on settle().
+ *
+ * This suits tables filled roughly row by row, such as match matrices
+ * and Viterbi lattices, far better than the hash-based SparseSheet.
+ * Note that a reference returned by cell() is only valid until the
+ * next cell is added to or removed from the same row.
+ *
+ */
+template <class T>
+class coopy::store::CompactSparseSheet : public DataSheet {
+ private:
+  std::vector<int> empty_set;
+  mutable std::vector<std::vector<int> > transpose;
+  mutable bool transpose_valid;
+  T zero;
+  // the open row, if any, with slot[x] its position of column x or -1
+  int open;
+  bool open_sorted;
+  std::vector<int> slot;
+  mutable std::vector<int> open_order;
+  std::vector<std::pair<int,T> > scratch;
+
+  int find(int x, int y) const {
+    if (y<0||y>=(int)index.size()) return -1;
+    if (y==open) {
+      if (x<0||x>=(int)slot.size()) return -1;
+      return slot[x];
+    }
+    const std::vector<int>& idx = index[y];
+    std::vector<int>::const_iterator it = 
+      std::lower_bound(idx.begin(),idx.end(),x);
+    if (it==idx.end()||*it!=x) return -1;
+    return (int)(it-idx.begin());
+  }
+
+  void openRow(int y) {
+    settle();
+    const std::vector<int>& idx = index[y];
+    for (int i=0; i<(int)idx.size(); i++) {
+      int x = idx[i];
+      if (x>=(int)slot.size()) slot.resize(x+1,-1);
+      slot[x] = i;
+    }
+    open = y;
+    open_sorted = true;
+  }
+
+  T& append(int x, int y) {
+    std::vector<int>& idx = index[y];
+    std::vector<T>& val = values[y];
+    if (!idx.empty()&&x<idx.back()) open_sorted = false;
+    if (x>=(int)slot.size()) slot.resize(x+1,-1);
+    slot[x] = (int)idx.size();
+    idx.push_back(x);
+    val.push_back(zero);
+    transpose_valid = false;
+    return val.back();
+  }
+
+  void buildTranspose() const {
+    transpose.clear();
+    transpose.resize(w);
+    for (int y=0; y<(int)index.size(); y++) {
+      const std::vector<int>& idx = index[y];
+      for (int i=0; i<(int)idx.size(); i++) {
+	int x = idx[i];
+	if (x>=(int)transpose.size()) transpose.resize(x+1);
+	transpose[x].push_back(y);
+      }
+    }
+    transpose_valid = true;
+  }
+
+public:
+  std::vector<std::vector<int> > index;
+  std::vector<std::vector<T> > values;
+  int h, w;
+
+  CompactSparseSheet() {
+    h = w = 0;
+    transpose_valid = false;
+    open = -1;
+    open_sorted = true;
+  }
+
+  const CompactSparseSheet& operator = (const CompactSparseSheet& alt) {
+    index = alt.index;
+    values = alt.values;
+    transpose.clear();
+    transpose_valid = false;
+    open = alt.open;
+    open_sorted = alt.open_sorted;
+    slot = alt.slot;
+    h = alt.h;
+    w = alt.w;
+    zero = alt.zero;
+    return *this;
+  }
+
+  bool resize(int w, int h, const T& zero) {
+    clear();
+    this->zero = zero;
+    this->h = h;
+    this->w = w;
+    return true;
+  }
+
+  bool nonDestructiveResize(int w, int h, const T& zero) {
+    this->zero = zero;
+    this->h = h;
+    this->w = w;
+    transpose_valid = false;
+    return true;
+  }
+
+  void reheight(int h) {
+    if (h>=this->h) {
+      this->h = h;
+    }
+  }
+
+  void clear() {
+    index.clear();
+    values.clear();
+    transpose.clear();
+    transpose_valid = false;
+    open = -1;
+    open_sorted = true;
+    slot.clear();
+  }
+
+  /**
+   *
+   * Close the open row, if any, so that every row of index and values
+   * is sorted by column.  Call this before reading them directly.
+   *
+   */
+  void settle() {
+    if (open<0) return;
+    std::vector<int>& idx = index[open];
+    std::vector<T>& val = values[open];
+    for (int i=0; i<(int)idx.size(); i++) {
+      slot[idx[i]] = -1;
+    }
+    if (!open_sorted) {
+      scratch.clear();
+      for (int i=0; i<(int)idx.size(); i++) {
+	scratch.push_back(std::make_pair(idx[i],val[i]));
+      }
+      std::sort(scratch.begin(),scratch.end());
+      for (int i=0; i<(int)idx.size(); i++) {
+	idx[i] = scratch[i].first;
+	val[i] = scratch[i].second;
+      }
+    }
+    open = -1;
+    open_sorted = true;
+  }
+
+  int width() const {
+    return w;
+  }
+
+  int height() const {
+    return h;
+  }
+
+  const T *pcell_const(int x, int y) const {
+    int at = find(x,y);
+    if (at<0) return 0/*NULL*/;
+    return &values[y][at];
+  }
+
+  T *pcell(int x, int y) {
+    int at = find(x,y);
+    if (at<0) return 0/*NULL*/;
+    return &values[y][at];
+  }
+
+  const T& cell(int x, int y) const {
+    int at = find(x,y);
+    if (at<0) return zero;
+    return values[y][at];
+  }
+
+  const T& cell_const(int x, int y) const {
+    return cell(x,y);
+  }
+
+  T& cell(int x, int y) {
+    COOPY_ASSERT(y>=0);
+    if (y>=(int)index.size()) {
+      index.resize(y+1);
+      values.resize(y+1);
+    }
+    if (y==open) {
+      if (x>=0&&x<(int)slot.size()&&slot[x]>=0) return values[y][slot[x]];
+      return append(x,y);
+    }
+    std::vector<int>& idx = index[y];
+    std::vector<T>& val = values[y];
+    if (idx.empty()||x>idx.back()) {
+      idx.push_back(x);
+      val.push_back(zero);
+      transpose_valid = false;
+      return val.back();
+    }
+    std::vector<int>::iterator it = std::lower_bound(idx.begin(),idx.end(),x);
+    if (*it==x) return val[it-idx.begin()];
+    openRow(y);
+    return append(x,y);
+  }
+
+  bool remove(int x, int y) {
+    if (y==open) settle();
+    int at = find(x,y);
+    if (at<0) return false;
+    index[y].erase(index[y].begin()+at);
+    values[y].erase(values[y].begin()+at);
+    transpose_valid = false;
+    return true;
+  }
+
+  const std::vector<int>& getCellsInRow(int y) const {
+    if (y<0||y>=(int)index.size()) {
+      return empty_set;
+    }
+    if (y==open&&!open_sorted) {
+      open_order = index[y];
+      std::sort(open_order.begin(),open_order.end());
+      return open_order;
+    }
+    return index[y];
+  }
+
+  const std::vector<int>& getCellsInCol(int x) const {
+    if (!transpose_valid) buildTranspose();
+    if (x<0||x>=(int)transpose.size()) {
+      return empty_set;
+    }
+    return transpose[x];
+  }
+
+  virtual std::string getDescription() const {
+    return "sparse";
+  }
+
+  virtual ColumnRef insertColumn(const ColumnRef& base, 
+				 const ColumnInfo& info) {
+    return ColumnRef();
+  }
+
+  virtual bool modifyColumn(const ColumnRef& base, 
+			    const ColumnInfo& info) {
+    return false;
+  }
+
+};
+
+
 class coopy::store::SparseStringSheet : public SparseSheet<std::string> {
 public:
   using SparseSheet<std::string>::resize;
@@ -179,10 +454,10 @@ public:
   }
 };
 
-class coopy::store::SparseFloatSheet : public SparseSheet<float> {
+class coopy::store::SparseFloatSheet : public CompactSparseSheet<float> {
 public:
-  using SparseSheet<float>::resize;
-  using SparseSheet<float>::nonDestructiveResize;
+  using CompactSparseSheet<float>::resize;
+  using CompactSparseSheet<float>::nonDestructiveResize;
 
   virtual std::string cellString(int x, int y) const {
     char buf[256];
@@ -194,14 +469,20 @@ public:
   Stat normalize(int first=-1, int last=-1, float sc=0.1, bool modify = true);
   
   void rescale(double factor) {
-    for (efficient_map<long long,float>::iterator it=data.begin(); it!=data.end(); it++) {
-      it->second *= factor;
+    for (int y=0; y<(int)values.size(); y++) {
+      std::vector<float>& val = values[y];
+      for (int i=0; i<(int)val.size(); i++) {
+	val[i] *= factor;
+      }
     }
   }
 
   void offset(double offset) {
-    for (efficient_map<long long,float>::iterator it=data.begin(); it!=data.end(); it++) {
-      it->second += offset;
+    for (int y=0; y<(int)values.size(); y++) {
+      std::vector<float>& val = values[y];
+      for (int i=0; i<(int)val.size(); i++) {
+	val[i] += offset;
+      }
     }
   }
 
@@ -230,10 +511,10 @@ public:
   }
 };
 
-class coopy::store::SparseIntSheet : public SparseSheet<int> {
+class coopy::store::SparseIntSheet : public CompactSparseSheet<int> {
 public:
-  using SparseSheet<int>::resize;
-  using SparseSheet<int>::nonDestructiveResize;
+  using CompactSparseSheet<int>::resize;
+  using CompactSparseSheet<int>::nonDestructiveResize;
 
   virtual std::string cellString(int x, int y) const {
     const int& v = cell(x,y);
@@ -0,0 +1,63 @@
+#ifndef COOPY_TASKGROUP_INC
+#define COOPY_TASKGROUP_INC
+
+#include <vector>
+
+namespace coopy {
+  namespace os {
+    class Task;
+    class TaskGroup;
+  }
+}
+
+/**
+ *
+ * A unit of work for a TaskGroup.
+ *
+ */
+class coopy::os::Task {
+public:
+  virtual ~Task() {}
+
+  virtual void run() = 0;
+};
+
+/**
+ *
+ * Run a set of independent tasks, on up to a given number of threads.
+ * With a single thread, or in builds without thread support, tasks
+ * simply run one after the other, in the order they were added, on
+ * the calling thread.  Tasks are responsible for not sharing anything
+ * but read-only state.
+ *
+ */
+class coopy::os::TaskGroup {
+public:
+  TaskGroup(int threads = 1) {
+    this->threads = threads;
+  }
+
+  void add(Task& task) {
+    tasks.push_back(&task);
+  }
+
+  /**
+   *
+   * Run all tasks added so far, and wait for them to finish.
+   *
+   */
+  void run();
+
+  /**
+   *
+   * True if tasks can actually run concurrently in this build.
+   *
+   */
+  static bool isThreaded();
+
+private:
+  int threads;
+  std::vector<Task*> tasks;
+};
+
+#endif
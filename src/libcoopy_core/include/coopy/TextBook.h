@@ -35,6 +35,17 @@ public:
 
   virtual PolySheet readSheet(const std::string& name) = 0;
 
+  /**
+   *
+   * Digest of the stored text of a sheet, if the book can give one
+   * without reading the sheet, or "" if not.  Sheets with the same
+   * digest read as the same table.
+   *
+   */
+  virtual std::string getSheetHash(const std::string& name) {
+    return "";
+  }
+
   virtual PolySheet readSheetByIndex(int index) {
     std::vector<std::string> names = getNames();
     if (index>=(int)names.size()) return PolySheet();
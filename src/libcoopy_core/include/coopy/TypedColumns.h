@@ -0,0 +1,157 @@
+#ifndef COOPY_TYPEDCOLUMNS
+#define COOPY_TYPEDCOLUMNS
+
+#include <coopy/DataSheet.h>
+#include <coopy/SheetCell.h>
+
+#include <string>
+#include <vector>
+
+namespace coopy {
+  namespace cmp {
+    class TypedValue;
+    class TypedColumns;
+  }
+}
+
+/**
+ *
+ * The value of one cell, read as a number, date or boolean.  Integers
+ * and dates are held exactly (dates as seconds since 1970-01-01);
+ * reals as doubles.  Integers are compared exactly, even past the
+ * range in which doubles can tell them apart.  Dates must exist, so
+ * 2012-02-31 is not read as one.  Cells that could not be read this
+ * way are of kind TYPED_TEXT, and are only ever compared as text.
+ *
+ */
+class coopy::cmp::TypedValue {
+public:
+  enum {
+    TYPED_TEXT,
+    TYPED_NULL,
+    TYPED_INTEGER,
+    TYPED_REAL,
+    TYPED_DATETIME,
+    TYPED_BOOLEAN,
+  };
+
+  int kind;
+  long long i;
+  double d;
+
+  TypedValue() {
+    kind = TYPED_TEXT;
+    i = 0;
+    d = 0;
+  }
+
+  /**
+   *
+   * Read a cell as a value of the given kind.  A TYPED_REAL column
+   * also accepts integers, which are read as TYPED_INTEGER so as to
+   * keep their exact value.  Returns false, leaving the value as
+   * TYPED_TEXT, if the cell does not have that form.  Numbers with
+   * redundant leading zeros ("007") are not accepted, since they are
+   * usually codes rather than quantities.
+   *
+   */
+  bool parse(const coopy::store::SheetCellView& v, int kind);
+
+  /**
+   *
+   * Check whether two values are known to be the same.  False if
+   * either is TYPED_TEXT.  Integers and reals compare by value; two
+   * integers are compared as integers.
+   *
+   */
+  bool equals(const TypedValue& alt) const;
+
+  /**
+   *
+   * Text of the value in a standard form, such that values that are
+   * equals() have the same text.
+   *
+   */
+  std::string canonical() const;
+};
+
+/**
+ *
+ * Values of the cells of a table, read once by column type.  The type
+ * of a column comes from the table's schema where it gives one, and is
+ * otherwise guessed from the cells: a column is taken as numeric (say)
+ * if at least half its non-blank cells are numbers, so that headers
+ * and odd entries do not stop the rest being read.
+ *
+ * Integers, dates and booleans are held as 64-bit integers, reals as
+ * doubles, with a bitmap of which cells are null and another of which
+ * cells were read successfully.  Integers in a column of reals are
+ * held as integers too, marked in a further bitmap.  Text columns
+ * hold nothing.
+ *
+ */
+class coopy::cmp::TypedColumns {
+public:
+  TypedColumns() {
+    h = 0;
+  }
+
+  void clear() {
+    cols.clear();
+    h = 0;
+  }
+
+  /**
+   *
+   * Read all cells of a table.
+   *
+   */
+  void build(const coopy::store::DataSheet& sheet);
+
+  int width() const {
+    return (int)cols.size();
+  }
+
+  int height() const {
+    return h;
+  }
+
+  /**
+   *
+   * The kind of values in a column, TYPED_TEXT if it is not typed.
+   *
+   */
+  int kind(int x) const {
+    if (x<0||x>=(int)cols.size()) return TypedValue::TYPED_TEXT;
+    return cols[x].kind;
+  }
+
+  /**
+   *
+   * Fetch the value read for a cell.  Returns false, leaving the value
+   * as TYPED_TEXT, if the cell has no typed value.
+   *
+   */
+  bool get(int x, int y, TypedValue& v) const;
+
+private:
+  class Column {
+  public:
+    int kind;
+    std::vector<long long> ival;
+    std::vector<double> dval;
+    std::vector<bool> nulls;
+    std::vector<bool> parsed;
+    // for reals, which cells are held in ival (empty if none)
+    std::vector<bool> whole;
+
+    Column() {
+      kind = TypedValue::TYPED_TEXT;
+    }
+  };
+
+  std::vector<Column> cols;
+  int h;
+};
+
+#endif
@@ -2,9 +2,11 @@
 #define COOPY_TYPEDSHEET
 
 #include <coopy/DataSheet.h>
+#include <coopy/RowDigests.h>
 
 #include <vector>
 #include <string>
+#include <algorithm>
 
 #include <stdio.h>
 
@@ -23,6 +25,10 @@ public:
   int h, w;
   T zero;
 
+  // kept up to date as rows change; only subclasses that know how to
+  // serialize T expose it (see getRowDigests)
+  RowDigests digests;
+
   TypedSheet() {
     h = w = 0;
   }
@@ -30,6 +36,7 @@ public:
   void clear() {
     arr.clear();
     h = w = 0;
+    digests.clear();
   }
 
   virtual bool resize(int w, int h) {
@@ -39,6 +46,7 @@ public:
   
   void resize(int w, int h, const T& zero) {
     arr.clear();
+    digests.clear();
     for (int i=0; i<h; i++) {
       arr.push_back(std::vector<T>());
       std::vector<T>& lst = arr.back();
@@ -54,6 +62,7 @@ public:
   void nonDestructiveResize(int w, int h, const T& zero) {
     this->zero = zero;
     if (this->h==h && this->w==w) return;
+    if (this->w!=w) digests.clear();
 
     this->h = h;
     this->w = w;
@@ -77,6 +86,7 @@ public:
   }
 
   T& cell(int x, int y) {
+    digests.touch(y);
     return arr[y][x];
   }
 
@@ -97,6 +107,7 @@ public:
       arr[i].erase(arr[i].begin()+offset);
     }
     w--;
+    digests.clear();
     return true;
   }
 
@@ -111,6 +122,7 @@ public:
       }
     }
     w++;
+    digests.clear();
     return ColumnRef((offset>=0)?offset:ColumnRef(w-1));
   }
 
@@ -148,6 +160,7 @@ public:
       }
       row.erase(row.begin()+offset_del);
     }
+    digests.clear();
     if (offset<0) {
       return ColumnRef(w-1);
     }
@@ -159,22 +172,83 @@ public:
     if (offset<0||offset>=h) return false;
     arr.erase(arr.begin()+offset);
     h--;
+    digests.rowsRemoved(offset,1);
+    return true;
+  }
+
+  virtual bool deleteRows(const RowRef& first, const RowRef& last) {
+    int start = first.getIndex();
+    int stop = last.getIndex()+1;
+    if (start<0||stop>h) return false;
+    if (start>=stop) return true;
+    arr.erase(arr.begin()+start,arr.begin()+stop);
+    h -= stop-start;
+    digests.rowsRemoved(start,stop-start);
+    return true;
+  }
+
+  virtual bool deleteData(int offset = 0) {
+    if (offset<0||offset>h) return false;
+    arr.resize(offset);
+    digests.rowsRemoved(offset,h-offset);
+    h = offset;
+    return true;
+  }
+
+  virtual bool deleteRowSet(const std::vector<int>& rows) {
+    if (rows.size()==0) return true;
+    if (rows[0]<0||rows.back()>=h) return false;
+    for (int i=1; i<(int)rows.size(); i++) {
+      if (rows[i]<=rows[i-1]) return false;
+    }
+    // rows are swapped down over the gaps, not copied
+    int at = rows[0];
+    int k = 0;
+    for (int y=rows[0]; y<h; y++) {
+      if (k<(int)rows.size() && rows[k]==y) {
+	k++;
+	continue;
+      }
+      arr[at].swap(arr[y]);
+      at++;
+    }
+    arr.resize(at);
+    h = at;
+    digests.rowsRemoved(rows);
+    return true;
+  }
+
+  virtual bool reorderRows(const std::vector<int>& order) {
+    // check every entry before any row is taken out of the table
+    std::vector<char> seen(h,0);
+    for (int i=0; i<(int)order.size(); i++) {
+      if (order[i]<0||order[i]>=h) return false;
+      if (seen[order[i]]) return false;
+      seen[order[i]] = 1;
+    }
+    std::vector<std::vector<T> > next(order.size());
+    for (int i=0; i<(int)order.size(); i++) {
+      next[i].swap(arr[order[i]]);
+    }
+    arr.swap(next);
+    h = (int)arr.size();
+    digests.clear();
     return true;
   }
 
   virtual RowRef insertRow(const RowRef& base) {
     int offset = base.getIndex();
     if (offset>=h) return RowRef();
+    // append and rotate into place, so rows are swapped rather than
+    // copied down to make room
+    arr.push_back(std::vector<T>(w,zero));
     if (offset<0) {
-      arr.push_back(std::vector<T>());
       offset = h;
     } else {
-      arr.insert(arr.begin()+offset,std::vector<T>());
+      std::rotate(arr.begin()+offset,arr.end()-1,arr.end());
+      digests.rowsInserted(offset,1);
     }
     h++;
-    for (int i=0; i<w; i++) {
-      arr[offset].push_back(zero);
-    }
     return RowRef(offset);
   }
 
@@ -185,16 +259,20 @@ public:
     int offset2 = base.getIndex();
     if (offset2>=h) return RowRef();
     //printf("Moving %d to %d\n", offset1, offset2);
-    if (offset2!=-1) {
-      int orig = offset1+((offset2<offset1)?1:0);
-      arr.insert(arr.begin()+offset2, arr[offset1]);
-      arr.erase(arr.begin()+orig);
-      if (offset2>offset1) offset2--;
-    } else {
-      arr.push_back(arr[offset1]);
-      arr.erase(arr.begin()+offset1);
+    // rotate rather than insert and erase, so the row is not copied
+    if (offset2==-1) {
+      std::rotate(arr.begin()+offset1,arr.begin()+offset1+1,arr.end());
       offset2 = (int)arr.size()-1;
+    } else if (offset2<offset1) {
+      std::rotate(arr.begin()+offset2,arr.begin()+offset1,
+		  arr.begin()+offset1+1);
+    } else if (offset2>offset1) {
+      std::rotate(arr.begin()+offset1,arr.begin()+offset1+1,
+		  arr.begin()+offset2);
+      offset2--;
     }
+    digests.rowsRemoved(offset1,1);
+    digests.rowsInserted(offset2,1);
     //printf("Move resulted in %d\n", offset2);
     return RowRef(offset2);
   }
@@ -216,6 +294,7 @@ public:
     arr.clear();
     h = 0;
     w = ss.getColumnCount();
+    digests.clear();
     return true;
   }
 
@@ -322,6 +401,22 @@ public:
     return s.deleteRow(src);
   }
 
+  virtual bool deleteRows(const RowRef& first, const RowRef& last) {
+    return s.deleteRows(first,last);
+  }
+
+  virtual bool deleteData(int offset = 0) {
+    return s.deleteData(offset);
+  }
+
+  virtual bool deleteRowSet(const std::vector<int>& rows) {
+    return s.deleteRowSet(rows);
+  }
+
+  virtual bool reorderRows(const std::vector<int>& order) {
+    return s.reorderRows(order);
+  }
+
   virtual RowRef insertRow(const RowRef& base) {
     return s.insertRow(base);
   }
@@ -335,6 +430,17 @@ public:
     return s.applySchema(ss);
   }
 
+  virtual bool updateRowDigests() {
+    s.digests.update(*this);
+    return true;
+  }
+
+  virtual const RowDigests *getRowDigests(int& offset) const {
+    if (!s.digests.isCurrent(*this)) return 0/*NULL*/;
+    offset = 0;
+    return &s.digests;
+  }
+
   virtual std::string getDescription() const {
     return "escaped";
   }
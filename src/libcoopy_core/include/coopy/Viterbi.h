@@ -2,15 +2,30 @@
 #define COOPY_VITERBI_INC
 
 #include <assert.h>
-#include <coopy/SparseSheet.h>
 #include <coopy/Dbg.h>
 
+#include <vector>
+
 namespace coopy {
   namespace cmp {
     class Viterbi;
   }
 }
 
+/**
+ *
+ * Find the cheapest path through a lattice of states, one step at a
+ * time.  Only states actually reached by a transition are stored: each
+ * step is a contiguous run of (state, cost, back-pointer) entries, and
+ * a dense state-to-entry table is kept for the current and previous
+ * step.  Storage is retained across reset()/setSize() so a single
+ * instance can be reused for repeated calculations.
+ *
+ * Optionally, a beam can be set.  At the end of each step, states
+ * costing more than the step's cheapest state plus the beam are
+ * dropped.
+ *
+ */
 class coopy::cmp::Viterbi {
 public:
   int K;
@@ -19,24 +34,27 @@ public:
   int mode;
   int path_valid;
   float best_cost;
-  coopy::store::SparseFloatSheet cost;
-  coopy::store::SparseIntSheet src;
-  coopy::store::SparseIntSheet path;
+  float beam;
 
   Viterbi() {
-      K = T = 0;
-      reset();
-    }
+    K = T = 0;
+    beam = 0;
+    reset();
+  }
 
   void setSize(int states, int sequence_length);
 
-  void reset()
-    {
-      index = 0;
-      mode = 0;
-      path_valid = 0;
-      best_cost = 0;
-    }
+  /**
+   *
+   * Set the cost margin beyond which states are pruned at the end of
+   * each step.  Zero (the default) disables pruning.
+   *
+   */
+  void setBeam(float beam) {
+    this->beam = beam;
+  }
+
+  void reset();
 
   void assertMode(int n_mode);
 
@@ -66,7 +84,7 @@ public:
   int getPath(int i) {
     calculatePath();
     COOPY_ASSERT(i<index);
-    return path(0,i);
+    return path[i];
   }
 
   int operator() (int i) {
@@ -77,6 +95,21 @@ public:
     calculatePath();
     return best_cost;
   }
+
+private:
+  std::vector<int> step_start;
+  std::vector<int> state;
+  std::vector<float> cost;
+  std::vector<int> src;
+  std::vector<int> slot_prev;
+  std::vector<int> slot_curr;
+  std::vector<int> path;
+
+  void growStates(int k);
+
+  void beginStep();
+
+  void endStep();
 };
 
 
@@ -3,9 +3,13 @@
 #include <coopy/CsvFile.h>
 #include <coopy/FormatSniffer.h>
 #include <coopy/unistdio.h>
+#include <coopy/FileIO.h>
+#include <coopy/Hasher.h>
 
 #include <algorithm>
 
+#include <limits.h>
+
 using namespace coopy::store;
 using namespace coopy::format;
 using namespace std;
@@ -44,9 +48,24 @@ std::string CsvTextBook::writeCsvsData() {
 }
 
 bool CsvTextBook::readCsvs(const char *fname) {
+  Property config;
+  return readCsvs(fname,config);
+}
+
+bool CsvTextBook::readCsvs(const char *fname, const Property& config) {
+  Property p;
+  // only these of the book's options apply to parsing
+  if (config.check("read_threads")) {
+    p.put("read_threads",config.get("read_threads").asInt());
+  }
+  if (config.check("chunk_bytes")) {
+    p.put("chunk_bytes",config.get("chunk_bytes").asInt());
+  }
   if (compact) {
     clear();
-    Property p;
+    if (string(fname)!="-") {
+      if (readCsvsIndexed(fname,p)) return true;
+    }
     if (CsvFile::read(fname,*this,p)!=0) {
       fprintf(stderr,"Failed to read %s\n", fname);
       return false;
@@ -59,7 +78,7 @@ bool CsvTextBook::readCsvs(const char *fname) {
   }
 
   CsvSheet index;
-  if (CsvFile::read(fname,index)!=0) {
+  if (CsvFile::read(fname,index,p)!=0) {
     fprintf(stderr,"Failed to read %s\n", fname);
     return false;
   }
@@ -77,7 +96,7 @@ bool CsvTextBook::readCsvs(const char *fname) {
 	fprintf(stderr,"Failed to allocated data sheet\n");
 	return false;
       }
-      if (CsvFile::read(f.c_str(),*data)!=0) {
+      if (CsvFile::read(f.c_str(),*data,p)!=0) {
 	fprintf(stderr,"Failed to read %s referenced from %s\n", f.c_str(),
 		fname);
 	delete data;
@@ -91,6 +110,119 @@ bool CsvTextBook::readCsvs(const char *fname) {
   return true;
 }
 
+bool CsvTextBook::readCsvsIndexed(const char *fname, const Property& config) {
+  FileIO fp;
+  if (!fp.open(fname,config)) return false;
+  string data;
+  char buf[32768];
+  size_t bytes_read;
+  while ((bytes_read=fp.fread(buf,1,sizeof(buf)))>0) {
+    data.append(buf,bytes_read);
+  }
+  fp.close();
+
+  // parse parts as they would be parsed as part of the whole file
+  SheetStyle style;
+  style.setFromFilename(fname);
+  part_config = config;
+  part_config.put("delimiter",style.getDelimiter());
+
+  vector<string> found;
+  vector<size_t> starts;
+  vector<size_t> ends;
+  if (!CsvFile::indexSheets(data.c_str(),data.length(),part_config,
+			    found,starts,ends)) {
+    if (data.length()>(size_t)INT_MAX) return false;
+    if (CsvFile::read(data.c_str(),(int)data.length(),*this,
+		      part_config)!=0) {
+      return false;
+    }
+    for (int i=0; i<(int)sheets.size(); i++) {
+      sheets[i].setRowOffset();
+    }
+    dbg_printf("Read CSVS file %s\n", fname);
+    return true;
+  }
+
+  raw.swap(data);
+  for (int i=0; i<(int)found.size(); i++) {
+    name2index[found[i]] = (int)sheets.size();
+    sheets.push_back(PolySheet());
+    names.push_back(found[i]);
+    spans.push_back(pair<size_t,size_t>(starts[i],starts[i+1]));
+    content.push_back(ends[i]);
+    part_hashes.push_back("");
+  }
+  unread = (int)found.size();
+  named = true;
+  dbg_printf("Indexed CSVS file %s, %d sheets\n", fname, unread);
+  return true;
+}
+
+bool CsvTextBook::readPart(int index) {
+  size_t start = spans[index].first;
+  size_t len = spans[index].second-start;
+  if (len>(size_t)INT_MAX) {
+    fprintf(stderr,"Sheet %s is too large\n", names[index].c_str());
+    return false;
+  }
+  CsvTextBook part(true);
+  if (CsvFile::read(raw.c_str()+start,(int)len,part,part_config)!=0 ||
+      part.sheets.size()!=1) {
+    fprintf(stderr,"Failed to read sheet %s\n", names[index].c_str());
+    return false;
+  }
+  sheets[index] = part.sheets[0];
+  sheets[index].setRowOffset();
+  // the digests go stale if the sheet is changed, and the hash of
+  // its text with them
+  if (sheets[index].updateRowDigests()) {
+    part_hashes[index] = hashPart(index);
+  }
+  spans[index] = pair<size_t,size_t>(0,0);
+  unread--;
+  if (unread==0) {
+    string().swap(raw);
+  }
+  dbg_printf("Read CSVS sheet %s\n", names[index].c_str());
+  return true;
+}
+
+PolySheet CsvTextBook::readSheet(const std::string& name) {
+  map<string,int>::const_iterator it = name2index.find(name);
+  if (it==name2index.end()) {
+    return PolySheet();
+  }
+  int index = it->second;
+  if (index<(int)spans.size()&&spans[index].second>spans[index].first) {
+    if (!readPart(index)) return PolySheet();
+  }
+  return sheets[index];
+}
+
+std::string CsvTextBook::getSheetHash(const std::string& name) {
+  map<string,int>::const_iterator it = name2index.find(name);
+  if (it==name2index.end()) return "";
+  int index = it->second;
+  if (index>=(int)spans.size()) return "";
+  if (spans[index].second>spans[index].first) return hashPart(index);
+  // once a sheet is read it may be changed, so its text is only
+  // vouched for while its row digests are current
+  int offset = 0;
+  if (sheets[index].getRowDigests(offset)==0/*NULL*/) return "";
+  return part_hashes[index];
+}
+
+std::string CsvTextBook::hashPart(int index) const {
+  size_t start = spans[index].first;
+  // blank rows after a sheet depend on where it sits in the file
+  size_t stop = content[index];
+  FastHasher hasher;
+  hasher.add(part_config.get("delimiter").asString());
+  hasher.add(raw.c_str()+start,(int)(stop-start));
+  return hasher.finish();
+}
+
 bool CsvTextBook::write(const char *fname, TextBook *book, bool compact,
 			std::string *output) {
   if (fname==NULL && output==NULL) return false;
@@ -132,6 +132,9 @@ int Diff::apply(const Options& opt) {
   PolyBook *local = &_local;
   PolyBook _remote;
   PolyBook *remote = &_remote;
+  _pivot.setThreads(flags.read_threads);
+  _local.setThreads(flags.read_threads);
+  _remote.setThreads(flags.read_threads);
 
   string local_file;
   if (core.size()>=1) {
@@ -478,6 +478,46 @@ Options::Options(const char *name) : name(name) {
       "context=N",
       "Number of rows of context before and after changes for highlighter diffs (\"all\" to include all rows)");
 
+  add(OPTION_FOR_DIFF|OPTION_FOR_MERGE|OPTION_FOR_REDIFF,
+      "hash-features",
+      "match rows using hashed text fragments rather than the fragments themselves (faster on wide text tables)");
+
+  add(OPTION_FOR_DIFF|OPTION_FOR_MERGE|OPTION_FOR_REDIFF,
+      "lsh=BANDS",
+      "for fuzzy row matching, only compare rows whose MinHash signatures collide in one of BANDS bands (16 is a reasonable start; for very large tables)");
+
+  add(OPTION_FOR_DIFF|OPTION_FOR_MERGE|OPTION_FOR_REDIFF,
+      "key-join",
+      "match rows with identical values in a unique key (from the schema, or guessed) directly, before any fuzzy matching");
+
+  add(OPTION_FOR_DIFF|OPTION_FOR_PATCH|OPTION_FOR_MERGE|OPTION_FOR_FORMAT|OPTION_FOR_REDIFF,
+      "threads=N",
+      "use up to N threads when matching (pivot/local and pivot/remote are matched concurrently)");
+
+  add(OPTION_FOR_DIFF|OPTION_FOR_PATCH|OPTION_FOR_MERGE|OPTION_FOR_FORMAT|OPTION_FOR_REDIFF,
+      "read-threads=N",
+      "parse large CSV files in parts on up to N threads; the whole file is held in memory first, so this only pays off with several cores");
+
+  add(OPTION_FOR_DIFF|OPTION_FOR_MERGE|OPTION_FOR_REDIFF,
+      "time-budget=MS",
+      "stop refining the match of a table after MS milliseconds, and go with what has been matched so far (rows left over appear as inserts/deletes)");
+
+  add(OPTION_FOR_DIFF|OPTION_FOR_MERGE|OPTION_FOR_REDIFF,
+      "memory-budget=MB",
+      "likewise, stop refining the match if the process grows beyond MB megabytes");
+
+  add(OPTION_FOR_DIFF|OPTION_FOR_MERGE|OPTION_FOR_REDIFF,
+      "feature-cache=BYTES",
+      "memory to spend on keeping text fragments of rows between matching passes (default 128MB); beyond that fragments are worked out again as needed");
+
+  add(OPTION_FOR_DIFF|OPTION_FOR_MERGE|OPTION_FOR_REDIFF,
+      "typed-compare",
+      "compare numbers, dates and booleans by value rather than as text, so that for example 1.0 and 1 count as the same");
+
+  add(OPTION_FOR_DIFF|OPTION_FOR_MERGE|OPTION_FOR_REDIFF,
+      "beam=COST",
+      "when ordering rows, drop candidate alignments costing more than COST above the best one (faster on large tables, may miss matches)");
+
   add(OPTION_FOR_DIFF|OPTION_FOR_REDIFF|OPTION_FOR_PATCH,
       "act=ACT",
       "filter for an action of a particular type (update, insert, delete, none, schema)");
@@ -872,6 +912,16 @@ int Options::apply(int argc, char *argv[]) {
       {(char*)"git", 0, 0, 0},
 
       {(char*)"context", 1, 0, 0},
+      {(char*)"beam", 1, 0, 0},
+      {(char*)"hash-features", 0, 0, 0},
+      {(char*)"lsh", 1, 0, 0},
+      {(char*)"key-join", 0, 0, 0},
+      {(char*)"threads", 1, 0, 0},
+      {(char*)"read-threads", 1, 0, 0},
+      {(char*)"time-budget", 1, 0, 0},
+      {(char*)"memory-budget", 1, 0, 0},
+      {(char*)"feature-cache", 1, 0, 0},
+      {(char*)"typed-compare", 0, 0, 0},
 
       {0, 0, 0, 0}
     };
@@ -1004,6 +1054,26 @@ int Options::apply(int argc, char *argv[]) {
 	  flags.context_lines = atoi(optarg);
 	  if (string(optarg)=="all") flags.context_lines = -1;
 	  if (string(optarg)=="default") flags.context_lines = -2;
+	} else if (k=="beam") {
+	  flags.viterbi_beam = atof(optarg);
+	} else if (k=="hash-features") {
+	  flags.hash_features = true;
+	} else if (k=="lsh") {
+	  flags.lsh_bands = atoi(optarg);
+	} else if (k=="key-join") {
+	  flags.key_join = true;
+	} else if (k=="threads") {
+	  flags.threads = atoi(optarg);
+	} else if (k=="read-threads") {
+	  flags.read_threads = atoi(optarg);
+	} else if (k=="time-budget") {
+	  flags.time_budget = atoi(optarg);
+	} else if (k=="memory-budget") {
+	  flags.memory_budget = atoi(optarg);
+	} else if (k=="feature-cache") {
+	  flags.feature_cache = atoi(optarg);
+	} else if (k=="typed-compare") {
+	  flags.typed_compare = true;
 	} else {
 	  fprintf(stderr,"Unknown option %s\n", k.c_str());
 	  return 1;
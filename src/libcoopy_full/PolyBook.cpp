@@ -313,6 +313,9 @@ bool PolyBook::attach(Property& config, PolyBook *base) {
 
   bool ok = expand(config);
   if (!ok) return false;
+  if (threads>1&&!config.check("read_threads")) {
+    config.put("read_threads",threads);
+  }
 
   string filename = config.get("expanded_filename").asString();
   string ext = config.get("expanded_ext").asString();
@@ -376,6 +379,18 @@ std::vector<FormatDesc> PolyBook::getFormatList() {
   csv.addOption("type",STRVAL("csv"),"CSV family",true);
   csv.addOption("file",STRVAL("fname.dsv"),"File name",true);
   csv.addOption("delimiter",STRVAL("|"),"Delimiter character",true);
+  csv.addOption("fast_scan",PolyValue::makeBoolean(false),
+		"Set false to parse field text one character at a time",true);
+  csv.addOption("columnar",PolyValue::makeBoolean(true),
+		"Store the table a column at a time, more compactly",true);
+  csv.addOption("dictionary",PolyValue::makeBoolean(true),
+		"With columnar, store repeated cell text once per column",true);
+  csv.addOption("mmap",PolyValue::makeBoolean(true),
+		"Map the file into memory and read it in place, read-only",true);
+  csv.addOption("read_threads",PolyValue::makeInt(4),
+		"Hold the file in memory and parse it in parts on up to this many threads",true);
+  csv.addOption("chunk_bytes",PolyValue::makeInt(1048576),
+		"With read_threads, the least number of bytes in each part",true);
   descs.push_back(csv);
 
   getFactoriesList(descs);
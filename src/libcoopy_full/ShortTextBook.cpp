@@ -11,5 +11,20 @@ bool ShortTextBook::open(const Property& config) {
   if (config.check("name")) {
     name = config.get("name").asString();
   }
-  return CsvFile::read(config.get("file").asString().c_str(),sheet,config)==0;
+  return read(config.get("file").asString().c_str(),config);
+}
+
+bool ShortTextBook::read(const char *fname, const Property& config) {
+  use_mmap = false;
+  if (config.flag("mmap",false)) {
+    use_mmap = mapped.open(fname,config);
+    if (use_mmap) return true;
+    dbg_printf("Cannot map %s, reading it instead\n", fname);
+  }
+  use_columnar = config.flag("columnar",false);
+  if (use_columnar) {
+    columnar.setDictionary(config.flag("dictionary",false));
+    return CsvFile::read(fname,columnar,config)==0;
+  }
+  return CsvFile::read(fname,sheet,config)==0;
 }
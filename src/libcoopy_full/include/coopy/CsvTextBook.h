@@ -25,6 +25,7 @@ class coopy::store::CsvTextBook : public TextBook, public CsvSheetReader {
 public:
   CsvTextBook(bool compact) : compact(compact) {
     named = true;
+    unread = 0;
   }
 
   std::vector<PolySheet> sheets;
@@ -35,22 +36,25 @@ public:
     return names;
   }
 
-  virtual PolySheet readSheet(const std::string& name) {
-    if (name2index.find(name)!=name2index.end()) {
-      return sheets[name2index[name]];
-    }
-    return PolySheet();
-  }
+  virtual PolySheet readSheet(const std::string& name);
+
+  virtual std::string getSheetHash(const std::string& name);
 
   bool clear() {
     sheets.clear();
     names.clear();
     name2index.clear();
+    spans.clear();
+    content.clear();
+    part_hashes.clear();
+    raw = "";
     return true;
   }
   
   bool readCsvs(const char *fname);
 
+  bool readCsvs(const char *fname, const Property& config);
+
   bool readCsvsData(const char *data, int len);
 
   std::string writeCsvsData();
@@ -75,6 +79,23 @@ public:
 private:
   bool compact;
   bool named;
+
+  // text of a .csvs file whose sheets are parsed when first read
+  std::string raw;
+  // where each sheet not yet parsed lies in raw (empty if parsed)
+  std::vector<std::pair<size_t,size_t> > spans;
+  // where the rows of each sheet end in raw, before blank rows
+  std::vector<size_t> content;
+  // hash of the text each sheet was parsed from, once it is read
+  std::vector<std::string> part_hashes;
+  int unread;
+  Property part_config;
+
+  bool readCsvsIndexed(const char *fname, const Property& config);
+
+  bool readPart(int index);
+
+  std::string hashPart(int index) const;
 };
 
 
@@ -123,7 +144,7 @@ public:
 	}
 	if (ok) {
 	  dbg_printf("reading csv file %s\n", config.options.get("file").asString().c_str());
-	  bool r = book->readCsvs(config.fname.c_str());
+	  bool r = book->readCsvs(config.fname.c_str(),config.options);
 	  if (!r) {
 	    delete book;
 	    book = NULL;
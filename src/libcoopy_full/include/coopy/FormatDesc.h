@@ -89,10 +89,12 @@ public:
 	PolyValue v = o.val;
 	if (o.val.isString()) {
 	  result += "\"";
-	}
-	result += o.val.asString();
-	if (o.val.isString()) {
+	  result += o.val.asString();
 	  result += "\"";
+	} else if (o.val.isBoolean()) {
+	  result += o.val.asBoolean()?"true":"false";
+	} else {
+	  result += o.val.toString();
 	}
 	if (i<(int)opts.size()-1) {
 	  result += ",";
@@ -22,9 +22,11 @@ class coopy::store::PolyBook : public TextBook {
 private:
   TextBook *book;
   coopy::store::Property options;
+  int threads;
 public:
   PolyBook() {
     book = 0/*NULL*/;
+    threads = 1;
   }
 
   virtual ~PolyBook() {
@@ -59,6 +61,7 @@ public:
 
   PolyBook(const PolyBook& alt) {
     book = alt.book;
+    threads = alt.threads;
     if (book!=0) {
       book->addReference();
     }
@@ -91,8 +94,25 @@ public:
     return PolySheet();
   }
 
+  virtual std::string getSheetHash(const std::string& name) {
+    if (book) {
+      return book->getSheetHash(name);
+    }
+    return "";
+  }
+
   bool isValid() const { return book!=NULL; }
 
+  /**
+   *
+   * Allow CSV files to be read on up to the given number of threads.
+   * Applies to books attached from now on.
+   *
+   */
+  void setThreads(int threads) {
+    this->threads = threads;
+  }
+
   bool readForReference(const char *fname, PolyBook& base) {
     return read(fname,NULL,&base);
   }
@@ -3,6 +3,8 @@
 
 #include <coopy/TextBook.h>
 #include <coopy/CsvSheet.h>
+#include <coopy/ColumnarSheet.h>
+#include <coopy/MmapCsvSheet.h>
 #include <coopy/TextBookFactory.h>
 #include <coopy/Dbg.h>
 
@@ -22,9 +24,15 @@ public:
   std::string name;
   int provides;
   CsvSheet sheet;
+  ColumnarSheet columnar;
+  bool use_columnar;
+  MmapCsvSheet mapped;
+  bool use_mmap;
 
   ShortTextBook() : name(coopy_get_default_table_name()) {
     provides = 0;
+    use_columnar = false;
+    use_mmap = false;
   }
 
   virtual std::vector<std::string> getNames() {
@@ -35,6 +43,12 @@ public:
 
   virtual PolySheet readSheet(const std::string& name) {
     if (name==this->name) {
+      if (use_mmap) {
+	return PolySheet(&mapped,false);
+      }
+      if (use_columnar) {
+	return PolySheet(&columnar,false);
+      }
       return PolySheet(&sheet,false);
     }
     return PolySheet();
@@ -42,6 +56,19 @@ public:
 
   virtual bool open(const Property& config);
 
+  /**
+   *
+   * Read a CSV file.  If the "columnar" option is set, the table is
+   * stored in a ColumnarSheet rather than a CsvSheet, which is more
+   * compact for large inputs.  The "dictionary" option additionally
+   * enables dictionary encoding of columns.  If the "mmap" option is
+   * set, the file is mapped into memory and read in place, as a
+   * read-only MmapCsvSheet; this falls back to a normal read for
+   * input that cannot be mapped, such as standard input.
+   *
+   */
+  bool read(const char *fname, const Property& config);
+
   virtual PolySheet provideSheet(const SheetSchema& schema) {
     if (provides==0) {
       provides++;
@@ -44,8 +44,7 @@ class coopy::store::ShortTextBookFactory : public TextBookFactory {
     if (config.shouldRead) {
       if (!config.options.check("should_attach")) {
 	dbg_printf("reading csv file %s\n", config.options.get("file").asString().c_str());
-	int r = CsvFile::read(config.fname.c_str(),book->sheet,config.options);
-	if (r!=0) {
+	if (!book->read(config.fname.c_str(),config.options)) {
 	  delete book;
 	  book = NULL;
 	}
@@ -10,18 +10,25 @@ extern "C" {
 
 #include <coopy/CsvRead.h>
 #include <coopy/CsvSheet.h>
+#include <coopy/ColumnarSheet.h>
 #include <coopy/Stringer.h>
 #include <coopy/FileIO.h>
+#include <coopy/TaskGroup.h>
 
 #include <string.h>
 
 using namespace std;
 using namespace coopy::store;
+using namespace coopy::os;
+
+// smallest part of a file given to a thread when reading in parallel
+#define CSV_CHUNK_BYTES (1024*1024)
 
 class CsvSheetReaderState {
 public:
   CsvSheetReader *reader;
   CsvSheet *sheet;
+  ColumnarSheet *columnar;
   SheetStyle style;
   bool expecting;
   bool ignore;
@@ -33,6 +40,7 @@ public:
   CsvSheetReaderState() {
     reader = NULL;
     sheet = NULL;
+    columnar = NULL;
     expecting = true;
     ignore = false;
     name = "";
@@ -46,12 +54,23 @@ public:
     if (sheet!=NULL) {
       sheet->setStyle(style);
     }
+    if (columnar!=NULL) {
+      columnar->setStyle(style);
+    }
   }
 
   void clear() {
     if (sheet!=NULL) {
       sheet->clear();
     }
+    if (columnar!=NULL) {
+      columnar->clear();
+    }
+  }
+
+  DataSheet *getSheet() {
+    if (columnar!=NULL) return columnar;
+    return sheet;
   }
 
   bool addSheet(const char *name,bool named) {
@@ -104,11 +123,44 @@ public:
 };
 
 
+template <class T>
+static void csvfile_add_field(T *sheet, void *s, size_t i) {
+  if (sheet->getStyle().haveNullToken()) {
+    string token = sheet->getStyle().getNullToken();
+    if (token.length()==i){
+      if (memcmp(s,token.c_str(),i)==0) {
+        sheet->addField((char *)s, i, true);
+        return;
+      }
+    }
+    if (sheet->getStyle().quoteCollidingText()) {
+      int score = 0;
+      for (score=0; score<(int)i; score++) {
+        if (((char*)s)[score]!='_') {
+          break;
+        }
+      }
+      if (score>0) {
+        if (memcmp(((char*)s)+score,token.c_str(),i-score)==0) {
+          sheet->addField((char*)s+1,i-1,false);
+          return;
+        }
+      }
+    }
+  }
+  sheet->addField((char *)s, i, false);
+}
+
 extern "C" void csvfile_merge_cb1 (void *s, size_t i, void *p, int quoted) {
   CsvSheetReaderState *state = (CsvSheetReaderState*)p;
   CsvSheet *sheet = state->sheet;
   char *str = (char *)s;
 
+  if (state->columnar!=NULL) {
+    csvfile_add_field(state->columnar,s,i);
+    return;
+  }
+
   /*
   printf("Expecting? %d  Reader? %d  WORKING ON ",
 	 state->expecting, state->reader!=NULL);
@@ -152,36 +204,17 @@ extern "C" void csvfile_merge_cb1 (void *s, size_t i, void *p, int quoted) {
   }
   if (sheet!=NULL) {
     state->expecting = false;
-    if (sheet->getStyle().haveNullToken()) {
-      string token = sheet->getStyle().getNullToken();
-      if (token.length()==i){
-	if (memcmp(s,token.c_str(),i)==0) {
-	  sheet->addField((char *)s, i, true);
-	  return;
-	}
-      }
-      if (sheet->getStyle().quoteCollidingText()) {
-	int score = 0;
-	for (score=0; score<(int)i; score++) {
-	  if (((char*)s)[score]!='_') {
-	    break;
-	  }
-	}
-	if (score>0) {
-	  if (memcmp(((char*)s)+score,token.c_str(),i-score)==0) {
-	    sheet->addField((char*)s+1,i-1,false);
-	    return;
-	  }
-	}
-      }
-    }
-    sheet->addField((char *)s, i, false);
+    csvfile_add_field(sheet,s,i);
   }
 }
 
 extern "C" void csvfile_merge_cb2 (int c, void *p) {
   CsvSheetReaderState *state = (CsvSheetReaderState*)p;
   CsvSheet *sheet = state->sheet;
+  if (state->columnar!=NULL) {
+    state->columnar->addRecord();
+    return;
+  }
   state->expecting = true;
   if (sheet==NULL) {
     return;
@@ -193,11 +226,173 @@ extern "C" void csvfile_merge_cb2 (int c, void *p) {
   sheet->addRecord();
 }
 
+/**
+ *
+ * One part of a CSV file, parsed on its own thread.  Rows are kept as
+ * cells ready for a CsvSheet.  Rows that might start with a table
+ * name or header break (or every row, if the destination needs fields
+ * one at a time) instead keep their fields as parsed, along with
+ * whether they were quoted, to go through the usual callbacks.
+ *
+ */
+class CsvChunk : public Task {
+public:
+  const char *data;
+  size_t len;
+  unsigned char options;
+  unsigned char delim;
+  SheetStyle style;
+  bool check_marks;
+  bool all_raw;
+  bool ok;
+
+  vector<vector<pair<string,bool> > > rows;
+  // rows kept as parsed, in order
+  vector<int> raw;
+  bool row_begun;
+  bool row_raw;
+
+  CsvChunk() {
+    data = NULL;
+    len = 0;
+    options = 0;
+    delim = ',';
+    check_marks = false;
+    all_raw = false;
+    ok = true;
+    row_begun = false;
+    row_raw = false;
+  }
+
+  const SheetStyle& getStyle() {
+    return style;
+  }
+
+  void addField(const char *s, int len, bool escaped) {
+    // CsvSheet::addField stops at a nul
+    const char *z = (const char *)memchr(s,'\0',len);
+    if (z!=NULL) len = (int)(z-s);
+    rows.back().push_back(pair<string,bool>(string(s,len),escaped));
+  }
+
+  virtual void run();
+};
+
+// true if csvfile_merge_cb1 might take this first field of a row as a
+// table name or header break rather than as data
+static bool csvfile_might_mark(const char *str, size_t i) {
+  if (i>4&&str[0]=='='&&str[1]=='='&&str[2]==' ') return true;
+  if (i<=3) return false;
+  for (size_t q=0; q<i; q++) {
+    if (str[q]!='-'&&str[q]!='\n'&&str[q]!='\r') return false;
+  }
+  return true;
+}
+
+extern "C" void csvfile_chunk_cb1 (void *s, size_t i, void *p, int quoted) {
+  CsvChunk *chunk = (CsvChunk*)p;
+  if (!chunk->row_begun) {
+    chunk->rows.push_back(vector<pair<string,bool> >());
+    if (chunk->rows.size()>1) {
+      // rows are usually all the same width
+      chunk->rows.back().reserve(chunk->rows[chunk->rows.size()-2].size());
+    }
+    chunk->row_begun = true;
+    chunk->row_raw = chunk->all_raw ||
+      (chunk->check_marks && !quoted && csvfile_might_mark((char*)s,i));
+    if (chunk->row_raw) {
+      chunk->raw.push_back((int)chunk->rows.size()-1);
+    }
+  }
+  if (chunk->row_raw) {
+    chunk->rows.back().push_back(pair<string,bool>(string((char*)s,i),
+						   quoted!=0));
+    return;
+  }
+  csvfile_add_field(chunk,s,i);
+}
+
+extern "C" void csvfile_chunk_cb2 (int c, void *p) {
+  CsvChunk *chunk = (CsvChunk*)p;
+  chunk->row_begun = false;
+}
+
+void CsvChunk::run() {
+  struct csv_parser p;
+  if (csv_init(&p,options)!=0) {
+    ok = false;
+    return;
+  }
+  csv_set_delim(&p,delim);
+  if (csv_parse(&p,data,len,csvfile_chunk_cb1,csvfile_chunk_cb2,
+		(void*)this) != len) {
+    ok = false;
+  }
+  csv_fini(&p,csvfile_chunk_cb1,csvfile_chunk_cb2,(void*)this);
+  csv_free(&p);
+}
+
+// add the rows of a chunk to dest, as the callbacks would have
+static void csvfile_merge_chunk(CsvChunk& chunk, CsvSheetReaderState& dest) {
+  size_t at = 0;
+  vector<char> buf;
+  for (int y=0; y<(int)chunk.rows.size(); y++) {
+    vector<pair<string,bool> >& row = chunk.rows[y];
+    if (at<chunk.raw.size()&&chunk.raw[at]==y) {
+      at++;
+      for (int x=0; x<(int)row.size(); x++) {
+	// the callback may look one past the field, and write into it
+	const string& txt = row[x].first;
+	buf.assign(txt.begin(),txt.end());
+	buf.push_back('\0');
+	csvfile_merge_cb1(&buf[0],txt.length(),(void*)(&dest),row[x].second);
+      }
+      csvfile_merge_cb2('\n',(void*)(&dest));
+    } else {
+      // the first field is plain data, so the row goes to the
+      // current sheet as is
+      if (dest.sheet==NULL) {
+	dest.addSheet(coopy_get_default_table_name(),false);
+      }
+      if (dest.sheet!=NULL) {
+	dest.sheet->addRecord(row);
+      }
+      dest.expecting = true;
+    }
+    vector<pair<string,bool> >().swap(row);
+  }
+  vector<vector<pair<string,bool> > >().swap(chunk.rows);
+}
+
+/**
+ *
+ * Finds, for one part of a CSV file, the state parsing would end in
+ * from each state it could start in.
+ *
+ */
+class CsvScan : public Task {
+public:
+  struct csv_parser *parser;
+  const char *data;
+  size_t len;
+  int states[CSV_SCAN_STATES];
+
+  virtual void run() {
+    csv_scan_all(parser,data,len,states);
+  }
+};
+
+// libcsv options for reading with config
+static unsigned char csv_options(const Property& config) {
+  // "fast_scan" is on unless turned off, to compare with plain csv_parse
+  return config.flag("fast_scan",true)?CSV_FAST_SCAN:0;
+}
+
 int CsvFile::read(coopy::format::Reader& reader, CsvSheet& dest, 
 		  const Property& config) {
   string cache = "";
   struct csv_parser p;
-  if (csv_init(&p,0)!=0) {
+  if (csv_init(&p,csv_options(config))!=0) {
     fprintf(stderr,"csv failed to initialize\n");
     exit(1);
   }
@@ -233,6 +428,90 @@ int CsvFile::read(coopy::format::Reader& reader, CsvSheet& dest,
 }
 
 
+// parse data held in memory on up to the given number of threads,
+// with the same result as a single csv_parse
+static bool read_parallel(const char *src, size_t len, 
+			  CsvSheetReaderState& dest, const Property& config,
+			  int threads) {
+  size_t step = len/(threads*4)+1;
+  size_t least = (size_t)config.get("chunk_bytes",
+				    PolyValue::makeInt(CSV_CHUNK_BYTES)).asInt();
+  if (least<1) least = 1;
+  if (step<least) step = least;
+  int n = (int)((len+step-1)/step);
+  if (n<1) n = 1;
+
+  struct csv_parser p;
+  if (csv_init(&p,csv_options(config))!=0) {
+    fprintf(stderr,"csv failed to initialize\n");
+    exit(1);
+  }
+  csv_set_delim(&p,dest.style.getDelimiter()[0]);
+
+  // First guess at where parts start
+  vector<size_t> at(n+1);
+  for (int k=0; k<n; k++) {
+    at[k] = step*k;
+  }
+  at[n] = len;
+
+  // Pass 1: without knowing whether a part starts in a quoted field,
+  // or anywhere else, work out where it would end up from each case
+  vector<CsvScan> scans(n);
+  TaskGroup group(threads);
+  for (int k=0; k<n-1; k++) {
+    scans[k].parser = &p;
+    scans[k].data = src+at[k];
+    scans[k].len = at[k+1]-at[k];
+    group.add(scans[k]);
+  }
+  group.run();
+
+  // Now the state at the start of each part is known, so each can be
+  // moved on to the start of a row.  A part with no row starting in it
+  // joins the part before.
+  vector<size_t> cuts;
+  cuts.push_back(0);
+  int state = 0;
+  for (int k=1; k<n; k++) {
+    state = scans[k-1].states[state];
+    int row_state = state;
+    size_t skip = csv_scan(&p,src+at[k],at[k+1]-at[k],&row_state,1);
+    if (row_state==0) {
+      size_t cut = at[k]+skip;
+      if (cut>cuts.back()&&cut<len) cuts.push_back(cut);
+    }
+  }
+  cuts.push_back(len);
+  csv_free(&p);
+  dbg_printf("CsvFile::read in %d parts on %d threads\n", 
+	     (int)cuts.size()-1, threads);
+
+  // Pass 2: each part starts a row, so parse them separately
+  int parts = (int)cuts.size()-1;
+  vector<CsvChunk> chunks(parts);
+  for (int k=0; k<parts; k++) {
+    CsvChunk& chunk = chunks[k];
+    chunk.data = src+cuts[k];
+    chunk.len = cuts[k+1]-cuts[k];
+    chunk.options = csv_options(config);
+    chunk.delim = dest.style.getDelimiter()[0];
+    chunk.style = dest.style;
+    chunk.check_marks = (dest.reader!=NULL);
+    chunk.all_raw = (dest.columnar!=NULL);
+    group.add(chunk);
+  }
+  group.run();
+
+  // and stitch them together in order
+  bool ok = true;
+  for (int k=0; k<parts; k++) {
+    if (!chunks[k].ok) ok = false;
+    csvfile_merge_chunk(chunks[k],dest);
+  }
+  return ok;
+}
+
 // len = -1: file
 // len >= 0: in memory
 static int read(const char *src, int len, CsvSheetReaderState& dest, 
@@ -243,7 +522,7 @@ static int read(const char *src, int len, CsvSheetReaderState& dest,
   size_t bytes_read;
   struct csv_parser p;
   dest.clear();
-  if (csv_init(&p,0)!=0) {
+  if (csv_init(&p,csv_options(config))!=0) {
     fprintf(stderr,"csv failed to initialize\n");
     exit(1);
   }
@@ -257,6 +536,9 @@ static int read(const char *src, int len, CsvSheetReaderState& dest,
 
   bool need_close = true;
 
+  int threads = config.get("read_threads").asInt();
+  if (!TaskGroup::isThreaded()) threads = 1;
+
   if (fromFile) {
     if (!fp.open(src,config)) {
       fprintf(stderr,"CsvRead: could not open %s\n", src);
@@ -282,6 +564,22 @@ static int read(const char *src, int len, CsvSheetReaderState& dest,
       fprintf(stderr,"error parsing standard input\n");
       exit(1);
     }
+  } else if (threads>1) {
+    // parse all at once, on several threads
+    string all;
+    const char *data = src;
+    size_t data_len = (size_t)len;
+    if (fp.isValid()) {
+      while ((bytes_read=fp.fread(buf,1,sizeof(buf)))>0) {
+	all.append(buf,bytes_read);
+      }
+      data = all.c_str();
+      data_len = all.length();
+    }
+    if (!read_parallel(data,data_len,dest,config,threads)) {
+      fprintf(stderr,"error parsing %s\n", fromFile?src:"data");
+      exit(1);
+    }
   } else if (fp.isValid()) {
     while ((bytes_read=fp.fread(buf,1,sizeof(buf)))>0) {
       if (csv_parse(&p,
@@ -314,7 +612,7 @@ static int read(const char *src, int len, CsvSheetReaderState& dest,
   csv_free(&p);
 
   if (config.get("flip_vertical").asInt()!=0) {
-    CsvSheet *sheet = dest.sheet;
+    DataSheet *sheet = dest.getSheet();
     for (int y=0; y<sheet->height()/2; y++) {
       int y2 = sheet->height()-1-y;
       for (int x=0; x<sheet->width(); x++) {
@@ -328,6 +626,129 @@ static int read(const char *src, int len, CsvSheetReaderState& dest,
   return 0;
 }
 
+// collects where rows begin that name a table
+class CsvSheetIndex {
+public:
+  const char *data;
+  size_t len;
+  unsigned char delim;
+  vector<size_t> marks;
+  // set if anything but table names and their rows was seen
+  bool irregular;
+};
+
+extern "C" void csvfile_index_cb (size_t pos, void *p) {
+  CsvSheetIndex *index = (CsvSheetIndex*)p;
+  const char *str = index->data+pos;
+  size_t rest = index->len-pos;
+  bool mark = false;
+  if (str[0]!='"') {
+    const unsigned char stops[3] = { index->delim, '\r', '\n' };
+    size_t end = csv_span(str,rest,stops,3);
+    size_t i = end;
+    while (i>0&&(str[i-1]==' '||str[i-1]=='\t')) {
+      i--;
+    }
+    mark = (i>4&&str[0]=='='&&str[1]=='='&&str[2]==' ');
+    if (mark&&end<rest&&str[end]==index->delim) {
+      // more fields after the name; leave that to a full parse
+      index->irregular = true;
+    }
+  }
+  if (mark) {
+    index->marks.push_back(pos);
+  } else if (index->marks.size()==0) {
+    // rows before the first name
+    index->irregular = true;
+  }
+}
+
+static bool csvfile_is_space(char c) {
+  return c==' '||c=='\t'||c=='\r';
+}
+
+// Step back from stop, the start of a table name or the end of the
+// data, over lines holding nothing but spaces, such as the " " line
+// CsvTextBook::write leaves between tables.  A row scan passes over
+// such lines between rows, so none of them can be inside a field.
+static size_t csvfile_content_end(const char *data, size_t stop) {
+  size_t at = stop;
+  while (at>0&&data[at-1]!='\n') {
+    if (!csvfile_is_space(data[at-1])) return stop;
+    at--;
+  }
+  while (at>0) {
+    size_t s = at-1;
+    while (s>0&&data[s-1]!='\n'&&csvfile_is_space(data[s-1])) {
+      s--;
+    }
+    if (s>0&&data[s-1]!='\n') break;
+    at = s;
+  }
+  return at;
+}
+
+// names a table from its first row, as csvfile_merge_cb1 would
+class CsvSheetNamer : public CsvSheetReader {
+public:
+  CsvSheet sheet;
+
+  virtual CsvSheet *nextSheet(const char *name, bool named) {
+    return &sheet;
+  }
+};
+
+bool CsvFile::indexSheets(const char *data, size_t len, 
+			  const Property& config,
+			  std::vector<std::string>& names,
+			  std::vector<size_t>& starts,
+			  std::vector<size_t>& ends) {
+  names.clear();
+  starts.clear();
+  ends.clear();
+  struct csv_parser p;
+  if (csv_init(&p,csv_options(config))!=0) {
+    fprintf(stderr,"csv failed to initialize\n");
+    exit(1);
+  }
+  SheetStyle style;
+  style.setFromProperty(config);
+  csv_set_delim(&p,style.getDelimiter()[0]);
+
+  CsvSheetIndex index;
+  index.data = data;
+  index.len = len;
+  index.delim = style.getDelimiter()[0];
+  index.irregular = false;
+  csv_scan_rows(&p,data,len,csvfile_index_cb,(void*)(&index));
+  if (index.irregular||index.marks.size()==0) {
+    csv_free(&p);
+    return false;
+  }
+
+  for (int k=0; k<(int)index.marks.size(); k++) {
+    // parse just the field holding the name
+    size_t at = index.marks[k];
+    const unsigned char stops[3] = { index.delim, '\r', '\n' };
+    size_t i = csv_span(data+at,len-at,stops,3);
+    CsvSheetNamer namer;
+    CsvSheetReaderState state;
+    state.reader = &namer;
+    state.setStyle(style);
+    csv_parse(&p,data+at,i,csvfile_merge_cb1,csvfile_merge_cb2,
+	      (void*)(&state));
+    csv_fini(&p,csvfile_merge_cb1,csvfile_merge_cb2,(void*)(&state));
+    names.push_back(state.name);
+    starts.push_back(at);
+  }
+  starts.push_back(len);
+  for (int k=1; k<(int)starts.size(); k++) {
+    ends.push_back(csvfile_content_end(data,starts[k]));
+  }
+  csv_free(&p);
+  return true;
+}
+
 int CsvFile::read(const char *src, CsvSheet& dest, const Property& config) {
   dbg_printf("CsvFile::read %s options %s\n", src, config.toString().c_str());
   CsvSheetReaderState state;
@@ -337,6 +758,15 @@ int CsvFile::read(const char *src, CsvSheet& dest, const Property& config) {
 }
 
 
+int CsvFile::read(const char *src, ColumnarSheet& dest,
+		  const Property& config) {
+  dbg_printf("CsvFile::read %s (columnar) options %s\n", src,
+	     config.toString().c_str());
+  CsvSheetReaderState state;
+  state.columnar = &dest;
+  return read(src,-1,state,config);
+}
+
 int CsvFile::read(const char *src, CsvSheet& dest) {
   Property config;
   return read(src,dest,config);
@@ -0,0 +1,301 @@
+extern "C" { 
+#include "csv.h"
+}
+
+#include <coopy/MmapCsvSheet.h>
+#include <coopy/FileIO.h>
+#include <coopy/Dbg.h>
+
+#include <string.h>
+
+#ifndef _WIN32
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+using namespace coopy::store;
+
+// parser states, as in libcsv
+#define MMAP_ROW_NOT_BEGUN 0
+#define MMAP_FIELD_NOT_BEGUN 1
+#define MMAP_FIELD_BEGUN 2
+#define MMAP_FIELD_MIGHT_HAVE_ENDED 3
+
+#define MMAP_QUOTE '\"'
+
+static bool is_space(unsigned char c) {
+  return c==' '||c=='\t';
+}
+
+static bool is_term(unsigned char c) {
+  return c=='\r'||c=='\n';
+}
+
+bool MmapCsvSheet::open(const char *fname, const Property& config) {
+  close();
+  if (strcmp(fname,"-")==0) return false;
+  if (config.get("length").asString()=="header") return false;
+  if (config.get("flip_vertical").asInt()!=0) return false;
+
+  style.setFromFilename(fname);
+  style.setFromProperty(config);
+  delim = style.getDelimiter()[0];
+  have_null = style.haveNullToken();
+  avoid_collision = style.quoteCollidingText();
+  null_token = style.getNullToken();
+
+#ifdef _WIN32
+  // no mapping here; keep the bytes in memory, still decoding lazily
+  FileIO fp;
+  if (!fp.open(fname,config)) return false;
+  char buf[32768];
+  size_t bytes_read;
+  while ((bytes_read=fp.fread(buf,1,sizeof(buf)))>0) {
+    buffer.append(buf,bytes_read);
+  }
+  fp.close();
+  data = buffer.c_str();
+  len = (long long)buffer.length();
+#else
+  int fd = ::open(fname,O_RDONLY);
+  if (fd<0) return false;
+  struct stat st;
+  if (fstat(fd,&st)!=0||!S_ISREG(st.st_mode)) {
+    ::close(fd);
+    return false;
+  }
+  len = (long long)st.st_size;
+  if (len>0) {
+    map = mmap(0/*NULL*/,(size_t)len,PROT_READ,MAP_PRIVATE,fd,0);
+    if (map==MAP_FAILED) {
+      map = 0/*NULL*/;
+      len = 0;
+      ::close(fd);
+      return false;
+    }
+    data = (const char *)map;
+  } else {
+    data = "";
+  }
+  ::close(fd);
+#endif
+
+  if (!index()) {
+    fprintf(stderr,"MmapCsvSheet: cannot index %s\n", fname);
+    close();
+    return false;
+  }
+  dbg_printf("MmapCsvSheet: %s is %dx%d\n", fname, width(), height());
+  return true;
+}
+
+void MmapCsvSheet::close() {
+#ifndef _WIN32
+  if (map!=0/*NULL*/) {
+    munmap(map,(size_t)len);
+  }
+#endif
+  map = 0/*NULL*/;
+  data = 0/*NULL*/;
+  len = 0;
+  tw = 0;
+  buffer = "";
+  vector<long long>().swap(row_at);
+  vector<long long>().swap(row_field);
+  vector<unsigned int>().swap(field_at);
+}
+
+bool MmapCsvSheet::index() {
+  // the state machine of csv_parse, noting where fields start and rows
+  // end rather than copying out the cells
+  const unsigned char *s = (const unsigned char *)data;
+  unsigned char d = (unsigned char)delim;
+  int pstate = MMAP_ROW_NOT_BEGUN;
+  bool quoted = false;
+  long long spaces = 0;
+  long long at = 0;
+  long long rel = 0;
+  bool end_row = false;
+  bool end_field = false;
+  // within a field, only these can change anything
+  unsigned char stops[4] = { MMAP_QUOTE, d, '\r', '\n' };
+  for (long long pos=0; pos<=len; pos++) {
+    end_row = end_field = false;
+    if (pstate==MMAP_FIELD_BEGUN&&pos<len) {
+      pos += (long long)csv_span(s+pos,(size_t)(len-pos),stops,quoted?1:4);
+    }
+    if (pos==len) {
+      // as csv_fini
+      if (pstate==MMAP_ROW_NOT_BEGUN) break;
+      end_field = end_row = true;
+    } else {
+      unsigned char c = s[pos];
+      switch (pstate) {
+      case MMAP_ROW_NOT_BEGUN:
+      case MMAP_FIELD_NOT_BEGUN:
+	if (is_space(c)&&c!=d) {
+	  continue;
+	} else if (is_term(c)) {
+	  if (pstate==MMAP_FIELD_NOT_BEGUN) {
+	    end_field = end_row = true;
+	  }
+	  break;
+	}
+	if (pstate==MMAP_ROW_NOT_BEGUN) {
+	  at = pos;
+	  row_at.push_back(at);
+	  row_field.push_back((long long)field_at.size());
+	  field_at.push_back(0);
+	}
+	if (c==d) {
+	  end_field = true;
+	} else if (c==MMAP_QUOTE) {
+	  pstate = MMAP_FIELD_BEGUN;
+	  quoted = true;
+	} else {
+	  pstate = MMAP_FIELD_BEGUN;
+	  quoted = false;
+	}
+	break;
+      case MMAP_FIELD_BEGUN:
+	if (c==MMAP_QUOTE) {
+	  if (quoted) {
+	    pstate = MMAP_FIELD_MIGHT_HAVE_ENDED;
+	  } else {
+	    spaces = 0;
+	  }
+	} else if (c==d) {
+	  if (!quoted) end_field = true;
+	} else if (is_term(c)) {
+	  if (!quoted) end_field = end_row = true;
+	} else if (!quoted && is_space(c)) {
+	  spaces++;
+	} else {
+	  spaces = 0;
+	}
+	break;
+      case MMAP_FIELD_MIGHT_HAVE_ENDED:
+	if (c==d) {
+	  end_field = true;
+	} else if (is_term(c)) {
+	  end_field = end_row = true;
+	} else if (is_space(c)) {
+	  spaces++;
+	} else if (c==MMAP_QUOTE) {
+	  if (spaces) {
+	    spaces = 0;
+	  } else {
+	    pstate = MMAP_FIELD_BEGUN;
+	  }
+	} else {
+	  pstate = MMAP_FIELD_BEGUN;
+	  spaces = 0;
+	}
+	break;
+      }
+    }
+    if (end_field) {
+      rel = pos+1-at;
+      if (rel>0xffffffffLL) return false;
+      field_at.push_back((unsigned int)rel);
+      pstate = MMAP_FIELD_NOT_BEGUN;
+      quoted = false;
+      spaces = 0;
+    }
+    if (end_row) {
+      int fields = (int)((long long)field_at.size()-row_field.back()-1);
+      if (fields>tw) tw = fields;
+      pstate = MMAP_ROW_NOT_BEGUN;
+    }
+  }
+  row_field.push_back((long long)field_at.size());
+  return true;
+}
+
+void MmapCsvSheet::decode(int x, int y, SheetCellView& v,
+			  string& scratch) const {
+  // short rows are padded with empty (not NULL) cells, as in CsvSheet
+  v.data = "";
+  v.len = 0;
+  v.escaped = false;
+  if (y<0||y>=height()||x<0) return;
+  long long first = row_field[y];
+  if (x>=(int)(row_field[y+1]-first-1)) return;
+  const unsigned char *s = (const unsigned char *)(data+row_at[y]);
+  unsigned int at = field_at[first+x];
+  unsigned int end = field_at[first+x+1]-1;
+  unsigned char d = (unsigned char)delim;
+
+  while (at<end&&is_space(s[at])&&s[at]!=d) {
+    at++;
+  }
+  if (at<end&&s[at]==MMAP_QUOTE) {
+    // the quoted half of csv_parse; delimiters and line ends inside
+    // the field are kept, and the field cannot end early
+    scratch.clear();
+    int pstate = MMAP_FIELD_BEGUN;
+    int spaces = 0;
+    for (unsigned int i=at+1; i<end; i++) {
+      unsigned char c = s[i];
+      if (pstate==MMAP_FIELD_BEGUN) {
+	scratch += (char)c;
+	if (c==MMAP_QUOTE) {
+	  pstate = MMAP_FIELD_MIGHT_HAVE_ENDED;
+	} else {
+	  spaces = 0;
+	}
+      } else if (is_space(c)) {
+	scratch += (char)c;
+	spaces++;
+      } else if (c==MMAP_QUOTE) {
+	if (spaces) {
+	  spaces = 0;
+	  scratch += (char)c;
+	} else {
+	  pstate = MMAP_FIELD_BEGUN;
+	}
+      } else {
+	pstate = MMAP_FIELD_BEGUN;
+	spaces = 0;
+	scratch += (char)c;
+      }
+    }
+    if (pstate==MMAP_FIELD_MIGHT_HAVE_ENDED) {
+      // drop the closing quote and anything blank after it
+      scratch.resize(scratch.length()-spaces-1);
+    }
+    v.data = scratch.c_str();
+    v.len = (int)scratch.length();
+  } else {
+    while (end>at&&is_space(s[end-1])) {
+      end--;
+    }
+    v.data = (const char *)(s+at);
+    v.len = (int)(end-at);
+  }
+
+  if (have_null) {
+    // as csvfile_add_field
+    int tlen = (int)null_token.length();
+    if (v.len==tlen&&memcmp(v.data,null_token.c_str(),tlen)==0) {
+      v.escaped = true;
+      return;
+    }
+    if (avoid_collision) {
+      int score = 0;
+      for (score=0; score<v.len; score++) {
+	if (v.data[score]!='_') break;
+      }
+      if (score>0&&v.len-score<=tlen+1) {
+	if (memcmp(v.data+score,null_token.c_str(),v.len-score)==0) {
+	  v.data++;
+	  v.len--;
+	}
+      }
+    }
+  }
+}
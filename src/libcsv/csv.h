@@ -26,6 +26,12 @@ extern "C" {
                              field is quoted and doesn't containg ending 
                              quote */
 #define CSV_APPEND_NULL 8 /* Ensure that all fields are null-ternimated */
+#define CSV_FAST_SCAN 16 /* copy runs of ordinary characters in bulk; only
+                           used with the default space and term functions,
+                           and not with CSV_STRICT */
+
+/* Number of states csv_scan can be in; state 0 is the start of a row */
+#define CSV_SCAN_STATES 6
 
 
 /* Character values */
@@ -62,6 +68,10 @@ void csv_free(struct csv_parser *p);
 int csv_error(struct csv_parser *p);
 char * csv_strerror(int error);
 size_t csv_parse(struct csv_parser *p, const void *s, size_t len, void (*cb1)(void *, size_t, void *,int), void (*cb2)(int, void *), void *data);
+size_t csv_span(const void *s, size_t len, const unsigned char *stops, int nstops);
+size_t csv_scan(struct csv_parser *p, const void *s, size_t len, int *state, int stop);
+void csv_scan_all(struct csv_parser *p, const void *s, size_t len, int *states);
+void csv_scan_rows(struct csv_parser *p, const void *s, size_t len, void (*cb)(size_t, void *), void *data);
 size_t csv_write(void *dest, size_t dest_size, const void *src, size_t src_size);
 int csv_fwrite(FILE *fp, const void *src, size_t src_size);
 size_t csv_write2(void *dest, size_t dest_size, const void *src, size_t src_size, unsigned char quote);
@@ -2,6 +2,7 @@
 #define SSFOSSIL_CSVREAD_INC
 
 #include <coopy/CsvSheet.h>
+#include <coopy/ColumnarSheet.h>
 #include <coopy/Reader.h>
 
 namespace coopy {
@@ -13,6 +14,8 @@ namespace coopy {
       int read(coopy::format::Reader& reader, CsvSheet& dest,
 	       const Property& config);
 
+      int read(const char *src, ColumnarSheet& dest, const Property& config);
+
       int read(const char *src, CsvSheet& dest);
       int read(coopy::format::Reader& reader, CsvSheet& dest);
 
@@ -23,6 +26,22 @@ namespace coopy {
       int read(const char *data, int len,
 	       CsvSheetReader& dest, 
 	       const Property& config);
+
+      /**
+       *
+       * Find the tables in a text holding several, as a .csvs file
+       * does, without parsing them.  Each table starts with a
+       * "== name ==" row; starts gets the offset of each, and then
+       * len.  ends gets where the rows of each table end, leaving
+       * out blank rows before the next table.  Returns false if
+       * there are no such rows, or there are rows before the first.
+       *
+       */
+      bool indexSheets(const char *data, size_t len,
+		       const Property& config,
+		       std::vector<std::string>& names,
+		       std::vector<size_t>& starts,
+		       std::vector<size_t>& ends);
     }
   }
 }
@@ -0,0 +1,141 @@
+#ifndef COOPY_MMAPCSVSHEET
+#define COOPY_MMAPCSVSHEET
+
+#include <coopy/DataSheet.h>
+#include <coopy/Property.h>
+
+#include <vector>
+#include <string>
+
+namespace coopy {
+  namespace store {
+    class MmapCsvSheet;
+  }
+}
+
+/**
+ *
+ * A read-only table backed directly by a CSV file mapped into memory.
+ * Opening the file makes a single pass over it to find where each row
+ * and field starts, following the same quoting rules as CsvFile::read.
+ * Cells are only decoded when asked for; unquoted cells are handed out
+ * as pointers into the file, and quoted cells are unescaped into the
+ * caller's scratch string.  Memory use is proportional to the number
+ * of fields, not to the size of the file.
+ *
+ * Cells read the same as for a CsvSheet loaded from the same file,
+ * including null token handling and padding of short rows.  The table
+ * cannot be modified.
+ *
+ */
+class coopy::store::MmapCsvSheet : public DataSheet {
+private:
+  const char *data;
+  long long len;
+  void *map;
+  std::string buffer;
+  int tw;
+  SheetStyle style;
+  char delim;
+  bool have_null;
+  bool avoid_collision;
+  std::string null_token;
+
+  // where each row starts in the file
+  std::vector<long long> row_at;
+  // for each row, the index in field_at of its first field; one more
+  // entry than there are rows
+  std::vector<long long> row_field;
+  // where each field starts, relative to its row, followed for each
+  // row by where a field after its last one would start
+  std::vector<unsigned int> field_at;
+
+  bool index();
+
+  void decode(int x, int y, SheetCellView& v, std::string& scratch) const;
+
+  MmapCsvSheet(const MmapCsvSheet& alt);
+  const MmapCsvSheet& operator=(const MmapCsvSheet& alt);
+
+public:
+  MmapCsvSheet() {
+    data = 0/*NULL*/;
+    len = 0;
+    map = 0/*NULL*/;
+    tw = 0;
+    delim = ',';
+    have_null = false;
+    avoid_collision = false;
+  }
+
+  virtual ~MmapCsvSheet() {
+    close();
+  }
+
+  /**
+   *
+   * Map and index a CSV file.  Returns false if the file cannot be
+   * mapped (for example, standard input), or if the options ask for
+   * something only CsvFile::read can do; the caller should fall back
+   * to reading the file normally.
+   *
+   */
+  bool open(const char *fname, const Property& config);
+
+  void close();
+
+  const SheetStyle& getStyle() {
+    return style;
+  }
+
+  virtual int width() const {
+    return tw;
+  }
+
+  virtual int height() const {
+    return (int)row_at.size();
+  }
+
+  virtual std::string cellString(int x, int y) const {
+    bool escaped = false;
+    return cellString(x,y,escaped);
+  }
+
+  virtual std::string cellString(int x, int y, bool& escaped) const {
+    std::string scratch;
+    SheetCellView v;
+    decode(x,y,v,scratch);
+    escaped = v.escaped;
+    return std::string(v.data,v.len);
+  }
+
+  virtual SheetCellView cellView(int x, int y, std::string& scratch) const {
+    SheetCellView v;
+    decode(x,y,v,scratch);
+    return v;
+  }
+
+  virtual bool canReadConcurrently() const {
+    return true;
+  }
+
+  virtual bool canWrite() {
+    return false;
+  }
+
+  virtual ColumnRef insertColumn(const ColumnRef& base,
+				 const ColumnInfo& info) {
+    return ColumnRef();
+  }
+
+  virtual bool modifyColumn(const ColumnRef& base,
+			    const ColumnInfo& info) {
+    return false;
+  }
+
+  virtual std::string getDescription() const {
+    return "mmap";
+  }
+};
+
+#endif
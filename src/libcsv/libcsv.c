@@ -23,8 +23,14 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #  define SIZE_MAX ((size_t)-1) /* C89 doesn't have stdint.h or SIZE_MAX */
 #endif
 
+#include <string.h>
+
 #include "csv.h"
 
+#if defined(__SSE2__)
+#  include <emmintrin.h>
+#endif
+
 #define VERSION "3.0.0"
 
 #define ROW_NOT_BEGUN           0
@@ -265,6 +271,220 @@ csv_get_buffer_size(struct csv_parser *p)
   return 0;
 }
  
+size_t
+csv_span(const void *s, size_t len, const unsigned char *stops, int nstops)
+{
+  /* Return the number of characters at the start of s that are not in
+   * stops (at most 6 of them), checking 16 characters at a time where
+   * SSE2 is available.
+   */
+  const unsigned char *us = s;
+  size_t pos = 0;
+  int i;
+
+  if (nstops == 1) {
+    const unsigned char *hit = memchr(us, stops[0], len);
+    return hit ? (size_t)(hit - us) : len;
+  }
+
+#if defined(__SSE2__)
+  {
+    __m128i want[6];
+    for (i = 0; i < nstops; i++)
+      want[i] = _mm_set1_epi8((char)stops[i]);
+    while (pos + 16 <= len) {
+      __m128i block = _mm_loadu_si128((const __m128i *)(us + pos));
+      __m128i hits = _mm_cmpeq_epi8(block, want[0]);
+      int mask;
+      for (i = 1; i < nstops; i++)
+        hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, want[i]));
+      mask = _mm_movemask_epi8(hits);
+      if (mask) {
+        while (!(mask & 1)) {
+          mask >>= 1;
+          pos++;
+        }
+        return pos;
+      }
+      pos += 16;
+    }
+  }
+#endif
+
+  for (; pos < len; pos++) {
+    for (i = 0; i < nstops; i++)
+      if (us[pos] == stops[i])
+        return pos;
+  }
+  return len;
+}
+
+/* States for csv_scan: those of csv_parse, with FIELD_BEGUN split by
+ * whether the field is quoted, and FIELD_MIGHT_HAVE_ENDED by whether
+ * spaces have been seen since the quote */
+#define SCAN_ROW_NOT_BEGUN      0
+#define SCAN_FIELD_NOT_BEGUN    1
+#define SCAN_FIELD_BEGUN        2
+#define SCAN_FIELD_QUOTED       3
+#define SCAN_MIGHT_HAVE_ENDED   4
+#define SCAN_MIGHT_HAVE_SPACED  5
+
+static int
+csv_scan_step(int state, unsigned char c, unsigned char delim, unsigned char quote)
+{
+  /* The state csv_parse moves to on reading c, with the default space
+   * and term functions and without CSV_STRICT or CSV_REPALL_NL */
+  int is_space = (c == CSV_SPACE || c == CSV_TAB);
+  int is_term = (c == CSV_CR || c == CSV_LF);
+
+  switch (state) {
+    case SCAN_ROW_NOT_BEGUN:
+    case SCAN_FIELD_NOT_BEGUN:
+      if (is_space && c != delim)
+        return state;
+      if (is_term)
+        return SCAN_ROW_NOT_BEGUN;
+      if (c == delim)
+        return SCAN_FIELD_NOT_BEGUN;
+      if (c == quote)
+        return SCAN_FIELD_QUOTED;
+      return SCAN_FIELD_BEGUN;
+    case SCAN_FIELD_BEGUN:
+      if (c == quote)
+        return state;
+      if (c == delim)
+        return SCAN_FIELD_NOT_BEGUN;
+      if (is_term)
+        return SCAN_ROW_NOT_BEGUN;
+      return state;
+    case SCAN_FIELD_QUOTED:
+      if (c == quote)
+        return SCAN_MIGHT_HAVE_ENDED;
+      return state;
+    default:
+      if (c == delim)
+        return SCAN_FIELD_NOT_BEGUN;
+      if (is_term)
+        return SCAN_ROW_NOT_BEGUN;
+      if (is_space)
+        return SCAN_MIGHT_HAVE_SPACED;
+      if (c == quote)
+        return (state == SCAN_MIGHT_HAVE_SPACED) ? SCAN_MIGHT_HAVE_ENDED : SCAN_FIELD_QUOTED;
+      return SCAN_FIELD_QUOTED;
+  }
+}
+
+static void
+csv_scan_table(struct csv_parser *p, unsigned char next[CSV_SCAN_STATES][256])
+{
+  int state, c;
+  for (state = 0; state < CSV_SCAN_STATES; state++)
+    for (c = 0; c < 256; c++)
+      next[state][c] = (unsigned char)csv_scan_step(state, (unsigned char)c,
+                                                    p->delim_char, p->quote_char);
+}
+
+size_t
+csv_scan(struct csv_parser *p, const void *s, size_t len, int *state, int stop)
+{
+  /* Follow the state machine of csv_parse over s without building any
+   * fields, starting from *state and leaving there the state reached.
+   * If stop is set, stop as soon as the start of a row is reached.
+   * Returns the number of characters read.
+   */
+  const unsigned char *us = s;
+  unsigned char next[CSV_SCAN_STATES][256];
+  unsigned char stops[3];
+  size_t pos = 0;
+  int st = *state;
+
+  stops[0] = p->delim_char;
+  stops[1] = CSV_CR;
+  stops[2] = CSV_LF;
+  csv_scan_table(p, next);
+  while (pos < len) {
+    if (stop && st == SCAN_ROW_NOT_BEGUN)
+      break;
+    /* within a field, skip to the next character that matters */
+    if (st == SCAN_FIELD_QUOTED)
+      pos += csv_span(us + pos, len - pos, &p->quote_char, 1);
+    else if (st == SCAN_FIELD_BEGUN)
+      pos += csv_span(us + pos, len - pos, stops, 3);
+    if (pos == len)
+      break;
+    st = next[st][us[pos++]];
+  }
+  *state = st;
+  return pos;
+}
+
+void
+csv_scan_rows(struct csv_parser *p, const void *s, size_t len, void (*cb)(size_t, void *), void *data)
+{
+  /* As csv_scan from the start of a row, calling cb with the offset of
+   * the first character of each row (after any leading spaces) */
+  const unsigned char *us = s;
+  unsigned char next[CSV_SCAN_STATES][256];
+  unsigned char stops[3];
+  size_t pos = 0;
+  int st = SCAN_ROW_NOT_BEGUN;
+
+  stops[0] = p->delim_char;
+  stops[1] = CSV_CR;
+  stops[2] = CSV_LF;
+  csv_scan_table(p, next);
+  while (pos < len) {
+    if (st == SCAN_FIELD_QUOTED)
+      pos += csv_span(us + pos, len - pos, &p->quote_char, 1);
+    else if (st == SCAN_FIELD_BEGUN)
+      pos += csv_span(us + pos, len - pos, stops, 3);
+    if (pos == len)
+      break;
+    if (st == SCAN_ROW_NOT_BEGUN) {
+      st = next[st][us[pos]];
+      if (st != SCAN_ROW_NOT_BEGUN)
+        cb(pos, data);
+      pos++;
+    } else {
+      st = next[st][us[pos++]];
+    }
+  }
+}
+
+void
+csv_scan_all(struct csv_parser *p, const void *s, size_t len, int *states)
+{
+  /* As csv_scan, from every state at once; states[i] is set to the
+   * state reached starting from state i.  The runs usually agree
+   * after a row or so, and are then followed as one.
+   */
+  const unsigned char *us = s;
+  unsigned char next[CSV_SCAN_STATES][256];
+  size_t pos = 0;
+  size_t end;
+  int i, same;
+
+  csv_scan_table(p, next);
+  for (i = 0; i < CSV_SCAN_STATES; i++)
+    states[i] = i;
+  while (pos < len) {
+    same = 1;
+    for (i = 1; i < CSV_SCAN_STATES; i++)
+      if (states[i] != states[0])
+        same = 0;
+    if (same) {
+      csv_scan(p, us + pos, len - pos, &states[0], 0);
+      for (i = 1; i < CSV_SCAN_STATES; i++)
+        states[i] = states[0];
+      return;
+    }
+    end = (len - pos > 64) ? pos + 64 : len;
+    for (; pos < end; pos++)
+      for (i = 0; i < CSV_SCAN_STATES; i++)
+        states[i] = next[states[i]][us[pos]];
+  }
+}
+
 static int
 csv_increase_buffer(struct csv_parser *p)
 {
@@ -315,7 +535,15 @@ csv_parse(struct csv_parser *p, const void *s, size_t len, void (*cb1)(void *, s
   int pstate = p->pstate;
   size_t spaces = p->spaces;
   size_t entry_pos = p->entry_pos;
+  int fast = (p->options & CSV_FAST_SCAN) && !(p->options & CSV_STRICT) &&
+             !is_space && !is_term;
+  size_t reserve = (p->options & CSV_APPEND_NULL) ? 1 : 0;
+  unsigned char stops[3];
+  size_t run, tail;
 
+  stops[0] = delim;
+  stops[1] = CSV_CR;
+  stops[2] = CSV_LF;
 
   if (!p->entry_buf && pos < len) {
     /* Buffer hasn't been allocated yet and len > 0 */
@@ -334,6 +562,38 @@ csv_parse(struct csv_parser *p, const void *s, size_t len, void (*cb1)(void *, s
       }
     }
 
+    if (fast && pstate == FIELD_BEGUN) {
+      /* Characters that cannot end the field here are just added to it;
+       * copy them together.  In a quoted field that is anything but a
+       * quote (and spaces stays 0).  Otherwise it is anything but a
+       * delimiter or line end, and spaces counts blanks at the end. */
+      if (quoted)
+        run = csv_span(us + pos, len - pos, &quote, 1);
+      else
+        run = csv_span(us + pos, len - pos, stops, 3);
+      if (run > 0) {
+        while (entry_pos + run + reserve > p->entry_size) {
+          if (csv_increase_buffer(p) != 0) {
+            p->quoted = quoted, p->pstate = pstate, p->spaces = spaces, p->entry_pos = entry_pos;
+            return pos;
+          }
+        }
+        memcpy(p->entry_buf + entry_pos, us + pos, run);
+        if (quoted) {
+          spaces = 0;
+        } else {
+          tail = 0;
+          while (tail < run && (us[pos + run - tail - 1] == CSV_SPACE ||
+                                us[pos + run - tail - 1] == CSV_TAB))
+            tail++;
+          spaces = (tail == run) ? spaces + run : tail;
+        }
+        entry_pos += run;
+        pos += run;
+        continue;
+      }
+    }
+
     c = us[pos++];
 
     switch (pstate) {
@@ -62,6 +62,50 @@ SheetCell GnumericSheet::cellSummary(int x, int y) const {
   return cell;
 }
 
+int GnumericSheet::readRows(int y0, int count, RowBlock& block) const {
+  if (y0+count>h) count = h-y0;
+  if (count<0) count = 0;
+  block.reset(y0,w,count);
+  GSheetCell gscell;
+  for (int y=y0; y<y0+count; y++) {
+    for (int x=0; x<w; x++) {
+      std::string& txt = block.scratch(x,y);
+      bool escaped = true;
+      gsheetcell_zero(&gscell);
+      int r = gnumeric_sheet_get_cell(SHEET(implementation),
+				      x, y,
+				      &gscell);
+      if (r!=0) {
+	txt = "";
+      } else if (!gscell.is_url) {
+	if (gscell.all==NULL) {
+	  txt = "NULL";
+	} else {
+	  txt = gscell.all;
+	  escaped = false;
+	}
+      } else {
+	SheetCellSimpleMeta *meta = new SheetCellSimpleMeta;
+	COOPY_ASSERT(meta);
+	txt = gscell.all?gscell.all:"";
+	if (gscell.url) {
+	  meta->url = gscell.url;
+	}
+	if (gscell.txt) {
+	  meta->txt = gscell.txt;
+	}
+	block.setMeta(x,y,Poly<SheetCellMeta>(meta,true));
+	escaped = false;
+      }
+      if (r==0) {
+	gsheetcell_free(&gscell);
+      }
+      block.cell(x,y) = SheetCellView(txt,escaped);
+    }
+  }
+  return count;
+}
+
 bool GnumericSheet::cellSummary(int x, int y, const SheetCell& c) {
   if (!c.meta.isValid()) {
     if (!c.escaped) {
@@ -25,6 +25,8 @@ public:
 
   virtual bool cellSummary(int x, int y, const SheetCell& c);
 
+  virtual int readRows(int y0, int count, RowBlock& block) const;
+
   virtual std::string cellString(int x, int y) const {
     SheetCell cell = cellSummary(x,y);
     return cell.text;
@@ -190,6 +190,57 @@ std::string RemoteSqlSheet::cellString(int x, int y, bool& escaped) const {
   return out;
 }
 
+int RemoteSqlSheet::readRows(int y0, int count, RowBlock& block) const {
+  if (y0+count>h) count = h-y0;
+  if (count<0) count = 0;
+  block.reset(y0,w,count);
+  for (int y=y0; y<y0+count; y++) {
+    bool missing = false;
+    for (int x=0; x<w; x++) {
+      SheetCellView& v = block.cell(x,y);
+      const unsigned char *f = cacheFlag.pcell_const(x,y);
+      if (f!=NULL) {
+	v = SheetCellView("NULL",4,true);
+	continue;
+      }
+      const string *c = cache.pcell_const(x,y);
+      if (c!=NULL) {
+	v = SheetCellView(*c,false);
+	continue;
+      }
+      v = SheetCellView("",0,false);
+      missing = true;
+    }
+    if (!missing) continue;
+
+    // one round trip for the whole row, not one per uncached cell
+    CSQL& SQL = SQL_CONNECTION(book);
+    string query = string("SELECT * FROM ") + name + " WHERE ";
+    const vector<string>& idx = row2sql[y];
+    for (int i=0; i<(int)keys.size(); i++) {
+      if (i!=0) {
+	query += " AND ";
+      }
+      query += keys[i];
+      query += " = ";
+      query += quote(idx[i]);
+    }
+    CSQLResult *result = SQL.openQuery(query);
+    if (result==NULL) continue;
+    if (result->fetch()) {
+      for (int x=0; x<w; x++) {
+	if (cacheFlag.pcell_const(x,y)!=NULL) continue;
+	if (cache.pcell_const(x,y)!=NULL) continue;
+	string& s = block.scratch(x,y);
+	s = result->get(x);
+	block.cell(x,y) = SheetCellView(s,false);
+      }
+    }
+    SQL.closeQuery(result);
+  }
+  return count;
+}
+
 bool RemoteSqlSheet::cellString(int x, int y, const std::string& str, bool escaped) {
   // starting with a COMPLETELY brain-dead implementation
 
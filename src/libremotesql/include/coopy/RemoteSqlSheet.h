@@ -30,6 +30,8 @@ public:
 
   virtual std::string cellString(int x, int y, bool& escaped) const;
 
+  virtual int readRows(int y0, int count, RowBlock& block) const;
+
   virtual bool cellString(int x, int y, const std::string& str) {
     return cellString(x,y,str,false);
   }
@@ -332,7 +332,7 @@ bool SqliteSheet::connect() {
   return true;
 }
 
-std::string SqliteSheet::getRawHash() const {
+std::string SqliteSheet::getRawHash(int kind) const {
   char *query = NULL;
   int iresult = 0;
   sqlite3 *db = DB(implementation);
@@ -353,7 +353,9 @@ std::string SqliteSheet::getRawHash() const {
     column_list += add;
   }
 
-  sqlite3_exec(db, "SELECT coopy_set(0)", NULL, NULL, NULL);
+  query = sqlite3_mprintf("SELECT coopy_set(0,%d)", kind);
+  sqlite3_exec(db, query, NULL, NULL, NULL);
+  sqlite3_free(query);
   query = sqlite3_mprintf("SELECT coopy_add(%s) FROM %s ORDER BY ROWID",
 			  column_list.c_str(),
 			  quoted_name.c_str());
@@ -594,6 +596,74 @@ std::string SqliteSheet::cellString(int x, int y, bool& escaped) const {
   return result;
 }
 
+SheetCellView SqliteSheet::cellView(int x, int y, std::string& scratch) const {
+  ((SqliteSheet *)this)->check();
+  const unsigned char *f = cacheFlag.pcell_const(x,y);
+  if (f!=NULL) {
+    return SheetCellView("NULL",4,true);
+  }
+  const string *c = cache.pcell_const(x,y);
+  if (c!=NULL) {
+    return SheetCellView(*c,false);
+  }
+  return DataSheet::cellView(x,y,scratch);
+}
+
+int SqliteSheet::readRows(int y0, int count, RowBlock& block) const {
+  ((SqliteSheet *)this)->check();
+  if (y0+count>h) count = h-y0;
+  if (count<0) count = 0;
+  block.reset(y0,w,count);
+  sqlite3 *db = DB(implementation);
+  for (int y=y0; y<y0+count; y++) {
+    bool missing = false;
+    for (int x=0; x<w; x++) {
+      SheetCellView& v = block.cell(x,y);
+      const unsigned char *f = cacheFlag.pcell_const(x,y);
+      if (f!=NULL) {
+	v = SheetCellView("NULL",4,true);
+	continue;
+      }
+      const string *c = cache.pcell_const(x,y);
+      if (c!=NULL) {
+	v = SheetCellView(*c,false);
+	continue;
+      }
+      v = SheetCellView((db==NULL)?"NULL":"",(db==NULL)?4:0,true);
+      missing = true;
+    }
+    if (!missing||db==NULL) continue;
+
+    // fetch any uncached cells with one query for the whole row,
+    // rather than one query per cell.
+    sqlite3_stmt *statement = NULL;
+    char *query = sqlite3_mprintf("SELECT * FROM %s WHERE ROWID = %d", 
+				  quoted_name.c_str(),
+				  row2sql[y]);
+    int iresult = sqlite3_prepare_v2(db, query, -1, 
+				     &statement, NULL);
+    if (iresult==SQLITE_OK) {
+      if (sqlite3_step(statement) == SQLITE_ROW) {
+	for (int x=0; x<w; x++) {
+	  if (cacheFlag.pcell_const(x,y)!=NULL) continue;
+	  if (cache.pcell_const(x,y)!=NULL) continue;
+	  char *txt = (char *)sqlite3_column_text(statement,x);
+	  if (txt!=NULL) {
+	    string& s = block.scratch(x,y);
+	    s = txt;
+	    block.cell(x,y) = SheetCellView(s,false);
+	  } else {
+	    block.cell(x,y) = SheetCellView("NULL",4,true);
+	  }
+	}
+      }
+    }
+    sqlite3_finalize(statement);
+    sqlite3_free(query);
+  }
+  return count;
+}
+
 
 bool SqliteSheet::cellString(int x, int y, const std::string& str, bool escaped) {
   check();
@@ -845,6 +915,62 @@ bool SqliteSheet::deleteRow(const RowRef& src) {
 }
 
 
+// rows named per DELETE statement, to keep statements a sane length
+#define SQLITE_DELETE_BATCH 500
+
+bool SqliteSheet::deleteRowSet(const std::vector<int>& rows) {
+  if (rows.size()==0) return true;
+  if (rows[0]<0||rows.back()>=(int)row2sql.size()) return false;
+  clearCache();
+
+  sqlite3 *db = DB(implementation);
+  if (db==NULL) return false;
+
+  for (int i=0; i<(int)rows.size(); i+=SQLITE_DELETE_BATCH) {
+    string ids = "";
+    for (int j=i; j<(int)rows.size() && j<i+SQLITE_DELETE_BATCH; j++) {
+      char buf[32];
+      snprintf(buf,sizeof(buf),"%s%d",(j==i)?"":",",row2sql[rows[j]]);
+      ids += buf;
+    }
+    char *query = sqlite3_mprintf("DELETE FROM %s WHERE ROWID IN (%s)",
+				  quoted_name.c_str(), ids.c_str());
+    int iresult = sqlite3_exec(db, query, NULL, NULL, NULL);
+    if (iresult!=SQLITE_OK) {
+      const char *msg = sqlite3_errmsg(db);
+      if (msg!=NULL) {
+	fprintf(stderr,"Error: %s\n", msg);
+	fprintf(stderr,"Query was: %s\n", query);
+      }
+      sqlite3_free(query);
+      return false;
+    }
+    sqlite3_free(query);
+  }
+
+  int at = rows[0];
+  int k = 0;
+  for (int y=rows[0]; y<(int)row2sql.size(); y++) {
+    if (k<(int)rows.size() && rows[k]==y) {
+      k++;
+      continue;
+    }
+    row2sql[at] = row2sql[y];
+    at++;
+  }
+  row2sql.resize(at);
+  h = at;
+  return true;
+}
+
+bool SqliteSheet::deleteRows(const RowRef& first, const RowRef& last) {
+  vector<int> rows;
+  for (int i=first.getIndex(); i<=last.getIndex(); i++) {
+    rows.push_back(i);
+  }
+  return deleteRowSet(rows);
+}
+
 bool SqliteSheet::applyRowCache(const RowCache& cache, int row,
 				SheetCell *result) {
   check();
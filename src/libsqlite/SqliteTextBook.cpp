@@ -23,14 +23,19 @@ using namespace coopy::format;
 
 void coopy_set_function(sqlite3_context *context, int argc, 
 			sqlite3_value **argv){
-  coopy::store::Sha1Generator& hasher = *((coopy::store::Sha1Generator*)sqlite3_user_data(context));
+  coopy::store::Hasher& hasher = *((coopy::store::Hasher*)sqlite3_user_data(context));
 
-  COOPY_ASSERT( argc==1 );
+  // coopy_set(0[,kind]) starts a hash, coopy_set(1) finishes it
+  COOPY_ASSERT( argc==1 || argc==2 );
   std::string result = "start";
   if (sqlite3_value_int64(argv[0])>0) {
     result = hasher.finish();
   } else {
-    hasher.finish();
+    int kind = Hasher::HASH_SHA1;
+    if (argc==2) {
+      kind = (int)sqlite3_value_int64(argv[1]);
+    }
+    hasher.setKind(kind);
   }
   //printf("HASHER %s\n", result.c_str());
   sqlite3_result_text(context, result.c_str(), result.length()+1, 
@@ -39,7 +44,7 @@ void coopy_set_function(sqlite3_context *context, int argc,
 
 void coopy_add_function(sqlite3_context *context, int argc, 
 			sqlite3_value **argv){
-  coopy::store::Sha1Generator& hasher = *((coopy::store::Sha1Generator*)sqlite3_user_data(context));
+  coopy::store::Hasher& hasher = *((coopy::store::Hasher*)sqlite3_user_data(context));
 
   //printf("HALLO?? %d\n", argc);
   for (int i=0; i<argc; i++) {
@@ -233,7 +238,7 @@ bool SqliteTextBook::read(const char *fname, bool can_create,
     }
 
     sqlite3_create_function((sqlite3*)implementation, 
-			    "coopy_set", 1, SQLITE_UTF8, (void*)&hasher,
+			    "coopy_set", -1, SQLITE_UTF8, (void*)&hasher,
 			    &coopy_set_function, NULL, NULL);
     sqlite3_create_function((sqlite3*)implementation, 
 			    "coopy_add", -1, SQLITE_UTF8, (void*)&hasher,
@@ -35,6 +35,10 @@ public:
 
   virtual std::string cellString(int x, int y, bool& escaped) const;
 
+  virtual SheetCellView cellView(int x, int y, std::string& scratch) const;
+
+  virtual int readRows(int y0, int count, RowBlock& block) const;
+
   virtual bool cellString(int x, int y, const std::string& str) {
     return cellString(x,y,str,false);
   }
@@ -55,6 +59,10 @@ public:
 
   virtual bool deleteRow(const RowRef& src);
 
+  virtual bool deleteRows(const RowRef& first, const RowRef& last);
+
+  virtual bool deleteRowSet(const std::vector<int>& rows);
+
   virtual ColumnInfo getColumnInfo(int x) {
     /*
     ColumnType t;
@@ -112,7 +120,7 @@ public:
 		     coopy::cmp::Patcher& output, 
 		     const coopy::cmp::CompareFlags& flags);
 
-  virtual std::string getRawHash() const;
+  virtual std::string getRawHash(int kind) const;
 
 private:
   SqliteSheetSchema *schema;
@@ -0,0 +1,5 @@
+file(STRINGS ${log} found REGEX "^${line}$")
+list(LENGTH found n)
+if (NOT n EQUAL ${count})
+  message(FATAL_ERROR "\"${line}\" appears ${n} times in ${log}, expected ${count}")
+endif()
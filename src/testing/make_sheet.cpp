@@ -3,23 +3,45 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include <vector>
+
 using namespace coopy::store;
 
+/*
+  make_sheet height width [seed]
+
+  Writes a sheet of distinct numbers.  Given a seed, rows come out in
+  a scrambled order (the same order for the same seed), for testing
+  row reordering.
+ */
+
 int main(int argc, char *argv[]) {
   if (argc<3) return 1;
   IntSheet s;
   int h = atoi(argv[1]);
   int w = atoi(argv[2]);
+  unsigned int seed = (argc>3)?atoi(argv[3]):0;
+  std::vector<int> order(h);
+  for (int y=0; y<h; y++) {
+    order[y] = y;
+  }
+  if (seed!=0) {
+    // shuffle with a fixed generator, so output is the same everywhere
+    for (int y=h-1; y>0; y--) {
+      seed = seed*1103515245+12345;
+      int z = (int)((seed>>8)%(unsigned int)(y+1));
+      int t = order[y];
+      order[y] = order[z];
+      order[z] = t;
+    }
+  }
   s.resize(w,h,0);
-  int ct = 0;
   for (int y=0; y<h; y++) {
     for (int x=0; x<w; x++) {
-      ct++;
-      s.cell(x,y) = ct;
+      s.cell(x,y) = order[y]*w+x+1;
     }
   }
   SheetStyle style;
   printf("%s",s.encode(style).c_str());
   return 0;
 }
-
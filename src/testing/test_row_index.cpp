@@ -0,0 +1,113 @@
+#include <coopy/RowMatchIndex.h>
+#include <coopy/CsvSheet.h>
+
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace coopy::store;
+using namespace coopy::cmp;
+
+// Apply inserts ("+"), moves, removals and changes to a table while
+// looking rows up ("=") through one index, and check each lookup
+// against a scan of the table.
+
+static unsigned int seed = 1;
+
+static int pick(int n) {
+  seed = seed*1103515245+12345;
+  return (int)((seed>>8)%(unsigned int)n);
+}
+
+static string name(int v) {
+  char buf[32];
+  snprintf(buf,sizeof(buf),"k%d",v);
+  return buf;
+}
+
+static int check(RowMatchIndex& index, CsvSheet& sheet,
+		 const vector<int>& cols, const string& txt) {
+  vector<SheetCell> cond(sheet.width());
+  cond[0] = SheetCell(txt,false);
+  vector<int> rows;
+  index.candidates(sheet,cols,cond,rows);
+  vector<int> expect;
+  for (int y=0; y<sheet.height(); y++) {
+    if (sheet.cellString(0,y)==txt) expect.push_back(y);
+  }
+  if (rows!=expect) {
+    printf("Lookup of %s in %d rows found %d rows, expected %d\n",
+	   txt.c_str(), sheet.height(), (int)rows.size(), (int)expect.size());
+    return 1;
+  }
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  CsvSheet sheet;
+  sheet.resize(2,0);
+  for (int y=0; y<300; y++) {
+    sheet.insertRow(RowRef(-1));
+    sheet.cellString(0,y,name(y%50));
+    sheet.cellString(1,y,name(y));
+  }
+  vector<int> cols;
+  cols.push_back(0);
+  RowMatchIndex index;
+  int out = 0;
+  int next = 300;
+  for (int i=0; i<5000 && out==0; i++) {
+    int h = sheet.height();
+    int op = (h==0)?0:pick(6);
+    switch (op) {
+    case 0:
+    case 1:
+      {
+	int y = pick(h+1);
+	sheet.insertRow(RowRef((y==h)?-1:y));
+	sheet.cellString(0,y,name(pick(60)));
+	sheet.cellString(1,y,name(next++));
+	index.rowInserted(sheet,y);
+      }
+      break;
+    case 2:
+      {
+	int from = pick(h);
+	int to = pick(h);
+	RowRef result = sheet.moveRow(RowRef(from),RowRef(to));
+	index.rowMoved(from,result.getIndex());
+      }
+      break;
+    case 3:
+      {
+	int y = pick(h);
+	sheet.cellString(0,y,name(pick(60)));
+	index.rowChanged(sheet,y);
+      }
+      break;
+    case 4:
+      if (pick(50)==0) {
+	vector<int> rows;
+	for (int y=0; y<h; y++) {
+	  if (pick(10)==0) rows.push_back(y);
+	}
+	sheet.deleteRowSet(rows);
+	index.rowsRemoved(rows);
+      } else {
+	int y = pick(h);
+	sheet.deleteRow(RowRef(y));
+	index.rowRemoved(y);
+      }
+      break;
+    default:
+      break;
+    }
+    out += check(index,sheet,cols,name(pick(60)));
+  }
+  if (out==0) {
+    printf("Index agrees with the table, %d rows\n", sheet.height());
+  }
+  return (out==0)?0:1;
+}
@@ -6,16 +6,63 @@
 #include <string>
 
 #include <coopy/CsvFile.h>
+#include <coopy/MmapCsvSheet.h>
 #include <coopy/DataStat.h>
 #include <coopy/SheetCompare.h>
 #include <coopy/MergeOutputCsvDiff.h>
 #include <coopy/Dbg.h>
 #include <coopy/Coopy.h>
+#include <coopy/RowDigests.h>
 
 using namespace coopy::store;
 using namespace coopy::cmp;
 using namespace coopy::app;
 
+static bool reorder(DataSheet& sheet, bool generic,
+		    const std::vector<int>& order) {
+  // generic calls the implementation every table inherits
+  return generic?sheet.DataSheet::reorderRows(order):sheet.reorderRows(order);
+}
+
+// A bad order must be refused with the table untouched; a good one
+// must leave row i holding what was row order[i].
+static int checkReorder(DataSheet& sheet, bool generic, 
+			const DataSheet& orig, const char *name) {
+  int failures = 0;
+  int h = orig.height();
+  std::vector<int> good;
+  for (int y=h-1; y>=0; y--) {
+    if (y%3!=1) good.push_back(y);
+  }
+  std::vector<int> twice(good);
+  twice.push_back(good.back());
+  std::vector<int> outside(good);
+  outside.push_back(h);
+  std::string hash = orig.getHash(false);
+  if (reorder(sheet,generic,twice)||sheet.getHash(false)!=hash) {
+    printf("%s: order listing a row twice was not refused cleanly\n", name);
+    failures++;
+  }
+  if (reorder(sheet,generic,outside)||sheet.getHash(false)!=hash) {
+    printf("%s: order listing a missing row was not refused cleanly\n", 
+	   name);
+    failures++;
+  }
+  if (!reorder(sheet,generic,good)||sheet.height()!=(int)good.size()) {
+    printf("%s: good order failed\n", name);
+    return failures+1;
+  }
+  for (int i=0; i<(int)good.size(); i++) {
+    for (int x=0; x<orig.width(); x++) {
+      if (sheet.cellString(x,i)!=orig.cellString(x,good[i])) {
+	printf("%s: row %d does not hold row %d\n", name, i, good[i]);
+	return failures+1;
+      }
+    }
+  }
+  return failures;
+}
+
 int main(int argc, char *argv[]) {
   int c;
   int result = 0;
@@ -33,6 +80,11 @@ int main(int argc, char *argv[]) {
     int option_index = 0;
     static struct option long_options[] = {
       {"read", 1, 0, 'r'},
+      {"read_columnar", 1, 0, 'C'},
+      {"read_dictionary", 1, 0, 'D'},
+      {"read_mmap", 1, 0, 'M'},
+      {"read_plain", 1, 0, 'N'},
+      {"read_threads", 1, 0, 'T'},
       {"write", 1, 0, 'w'},
       {"save", 1, 0, 's'},
       {"prop", 1, 0, 'p'},
@@ -76,6 +128,55 @@ int main(int argc, char *argv[]) {
 	dirty = true;
       }
       break;
+    case 'C':
+    case 'D':
+      if (optarg) {
+	ColumnarSheet col;
+	col.setDictionary(c=='D');
+	Property config;
+	CsvFile::read(optarg,col,config);
+	ss->copy(col);
+	printf("Read %s as columns (%dx%d)\n", optarg, ss->width(), 
+	       ss->height());
+	dirty = true;
+      }
+      break;
+    case 'N':
+      if (optarg) {
+	Property config;
+	config.put("fast_scan",false);
+	CsvFile::read(optarg,*ss,config);
+	printf("Read %s without fast scan (%dx%d)\n", optarg, ss->width(), 
+	       ss->height());
+	dirty = true;
+      }
+      break;
+    case 'T':
+      if (optarg) {
+	Property config;
+	config.put("read_threads",4);
+	// small parts, so that even short files are split up
+	config.put("chunk_bytes",16);
+	CsvFile::read(optarg,*ss,config);
+	printf("Read %s on threads (%dx%d)\n", optarg, ss->width(), 
+	       ss->height());
+	dirty = true;
+      }
+      break;
+    case 'M':
+      if (optarg) {
+	MmapCsvSheet mapped;
+	Property config;
+	if (!mapped.open(optarg,config)) {
+	  printf("Could not map %s\n", optarg);
+	  return 1;
+	}
+	ss->copy(mapped);
+	printf("Read %s as mapped (%dx%d)\n", optarg, ss->width(), 
+	       ss->height());
+	dirty = true;
+      }
+      break;
     case 'w':
       if (optarg) {
 	CsvFile::write(*ss,optarg);
@@ -100,6 +201,35 @@ int main(int argc, char *argv[]) {
 	} else if (prop=="diffs") {
 	  result = diffs;
 	  printf("diffs is %d\n", result);
+	} else if (prop=="sha1_match"||prop=="fast_match") {
+	  int kind = (prop=="sha1_match")?Hasher::HASH_SHA1:Hasher::HASH_FAST;
+	  std::string h1 = local.getHash(false,kind);
+	  std::string h2 = remote.getHash(false,kind);
+	  result = (h1==h2)?1:0;
+	  printf("%s is %d (%s vs %s)\n", prop.c_str(), result,
+		 h1.c_str(), h2.c_str());
+	} else if (prop=="reorder_failures") {
+	  CsvSheet typed;
+	  typed.copy(local);
+	  CsvSheet generic;
+	  generic.copy(local);
+	  ColumnarSheet col;
+	  col.copyData(local);
+	  result = checkReorder(typed,false,local,"typed");
+	  result += checkReorder(generic,true,local,"generic");
+	  result += checkReorder(col,false,local,"columnar");
+	  printf("reorder_failures is %d\n", result);
+	} else if (prop=="differing_rows") {
+	  std::vector<std::pair<int,int> > ranges;
+	  local.updateRowDigests();
+	  remote.updateRowDigests();
+	  RowDigests::differingRanges(local,remote,ranges);
+	  result = 0;
+	  for (int i=0; i<(int)ranges.size(); i++) {
+	    result += ranges[i].second-ranges[i].first;
+	  }
+	  printf("differing_rows is %d (%d ranges)\n", result,
+		 (int)ranges.size());
 	}
       }
       break;
@@ -1,11 +1,54 @@
 #include <coopy/Viterbi.h>
 
-using namespace coopy::store;
+#include <stdio.h>
+#include <stdlib.h>
+
 using namespace coopy::cmp;
 
+// Two paths: staying in state 0 is cheapest at first but costly at
+// the end, staying in state 1 costs more at first but less overall.
+// A narrow beam drops state 1 after the first step.
+static int checkTrap(float beam, int expect_state, float expect_cost) {
+  Viterbi v;
+  v.setSize(2,5);
+  v.setBeam(beam);
+  v.beginTransitions();
+  v.addTransition(0,0,0);
+  v.addTransition(0,1,2);
+  v.endTransitions();
+  for (int i=0; i<3; i++) {
+    v.beginTransitions();
+    v.addTransition(0,0,0);
+    v.addTransition(1,1,0);
+    v.endTransitions();
+  }
+  v.beginTransitions();
+  v.addTransition(0,0,10);
+  v.addTransition(1,1,0);
+  v.endTransitions();
+  int out = 0;
+  for (int i=0; i<5; i++) {
+    if (v(i)!=expect_state) {
+      out++;
+    }
+  }
+  if (v.getCost()!=expect_cost) {
+    out++;
+  }
+  printf("beam %g: ", beam);
+  v.showPath();
+  if (out!=0) {
+    printf("Path through trap is incorrect\n");
+  }
+  return out;
+}
+
 int main(int argc, char *argv[]) {
   Viterbi v;
   v.setSize(10,100);
+  if (argc>1) {
+    v.setBeam(atof(argv[1]));
+  }
   v.beginTransitions();
   v.addTransition(0,0,1);
   v.endTransitions();
@@ -25,5 +68,11 @@ int main(int argc, char *argv[]) {
   if (out!=0) {
     printf("Path is incorrect\n");
   }
+
+  // no beam, or a wide one, finds the cheapest path
+  out += checkTrap(0,1,2);
+  out += checkTrap(5,1,2);
+  // a narrow beam prunes it, and settles for the other
+  out += checkTrap(1,0,10);
   return (out==0)?0:1;
 }